@@ -0,0 +1,179 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CpuFilter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if CPU_FILTER_USE_SIMD && defined( _MSC_VER )
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Number of rows that a thread processes at a time
+const int kBandHeight = 16;
+
+#if CPU_FILTER_USE_SIMD
+
+#if defined( _MSC_VER )
+bool hasSse41()
+{
+	int info[4];
+	__cpuid( info, 1 );
+	return ( info[2] & ( 1 << 19 ) ) != 0;
+}
+
+bool hasAvx2()
+{
+	int info[4];
+	__cpuid( info, 0 );
+	if( info[0] < 7 )
+		return false;
+
+	// The operating system should save the AVX registers too
+	__cpuid( info, 1 );
+	const bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+	const bool avx = ( info[2] & ( 1 << 28 ) ) != 0;
+	if( !osxsave || !avx || ( _xgetbv( 0 ) & 6 ) != 6 )
+		return false;
+
+	__cpuidex( info, 7, 0 );
+	return ( info[1] & ( 1 << 5 ) ) != 0;
+}
+#else
+bool hasSse41()
+{
+	return __builtin_cpu_supports( "sse4.1" ) != 0;
+}
+
+bool hasAvx2()
+{
+	return __builtin_cpu_supports( "avx2" ) != 0;
+}
+#endif
+
+#endif // CPU_FILTER_USE_SIMD
+
+} // anonymous namespace
+
+CpuFilter::CpuFilter()
+    : mKernel( AUTO )
+    , mNumThreads( 0 )
+{
+}
+
+bool CpuFilter::isSupported( Kernel kernel )
+{
+	switch( kernel ) {
+	case SCALAR:
+	case AUTO:
+		return true;
+#if CPU_FILTER_USE_SIMD
+	case SSE41:
+		return hasSse41();
+	case AVX2:
+		return hasAvx2();
+#endif
+	default:
+		return false;
+	}
+}
+
+const char *CpuFilter::getKernelName( Kernel kernel )
+{
+	switch( kernel ) {
+	case SCALAR:
+		return "Scalar";
+	case SSE41:
+		return "SSE4.1";
+	case AVX2:
+		return "AVX2";
+	default:
+		return "Auto";
+	}
+}
+
+CpuFilter::Kernel CpuFilter::getKernel() const
+{
+	if( mKernel != AUTO && isSupported( mKernel ) )
+		return mKernel;
+
+	return isSupported( AVX2 ) ? AVX2 : ( isSupported( SSE41 ) ? SSE41 : SCALAR );
+}
+
+unsigned CpuFilter::getNumThreads() const
+{
+	if( mNumThreads > 0 )
+		return mNumThreads;
+
+	return std::max( std::thread::hardware_concurrency(), 1u );
+}
+
+int CpuFilter::getNumBands( int height )
+{
+	return ( height + kBandHeight - 1 ) / kBandHeight;
+}
+
+void CpuFilter::processBands( int height, int numPasses, const std::function<void( int, int, int, int )> &process ) const
+{
+	const int numBands = getNumBands( height );
+	if( numBands <= 0 || numPasses <= 0 )
+		return;
+
+	const unsigned numThreads = std::min( getNumThreads(), unsigned( numBands ) );
+
+	// Each pass has its own counter, so no thread has to reset it
+	std::unique_ptr<std::atomic<int>[]> nextBand( new std::atomic<int>[numPasses] );
+	for( int pass = 0; pass < numPasses; ++pass )
+		nextBand[pass] = 0;
+
+	std::atomic<unsigned> numWaiting( 0 );
+
+	auto work = [&]() {
+		for( int pass = 0; pass < numPasses; ++pass ) {
+			// Wait until all threads have finished the previous pass
+			if( pass > 0 ) {
+				++numWaiting;
+				while( numWaiting < unsigned( pass ) * numThreads )
+					std::this_thread::yield();
+			}
+
+			for( int band = nextBand[pass]++; band < numBands; band = nextBand[pass]++ )
+				process( pass, band, band * kBandHeight, std::min( ( band + 1 ) * kBandHeight, height ) );
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for( unsigned i = 1; i < numThreads; ++i )
+		threads.emplace_back( work );
+
+	work();
+
+	for( auto &thread : threads )
+		thread.join();
+}
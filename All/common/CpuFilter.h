@@ -0,0 +1,82 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Surface.h"
+
+#include <functional>
+
+// The SSE4.1 and AVX2 kernels are compiled for their instruction set with a target attribute, so the rest
+// of the code still runs on any processor. Visual C++ does not need the attribute.
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ )
+#define CPU_FILTER_USE_SIMD 1
+#if defined( _MSC_VER )
+#define CPU_FILTER_TARGET_SSE41
+#define CPU_FILTER_TARGET_AVX2
+#else
+#define CPU_FILTER_TARGET_SSE41 __attribute__( ( target( "sse4.1" ) ) )
+#define CPU_FILTER_TARGET_AVX2 __attribute__( ( target( "avx2" ) ) )
+#endif
+#else
+#define CPU_FILTER_USE_SIMD 0
+#endif
+
+// Base class of the anti-aliasing filters that run on the CPU, like FXAACpu and SMAACpu. Selects the fastest
+// kernel the processor supports and divides the rows of the image into bands, which are processed by multiple threads.
+class CpuFilter {
+  public:
+	enum Kernel { SCALAR, SSE41, AVX2, AUTO };
+
+	virtual ~CpuFilter() {}
+
+	// Applies the filter to the source and writes the result to the destination. The destination should have the same
+	// size and channel order, and can not be the same surface.
+	virtual void apply( ci::Surface8u &destination, const ci::Surface8u &source ) = 0;
+
+	// Selects the kernel. AUTO selects the fastest one this processor supports, which is also used
+	// if the selected kernel is not supported.
+	void   setKernel( Kernel kernel ) { mKernel = kernel; }
+	Kernel getKernel() const;
+
+	static bool        isSupported( Kernel kernel );
+	static const char *getKernelName( Kernel kernel );
+
+	// Sets the number of threads. Zero uses one thread for each core.
+	void     setNumThreads( unsigned numThreads ) { mNumThreads = numThreads; }
+	unsigned getNumThreads() const;
+
+  protected:
+	CpuFilter();
+
+	// Returns the number of bands of an image with the given height.
+	static int getNumBands( int height );
+
+	// Calls process( pass, band, begin, end ) for each band of rows [begin, end) of an image with the given height,
+	// once for each pass. Threads take bands until none are left and wait for each other before they start the next
+	// pass, so a pass can read what the previous pass wrote to other bands.
+	void processBands( int height, int numPasses, const std::function<void( int, int, int, int )> &process ) const;
+
+  private:
+	Kernel   mKernel;
+	unsigned mNumThreads;
+};
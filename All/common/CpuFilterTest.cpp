@@ -0,0 +1,192 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CpuFilterTest.h"
+
+#include "cinder/Rand.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace ci;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double getSeconds( Clock::time_point start )
+{
+	return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+} // anonymous namespace
+
+Surface8u createTestImage( int width, int height, bool hasAlpha )
+{
+	Surface8u surface( width, height, hasAlpha );
+
+	const uint8_t red = surface.getRedOffset();
+	const uint8_t green = surface.getGreenOffset();
+	const uint8_t blue = surface.getBlueOffset();
+
+	auto setPixel = [&]( int x, int y, int r, int g, int b ) {
+		uint8_t *pixel = surface.getData() + y * surface.getRowBytes() + x * surface.getPixelInc();
+		pixel[red] = uint8_t( r );
+		pixel[green] = uint8_t( g );
+		pixel[blue] = uint8_t( b );
+		if( hasAlpha )
+			pixel[surface.getAlphaOffset()] = uint8_t( ( 299 * r + 587 * g + 114 * b + 500 ) / 1000 );
+	};
+
+	// A smooth background, which anti-aliasing should leave alone
+	for( int y = 0; y < height; ++y )
+		for( int x = 0; x < width; ++x )
+			setPixel( x, y, 32 + 64 * x / width, 32 + 64 * y / height, 64 );
+
+	// The same triangles at every resolution, so the fraction of pixels on an edge drops as the resolution goes up
+	Rand rand( 12345 );
+
+	for( int i = 0; i < 400; ++i ) {
+		const vec2  center( rand.nextFloat() * width, rand.nextFloat() * height );
+		const float radius = ( 0.02f + 0.1f * rand.nextFloat() ) * height;
+
+		vec2 p[3];
+		for( auto &point : p ) {
+			const float angle = rand.nextFloat() * 6.2831853f;
+			point = center + radius * vec2( std::cos( angle ), std::sin( angle ) );
+		}
+
+		const int r = int( 255 * rand.nextFloat() );
+		const int g = int( 255 * rand.nextFloat() );
+		const int b = int( 255 * rand.nextFloat() );
+
+		const int x0 = std::max( 0, int( std::min( { p[0].x, p[1].x, p[2].x } ) ) );
+		const int x1 = std::min( width - 1, int( std::max( { p[0].x, p[1].x, p[2].x } ) ) );
+		const int y0 = std::max( 0, int( std::min( { p[0].y, p[1].y, p[2].y } ) ) );
+		const int y1 = std::min( height - 1, int( std::max( { p[0].y, p[1].y, p[2].y } ) ) );
+
+		auto side = [&]( const vec2 &a, const vec2 &b, const vec2 &c ) { return ( b.x - a.x ) * ( c.y - a.y ) - ( b.y - a.y ) * ( c.x - a.x ); };
+		const float area = side( p[0], p[1], p[2] );
+
+		// A pixel is covered if its center is on the inside of all three edges
+		for( int y = y0; y <= y1; ++y ) {
+			for( int x = x0; x <= x1; ++x ) {
+				const vec2 c( x + 0.5f, y + 0.5f );
+				if( side( p[0], p[1], c ) * area >= 0.0f && side( p[1], p[2], c ) * area >= 0.0f && side( p[2], p[0], c ) * area >= 0.0f )
+					setPixel( x, y, r, g, b );
+			}
+		}
+	}
+
+	return surface;
+}
+
+int compareSurfaces( const Surface8u &a, const Surface8u &b, int tolerance, size_t *numDifferent, bool compareAlpha )
+{
+	int offsetsA[4] = { a.getRedOffset(), a.getGreenOffset(), a.getBlueOffset(), 0 };
+	int offsetsB[4] = { b.getRedOffset(), b.getGreenOffset(), b.getBlueOffset(), 0 };
+	int numChannels = 3;
+
+	if( compareAlpha && a.hasAlpha() && b.hasAlpha() ) {
+		offsetsA[3] = a.getAlphaOffset();
+		offsetsB[3] = b.getAlphaOffset();
+		numChannels = 4;
+	}
+
+	int maxDifference = 0;
+	*numDifferent = 0;
+
+	for( int y = 0; y < a.getHeight(); ++y ) {
+		const uint8_t *pa = a.getData() + y * a.getRowBytes();
+		const uint8_t *pb = b.getData() + y * b.getRowBytes();
+
+		for( int x = 0; x < a.getWidth(); ++x, pa += a.getPixelInc(), pb += b.getPixelInc() ) {
+			int difference = 0;
+			for( int c = 0; c < numChannels; ++c )
+				difference = std::max( difference, std::abs( pa[offsetsA[c]] - pb[offsetsB[c]] ) );
+
+			if( difference > tolerance )
+				++*numDifferent;
+			maxDifference = std::max( maxDifference, difference );
+		}
+	}
+
+	return maxDifference;
+}
+
+bool benchmarkKernels( CpuFilter &filter, const Surface8u &source, const Surface8u &reference, double seconds )
+{
+	const int    width = source.getWidth();
+	const int    height = source.getHeight();
+	const double megapixels = 1e-6 * width * height;
+
+	const unsigned numCores = std::max( std::thread::hardware_concurrency(), 1u );
+	const unsigned threads[] = { 1, numCores };
+	const int      numThreadCounts = numCores > 1 ? 2 : 1;
+
+	const CpuFilter::Kernel kernels[] = { CpuFilter::SCALAR, CpuFilter::SSE41, CpuFilter::AVX2 };
+
+	bool      isValid = true;
+	Surface8u result( width, height, source.hasAlpha(), source.getChannelOrder() );
+
+	for( auto kernel : kernels ) {
+		if( !CpuFilter::isSupported( kernel ) ) {
+			std::printf( "  %-7s not supported by this processor\n", CpuFilter::getKernelName( kernel ) );
+			continue;
+		}
+
+		for( int i = 0; i < numThreadCounts; ++i ) {
+			filter.setKernel( kernel );
+			filter.setNumThreads( threads[i] );
+
+			// Run once to allocate the buffers, then for at least the specified time
+			std::memset( result.getData(), 0, size_t( result.getRowBytes() ) * height );
+			filter.apply( result, source );
+
+			int  numFrames = 0;
+			auto start = Clock::now();
+			do {
+				filter.apply( result, source );
+				++numFrames;
+			} while( getSeconds( start ) < seconds );
+			const double time = getSeconds( start ) / numFrames;
+
+			size_t    numDifferent;
+			const int maxDifference = compareSurfaces( reference, result, 0, &numDifferent, true );
+
+			std::printf( "  %-7s %2u thread(s) %8.2f ms %8.1f MP/s, max difference %d (%lu pixels)\n", CpuFilter::getKernelName( kernel ), threads[i], 1e3 * time, megapixels / time, maxDifference,
+			             (unsigned long)numDifferent );
+
+			if( maxDifference > 0 ) {
+				std::printf( "  FAILED: the result differs from the scalar kernel\n" );
+				isValid = false;
+			}
+		}
+	}
+
+	return isValid;
+}
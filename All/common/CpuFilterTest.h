@@ -0,0 +1,47 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "CpuFilter.h"
+
+#include "cinder/Surface.h"
+
+#include <cstddef>
+
+// Helpers to verify and measure the anti-aliasing filters that run on the CPU, used by the benchmarks and by the
+// comparison with the GPU in the samples.
+
+// The result of a CpuFilter matches the GPU if at most this percentage of the pixels differ by more than one level.
+const double kGpuTolerancePercentage = 1.0;
+
+// Renders random triangles without anti-aliasing on a smooth background. If \a hasAlpha is true, stores the luminance
+// in the alpha channel, like the Pistons shader.
+ci::Surface8u createTestImage( int width, int height, bool hasAlpha );
+
+// Returns the largest difference between the channels of two surfaces of the same size and counts the pixels that
+// differ by more than \a tolerance. Alpha is ignored, unless \a compareAlpha is true and both surfaces have it.
+int compareSurfaces( const ci::Surface8u &a, const ci::Surface8u &b, int tolerance, size_t *numDifferent, bool compareAlpha );
+
+// Applies \a filter to \a source with each kernel, on a single thread and on all cores, for at least \a seconds per
+// measurement. Prints the throughput and returns false if any result differs from \a reference.
+bool benchmarkKernels( CpuFilter &filter, const ci::Surface8u &source, const ci::Surface8u &reference, double seconds );
@@ -0,0 +1,767 @@
+/*
+ Copyright (c) 2016, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MeshFile.h"
+
+#include "cinder/gl/Vbo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#if defined( CINDER_MSW )
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace ci;
+
+namespace {
+
+// Identifies the binary mesh file and its version. Increase the version whenever the layout changes.
+const char     kMagic[4] = { 'M', 'E', 'S', 'H' };
+const uint32_t kVersion = 1;
+const uint64_t kAlignment = 64;
+
+const uint32_t kHasNormals = 1 << 0;
+const uint32_t kHasTexCoords = 1 << 1;
+
+// 64 bytes, so the first array is aligned as well.
+struct FileHeader {
+	char     mMagic[4];
+	uint32_t mVersion;
+	uint32_t mNumVertices;
+	uint32_t mNumIndices;
+	uint32_t mFlags;
+	uint32_t mReserved;
+	uint64_t mPositionsOffset;
+	uint64_t mNormalsOffset;
+	uint64_t mTexCoordsOffset;
+	uint64_t mIndicesOffset;
+	uint64_t mSize;
+};
+
+static_assert( sizeof( FileHeader ) <= kAlignment, "The file header should fit in the first 64 bytes." );
+
+inline uint64_t align( uint64_t offset )
+{
+	return ( offset + kAlignment - 1 ) & ~( kAlignment - 1 );
+}
+
+// Chunks smaller than this are not worth a thread of their own.
+const size_t kMinChunkSize = 64 * 1024;
+
+// Marks a missing texture coordinate or normal index.
+const int32_t kMissing = INT32_MIN;
+// Negative OBJ indices are relative to the end of the vertex list. While parsing a chunk, we do not know yet how many vertices
+// came before it, so they are stored relative to the start of the chunk, offset by this bias to tell them apart.
+const int32_t kRelative = 1 << 29;
+
+struct Corner {
+	int32_t mPosition, mTexCoord, mNormal;
+};
+
+struct Chunk {
+	const char *mBegin;
+	const char *mEnd;
+
+	std::vector<vec3>   mPositions;
+	std::vector<vec2>   mTexCoords;
+	std::vector<vec3>   mNormals;
+	std::vector<Corner> mCorners; // Three per triangle.
+
+	std::string mError;
+};
+
+// Runs \a fn( index ) for each index in [0, count) on its own thread.
+template <typename Fn>
+void parallelFor( size_t count, Fn fn )
+{
+	if( count == 1 ) {
+		fn( size_t( 0 ) );
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	threads.reserve( count );
+	for( size_t i = 0; i < count; ++i )
+		threads.emplace_back( fn, i );
+	for( auto &thread : threads )
+		thread.join();
+}
+
+inline bool isSpace( char c )
+{
+	return c == ' ' || c == '\t';
+}
+
+inline const char *skipSpaces( const char *p, const char *end )
+{
+	while( p < end && isSpace( *p ) )
+		++p;
+	return p;
+}
+
+// Parses a decimal floating point number without locale or allocations, like std::from_chars (which is not available
+// in all compilers we support). Returns a pointer past the number, or nullptr if there is no number.
+const char *parseFloat( const char *p, const char *end, float *value )
+{
+	static const double kPowers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	bool isNegative = false;
+	if( p < end && ( *p == '-' || *p == '+' ) )
+		isNegative = *p++ == '-';
+
+	uint64_t mantissa = 0;
+	int      exponent = 0;
+	int      numDigits = 0;
+	bool     hasDigits = false;
+
+	for( ; p < end && *p >= '0' && *p <= '9'; ++p, hasDigits = true ) {
+		if( numDigits < 19 ) {
+			mantissa = mantissa * 10 + uint64_t( *p - '0' );
+			numDigits += mantissa > 0 ? 1 : 0;
+		}
+		else
+			++exponent;
+	}
+
+	if( p < end && *p == '.' ) {
+		for( ++p; p < end && *p >= '0' && *p <= '9'; ++p, hasDigits = true ) {
+			if( numDigits < 19 ) {
+				mantissa = mantissa * 10 + uint64_t( *p - '0' );
+				numDigits += mantissa > 0 ? 1 : 0;
+				--exponent;
+			}
+		}
+	}
+
+	if( !hasDigits )
+		return nullptr;
+
+	if( p < end && ( *p == 'e' || *p == 'E' ) ) {
+		const char *q = p + 1;
+		bool        isNegativeExponent = false;
+		if( q < end && ( *q == '-' || *q == '+' ) )
+			isNegativeExponent = *q++ == '-';
+
+		if( q < end && *q >= '0' && *q <= '9' ) {
+			int e = 0;
+			for( ; q < end && *q >= '0' && *q <= '9'; ++q )
+				e = std::min( e * 10 + ( *q - '0' ), 9999 );
+			exponent += isNegativeExponent ? -e : e;
+			p = q;
+		}
+	}
+
+	double result = double( mantissa );
+	if( exponent != 0 && mantissa != 0 ) {
+		if( exponent > 0 && exponent <= 22 )
+			result *= kPowers[exponent];
+		else if( exponent < 0 && exponent >= -22 )
+			result /= kPowers[-exponent];
+		else
+			result *= std::pow( 10.0, double( exponent ) );
+	}
+
+	*value = float( isNegative ? -result : result );
+	return p;
+}
+
+// Parses a (possibly negative) integer. Returns a pointer past the number, or nullptr if there is no number.
+const char *parseInt( const char *p, const char *end, int32_t *value )
+{
+	bool isNegative = false;
+	if( p < end && ( *p == '-' || *p == '+' ) )
+		isNegative = *p++ == '-';
+
+	if( p >= end || *p < '0' || *p > '9' )
+		return nullptr;
+
+	int64_t result = 0;
+	for( ; p < end && *p >= '0' && *p <= '9'; ++p )
+		result = std::min<int64_t>( result * 10 + ( *p - '0' ), INT32_MAX );
+
+	*value = int32_t( isNegative ? -result : result );
+	return p;
+}
+
+// Converts a 1-based or negative OBJ index to a 0-based index, or to one relative to the start of the chunk.
+inline int32_t toIndex( int32_t index, size_t count )
+{
+	if( index > 0 )
+		return index - 1;
+	if( index < 0 )
+		return int32_t( count ) + index - kRelative;
+	return kMissing;
+}
+
+void parseChunk( Chunk &chunk )
+{
+	const char *p = chunk.mBegin;
+	const char *end = chunk.mEnd;
+
+	std::vector<Corner> polygon;
+
+	while( p < end ) {
+		const char *eol = static_cast<const char *>( std::memchr( p, '\n', end - p ) );
+		if( !eol )
+			eol = end;
+
+		const char *q = skipSpaces( p, eol );
+		const char *next = eol < end ? eol + 1 : end;
+
+		if( q + 1 < eol && q[0] == 'v' && isSpace( q[1] ) ) {
+			vec3 v;
+			q = parseFloat( skipSpaces( q + 1, eol ), eol, &v.x );
+			q = q ? parseFloat( skipSpaces( q, eol ), eol, &v.y ) : nullptr;
+			q = q ? parseFloat( skipSpaces( q, eol ), eol, &v.z ) : nullptr;
+			if( !q ) {
+				chunk.mError = "invalid vertex position";
+				return;
+			}
+			chunk.mPositions.push_back( v );
+		}
+		else if( q + 2 < eol && q[0] == 'v' && q[1] == 't' && isSpace( q[2] ) ) {
+			vec2 t;
+			q = parseFloat( skipSpaces( q + 2, eol ), eol, &t.x );
+			// The second coordinate is optional.
+			const char *r = q ? parseFloat( skipSpaces( q, eol ), eol, &t.y ) : nullptr;
+			if( !q ) {
+				chunk.mError = "invalid texture coordinate";
+				return;
+			}
+			if( !r )
+				t.y = 0.0f;
+			chunk.mTexCoords.push_back( t );
+		}
+		else if( q + 2 < eol && q[0] == 'v' && q[1] == 'n' && isSpace( q[2] ) ) {
+			vec3 n;
+			q = parseFloat( skipSpaces( q + 2, eol ), eol, &n.x );
+			q = q ? parseFloat( skipSpaces( q, eol ), eol, &n.y ) : nullptr;
+			q = q ? parseFloat( skipSpaces( q, eol ), eol, &n.z ) : nullptr;
+			if( !q ) {
+				chunk.mError = "invalid normal";
+				return;
+			}
+			chunk.mNormals.push_back( n );
+		}
+		else if( q + 1 < eol && q[0] == 'f' && isSpace( q[1] ) ) {
+			// Each corner is v, v/t, v//n or v/t/n.
+			polygon.clear();
+			q = skipSpaces( q + 1, eol );
+			while( q < eol && *q != '\r' ) {
+				Corner  corner = { kMissing, kMissing, kMissing };
+				int32_t index;
+
+				q = parseInt( q, eol, &index );
+				if( !q ) {
+					chunk.mError = "invalid face";
+					return;
+				}
+				corner.mPosition = toIndex( index, chunk.mPositions.size() );
+
+				if( q < eol && *q == '/' ) {
+					++q;
+					if( q < eol && *q != '/' ) {
+						q = parseInt( q, eol, &index );
+						if( !q ) {
+							chunk.mError = "invalid face";
+							return;
+						}
+						corner.mTexCoord = toIndex( index, chunk.mTexCoords.size() );
+					}
+					if( q < eol && *q == '/' ) {
+						q = parseInt( q + 1, eol, &index );
+						if( !q ) {
+							chunk.mError = "invalid face";
+							return;
+						}
+						corner.mNormal = toIndex( index, chunk.mNormals.size() );
+					}
+				}
+
+				polygon.push_back( corner );
+				q = skipSpaces( q, eol );
+			}
+
+			// Triangulate the polygon as a fan.
+			for( size_t i = 2; i < polygon.size(); ++i ) {
+				chunk.mCorners.push_back( polygon[0] );
+				chunk.mCorners.push_back( polygon[i - 1] );
+				chunk.mCorners.push_back( polygon[i] );
+			}
+		}
+
+		p = next;
+	}
+}
+
+// Resolves an index of a corner in a chunk to an index in the whole file. Returns false if it is out of range.
+inline bool resolve( int32_t &index, size_t offset, size_t count )
+{
+	if( index == kMissing )
+		return true;
+
+	int64_t resolved = index;
+	if( index < 0 )
+		resolved = int64_t( index ) + kRelative + int64_t( offset );
+
+	if( resolved < 0 || resolved >= int64_t( count ) )
+		return false;
+
+	index = int32_t( resolved );
+	return true;
+}
+
+inline uint32_t hashCorner( const Corner &corner )
+{
+	uint32_t h = uint32_t( corner.mPosition ) * 0x9E3779B1u;
+	h ^= uint32_t( corner.mTexCoord ) * 0x85EBCA77u;
+	h ^= uint32_t( corner.mNormal ) * 0xC2B2AE3Du;
+	return h ^ ( h >> 15 );
+}
+
+// Returns the thread that takes care of merging corners with this hash. Uses the upper bits, because the lower bits select the slot in the hash table.
+inline size_t getPartition( uint32_t hash, size_t numThreads )
+{
+	return size_t( ( uint64_t( hash ) * numThreads ) >> 32 );
+}
+
+inline bool operator==( const Corner &a, const Corner &b )
+{
+	return a.mPosition == b.mPosition && a.mTexCoord == b.mTexCoord && a.mNormal == b.mNormal;
+}
+
+} // anonymous namespace
+
+MeshData ObjParser::parse( const char *text, size_t size, size_t numThreads )
+{
+	if( numThreads == 0 )
+		numThreads = std::max( 1u, std::thread::hardware_concurrency() );
+	numThreads = std::max<size_t>( 1, std::min( numThreads, size / kMinChunkSize ) );
+
+	// Split the file into chunks, each ending at a line break.
+	std::vector<Chunk> chunks( numThreads );
+	const char        *begin = text;
+	const char        *end = text + size;
+	for( size_t i = 0; i < numThreads; ++i ) {
+		const char *chunkEnd = ( i + 1 == numThreads ) ? end : std::max( begin, text + size * ( i + 1 ) / numThreads );
+		while( chunkEnd < end && chunkEnd > begin && chunkEnd[-1] != '\n' )
+			++chunkEnd;
+
+		chunks[i].mBegin = begin;
+		chunks[i].mEnd = chunkEnd;
+		begin = chunkEnd;
+	}
+
+	parallelFor( numThreads, [&]( size_t i ) { parseChunk( chunks[i] ); } );
+
+	// Find out where the arrays of each chunk start in the arrays of the whole file.
+	std::vector<size_t> positionOffsets( numThreads + 1, 0 );
+	std::vector<size_t> texCoordOffsets( numThreads + 1, 0 );
+	std::vector<size_t> normalOffsets( numThreads + 1, 0 );
+	std::vector<size_t> cornerOffsets( numThreads + 1, 0 );
+	for( size_t i = 0; i < numThreads; ++i ) {
+		if( !chunks[i].mError.empty() )
+			throw MeshFileExc( "ObjParser: " + chunks[i].mError );
+
+		positionOffsets[i + 1] = positionOffsets[i] + chunks[i].mPositions.size();
+		texCoordOffsets[i + 1] = texCoordOffsets[i] + chunks[i].mTexCoords.size();
+		normalOffsets[i + 1] = normalOffsets[i] + chunks[i].mNormals.size();
+		cornerOffsets[i + 1] = cornerOffsets[i] + chunks[i].mCorners.size();
+	}
+
+	const size_t numPositions = positionOffsets[numThreads];
+	const size_t numTexCoords = texCoordOffsets[numThreads];
+	const size_t numNormals = normalOffsets[numThreads];
+	const size_t numCorners = cornerOffsets[numThreads];
+
+	if( numCorners == 0 )
+		throw MeshFileExc( "ObjParser: the file does not contain any faces" );
+	if( numCorners >= UINT32_MAX || std::max( numPositions, std::max( numTexCoords, numNormals ) ) >= size_t( kRelative ) )
+		throw MeshFileExc( "ObjParser: the file is too large" );
+
+	// Gather the attributes of all chunks, resolve the indices of all corners and calculate their hashes.
+	std::vector<vec3>     positions( numPositions );
+	std::vector<vec2>     texCoords( numTexCoords );
+	std::vector<vec3>     normals( numNormals );
+	std::vector<Corner>   corners( numCorners );
+	std::vector<uint32_t> hashes( numCorners );
+	std::vector<char>     isValid( numThreads, 1 );
+
+	parallelFor( numThreads, [&]( size_t i ) {
+		const Chunk &chunk = chunks[i];
+		std::copy( chunk.mPositions.begin(), chunk.mPositions.end(), positions.begin() + positionOffsets[i] );
+		std::copy( chunk.mTexCoords.begin(), chunk.mTexCoords.end(), texCoords.begin() + texCoordOffsets[i] );
+		std::copy( chunk.mNormals.begin(), chunk.mNormals.end(), normals.begin() + normalOffsets[i] );
+
+		for( size_t j = 0; j < chunk.mCorners.size(); ++j ) {
+			Corner corner = chunk.mCorners[j];
+			if( corner.mPosition == kMissing || !resolve( corner.mPosition, positionOffsets[i], numPositions ) || !resolve( corner.mTexCoord, texCoordOffsets[i], numTexCoords )
+			    || !resolve( corner.mNormal, normalOffsets[i], numNormals ) ) {
+				isValid[i] = 0;
+				return;
+			}
+
+			corners[cornerOffsets[i] + j] = corner;
+			hashes[cornerOffsets[i] + j] = hashCorner( corner );
+		}
+	} );
+
+	if( std::find( isValid.begin(), isValid.end(), 0 ) != isValid.end() )
+		throw MeshFileExc( "ObjParser: face index out of range" );
+
+	// Merge corners that share the same position, texture coordinate and normal. Each thread only takes care of the corners
+	// in its own partition of hashes, so no locking is needed, and finds the first corner with the same indices.
+	std::vector<uint32_t> first( numCorners );
+
+	parallelFor( numThreads, [&]( size_t t ) {
+		// Open addressing hash table, which is grown when it is half full.
+		size_t capacity = 1024;
+		while( capacity < numCorners / numThreads )
+			capacity *= 2;
+
+		std::vector<uint32_t> table( capacity, UINT32_MAX );
+		size_t                numUsed = 0;
+
+		for( uint32_t c = 0; c < uint32_t( numCorners ); ++c ) {
+			if( getPartition( hashes[c], numThreads ) != t )
+				continue;
+
+			if( 2 * ( numUsed + 1 ) > capacity ) {
+				std::vector<uint32_t> old( capacity * 2, UINT32_MAX );
+				old.swap( table );
+				capacity *= 2;
+				for( uint32_t entry : old ) {
+					if( entry == UINT32_MAX )
+						continue;
+
+					size_t slot = hashes[entry] & ( capacity - 1 );
+					while( table[slot] != UINT32_MAX )
+						slot = ( slot + 1 ) & ( capacity - 1 );
+					table[slot] = entry;
+				}
+			}
+
+			size_t slot = hashes[c] & ( capacity - 1 );
+			while( table[slot] != UINT32_MAX && !( corners[table[slot]] == corners[c] ) )
+				slot = ( slot + 1 ) & ( capacity - 1 );
+
+			if( table[slot] == UINT32_MAX ) {
+				table[slot] = c;
+				++numUsed;
+			}
+
+			first[c] = table[slot];
+		}
+	} );
+
+	// Number the vertices in order of their first appearance, so the result does not depend on the number of threads.
+	std::vector<uint32_t> vertices( numCorners );
+	uint32_t              numVertices = 0;
+	for( uint32_t c = 0; c < uint32_t( numCorners ); ++c ) {
+		if( first[c] == c )
+			vertices[c] = numVertices++;
+	}
+
+	MeshData mesh;
+	mesh.mPositions.resize( numVertices );
+	mesh.mTexCoords.resize( numTexCoords > 0 ? numVertices : 0 );
+	mesh.mNormals.resize( numNormals > 0 ? numVertices : 0 );
+	mesh.mIndices.resize( numCorners );
+
+	parallelFor( numThreads, [&]( size_t t ) {
+		const size_t cornerEnd = numCorners * ( t + 1 ) / numThreads;
+		for( size_t c = numCorners * t / numThreads; c < cornerEnd; ++c ) {
+			const uint32_t vertex = vertices[first[c]];
+			mesh.mIndices[c] = vertex;
+
+			if( first[c] != c )
+				continue;
+
+			const Corner &corner = corners[c];
+			mesh.mPositions[vertex] = positions[corner.mPosition];
+			if( !mesh.mTexCoords.empty() )
+				mesh.mTexCoords[vertex] = corner.mTexCoord != kMissing ? texCoords[corner.mTexCoord] : vec2( 0 );
+			if( !mesh.mNormals.empty() )
+				mesh.mNormals[vertex] = corner.mNormal != kMissing ? normals[corner.mNormal] : vec3( 0 );
+		}
+	} );
+
+	return mesh;
+}
+
+MeshData ObjParser::load( const fs::path &path, size_t numThreads )
+{
+	std::ifstream file( path.string().c_str(), std::ios::binary );
+	if( !file )
+		throw MeshFileExc( "ObjParser: could not open " + path.string() );
+
+	file.seekg( 0, std::ios::end );
+	const std::streamoff size = file.tellg();
+	file.seekg( 0, std::ios::beg );
+
+	std::vector<char> text( size_t( std::max<std::streamoff>( size, 1 ) ) );
+	if( size <= 0 || !file.read( text.data(), size ) )
+		throw MeshFileExc( "ObjParser: could not read " + path.string() );
+
+	return parse( text.data(), size_t( size ), numThreads );
+}
+
+/////////////////////////////////////
+
+MeshFile::MeshFile()
+    : mData( nullptr )
+    , mSize( 0 )
+    , mFile( nullptr )
+    , mMapping( nullptr )
+    , mNumVertices( 0 )
+    , mNumIndices( 0 )
+    , mPositions( nullptr )
+    , mNormals( nullptr )
+    , mTexCoords( nullptr )
+    , mIndices( nullptr )
+{
+}
+
+MeshFile::~MeshFile()
+{
+	unmap();
+}
+
+MeshFileRef MeshFile::open( const fs::path &path )
+{
+	MeshFileRef file( new MeshFile() );
+	file->map( path );
+
+	FileHeader header;
+	if( file->mSize < sizeof( header ) )
+		throw MeshFileExc( "MeshFile: " + path.string() + " is too small" );
+
+	std::memcpy( &header, file->mData, sizeof( header ) );
+	if( std::memcmp( header.mMagic, kMagic, sizeof( kMagic ) ) != 0 )
+		throw MeshFileExc( "MeshFile: " + path.string() + " is not a mesh file" );
+	if( header.mVersion != kVersion )
+		throw MeshFileExc( "MeshFile: " + path.string() + " has a different version" );
+
+	// Make sure all arrays are within the file, so a damaged file can not make us read outside of it.
+	auto isValid = [&]( uint64_t offset, uint64_t size ) { return offset % kAlignment == 0 && offset <= header.mSize && size <= header.mSize - offset; };
+
+	const uint64_t numVertices = header.mNumVertices;
+	const uint64_t numIndices = header.mNumIndices;
+
+	bool ok = header.mSize == file->mSize && numIndices % 3 == 0;
+	ok = ok && isValid( header.mPositionsOffset, numVertices * sizeof( vec3 ) );
+	ok = ok && isValid( header.mIndicesOffset, numIndices * sizeof( uint32_t ) );
+	ok = ok && ( !( header.mFlags & kHasNormals ) || isValid( header.mNormalsOffset, numVertices * sizeof( vec3 ) ) );
+	ok = ok && ( !( header.mFlags & kHasTexCoords ) || isValid( header.mTexCoordsOffset, numVertices * sizeof( vec2 ) ) );
+	if( !ok )
+		throw MeshFileExc( "MeshFile: " + path.string() + " is damaged" );
+
+	file->mNumVertices = header.mNumVertices;
+	file->mNumIndices = header.mNumIndices;
+	file->mPositions = reinterpret_cast<const vec3 *>( file->mData + header.mPositionsOffset );
+	file->mNormals = ( header.mFlags & kHasNormals ) ? reinterpret_cast<const vec3 *>( file->mData + header.mNormalsOffset ) : nullptr;
+	file->mTexCoords = ( header.mFlags & kHasTexCoords ) ? reinterpret_cast<const vec2 *>( file->mData + header.mTexCoordsOffset ) : nullptr;
+	file->mIndices = reinterpret_cast<const uint32_t *>( file->mData + header.mIndicesOffset );
+
+	// Catch indices that are out of range now, instead of on the GPU.
+	for( uint32_t i = 0; i < file->mNumIndices; ++i ) {
+		if( file->mIndices[i] >= file->mNumVertices )
+			throw MeshFileExc( "MeshFile: " + path.string() + " is damaged" );
+	}
+
+	return file;
+}
+
+MeshFileRef MeshFile::load( const fs::path &objPath, const fs::path &cachePath )
+{
+	bool isCached = fs::exists( cachePath ) && ( !fs::exists( objPath ) || fs::last_write_time( cachePath ) >= fs::last_write_time( objPath ) );
+	if( isCached ) {
+		try {
+			return open( cachePath );
+		}
+		catch( const MeshFileExc & ) {
+			// Written by a different version or damaged, so create it again.
+		}
+	}
+
+	write( cachePath, ObjParser::load( objPath ) );
+
+	return open( cachePath );
+}
+
+void MeshFile::write( const fs::path &path, const MeshData &mesh )
+{
+	if( mesh.mPositions.size() >= UINT32_MAX || mesh.mIndices.size() >= UINT32_MAX )
+		throw MeshFileExc( "MeshFile: the mesh is too large" );
+	if( ( !mesh.mNormals.empty() && mesh.mNormals.size() != mesh.mPositions.size() ) || ( !mesh.mTexCoords.empty() && mesh.mTexCoords.size() != mesh.mPositions.size() ) )
+		throw MeshFileExc( "MeshFile: all attributes should have the same number of vertices" );
+
+	FileHeader header;
+	std::memset( &header, 0, sizeof( header ) );
+	std::memcpy( header.mMagic, kMagic, sizeof( kMagic ) );
+	header.mVersion = kVersion;
+	header.mNumVertices = uint32_t( mesh.mPositions.size() );
+	header.mNumIndices = uint32_t( mesh.mIndices.size() );
+	header.mFlags = ( mesh.mNormals.empty() ? 0 : kHasNormals ) | ( mesh.mTexCoords.empty() ? 0 : kHasTexCoords );
+
+	// The attributes are stored one after the other, so they can be uploaded to a single buffer.
+	uint64_t offset = kAlignment;
+	header.mPositionsOffset = offset;
+	offset = align( offset + mesh.mPositions.size() * sizeof( vec3 ) );
+	header.mNormalsOffset = offset;
+	offset = align( offset + mesh.mNormals.size() * sizeof( vec3 ) );
+	header.mTexCoordsOffset = offset;
+	offset = align( offset + mesh.mTexCoords.size() * sizeof( vec2 ) );
+	header.mIndicesOffset = offset;
+	header.mSize = offset + mesh.mIndices.size() * sizeof( uint32_t );
+
+	std::ofstream file( path.string().c_str(), std::ios::binary | std::ios::trunc );
+	if( !file )
+		throw MeshFileExc( "MeshFile: could not create " + path.string() );
+
+	auto writeAt = [&]( uint64_t at, const void *data, size_t size ) {
+		static const char kZeros[kAlignment] = {};
+		while( uint64_t( file.tellp() ) < at )
+			file.write( kZeros, std::min<uint64_t>( kAlignment, at - uint64_t( file.tellp() ) ) );
+		if( size > 0 )
+			file.write( static_cast<const char *>( data ), size );
+	};
+
+	writeAt( 0, &header, sizeof( header ) );
+	writeAt( header.mPositionsOffset, mesh.mPositions.data(), mesh.mPositions.size() * sizeof( vec3 ) );
+	writeAt( header.mNormalsOffset, mesh.mNormals.data(), mesh.mNormals.size() * sizeof( vec3 ) );
+	writeAt( header.mTexCoordsOffset, mesh.mTexCoords.data(), mesh.mTexCoords.size() * sizeof( vec2 ) );
+	writeAt( header.mIndicesOffset, mesh.mIndices.data(), mesh.mIndices.size() * sizeof( uint32_t ) );
+
+	if( !file )
+		throw MeshFileExc( "MeshFile: could not write " + path.string() );
+}
+
+gl::VboMeshRef MeshFile::createVboMesh() const
+{
+	// Upload all attributes to a single buffer, straight from the mapped file.
+	const uint8_t *vertices = reinterpret_cast<const uint8_t *>( mPositions );
+	const uint8_t *verticesEnd = reinterpret_cast<const uint8_t *>( mPositions + mNumVertices );
+	if( mNormals )
+		verticesEnd = std::max( verticesEnd, reinterpret_cast<const uint8_t *>( mNormals + mNumVertices ) );
+	if( mTexCoords )
+		verticesEnd = std::max( verticesEnd, reinterpret_cast<const uint8_t *>( mTexCoords + mNumVertices ) );
+
+	auto vertexVbo = gl::Vbo::create( GL_ARRAY_BUFFER, verticesEnd - vertices, vertices, GL_STATIC_DRAW );
+	auto indexVbo = gl::Vbo::create( GL_ELEMENT_ARRAY_BUFFER, mNumIndices * sizeof( uint32_t ), mIndices, GL_STATIC_DRAW );
+
+	geom::BufferLayout layout;
+	layout.append( geom::Attrib::POSITION, 3, 0, 0 );
+	if( mNormals )
+		layout.append( geom::Attrib::NORMAL, 3, 0, reinterpret_cast<const uint8_t *>( mNormals ) - vertices );
+	if( mTexCoords )
+		layout.append( geom::Attrib::TEX_COORD_0, 2, 0, reinterpret_cast<const uint8_t *>( mTexCoords ) - vertices );
+
+	return gl::VboMesh::create( mNumVertices, GL_TRIANGLES, { { layout, vertexVbo } }, mNumIndices, GL_UNSIGNED_INT, indexVbo );
+}
+
+#if defined( CINDER_MSW )
+
+void MeshFile::map( const fs::path &path )
+{
+	HANDLE file = ::CreateFileW( path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( file == INVALID_HANDLE_VALUE )
+		throw MeshFileExc( "MeshFile: could not open " + path.string() );
+	mFile = file;
+
+	LARGE_INTEGER size;
+	if( !::GetFileSizeEx( file, &size ) || size.QuadPart == 0 ) {
+		unmap();
+		throw MeshFileExc( "MeshFile: could not map " + path.string() );
+	}
+
+	HANDLE mapping = ::CreateFileMappingW( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	mMapping = mapping;
+
+	mData = mapping ? static_cast<const uint8_t *>( ::MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) ) : nullptr;
+	if( !mData ) {
+		unmap();
+		throw MeshFileExc( "MeshFile: could not map " + path.string() );
+	}
+
+	mSize = size_t( size.QuadPart );
+}
+
+void MeshFile::unmap()
+{
+	if( mData )
+		::UnmapViewOfFile( mData );
+	if( mMapping )
+		::CloseHandle( mMapping );
+	if( mFile )
+		::CloseHandle( mFile );
+
+	mData = nullptr;
+	mSize = 0;
+	mMapping = nullptr;
+	mFile = nullptr;
+}
+
+#else
+
+void MeshFile::map( const fs::path &path )
+{
+	const int fd = ::open( path.string().c_str(), O_RDONLY );
+	if( fd < 0 )
+		throw MeshFileExc( "MeshFile: could not open " + path.string() );
+
+	// The mapping stays valid after the file has been closed.
+	struct stat info;
+	void       *data = MAP_FAILED;
+	if( ::fstat( fd, &info ) == 0 && info.st_size > 0 )
+		data = ::mmap( nullptr, size_t( info.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+	::close( fd );
+
+	if( data == MAP_FAILED )
+		throw MeshFileExc( "MeshFile: could not map " + path.string() );
+
+	mData = static_cast<const uint8_t *>( data );
+	mSize = size_t( info.st_size );
+}
+
+void MeshFile::unmap()
+{
+	if( mData )
+		::munmap( const_cast<uint8_t *>( mData ), mSize );
+
+	mData = nullptr;
+	mSize = 0;
+}
+
+#endif
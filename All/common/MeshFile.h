@@ -0,0 +1,111 @@
+/*
+ Copyright (c) 2016, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Exception.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Vector.h"
+#include "cinder/gl/VboMesh.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//! Triangle mesh with positions, normals and texture coordinates in separate arrays,
+//! so that each of them can be used directly, e.g. to build a bounding volume hierarchy.
+struct MeshData {
+	std::vector<ci::vec3> mPositions;
+	std::vector<ci::vec3> mNormals;   // Empty if the mesh has no normals.
+	std::vector<ci::vec2> mTexCoords; // Empty if the mesh has no texture coordinates.
+	std::vector<uint32_t> mIndices;
+};
+
+//! Parses Wavefront OBJ files on multiple threads. The file is split into chunks at line boundaries,
+//! which are parsed in parallel without allocating a string per line. After that, vertices that share
+//! the same position, normal and texture coordinate are merged in parallel. The result is the same
+//! regardless of the number of threads. Polygons are triangulated, materials and groups are ignored.
+class ObjParser {
+  public:
+	//! Parses the OBJ data in \a text, using up to \a numThreads threads (0 uses all cores). Throws MeshFileExc on error.
+	static MeshData parse( const char *text, size_t size, size_t numThreads = 0 );
+	//! Loads and parses an OBJ file. Throws MeshFileExc on error.
+	static MeshData load( const ci::fs::path &path, size_t numThreads = 0 );
+};
+
+typedef std::shared_ptr<class MeshFile> MeshFileRef;
+
+//! Versioned binary mesh file that is memory-mapped, so its vertices and indices can be copied straight to the GPU
+//! without parsing or copying them first. Each array starts at a 64-byte aligned offset. Because it is mapped,
+//! the data is only valid for as long as the MeshFile exists, so keep it around only while creating buffers.
+class MeshFile {
+  public:
+	~MeshFile();
+
+	//! Maps a binary mesh file. Throws MeshFileExc if it does not exist, is damaged or has a different version.
+	static MeshFileRef open( const ci::fs::path &path );
+	//! Maps the binary mesh file \a cachePath. If it does not exist or is older than \a objPath,
+	//! parses the OBJ file and writes the binary mesh file first. Throws MeshFileExc on error.
+	static MeshFileRef load( const ci::fs::path &objPath, const ci::fs::path &cachePath );
+	//! Writes \a mesh to a binary mesh file. Throws MeshFileExc on error.
+	static void write( const ci::fs::path &path, const MeshData &mesh );
+
+	//! Creates a VboMesh directly from the mapped file. Requires an OpenGL context.
+	ci::gl::VboMeshRef createVboMesh() const;
+
+	uint32_t getNumVertices() const { return mNumVertices; }
+	uint32_t getNumIndices() const { return mNumIndices; }
+	uint32_t getNumTriangles() const { return mNumIndices / 3; }
+
+	const ci::vec3 *getPositions() const { return mPositions; }
+	//! Returns nullptr if the mesh has no normals.
+	const ci::vec3 *getNormals() const { return mNormals; }
+	//! Returns nullptr if the mesh has no texture coordinates.
+	const ci::vec2 *getTexCoords() const { return mTexCoords; }
+	const uint32_t *getIndices() const { return mIndices; }
+
+  private:
+	MeshFile();
+
+	void map( const ci::fs::path &path );
+	void unmap();
+
+	const uint8_t *mData;
+	size_t         mSize;
+	void *         mFile; // Platform specific handles of the mapping.
+	void *         mMapping;
+
+	uint32_t        mNumVertices;
+	uint32_t        mNumIndices;
+	const ci::vec3 *mPositions;
+	const ci::vec3 *mNormals;
+	const ci::vec2 *mTexCoords;
+	const uint32_t *mIndices;
+};
+
+class MeshFileExc : public ci::Exception {
+  public:
+	MeshFileExc( const std::string &description )
+	    : ci::Exception( description )
+	{
+	}
+};
@@ -8,7 +8,7 @@ out vec4 fragColor;
 void main(void)
 {
 	// calculate glowing line strips based on texture coordinate
-	const float kResolution = 256.0;
+	const float kResolution = 128.0;
 	const float kCenter = 0.5;
 	const float kWidth = 0.02;
 
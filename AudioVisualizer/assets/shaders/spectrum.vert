@@ -1,36 +1,49 @@
 #version 150
 
 uniform float		uTexOffset;
-uniform sampler2D	uLeftTex;
-uniform sampler2D	uRightTex;
+uniform sampler2D	uSpectrumTex; // red = left channel, green = right channel
 
-uniform mat4 ciModelViewProjection;
+uniform int			uResolution; // number of vertices along each side of the mesh
+uniform vec2		uSize;       // size of the mesh
 
-in vec4 ciPosition;
-in vec4 ciColor;
-in vec2 ciTexCoord0;
+uniform mat4 ciModelViewProjection;
 
 out vec4 vertColor;
 out vec2 vertTexCoord0;
 
+vec3 hsv2rgb( vec3 c )
+{
+	vec3 p = abs( fract( c.xxx + vec3( 1.0, 2.0 / 3.0, 1.0 / 3.0 ) ) * 6.0 - 3.0 );
+	return c.z * mix( vec3( 1.0 ), clamp( p - 1.0, 0.0, 1.0 ), c.y );
+}
+
 void main(void)
 {	
+	// each instance is a triangle strip that connects two rows of the mesh,
+	// so we can reconstruct the grid position from the vertex and instance id
+	float s = float( gl_VertexID / 2 ) / float( uResolution - 1 );
+	float t = float( gl_InstanceID + gl_VertexID % 2 ) / float( uResolution - 1 );
+
+	// the texture only contains the perceptual bands, so we use all of them
+	vec2 texCoord = vec2( 1.0 - s, t );
+
 	// retrieve texture coordinate and offset it to scroll the texture
-	vec2 coord = ciTexCoord0 + vec2(0.0, uTexOffset);
+	vec2 coord = texCoord + vec2(0.0, uTexOffset);
 
-	// retrieve the FFT from left and right texture and average it
-	float fft = max(0.0001, mix( texture( uLeftTex, coord ).r, texture( uRightTex, coord ).r, 0.5));
+	// retrieve the FFT of the left and right channel and average it
+	vec2 spectrum = texture( uSpectrumTex, coord ).rg;
+	float fft = max(0.0001, mix( spectrum.r, spectrum.g, 0.5));
 
 	// convert to decibels
 	const float kLogBase10 = 1.0 / log(10.0);
 	float decibels = 10.0 * log( fft ) * kLogBase10;
 
 	// offset the vertex based on the decibels
-	vec4 vertex = ciPosition;
+	vec4 vertex = vec4( s * uSize.x, 0.0, t * uSize.y, 1.0 );
 	vertex.y += 2.0 * decibels;
 
-	// pass (unchanged) texture coordinates, bumped vertex and vertex color
-	vertTexCoord0 = ciTexCoord0;
-	vertColor = ciColor;
+	// pass texture coordinates, bumped vertex and vertex color
+	vertTexCoord0 = texCoord;
+	vertColor = vec4( hsv2rgb( vec3( s, 0.5, 0.75 ) ), 1.0 );
 	gl_Position = ciModelViewProjection * vertex;
 }
\ No newline at end of file
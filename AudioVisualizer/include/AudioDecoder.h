@@ -0,0 +1,60 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Filesystem.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+typedef std::shared_ptr<class AudioDecoder> AudioDecoderRef;
+
+//! Interface for decoders that convert an audio file to floating point samples. Decoders are created
+//! by file extension. WAV files are supported out of the box, other formats can be added by registering
+//! a factory function.
+class AudioDecoder {
+  public:
+	typedef std::function<AudioDecoderRef( const ci::fs::path & )> Factory;
+
+	virtual ~AudioDecoder() {}
+
+	//! Returns a decoder for \a path, based on its file extension, or an empty reference if the format is not supported.
+	//! Throws if the file could not be opened.
+	static AudioDecoderRef create( const ci::fs::path &path );
+	//! Registers a \a factory for files with the given \a extension (without the dot, case insensitive). Replaces existing factories.
+	static void registerFactory( const std::string &extension, const Factory &factory );
+
+	//! Returns the number of frames per second.
+	virtual size_t getSampleRate() const = 0;
+	//! Returns the number of samples per frame.
+	virtual size_t getNumChannels() const = 0;
+	//! Returns the total number of frames, or 0 if unknown.
+	virtual uint64_t getNumFrames() const = 0;
+
+	//! Reads up to \a numFrames frames of interleaved samples in the range [-1, 1] into \a buffer.
+	//! Returns the number of frames read, which is less than \a numFrames at the end of the file.
+	virtual size_t read( float *buffer, size_t numFrames ) = 0;
+};
@@ -0,0 +1,78 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! Converts a linear spectrum into a smaller number of perceptual frequency bands. Each band is a weighted
+//! average of the bins it covers. The weights are precomputed and stored sparsely: only the bins that
+//! contribute to a band are visited, using SSE if available. The bands can be smoothed over time in the
+//! same pass.
+class BandMapper {
+  public:
+	typedef enum { LOGARITHMIC, MEL, CONSTANT_Q } Scale;
+
+	//! Creates a mapper from \a numBins linear bins, covering 0 Hz up to half the \a sampleRate, to \a numBands bands
+	//! spaced according to \a scale between \a minFrequency and \a maxFrequency.
+	BandMapper( size_t numBins, double sampleRate, size_t numBands, Scale scale = MEL, double minFrequency = 30.0, double maxFrequency = 16000.0 );
+
+	//! Returns the number of linear bins.
+	size_t getNumBins() const { return mNumBins; }
+	//! Returns the number of bands.
+	size_t getNumBands() const { return mNumBands; }
+	//! Returns the scale of the bands.
+	Scale getScale() const { return mScale; }
+	//! Returns the center frequency of band \a index in Hz.
+	double getFrequency( size_t index ) const { return mFrequencies[index]; }
+
+	//! Sets how much of the previous value is kept when a band rises (\a attack) or falls (\a release), in the range [0, 1). Defaults to no smoothing.
+	void setSmoothing( float attack, float release );
+	//! Resets the smoothed bands to zero.
+	void reset();
+
+	//! Converts getNumBins() \a magnitudes to getNumBands() \a bands.
+	void process( const float *magnitudes, float *bands );
+
+  private:
+	// A band is a weighted sum of a range of bins. The range is padded to a multiple of four, so that it can be vectorized.
+	struct Kernel {
+		uint32_t mFirstBin;
+		uint32_t mNumBins;
+		uint32_t mOffset;
+	};
+
+	size_t mNumBins;
+	size_t mNumBands;
+	Scale  mScale;
+
+	std::vector<Kernel> mKernels;
+	std::vector<float>  mWeights;
+	std::vector<double> mFrequencies;
+
+	float mAttack;
+	float mRelease;
+
+	std::vector<float> mSmoothed;
+};
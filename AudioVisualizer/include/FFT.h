@@ -0,0 +1,62 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+//! Fast Fourier transform of real valued input. The transform size must be a power of two. Internally,
+//! the samples are packed into a complex sequence of half the size, which is transformed using
+//! radix-4 butterflies (followed by a single radix-2 pass if needed). The butterflies are vectorized
+//! using SSE if available. All buffers are allocated up front, so the transform itself does not allocate.
+class FFT {
+  public:
+	//! Creates a transform of \a size real samples. \a size must be a power of two and at least 4.
+	explicit FFT( size_t size );
+
+	//! Returns the number of real input samples.
+	size_t getSize() const { return mSize; }
+	//! Returns the number of frequency bins produced by magnitudes(), which is half the size.
+	size_t getNumBins() const { return mSize / 2; }
+
+	//! Transforms getSize() samples of \a input. Writes getNumBins() + 1 complex bins, from DC up to and including Nyquist, to \a real and \a imag.
+	void forward( const float *input, float *real, float *imag );
+	//! Transforms getSize() samples of \a input and writes the magnitude of the first getNumBins() bins to \a output, multiplied by \a scale.
+	void magnitudes( const float *input, float *output, float scale = 1.0f );
+
+  private:
+	//! Transforms the packed complex sequence in mReal and mImag in place.
+	void transform();
+
+  private:
+	size_t mSize;
+
+	std::vector<float> mReal, mImag;
+	std::vector<float> mWorkReal, mWorkImag;
+	std::vector<float> mTwiddles;
+	std::vector<float> mPackCos, mPackSin;
+};
+
+//! Fills \a window with a Hann window of \a size samples. Returns the scale factor that should be passed to FFT::magnitudes(),
+//! so that a full scale sine wave has a magnitude of about 1.
+float createHannWindow( size_t size, std::vector<float> &window );
@@ -0,0 +1,54 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "AudioDecoder.h"
+
+#include "FMOD.hpp"
+
+#include <vector>
+
+//! Decodes any format supported by FMOD, like MP3 and OGG, by reading the raw PCM data of a sound
+//! that was opened without playing it. The FMOD system must outlive the decoder.
+class FmodDecoder : public AudioDecoder {
+  public:
+	//! Opens the file at \a path using \a system. Throws if the file could not be opened or is not supported.
+	FmodDecoder( FMOD::System *system, const ci::fs::path &path );
+	~FmodDecoder();
+
+	size_t   getSampleRate() const override { return mSampleRate; }
+	size_t   getNumChannels() const override { return mNumChannels; }
+	uint64_t getNumFrames() const override { return mNumFrames; }
+
+	size_t read( float *buffer, size_t numFrames ) override;
+
+  private:
+	FMOD::Sound         *mSound;
+	FMOD_SOUND_FORMAT    mFormat;
+	std::vector<uint8_t> mBuffer;
+
+	size_t   mSampleRate;
+	size_t   mNumChannels;
+	size_t   mBytesPerSample;
+	uint64_t mNumFrames;
+};
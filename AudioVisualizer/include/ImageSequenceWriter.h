@@ -0,0 +1,75 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Filesystem.h"
+#include "cinder/Surface.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! Writes a sequence of images on background threads, so that encoding and saving the images does not
+//! stall rendering. The number of queued images is limited: if the threads can't keep up, write() blocks.
+class ImageSequenceWriter {
+  public:
+	//! Creates a writer that saves images to \a directory, named \a prefix followed by the zero padded index and \a extension,
+	//! which also determines the file format. At most \a capacity images are queued.
+	ImageSequenceWriter( const ci::fs::path &directory, const std::string &prefix = "frame_", const std::string &extension = "png", size_t numThreads = 2, size_t capacity = 8 );
+	//! Waits until all images have been written.
+	~ImageSequenceWriter();
+
+	//! Queues \a surface to be saved as image number \a index. Blocks while the queue is full.
+	void write( ci::Surface8u surface, size_t index );
+	//! Blocks until all queued images have been saved.
+	void finish();
+
+	//! Returns the number of images that were saved.
+	size_t getNumWritten() const;
+	//! Returns the number of images that could not be saved.
+	size_t getNumFailed() const;
+
+  private:
+	void work();
+
+  private:
+	ci::fs::path mDirectory;
+	std::string  mPrefix;
+	std::string  mExtension;
+	size_t       mCapacity;
+
+	std::vector<std::thread>                     mThreads;
+	std::deque<std::pair<ci::Surface8u, size_t>> mQueue;
+
+	mutable std::mutex      mMutex;
+	std::condition_variable mQueueChanged;
+
+	size_t mNumBusy;
+	size_t mNumWritten;
+	size_t mNumFailed;
+	bool   mIsRunning;
+};
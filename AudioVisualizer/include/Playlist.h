@@ -0,0 +1,91 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Filesystem.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//! Keeps a sorted index of all audio files in a directory. The index is built on a background thread and is
+//! refreshed when the directory changes, so navigating the playlist never touches the file system.
+class Playlist {
+  public:
+	//! Creates an empty playlist that accepts files with any of the given \a extensions (without the dot).
+	//! The directory is checked for changes every \a refreshInterval seconds.
+	Playlist( const std::vector<std::string> &extensions, double refreshInterval = 2.0 );
+	//! Stops the background thread.
+	~Playlist();
+
+	//! Starts indexing \a directory on the background thread. Does nothing if it already is the current directory.
+	void setDirectory( const ci::fs::path &directory );
+	//! Returns the current directory.
+	ci::fs::path getDirectory() const;
+
+	//! Returns true if the current directory has been indexed.
+	bool isReady() const;
+	//! Blocks until the current directory has been indexed, or until \a timeout seconds have passed. Returns isReady().
+	bool wait( double timeout ) const;
+
+	//! Returns the number of audio files in the current directory, or zero if it has not been indexed yet.
+	size_t getNumFiles() const;
+	//! Returns the first audio file, or an empty path if there are none.
+	ci::fs::path first() const;
+	//! Returns the audio file before \a file, wrapping around. If \a file is not in the playlist, returns the last file.
+	ci::fs::path prev( const ci::fs::path &file ) const;
+	//! Returns the audio file after \a file, wrapping around. If \a file is not in the playlist, returns the first file.
+	ci::fs::path next( const ci::fs::path &file ) const;
+
+  private:
+	struct Index {
+		ci::fs::path                            mDirectory;
+		std::vector<ci::fs::path>               mFiles;
+		std::unordered_map<std::string, size_t> mPositions;
+	};
+
+	typedef std::shared_ptr<const Index> IndexRef;
+
+	//! Returns the index of the current directory, or null if it has not been indexed yet.
+	IndexRef getIndex() const;
+	//! Lists and sorts all audio files in \a directory.
+	IndexRef createIndex( const ci::fs::path &directory ) const;
+
+	void run();
+
+  private:
+	std::vector<std::string> mExtensions;
+	double                   mRefreshInterval;
+
+	ci::fs::path mDirectory;
+	IndexRef     mIndex;
+	bool         mIsRunning;
+
+	mutable std::mutex              mMutex;
+	mutable std::condition_variable mChanged;
+	std::thread                     mThread;
+};
@@ -0,0 +1,61 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "AudioDecoder.h"
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+//! The spectrum of an entire audio file, sampled at a fixed rate. The audio is decoded up front, after which
+//! the spectra are computed in parallel, because they are independent of each other. Spectrum i is computed from
+//! the samples that precede time ( i + 1 ) / getSpectraPerSecond(), just like the SpectrumAnalyzer does.
+class Spectrogram {
+  public:
+	//! Decodes all audio from \a decoder and computes \a spectraPerSecond spectra of \a fftSize samples per second of audio, using \a numThreads threads.
+	Spectrogram( const AudioDecoderRef &decoder, double spectraPerSecond, size_t fftSize = 2048, size_t numThreads = std::thread::hardware_concurrency() );
+
+	//! Returns the duration of the audio in seconds.
+	double getDuration() const { return mDuration; }
+	//! Returns the number of spectra per second of audio.
+	double getSpectraPerSecond() const { return mSpectraPerSecond; }
+	//! Returns the number of spectra.
+	size_t getNumSpectra() const { return mNumSpectra; }
+	//! Returns the number of frequency bins per spectrum.
+	size_t getNumBins() const { return mNumBins; }
+
+	//! Returns the magnitudes of spectrum \a index of the left channel.
+	const float *getLeft( size_t index ) const { return &mLeft[index * mNumBins]; }
+	//! Returns the magnitudes of spectrum \a index of the right channel.
+	const float *getRight( size_t index ) const { return &mRight[index * mNumBins]; }
+
+  private:
+	double mDuration;
+	double mSpectraPerSecond;
+	size_t mNumSpectra;
+	size_t mNumBins;
+
+	std::vector<float> mLeft;
+	std::vector<float> mRight;
+};
@@ -0,0 +1,109 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "AudioDecoder.h"
+#include "FFT.h"
+#include "SpscRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+//! The spectrum of the left and right channel at a moment in time.
+struct Spectrum {
+	//! Time in seconds of the most recent sample that was analyzed.
+	double mTime;
+	//! Magnitude per frequency bin. A full scale sine wave has a magnitude of about 1.
+	std::vector<float> mLeft;
+	std::vector<float> mRight;
+};
+
+//! Computes the spectrum of an audio file on a dedicated audio thread. Every hop, the most recent samples
+//! are multiplied by a Hann window and transformed. The resulting spectra are published through a lock-free
+//! ring buffer, which is drained by calling pop() from a single consumer thread, usually the render thread.
+class SpectrumAnalyzer {
+  public:
+	//! Creates an analyzer that transforms \a fftSize samples per channel and can buffer up to \a capacity spectra.
+	explicit SpectrumAnalyzer( size_t fftSize = 2048, size_t capacity = 256 );
+	~SpectrumAnalyzer();
+
+	//! Returns the playback position of the audio in seconds. Called from the audio thread.
+	typedef std::function<double()> PlaybackClock;
+
+	//! Starts analyzing the audio from \a decoder, producing a spectrum every \a hopSize frames. If \a isRealTime is true,
+	//! spectra are published at the rate at which the audio is played back and dropped if the consumer can't keep up.
+	//! Otherwise, the audio is analyzed as fast as possible and the audio thread waits for the consumer. In real-time,
+	//! \a playbackClock should return the position of the audio that is playing, so the spectra stay in sync if
+	//! playback starts late, stalls or is paused. Without it, playback is assumed to start right away and never pause.
+	void start( const AudioDecoderRef &decoder, size_t hopSize, bool isRealTime = true, const PlaybackClock &playbackClock = nullptr );
+	//! Stops the audio thread and discards all spectra that have not been consumed yet.
+	void stop();
+	//! Returns true until all audio has been analyzed or stop() has been called. Remaining spectra can still be consumed.
+	bool isRunning() const { return mIsRunning; }
+
+	//! Copies the oldest spectrum to \a spectrum and removes it from the ring. Returns false if no spectrum is available.
+	bool pop( Spectrum &spectrum );
+
+	//! Returns the number of samples per transform.
+	size_t getFftSize() const { return mFft.getSize(); }
+	//! Returns the number of frequency bins per spectrum.
+	size_t getNumBins() const { return mFft.getNumBins(); }
+
+	//! Returns the number of transforms performed since construction.
+	uint64_t getNumFfts() const { return mNumFfts; }
+	//! Returns the number of spectra that were dropped, because the consumer did not keep up.
+	uint64_t getNumDropped() const { return mNumDropped; }
+	//! Returns the number of transforms per second the audio thread is able to perform, based on the time spent windowing and transforming.
+	double getFftsPerSecond() const;
+
+  private:
+	void run();
+	void waitForPlayback( double time, std::chrono::steady_clock::time_point startTime );
+	void analyze( const std::vector<float> &history, std::vector<float> &magnitudes );
+
+  private:
+	FFT                mFft;
+	std::vector<float> mWindow;
+	std::vector<float> mWindowed;
+	float              mScale;
+
+	SpscRing<Spectrum> mRing;
+
+	AudioDecoderRef mDecoder;
+	size_t          mHopSize;
+	bool            mIsRealTime;
+	PlaybackClock   mPlaybackClock;
+
+	std::thread       mThread;
+	std::atomic<bool> mIsRunning;
+	std::atomic<bool> mShouldStop;
+
+	std::atomic<uint64_t> mNumFfts;
+	std::atomic<uint64_t> mNumDropped;
+	std::atomic<uint64_t> mFftNanoseconds;
+};
@@ -0,0 +1,88 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+//! Lock-free ring buffer for a single producer thread and a single consumer thread. All slots are
+//! allocated up front and are reused, so pushing and popping never allocates. The producer writes
+//! directly into the slot returned by beginPush() and publishes it with endPush(). The consumer reads
+//! the slot returned by front() and releases it with pop().
+template <typename T>
+class SpscRing {
+  public:
+	//! Creates a ring that can hold \a capacity items, each initialized to a copy of \a prototype.
+	explicit SpscRing( size_t capacity, const T &prototype = T() )
+	    : mSlots( capacity + 1, prototype )
+	    , mHead( 0 )
+	    , mTail( 0 )
+	{
+	}
+
+	//! Returns the maximum number of items in the ring.
+	size_t getCapacity() const { return mSlots.size() - 1; }
+
+	//! Returns the slot to write the next item to, or a null pointer if the ring is full. Producer only.
+	T *beginPush()
+	{
+		const size_t head = mHead.load( std::memory_order_relaxed );
+		if( next( head ) == mTail.load( std::memory_order_acquire ) )
+			return nullptr;
+
+		return &mSlots[head];
+	}
+	//! Publishes the slot returned by beginPush(). Producer only.
+	void endPush() { mHead.store( next( mHead.load( std::memory_order_relaxed ) ), std::memory_order_release ); }
+
+	//! Returns the oldest item, or a null pointer if the ring is empty. Consumer only.
+	const T *front() const
+	{
+		const size_t tail = mTail.load( std::memory_order_relaxed );
+		if( tail == mHead.load( std::memory_order_acquire ) )
+			return nullptr;
+
+		return &mSlots[tail];
+	}
+	//! Releases the item returned by front(), so that its slot can be reused by the producer. Consumer only.
+	void pop() { mTail.store( next( mTail.load( std::memory_order_relaxed ) ), std::memory_order_release ); }
+
+	//! Removes all items. Only call this if neither the producer nor the consumer is active.
+	void clear()
+	{
+		mHead.store( 0 );
+		mTail.store( 0 );
+	}
+
+  private:
+	size_t next( size_t index ) const { return ( index + 1 ) % mSlots.size(); }
+
+  private:
+	std::vector<T> mSlots;
+
+	// keep both indices on separate cache lines, to prevent false sharing between producer and consumer
+	std::atomic<size_t> mHead;
+	char                mPadding[64];
+	std::atomic<size_t> mTail;
+};
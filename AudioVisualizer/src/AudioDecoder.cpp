@@ -0,0 +1,67 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "AudioDecoder.h"
+#include "WavDecoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+
+namespace {
+
+std::string toLower( std::string str )
+{
+	std::transform( str.begin(), str.end(), str.begin(), []( char c ) { return char( std::tolower( (unsigned char)c ) ); } );
+	return str;
+}
+
+// Returns the registered factories, which are initialized with the built-in decoders.
+std::map<std::string, AudioDecoder::Factory> &getFactories()
+{
+	static std::map<std::string, AudioDecoder::Factory> factories;
+	if( factories.empty() )
+		factories["wav"] = []( const ci::fs::path &path ) { return std::make_shared<WavDecoder>( path ); };
+
+	return factories;
+}
+
+} // anonymous namespace
+
+AudioDecoderRef AudioDecoder::create( const ci::fs::path &path )
+{
+	std::string extension = toLower( path.extension().string() );
+	if( !extension.empty() && extension[0] == '.' )
+		extension.erase( 0, 1 );
+
+	auto &factories = getFactories();
+	auto  itr = factories.find( extension );
+	if( itr == factories.end() )
+		return AudioDecoderRef();
+
+	return itr->second( path );
+}
+
+void AudioDecoder::registerFactory( const std::string &extension, const Factory &factory )
+{
+	getFactories()[toLower( extension )] = factory;
+}
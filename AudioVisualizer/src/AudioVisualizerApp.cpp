@@ -23,16 +23,30 @@
 #include "cinder/app/App.h"
 #include "cinder/Camera.h"
 #include "cinder/CameraUI.h"
-#include "cinder/Channel.h"
 #include "cinder/ImageIo.h"
 #include "cinder/Rand.h"
+#include "cinder/Timer.h"
 #include "cinder/app/RendererGl.h"
+#include "cinder/gl/Fbo.h"
 #include "cinder/gl/GlslProg.h"
+#include "cinder/gl/Pbo.h"
 #include "cinder/gl/Texture.h"
-#include "cinder/gl/Vbo.h"
+#include "cinder/gl/Vao.h"
 #include "cinder/gl/gl.h"
 
 #include "FMOD.hpp"
+#include "BandMapper.h"
+#include "FmodDecoder.h"
+#include "ImageSequenceWriter.h"
+#include "Playlist.h"
+#include "Spectrogram.h"
+#include "SpectrumAnalyzer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <limits>
 
 // Channel callback function used by FMOD to notify us of channel events
 FMOD_RESULT F_CALLBACK channelCallback( FMOD_CHANNEL *channel, FMOD_CHANNEL_CALLBACKTYPE type, void *commanddata1, void *commanddata2 );
@@ -57,39 +71,81 @@ class AudioVisualizerApp : public App {
 	void keyDown( KeyEvent event );
 	void resize();
 
-	// lists all audio files in the given directory
-	void listAudio( const fs::path &directory, vector<fs::path> &list );
 	// show the open file dialog and let the user select an audio file
 	fs::path openAudio( const fs::path &directory );
-	// find the first audio file in a given directory
-	fs::path findAudio( const fs::path &directory );
-	// find the previous audio file relative to the given file
-	fs::path prevAudio( const fs::path &file );
-	// find the next audio file relative to the given file
-	fs::path nextAudio( const fs::path &file );
+	// play the first audio file in a given directory, or the previous or next file relative to the given file
+	void findAudio( const fs::path &directory );
+	void prevAudio( const fs::path &file );
+	void nextAudio( const fs::path &file );
+	// switch tracks once the playlist and the preloaded audio file are ready, without blocking
+	void updateNavigation();
 	// play the audio file
 	void playAudio( const fs::path &file );
+	// open the audio file on a background thread, so that it can be played without delay
+	void preloadAudio( const fs::path &file );
+	// release the preloaded audio file, if any. If it is still being opened, it is released in update()
+	void discardPreload();
+	// release the discarded audio files that have finished opening, or wait for all of them
+	void releaseDiscarded( bool wait );
 	// stop playing the current audio file
 	void stopAudio();
 
+	// map the spectrum of an audio file with the given sample rate to perceptual bands
+	void createBandMappers( double sampleRate );
+	// upload the latest spectrum to our texture
+	void uploadSpectrum();
+	// animate the camera along its path
+	void animateCamera( float t );
+	// draw the terrain using the current camera
+	void drawTerrain();
+
+	// analyze the audio file and prepare for offline rendering
+	void startRender();
+	// upload the spectra for the next frame that will be rendered offline
+	void updateRender();
+	// render the next frame offline and start copying it to a pixel buffer
+	void drawRender();
+	// save the frames that have been copied to a pixel buffer, oldest first. If \a wait is true, waits for the oldest one
+	void saveRenderedFrames( bool wait );
+
   private:
 	// width and height of our mesh
 	static const int kWidth = 512;
 	static const int kHeight = 512;
 
-	// number of frequency bands of our spectrum
-	static const int kBands = 1024;
+	// minimum and maximum number of vertices along each side of our mesh
+	static const int kMinResolution = 128;
+	static const int kMaxResolution = 2048;
+
+	// number of frequency bins of our spectrum, and the number of bands they are mapped to
+	static const int kBins = 1024;
+	static const int kBands = 256;
 	static const int kHistory = 128;
 
-	Channel32f            mChannelLeft;
-	Channel32f            mChannelRight;
+	// number of spectra per second of audio
+	static const int kSpectraPerSecond = 60;
+	// number of pixel buffers used to read back frames rendered offline
+	static const int kNumRenderReadbacks = 3;
+
+	std::shared_ptr<SpectrumAnalyzer> mAnalyzer;
+	Spectrum                          mSpectrum;
+
+	// perceptual bands of the left and right channel
+	std::shared_ptr<BandMapper> mBandMapperLeft;
+	std::shared_ptr<BandMapper> mBandMapperRight;
+	BandMapper::Scale           mBandScale;
+	double                      mSampleRate;
+	vector<float>               mBandsLeft;
+	vector<float>               mBandsRight;
+
 	CameraPersp           mCamera;
 	CameraUi              mCameraUi;
 	gl::GlslProgRef       mShader;
-	gl::Texture2dRef      mTextureLeft;
-	gl::Texture2dRef      mTextureRight;
+	gl::Texture2dRef      mTexture;
 	gl::Texture2d::Format mTextureFormat;
-	gl::VboMeshRef        mMesh;
+	gl::PboRef            mPbo;
+	gl::VaoRef            mVao;
+	int                   mResolution;
 	uint32_t              mOffset;
 
 	FMOD::System * mFMODSystem;
@@ -104,6 +160,48 @@ class AudioVisualizerApp : public App {
 	vector<string> mAudioExtensions;
 	fs::path       mAudioPath;
 
+	// index of the audio files in the directory of the current audio file
+	std::shared_ptr<Playlist> mPlaylist;
+
+	// the next audio file, opened in advance for both playback and analysis
+	struct PreloadedAudio {
+		FMOD::Sound *   mSound;
+		AudioDecoderRef mDecoder;
+	};
+
+	fs::path                                 mPreloadPath;
+	std::future<PreloadedAudio>              mPreload;
+	std::vector<std::future<PreloadedAudio>> mDiscarded;
+
+	// the track to play as soon as the playlist is ready
+	enum Navigation { NAVIGATE_NONE, NAVIGATE_FIRST, NAVIGATE_PREV, NAVIGATE_NEXT };
+
+	Navigation mNavigation;
+	fs::path   mNavigationPath;
+
+	// offline rendering: the audio file, output directory, frame rate, size of the frames and number of samples per pixel
+	fs::path mRenderPath;
+	fs::path mRenderDirectory;
+	double   mRenderFps;
+	ivec2    mRenderSize;
+	int      mRenderSamples;
+
+	std::shared_ptr<Spectrogram>         mSpectrogram;
+	std::shared_ptr<ImageSequenceWriter> mImageWriter;
+	gl::FboRef                           mRenderFbo;
+	Timer                                mRenderTimer;
+	size_t                               mRenderFrame;
+	size_t                               mRenderSpectrum;
+	size_t                               mNumRenderFrames;
+	bool                                 mIsRendering;
+
+	// pixel buffers, fences and frame numbers of pending readbacks
+	gl::PboRef mRenderPbo[kNumRenderReadbacks];
+	GLsync     mRenderSync[kNumRenderReadbacks];
+	size_t     mRenderSyncFrame[kNumRenderReadbacks];
+	int        mRenderReadIndex;
+	int        mRenderWriteIndex;
+
   public:
 	bool signalChannelEnd;
 };
@@ -112,6 +210,12 @@ void AudioVisualizerApp::prepare( Settings *settings )
 {
 	settings->setFullScreen( false );
 	settings->setWindowSize( 1280, 720 );
+
+	// while rendering offline, the window only shows a preview, so don't ask for a multisampled window. Software
+	// implementations of OpenGL on headless machines may not support one.
+	const vector<string> &args = settings->getCommandLineArgs();
+	if( std::find( args.begin(), args.end(), "--render" ) != args.end() )
+		settings->setDefaultRenderer( RendererGl::create( RendererGl::Options().msaa( 0 ) ) );
 }
 
 void AudioVisualizerApp::setup()
@@ -124,6 +228,38 @@ void AudioVisualizerApp::setup()
 	mAudioExtensions = vector<string>( extensions, extensions + 2 );
 	mAudioPath = getAssetPath( "" );
 	mIsAudioPlaying = false;
+	mNavigation = NAVIGATE_NONE;
+
+	// index audio files on a background thread, so that skipping to the next file is instant
+	mPlaylist = std::make_shared<Playlist>( mAudioExtensions );
+
+	// render offline if requested:
+	//  AudioVisualizer --render <audio file> [--output <directory>] [--fps <frames per second>] [--size <width> <height>] [--samples <samples>]
+	mRenderFps = 60.0;
+	mRenderSize = ivec2( 1920, 1080 );
+	mRenderSamples = 8;
+	mIsRendering = false;
+
+	for( int i = 0; i < kNumRenderReadbacks; ++i )
+		mRenderSync[i] = nullptr;
+	mRenderReadIndex = 0;
+	mRenderWriteIndex = 0;
+
+	const vector<string> &args = getCommandLineArgs();
+	for( size_t i = 1; i < args.size(); ++i ) {
+		if( args[i] == "--render" && i + 1 < args.size() )
+			mRenderPath = args[++i];
+		else if( args[i] == "--output" && i + 1 < args.size() )
+			mRenderDirectory = args[++i];
+		else if( args[i] == "--fps" && i + 1 < args.size() )
+			mRenderFps = math<double>::max( 1.0, atof( args[++i].c_str() ) );
+		else if( args[i] == "--size" && i + 2 < args.size() ) {
+			mRenderSize.x = math<int>::max( 1, atoi( args[++i].c_str() ) );
+			mRenderSize.y = math<int>::max( 1, atoi( args[++i].c_str() ) );
+		}
+		else if( args[i] == "--samples" && i + 1 < args.size() )
+			mRenderSamples = math<int>::max( 0, atoi( args[++i].c_str() ) );
+	}
 
 	// setup camera
 	mCamera.setPerspective( 50.0f, 1.0f, 1.0f, 10000.0f );
@@ -131,19 +267,32 @@ void AudioVisualizerApp::setup()
 
 	mCameraUi.setCamera( &mCamera );
 
-	// create channels from which we can construct our textures
-	mChannelLeft = Channel32f( kBands, kHistory );
-	mChannelRight = Channel32f( kBands, kHistory );
-	memset( mChannelLeft.getData(), 0, mChannelLeft.getRowBytes() * kHistory );
-	memset( mChannelRight.getData(), 0, mChannelRight.getRowBytes() * kHistory );
+	// create the analyzer, which computes the spectrum of the audio on a separate thread
+	mAnalyzer = std::make_shared<SpectrumAnalyzer>( 2 * kBins );
+	mSpectrum.mTime = 0.0;
+	mSpectrum.mLeft.assign( kBins, 0.0f );
+	mSpectrum.mRight.assign( kBins, 0.0f );
+
+	// map the linear spectrum to fewer perceptual bands, which is all we need to draw
+	mBandScale = BandMapper::MEL;
+	createBandMappers( 44100.0 );
 
 	// create texture format (wrap the y-axis, clamp the x-axis)
 	mTextureFormat.setWrapS( GL_CLAMP_TO_BORDER );
 	mTextureFormat.setWrapT( GL_REPEAT );
 	mTextureFormat.setMinFilter( GL_LINEAR );
 	mTextureFormat.setMagFilter( GL_LINEAR );
+	mTextureFormat.setInternalFormat( GL_RG32F );
 	mTextureFormat.loadTopDown( true );
 
+	// create a single texture that stores the history of both channels (red = left, green = right),
+	// we will only update the rows that have changed
+	vector<float> empty( kBands * kHistory * 2, 0.0f );
+	mTexture = gl::Texture2d::create( empty.data(), GL_RG, kBands, kHistory, mTextureFormat );
+
+	// create a pixel buffer that holds the latest spectrum and an empty row
+	mPbo = gl::Pbo::create( GL_PIXEL_UNPACK_BUFFER, 2 * kBands * 2 * sizeof( float ), nullptr, GL_STREAM_DRAW );
+
 	// compile shader
 	try {
 		mShader = gl::GlslProg::create( loadAsset( "shaders/spectrum.vert" ), loadAsset( "shaders/spectrum.frag" ) );
@@ -154,61 +303,22 @@ void AudioVisualizerApp::setup()
 		return;
 	}
 
-	// create static mesh (all animation is done in the vertex shader)
-	std::vector<vec3>     positions;
-	std::vector<Colorf>   colors;
-	std::vector<vec2>     coords;
-	std::vector<uint32_t> indices;
-
-	for( size_t h = 0; h < kHeight; ++h ) {
-		for( size_t w = 0; w < kWidth; ++w ) {
-			// add polygon indices
-			if( h < kHeight - 1 && w < kWidth - 1 ) {
-				size_t offset = positions.size();
-
-				indices.emplace_back( offset );
-				indices.emplace_back( offset + kWidth );
-				indices.emplace_back( offset + kWidth + 1 );
-				indices.emplace_back( offset );
-				indices.emplace_back( offset + kWidth + 1 );
-				indices.emplace_back( offset + 1 );
-			}
-
-			// add vertex
-			positions.emplace_back( vec3( float( w ), 0, float( h ) ) );
-
-			// add texture coordinates
-			// note: we only want to draw the lower part of the frequency bands,
-			//  so we scale the coordinates a bit
-			const float part = 0.5f;
-			float       s = w / float( kWidth - 1 );
-			float       t = h / float( kHeight - 1 );
-			coords.emplace_back( vec2( part - part * s, t ) );
-
-			// add vertex colors
-			colors.emplace_back( Color( CM_HSV, s, 0.5f, 0.75f ) );
-		}
-	}
-
-	gl::VboMesh::Layout layout;
-	layout.usage( GL_STATIC_DRAW );
-	layout.attrib( geom::Attrib::POSITION, 3 );
-	layout.attrib( geom::Attrib::COLOR, 3 );
-	layout.attrib( geom::Attrib::TEX_COORD_0, 2 );
-
-	mMesh = gl::VboMesh::create( positions.size(), GL_TRIANGLES, { layout }, indices.size(), GL_UNSIGNED_INT );
-	mMesh->bufferAttrib( geom::POSITION, positions.size() * sizeof( vec3 ), positions.data() );
-	mMesh->bufferAttrib( geom::COLOR, colors.size() * sizeof( vec3 ), colors.data() );
-	mMesh->bufferAttrib( geom::TEX_COORD_0, coords.size() * sizeof( vec2 ), coords.data() );
-	mMesh->bufferIndices( indices.size() * sizeof( uint32_t ), indices.data() );
+	// the terrain is generated in the vertex shader, so we only need an empty vertex array object
+	mVao = gl::Vao::create();
+	mResolution = 512;
 
-	// play audio using the Cinder FMOD block
+	// play audio using the Cinder FMOD block, which is silent while rendering offline, so we don't need a sound card
 	FMOD::System_Create( &mFMODSystem );
+	if( !mRenderPath.empty() )
+		mFMODSystem->setOutput( FMOD_OUTPUTTYPE_NOSOUND );
 	mFMODSystem->init( 32, FMOD_INIT_NORMAL | FMOD_INIT_ENABLE_PROFILE, NULL );
 	mFMODSound = nullptr;
 	mFMODChannel = nullptr;
 
-	playAudio( findAudio( mAudioPath ) );
+	// let FMOD decode compressed audio for the analyzer, WAV files are decoded by the analyzer itself
+	auto factory = [this]( const fs::path &path ) { return std::make_shared<FmodDecoder>( mFMODSystem, path ); };
+	AudioDecoder::registerFactory( "mp3", factory );
+	AudioDecoder::registerFactory( "ogg", factory );
 
 	mIsMouseDown = false;
 	mMouseUpDelay = 30.0;
@@ -218,92 +328,133 @@ void AudioVisualizerApp::setup()
 	//  1) it tells us where to upload the next spectrum data
 	//  2) we use it to offset the texture coordinates in the shader for the scrolling effect
 	mOffset = 0;
+
+	if( !mRenderPath.empty() )
+		startRender();
+	else
+		findAudio( mAudioPath );
 }
 
 void AudioVisualizerApp::shutdown()
 {
 	// properly shut down FMOD
 	stopAudio();
+	discardPreload();
+	releaseDiscarded( true );
 
 	if( mFMODSystem )
 		mFMODSystem->release();
+
+	// release the fences of frames that were still being read back
+	for( int i = 0; i < kNumRenderReadbacks; ++i ) {
+		if( mRenderSync[i] )
+			glDeleteSync( mRenderSync[i] );
+	}
 }
 
 void AudioVisualizerApp::update()
 {
+	if( mIsRendering ) {
+		updateRender();
+		return;
+	}
+
 	// update FMOD so it can notify us of events
 	mFMODSystem->update();
 
 	// handle signal: if audio has ended, play next file
 	if( mIsAudioPlaying && signalChannelEnd )
-		playAudio( nextAudio( mAudioPath ) );
+		nextAudio( mAudioPath );
 
 	// reset FMOD signals
 	signalChannelEnd = false;
 
-	// get spectrum for left and right channels and copy it into our channels
-	float *pDataLeft = mChannelLeft.getData() + kBands * mOffset;
-	float *pDataRight = mChannelRight.getData() + kBands * mOffset;
+	// switch tracks if we were waiting for the playlist or the preloaded file
+	updateNavigation();
+	releaseDiscarded( false );
 
-	mFMODSystem->getSpectrum( pDataLeft, kBands, 0, FMOD_DSP_FFT_WINDOW_HANNING );
-	mFMODSystem->getSpectrum( pDataRight, kBands, 1, FMOD_DSP_FFT_WINDOW_HANNING );
+	// as soon as we know which file is next, open it in advance
+	if( mIsAudioPlaying && mPlaylist->isReady() ) {
+		fs::path next = mPlaylist->next( mAudioPath );
+		if( next != mPreloadPath )
+			preloadAudio( next );
+	}
 
-	// increment texture offset
-	mOffset = ( mOffset + 1 ) % kHistory;
+	// upload all spectra that were analyzed since the previous frame and increment the texture offset for each of them
+	bool isAnalyzing = mAnalyzer->isRunning();
+	while( mAnalyzer->pop( mSpectrum ) ) {
+		uploadSpectrum();
+		mOffset = ( mOffset + 1 ) % kHistory;
+	}
 
-	// clear the spectrum for this row to avoid old data from showing up
-	pDataLeft = mChannelLeft.getData() + kBands * mOffset;
-	pDataRight = mChannelRight.getData() + kBands * mOffset;
-	memset( pDataLeft, 0, kBands * sizeof( float ) );
-	memset( pDataRight, 0, kBands * sizeof( float ) );
+	// if there is nothing to analyze, keep scrolling silence
+	if( !isAnalyzing ) {
+		std::fill( mSpectrum.mLeft.begin(), mSpectrum.mLeft.end(), 0.0f );
+		std::fill( mSpectrum.mRight.begin(), mSpectrum.mRight.end(), 0.0f );
 
-	// animate camera if mouse has not been down for more than 30 seconds
-	if( !mIsMouseDown && ( getElapsedSeconds() - mMouseUpTime ) > mMouseUpDelay ) {
-		float t = float( getElapsedSeconds() );
-		float x = 0.5f + 0.5f * math<float>::cos( t * 0.07f );
-		float y = 0.1f - 0.2f * math<float>::sin( t * 0.09f );
-		float z = 0.25f * math<float>::sin( t * 0.05f ) - 0.25f;
-		vec3  eye = vec3( kWidth * x, kHeight * y, kHeight * z );
-
-		x = 1.0f - x;
-		y = -0.3f;
-		z = 0.6f + 0.2f * math<float>::sin( t * 0.12f );
-		vec3 interest = vec3( kWidth * x, kHeight * y, kHeight * z );
-
-		// gradually move to eye position and center of interest
-		mCamera.lookAt( glm::mix( eye, mCamera.getEyePoint(), 0.995f ), glm::mix( interest, mCamera.getPivotPoint(), 0.990f ) );
+		uploadSpectrum();
+		mOffset = ( mOffset + 1 ) % kHistory;
 	}
+
+	// animate camera if mouse has not been down for more than 30 seconds
+	if( !mIsMouseDown && ( getElapsedSeconds() - mMouseUpTime ) > mMouseUpDelay )
+		animateCamera( float( getElapsedSeconds() ) );
+}
+
+void AudioVisualizerApp::animateCamera( float t )
+{
+	float x = 0.5f + 0.5f * math<float>::cos( t * 0.07f );
+	float y = 0.1f - 0.2f * math<float>::sin( t * 0.09f );
+	float z = 0.25f * math<float>::sin( t * 0.05f ) - 0.25f;
+	vec3  eye = vec3( kWidth * x, kHeight * y, kHeight * z );
+
+	x = 1.0f - x;
+	y = -0.3f;
+	z = 0.6f + 0.2f * math<float>::sin( t * 0.12f );
+	vec3 interest = vec3( kWidth * x, kHeight * y, kHeight * z );
+
+	// gradually move to eye position and center of interest
+	mCamera.lookAt( glm::mix( eye, mCamera.getEyePoint(), 0.995f ), glm::mix( interest, mCamera.getPivotPoint(), 0.990f ) );
 }
 
 void AudioVisualizerApp::draw()
 {
+	if( mIsRendering ) {
+		drawRender();
+		return;
+	}
+
 	gl::clear();
 
 	// use camera
 	gl::pushMatrices();
 	gl::setMatrices( mCamera );
-	{
-		// bind shader
-		gl::ScopedGlslProg shader( mShader );
-		mShader->uniform( "uTexOffset", mOffset / float( kHistory ) );
-		mShader->uniform( "uLeftTex", 0 );
-		mShader->uniform( "uRightTex", 1 );
-
-		// create textures from our channels and bind them
-		mTextureLeft = gl::Texture2d::create( mChannelLeft, mTextureFormat );
-		mTextureRight = gl::Texture2d::create( mChannelRight, mTextureFormat );
-
-		gl::ScopedTextureBind tex0( mTextureLeft, 0 );
-		gl::ScopedTextureBind tex1( mTextureRight, 1 );
-
-		// draw mesh using additive blending
-		gl::ScopedBlendAdditive blend;
-		gl::ScopedColor         color( 1, 1, 1 );
-		gl::draw( mMesh );
-	}
+	drawTerrain();
 	gl::popMatrices();
 }
 
+void AudioVisualizerApp::drawTerrain()
+{
+	// bind shader
+	gl::ScopedGlslProg shader( mShader );
+	mShader->uniform( "uTexOffset", mOffset / float( kHistory ) );
+	mShader->uniform( "uSpectrumTex", 0 );
+	mShader->uniform( "uResolution", mResolution );
+	mShader->uniform( "uSize", vec2( kWidth - 1, kHeight - 1 ) );
+
+	// bind our spectrum texture
+	gl::ScopedTextureBind tex0( mTexture, 0 );
+
+	// draw mesh using additive blending
+	gl::ScopedBlendAdditive blend;
+	gl::ScopedColor         color( 1, 1, 1 );
+
+	// draw one triangle strip per row of the mesh
+	gl::ScopedVao vao( mVao );
+	gl::setDefaultShaderVars();
+	gl::drawArraysInstanced( GL_TRIANGLE_STRIP, 0, 2 * mResolution, mResolution - 1 );
+}
+
 void AudioVisualizerApp::mouseDown( MouseEvent event )
 {
 	// handle mouse down
@@ -327,6 +478,10 @@ void AudioVisualizerApp::mouseUp( MouseEvent event )
 
 void AudioVisualizerApp::keyDown( KeyEvent event )
 {
+	// only allow quitting while rendering offline
+	if( mIsRendering && event.getCode() != KeyEvent::KEY_ESCAPE )
+		return;
+
 	// handle key down
 	switch( event.getCode() ) {
 	case KeyEvent::KEY_ESCAPE:
@@ -337,14 +492,29 @@ void AudioVisualizerApp::keyDown( KeyEvent event )
 			quit();
 		break;
 	case KeyEvent::KEY_LEFT:
-		playAudio( prevAudio( mAudioPath ) );
+		prevAudio( mAudioPath );
 		break;
 	case KeyEvent::KEY_RIGHT:
-		playAudio( nextAudio( mAudioPath ) );
+		nextAudio( mAudioPath );
 		break;
 	case KeyEvent::KEY_f:
 		setFullScreen( !isFullScreen() );
 		break;
+	case KeyEvent::KEY_PLUS:
+	case KeyEvent::KEY_EQUALS:
+	case KeyEvent::KEY_KP_PLUS:
+		mResolution = math<int>::min( mResolution * 2, kMaxResolution );
+		console() << "Resolution: " << mResolution << " x " << mResolution << std::endl;
+		break;
+	case KeyEvent::KEY_MINUS:
+	case KeyEvent::KEY_KP_MINUS:
+		mResolution = math<int>::max( mResolution / 2, kMinResolution );
+		console() << "Resolution: " << mResolution << " x " << mResolution << std::endl;
+		break;
+	case KeyEvent::KEY_b:
+		mBandScale = BandMapper::Scale( ( mBandScale + 1 ) % 3 );
+		createBandMappers( mSampleRate );
+		break;
 	case KeyEvent::KEY_o:
 		playAudio( openAudio( mAudioPath ) );
 		break;
@@ -359,34 +529,9 @@ void AudioVisualizerApp::keyDown( KeyEvent event )
 
 void AudioVisualizerApp::resize()
 {
-	// handle resize
-	mCamera.setAspectRatio( getWindowAspectRatio() );
-}
-
-void AudioVisualizerApp::listAudio( const fs::path &directory, vector<fs::path> &list )
-{
-	// clear the list
-	list.clear();
-
-	if( directory.empty() || !fs::is_directory( directory ) )
-		return;
-
-	// make a list of all audio files in the directory
-	fs::directory_iterator end_itr;
-	for( fs::directory_iterator i( directory ); i != end_itr; ++i ) {
-		// skip if not a file
-		if( !fs::is_regular_file( i->status() ) )
-			continue;
-
-		// skip if extension does not match
-		string extension = i->path().extension().string();
-		extension.erase( 0, 1 );
-		if( std::find( mAudioExtensions.begin(), mAudioExtensions.end(), extension ) == mAudioExtensions.end() )
-			continue;
-
-		// file matches
-		list.push_back( i->path() );
-	}
+	// handle resize, unless we're rendering offline at a fixed size
+	if( !mIsRendering )
+		mCamera.setAspectRatio( getWindowAspectRatio() );
 }
 
 fs::path AudioVisualizerApp::openAudio( const fs::path &directory )
@@ -402,69 +547,70 @@ fs::path AudioVisualizerApp::openAudio( const fs::path &directory )
 	return file;
 }
 
-fs::path AudioVisualizerApp::findAudio( const fs::path &directory )
+void AudioVisualizerApp::findAudio( const fs::path &directory )
 {
-	vector<fs::path> files;
-	listAudio( directory, files );
-
-	// if available, return the first audio file
-	if( !files.empty() )
-		return files.front();
+	// index the directory, the first file is played as soon as it is ready
+	mPlaylist->setDirectory( directory );
+	mNavigation = NAVIGATE_FIRST;
+	mNavigationPath = directory;
 
-	// failed, let user select file using dialog
-	return openAudio( directory );
+	updateNavigation();
 }
 
-fs::path AudioVisualizerApp::prevAudio( const fs::path &file )
+void AudioVisualizerApp::prevAudio( const fs::path &file )
 {
-	if( file.empty() || !fs::is_regular_file( file ) )
-		return fs::path();
-
-	fs::path &directory = file.parent_path();
+	if( file.empty() )
+		return;
 
-	// make a list of all audio files in the directory
-	vector<fs::path> files;
-	listAudio( directory, files );
+	// the directory is usually indexed already, because it was set when the file started playing
+	mPlaylist->setDirectory( file.parent_path() );
+	mNavigation = NAVIGATE_PREV;
+	mNavigationPath = file;
 
-	// return if there are no audio files in the directory
-	if( files.empty() )
-		return fs::path();
+	updateNavigation();
+}
 
-	// find current audio file
-	auto itr = std::find( files.begin(), files.end(), file );
+void AudioVisualizerApp::nextAudio( const fs::path &file )
+{
+	if( file.empty() )
+		return;
 
-	// if not found, or if it is the first audio file, simply return last audio file
-	if( itr == files.end() || itr == files.begin() )
-		return files.back();
+	// the directory is usually indexed already, because it was set when the file started playing
+	mPlaylist->setDirectory( file.parent_path() );
+	mNavigation = NAVIGATE_NEXT;
+	mNavigationPath = file;
 
-	// return previous file
-	return *( --itr );
+	updateNavigation();
 }
 
-fs::path AudioVisualizerApp::nextAudio( const fs::path &file )
+void AudioVisualizerApp::updateNavigation()
 {
-	if( file.empty() || !fs::is_regular_file( file ) )
-		return fs::path();
-
-	fs::path &directory = file.parent_path();
-
-	// make a list of all audio files in the directory
-	vector<fs::path> files;
-	listAudio( directory, files );
+	if( mNavigation == NAVIGATE_NONE || !mPlaylist->isReady() )
+		return;
 
-	// return if there are no audio files in the directory
-	if( files.empty() )
-		return fs::path();
+	fs::path file;
+	switch( mNavigation ) {
+	case NAVIGATE_FIRST:
+		file = mPlaylist->first();
+		break;
+	case NAVIGATE_PREV:
+		file = mPlaylist->prev( mNavigationPath );
+		break;
+	default:
+		file = mPlaylist->next( mNavigationPath );
+		break;
+	}
 
-	// find current audio file
-	auto itr = std::find( files.begin(), files.end(), file );
+	// if the file is still being preloaded, keep the current one playing until it is done
+	if( !file.empty() && file == mPreloadPath && mPreload.valid() && mPreload.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
+		return;
 
-	// if not found, or if it is the last audio file, simply return first audio file
-	if( itr == files.end() || *itr == files.back() )
-		return files.front();
+	// failed to find an audio file in the directory, let user select file using dialog
+	if( file.empty() && mNavigation == NAVIGATE_FIRST )
+		file = openAudio( mNavigationPath );
 
-	// return next file
-	return *( ++itr );
+	mNavigation = NAVIGATE_NONE;
+	playAudio( file );
 }
 
 void AudioVisualizerApp::playAudio( const fs::path &file )
@@ -478,27 +624,126 @@ void AudioVisualizerApp::playAudio( const fs::path &file )
 	// if audio is already playing, stop it first
 	stopAudio();
 
+	// any pending navigation is overruled by this file
+	mNavigation = NAVIGATE_NONE;
+
+	// use the preloaded file if it is ready, otherwise open it now
+	AudioDecoderRef decoder;
+	mFMODSound = nullptr;
+	if( file == mPreloadPath && mPreload.valid() && mPreload.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready ) {
+		PreloadedAudio audio = mPreload.get();
+		mFMODSound = audio.mSound;
+		decoder = audio.mDecoder;
+		mPreloadPath.clear();
+	}
+	else
+		discardPreload();
+
 	// stream the audio
-	err = mFMODSystem->createStream( file.string().c_str(), FMOD_SOFTWARE, NULL, &mFMODSound );
+	if( !mFMODSound )
+		err = mFMODSystem->createStream( file.string().c_str(), FMOD_SOFTWARE, NULL, &mFMODSound );
 	err = mFMODSystem->playSound( FMOD_CHANNEL_FREE, mFMODSound, false, &mFMODChannel );
 
 	// we want to be notified of channel events
 	err = mFMODChannel->setCallback( channelCallback );
 
-	// keep track of the audio file
+	// analyze the audio while it is playing
+	try {
+		if( !decoder )
+			decoder = AudioDecoder::create( file );
+		if( decoder ) {
+			createBandMappers( decoder->getSampleRate() );
+
+			// follow the position of the channel, so the spectrum stays in sync with what we hear. If the channel
+			// has stopped, there is nothing left to wait for. The analyzer is stopped before the channel is released.
+			FMOD::Channel *channel = mFMODChannel;
+			mAnalyzer->start( decoder, decoder->getSampleRate() / kSpectraPerSecond, true, [channel]() {
+				unsigned int position;
+				if( channel->getPosition( &position, FMOD_TIMEUNIT_MS ) != FMOD_OK )
+					return std::numeric_limits<double>::max();
+
+				return 0.001 * double( position );
+			} );
+		}
+		else
+			console() << "No decoder available for:" << file.filename() << std::endl;
+	}
+	catch( const std::exception &e ) {
+		console() << e.what() << std::endl;
+	}
+
+	// keep track of the audio file and start indexing its directory
 	mAudioPath = file;
 	mIsAudioPlaying = true;
+	mPlaylist->setDirectory( file.parent_path() );
 
 	//
 	console() << "Now playing:" << mAudioPath.filename() << std::endl;
 }
 
+void AudioVisualizerApp::preloadAudio( const fs::path &file )
+{
+	discardPreload();
+
+	if( file.empty() )
+		return;
+
+	// opening a file can take a while, especially on a network drive, so do it on a separate thread.
+	// FMOD can be called from any thread.
+	FMOD::System *system = mFMODSystem;
+	mPreload = std::async( std::launch::async, [system, file]() {
+		PreloadedAudio audio;
+		audio.mSound = nullptr;
+
+		if( system->createStream( file.string().c_str(), FMOD_SOFTWARE, NULL, &audio.mSound ) != FMOD_OK )
+			audio.mSound = nullptr;
+
+		// if the decoder can't be created, we will try again and report the error when the file is played
+		try {
+			audio.mDecoder = AudioDecoder::create( file );
+		}
+		catch( const std::exception & ) {
+		}
+
+		return audio;
+	} );
+
+	mPreloadPath = file;
+}
+
+void AudioVisualizerApp::discardPreload()
+{
+	// don't wait for the file to be opened, release it later
+	if( mPreload.valid() )
+		mDiscarded.push_back( std::move( mPreload ) );
+
+	mPreloadPath.clear();
+}
+
+void AudioVisualizerApp::releaseDiscarded( bool wait )
+{
+	for( auto itr = mDiscarded.begin(); itr != mDiscarded.end(); ) {
+		if( !wait && itr->wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready ) {
+			++itr;
+			continue;
+		}
+
+		PreloadedAudio audio = itr->get();
+		if( audio.mSound )
+			audio.mSound->release();
+
+		itr = mDiscarded.erase( itr );
+	}
+}
+
 void AudioVisualizerApp::stopAudio()
 {
 	FMOD_RESULT err;
 
 	mIsAudioPlaying = false;
 
+	mAnalyzer->stop();
+
 	if( !mFMODChannel || !mFMODSound )
 		return;
 
@@ -516,6 +761,216 @@ void AudioVisualizerApp::stopAudio()
 	mFMODChannel = nullptr;
 }
 
+void AudioVisualizerApp::createBandMappers( double sampleRate )
+{
+	static const char *kScaleNames[] = { "logarithmic", "mel", "constant-Q" };
+
+	try {
+		mBandMapperLeft = std::make_shared<BandMapper>( kBins, sampleRate, kBands, mBandScale );
+		mBandMapperRight = std::make_shared<BandMapper>( kBins, sampleRate, kBands, mBandScale );
+	}
+	catch( const std::exception &e ) {
+		console() << e.what() << std::endl;
+		return;
+	}
+
+	// let the bands rise immediately, but fall smoothly
+	mBandMapperLeft->setSmoothing( 0.0f, 0.6f );
+	mBandMapperRight->setSmoothing( 0.0f, 0.6f );
+
+	mBandsLeft.assign( kBands, 0.0f );
+	mBandsRight.assign( kBands, 0.0f );
+	mSampleRate = sampleRate;
+
+	console() << "Bands: " << kBands << " (" << kScaleNames[mBandScale] << ")" << std::endl;
+}
+
+void AudioVisualizerApp::uploadSpectrum()
+{
+	// map the spectrum to bands
+	mBandMapperLeft->process( mSpectrum.mLeft.data(), mBandsLeft.data() );
+	mBandMapperRight->process( mSpectrum.mRight.data(), mBandsRight.data() );
+
+	// write the bands to the pixel buffer, followed by an empty row. The empty row
+	// clears the oldest spectrum, to avoid old data from showing up.
+	float *ptr = static_cast<float *>( mPbo->mapReplace() );
+	for( int i = 0; i < kBands; ++i ) {
+		*ptr++ = mBandsLeft[i];
+		*ptr++ = mBandsRight[i];
+	}
+	memset( ptr, 0, kBands * 2 * sizeof( float ) );
+	mPbo->unmap();
+
+	// copy both rows from the pixel buffer to the texture, without stalling the CPU
+	gl::ScopedBuffer      scpPbo( mPbo );
+	gl::ScopedTextureBind scpTex( mTexture );
+
+	uint32_t next = ( mOffset + 1 ) % kHistory;
+	if( next > mOffset ) {
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, mOffset, kBands, 2, GL_RG, GL_FLOAT, nullptr );
+	}
+	else {
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, mOffset, kBands, 1, GL_RG, GL_FLOAT, nullptr );
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, next, kBands, 1, GL_RG, GL_FLOAT, reinterpret_cast<const GLvoid *>( kBands * 2 * sizeof( float ) ) );
+	}
+}
+
+void AudioVisualizerApp::startRender()
+{
+	try {
+		AudioDecoderRef decoder = AudioDecoder::create( mRenderPath );
+		if( !decoder )
+			throw std::runtime_error( "No decoder available for: " + mRenderPath.string() );
+
+		// decode the whole file and compute all spectra up front, using all cores
+		Timer timer( true );
+		mSpectrogram = std::make_shared<Spectrogram>( decoder, kSpectraPerSecond, 2 * kBins );
+		createBandMappers( decoder->getSampleRate() );
+		console() << "Analyzed " << mRenderPath.filename() << " (" << mSpectrogram->getNumSpectra() << " spectra) in " << timer.getSeconds() << " seconds" << std::endl;
+
+		// save frames on background threads
+		if( mRenderDirectory.empty() )
+			mRenderDirectory = mRenderPath.parent_path() / ( mRenderPath.stem().string() + "_frames" );
+		fs::create_directories( mRenderDirectory );
+
+		const size_t numThreads = math<size_t>::max( 1, std::thread::hardware_concurrency() );
+		mImageWriter = std::make_shared<ImageSequenceWriter>( mRenderDirectory, "frame_", "png", numThreads, 2 * numThreads );
+
+		// render into a multisampled offscreen buffer of a fixed size, independent of the window
+		gl::Fbo::Format format;
+		format.samples( math<int>::min( mRenderSamples, gl::Fbo::getMaxSamples() ) );
+		mRenderFbo = gl::Fbo::create( mRenderSize.x, mRenderSize.y, format );
+		mCamera.setAspectRatio( mRenderFbo->getAspectRatio() );
+
+		for( int i = 0; i < kNumRenderReadbacks; ++i )
+			mRenderPbo[i] = gl::Pbo::create( GL_PIXEL_PACK_BUFFER, mRenderSize.x * mRenderSize.y * 4, nullptr, GL_STREAM_READ );
+	}
+	catch( const std::exception &e ) {
+		console() << e.what() << std::endl;
+		quit();
+		return;
+	}
+
+	mRenderFrame = 0;
+	mRenderSpectrum = 0;
+	mNumRenderFrames = size_t( math<double>::ceil( mSpectrogram->getDuration() * mRenderFps ) );
+	mIsRendering = true;
+
+	// render as fast as possible
+	disableFrameRate();
+	gl::enableVerticalSync( false );
+
+	console() << "Rendering " << mNumRenderFrames << " frames of " << mRenderSize.x << " x " << mRenderSize.y << " at " << mRenderFps << " fps to " << mRenderDirectory << std::endl;
+	mRenderTimer.start();
+}
+
+void AudioVisualizerApp::updateRender()
+{
+	// upload all spectra up to the time of this frame
+	const double time = mRenderFrame / mRenderFps;
+	while( mRenderSpectrum < mSpectrogram->getNumSpectra() && double( mRenderSpectrum + 1 ) <= time * mSpectrogram->getSpectraPerSecond() + 1e-6 ) {
+		std::copy( mSpectrogram->getLeft( mRenderSpectrum ), mSpectrogram->getLeft( mRenderSpectrum ) + kBins, mSpectrum.mLeft.begin() );
+		std::copy( mSpectrogram->getRight( mRenderSpectrum ), mSpectrogram->getRight( mRenderSpectrum ) + kBins, mSpectrum.mRight.begin() );
+
+		uploadSpectrum();
+		mOffset = ( mOffset + 1 ) % kHistory;
+		mRenderSpectrum++;
+	}
+
+	animateCamera( float( time ) );
+}
+
+void AudioVisualizerApp::drawRender()
+{
+	// render the frame
+	{
+		gl::ScopedFramebuffer fbo( mRenderFbo );
+		gl::ScopedViewport    viewport( ivec2( 0 ), mRenderFbo->getSize() );
+
+		gl::clear();
+
+		gl::pushMatrices();
+		gl::setMatrices( mCamera );
+		drawTerrain();
+		gl::popMatrices();
+	}
+
+	// save the frames that are ready. If all pixel buffers are still in use, wait for the oldest one.
+	saveRenderedFrames( mRenderSync[mRenderWriteIndex] != nullptr );
+
+	// resolve the frame and copy it to a pixel buffer. With a pixel buffer bound, glReadPixels returns
+	//  immediately and copies the pixels in the background, while we render the next frames.
+	{
+		const int index = mRenderWriteIndex;
+		mRenderWriteIndex = ( index + 1 ) % kNumRenderReadbacks;
+
+		mRenderFbo->resolveTextures();
+
+		gl::ScopedFramebuffer fbo( GL_READ_FRAMEBUFFER, mRenderFbo->getId() );
+		gl::ScopedBuffer      pbo( mRenderPbo[index] );
+
+		glReadBuffer( GL_COLOR_ATTACHMENT0 );
+		glReadPixels( 0, 0, mRenderSize.x, mRenderSize.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+
+		mRenderSync[index] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+		mRenderSyncFrame[index] = mRenderFrame;
+	}
+
+	// show a preview
+	gl::clear();
+	gl::draw( mRenderFbo->getColorTexture(), Rectf( mRenderFbo->getBounds() ).getCenteredFit( getWindowBounds(), true ) );
+
+	// report progress once per second of audio
+	++mRenderFrame;
+	if( mRenderFrame % size_t( mRenderFps ) == 0 && mRenderFrame < mNumRenderFrames )
+		console() << "Rendered " << mRenderFrame << " of " << mNumRenderFrames << " frames (" << mRenderFrame / mRenderTimer.getSeconds() << " fps)" << std::endl;
+
+	if( mRenderFrame >= mNumRenderFrames ) {
+		while( mRenderSync[mRenderReadIndex] )
+			saveRenderedFrames( true );
+
+		mImageWriter->finish();
+		mRenderTimer.stop();
+
+		console() << "Rendered " << mRenderFrame << " frames in " << mRenderTimer.getSeconds() << " seconds (" << mRenderFrame / mRenderTimer.getSeconds() << " fps), saved "
+		          << mImageWriter->getNumWritten() << " images, " << mImageWriter->getNumFailed() << " failed" << std::endl;
+
+		mIsRendering = false;
+		quit();
+	}
+}
+
+void AudioVisualizerApp::saveRenderedFrames( bool wait )
+{
+	while( mRenderSync[mRenderReadIndex] ) {
+		const int index = mRenderReadIndex;
+
+		GLenum status = glClientWaitSync( mRenderSync[index], GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0 );
+		if( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED )
+			break;
+
+		glDeleteSync( mRenderSync[index] );
+		mRenderSync[index] = nullptr;
+		mRenderReadIndex = ( index + 1 ) % kNumRenderReadbacks;
+		wait = false;
+
+		gl::ScopedBuffer pbo( mRenderPbo[index] );
+
+		auto pixels = (const uint8_t *)mRenderPbo[index]->map( GL_READ_ONLY );
+		if( pixels ) {
+			// OpenGL stores the bottom row first, so flip the image while copying it
+			Surface8u    surface( mRenderSize.x, mRenderSize.y, true, SurfaceChannelOrder::RGBA );
+			const size_t rowBytes = size_t( mRenderSize.x ) * 4;
+			for( int y = 0; y < mRenderSize.y; ++y )
+				std::memcpy( surface.getData( ivec2( 0, mRenderSize.y - 1 - y ) ), pixels + y * rowBytes, rowBytes );
+
+			// save it on a background thread
+			mImageWriter->write( surface, mRenderSyncFrame[index] );
+		}
+		mRenderPbo[index]->unmap();
+	}
+}
+
 // Channel callback function used by FMOD to notify us of channel events
 FMOD_RESULT F_CALLBACK channelCallback( FMOD_CHANNEL *channel, FMOD_CHANNEL_CALLBACKTYPE type, void *commanddata1, void *commanddata2 )
 {
@@ -0,0 +1,183 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "BandMapper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#include <xmmintrin.h>
+#define BAND_MAPPER_USE_SSE 1
+#endif
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Converts a frequency in Hz to the scale on which the bands are evenly spaced, and back.
+double toScale( BandMapper::Scale scale, double frequency )
+{
+	return scale == BandMapper::MEL ? 2595.0 * std::log10( 1.0 + frequency / 700.0 ) : std::log2( frequency );
+}
+
+double fromScale( BandMapper::Scale scale, double value )
+{
+	return scale == BandMapper::MEL ? 700.0 * ( std::pow( 10.0, value / 2595.0 ) - 1.0 ) : std::pow( 2.0, value );
+}
+
+} // anonymous namespace
+
+BandMapper::BandMapper( size_t numBins, double sampleRate, size_t numBands, Scale scale, double minFrequency, double maxFrequency )
+    : mNumBins( numBins )
+    , mNumBands( numBands )
+    , mScale( scale )
+    , mAttack( 0.0f )
+    , mRelease( 0.0f )
+{
+	if( numBins < 4 || numBands == 0 || sampleRate <= 0.0 )
+		throw std::invalid_argument( "BandMapper requires at least 4 bins, 1 band and a positive sample rate." );
+
+	const double binWidth = 0.5 * sampleRate / double( numBins );
+
+	maxFrequency = std::min( maxFrequency, 0.5 * sampleRate - binWidth );
+	minFrequency = std::max( std::min( minFrequency, 0.5 * maxFrequency ), 1.0 );
+
+	// band i rises from edge i, peaks at edge i + 1 and falls to edge i + 2
+	const double lo = toScale( scale, minFrequency );
+	const double hi = toScale( scale, maxFrequency );
+
+	std::vector<double> edges( numBands + 2 );
+	for( size_t i = 0; i < edges.size(); ++i )
+		edges[i] = fromScale( scale, lo + ( hi - lo ) * double( i ) / double( numBands + 1 ) );
+
+	// constant-Q bands have a fixed ratio between center frequency and bandwidth
+	const double q = 1.0 / ( std::pow( 2.0, ( std::log2( maxFrequency ) - std::log2( minFrequency ) ) / double( numBands + 1 ) ) - 1.0 );
+
+	mKernels.resize( numBands );
+	mFrequencies.resize( numBands );
+
+	std::vector<double> weights;
+	for( size_t i = 0; i < numBands; ++i ) {
+		const double center = edges[i + 1];
+		const double lower = ( scale == CONSTANT_Q ) ? center - 0.5 * center / q : edges[i];
+		const double upper = ( scale == CONSTANT_Q ) ? center + 0.5 * center / q : edges[i + 2];
+
+		mFrequencies[i] = center;
+
+		// weigh all bins within the band: a Hann shape for constant-Q bands, a triangle otherwise
+		size_t first = size_t( std::max( 0.0, std::floor( lower / binWidth ) ) );
+		size_t last = std::min( numBins - 1, size_t( std::ceil( upper / binWidth ) ) );
+
+		weights.assign( last - first + 1, 0.0 );
+
+		double sum = 0.0;
+		for( size_t b = first; b <= last; ++b ) {
+			const double f = double( b ) * binWidth;
+			double       w = 0.0;
+			if( scale == CONSTANT_Q )
+				w = ( f > lower && f < upper ) ? 0.5 + 0.5 * std::cos( 2.0 * kPi * ( f - center ) / ( upper - lower ) ) : 0.0;
+			else if( f > lower && f <= center )
+				w = ( f - lower ) / ( center - lower );
+			else if( f > center && f < upper )
+				w = ( upper - f ) / ( upper - center );
+
+			weights[b - first] = w;
+			sum += w;
+		}
+
+		// bands that are narrower than a bin interpolate between the two nearest bins
+		if( sum < 1.0 ) {
+			const double position = center / binWidth;
+			first = std::min( size_t( position ), numBins - 2 );
+			last = first + 1;
+
+			const double t = std::min( 1.0, position - double( first ) );
+			weights.assign( 2, 0.0 );
+			weights[0] = 1.0 - t;
+			weights[1] = t;
+			sum = 1.0;
+		}
+
+		// pad the range to a multiple of four bins, without reading past the last bin
+		size_t count = ( ( last - first + 1 ) + 3 ) & ~size_t( 3 );
+		count = std::min( count, numBins & ~size_t( 3 ) );
+
+		size_t padded = std::min( first, numBins - count );
+
+		Kernel &kernel = mKernels[i];
+		kernel.mFirstBin = uint32_t( padded );
+		kernel.mNumBins = uint32_t( count );
+		kernel.mOffset = uint32_t( mWeights.size() );
+
+		// normalize, so that each band is a weighted average of its bins
+		mWeights.resize( mWeights.size() + count, 0.0f );
+		for( size_t b = first; b <= last; ++b ) {
+			if( b >= padded && b < padded + count )
+				mWeights[kernel.mOffset + b - padded] = float( weights[b - first] / sum );
+		}
+	}
+
+	reset();
+}
+
+void BandMapper::setSmoothing( float attack, float release )
+{
+	mAttack = std::max( 0.0f, std::min( attack, 0.999f ) );
+	mRelease = std::max( 0.0f, std::min( release, 0.999f ) );
+}
+
+void BandMapper::reset()
+{
+	mSmoothed.assign( mNumBands, 0.0f );
+}
+
+void BandMapper::process( const float *magnitudes, float *bands )
+{
+	for( size_t i = 0; i < mNumBands; ++i ) {
+		const Kernel &kernel = mKernels[i];
+		const float * m = magnitudes + kernel.mFirstBin;
+		const float * w = &mWeights[kernel.mOffset];
+
+		// weighted average of the bins
+#if BAND_MAPPER_USE_SSE
+		__m128 acc = _mm_setzero_ps();
+		for( uint32_t j = 0; j < kernel.mNumBins; j += 4 )
+			acc = _mm_add_ps( acc, _mm_mul_ps( _mm_loadu_ps( m + j ), _mm_loadu_ps( w + j ) ) );
+
+		acc = _mm_add_ps( acc, _mm_movehl_ps( acc, acc ) );
+		acc = _mm_add_ss( acc, _mm_shuffle_ps( acc, acc, 1 ) );
+		float value = _mm_cvtss_f32( acc );
+#else
+		float value = 0.0f;
+		for( uint32_t j = 0; j < kernel.mNumBins; ++j )
+			value += m[j] * w[j];
+#endif
+
+		// smoothing, with separate coefficients for rising and falling values
+		const float previous = mSmoothed[i];
+		value += ( value > previous ? mAttack : mRelease ) * ( previous - value );
+		mSmoothed[i] = value;
+		bands[i] = value;
+	}
+}
@@ -0,0 +1,435 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Headless benchmark of the spectrum analyzer. It does not need a window, a graphics card
+// or a sound card, so it can be run on any machine. Usage:
+//
+//   AudioVisualizerBenchmark [seconds] [fft size] [hop size]
+//
+// Analyzes a synthetic sine sweep as fast as possible and reports the number of FFTs per second,
+// both for the real-time analyzer and for the spectrogram that is used for offline rendering.
+// Verifies the FFT against a naive DFT, that the peak of each spectrum follows the sweep, that
+// the spectrogram matches the analyzer, that the band mapper puts tones in the right bands and
+// that WAV files are decoded correctly. Also reports the time it takes to map a spectrum to bands. Returns a
+// non-zero exit code on failure.
+
+#include "AudioDecoder.h"
+#include "BandMapper.h"
+#include "FFT.h"
+#include "Spectrogram.h"
+#include "SpectrumAnalyzer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace ci;
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Generates a logarithmic sine sweep in the left channel and a constant sine wave in the right channel.
+class SineSweepDecoder : public AudioDecoder {
+  public:
+	static const size_t kSampleRate = 44100;
+
+	SineSweepDecoder( double seconds, double from, double to )
+	    : mNumFrames( uint64_t( seconds * kSampleRate ) )
+	    , mFramesRead( 0 )
+	    , mSeconds( seconds )
+	    , mFrom( from )
+	    , mTo( to )
+	{
+	}
+
+	size_t   getSampleRate() const override { return kSampleRate; }
+	size_t   getNumChannels() const override { return 2; }
+	uint64_t getNumFrames() const override { return mNumFrames; }
+
+	size_t read( float *buffer, size_t numFrames ) override
+	{
+		numFrames = size_t( std::min<uint64_t>( numFrames, mNumFrames - mFramesRead ) );
+
+		const double k = std::log( mTo / mFrom );
+		for( size_t i = 0; i < numFrames; ++i, ++mFramesRead ) {
+			const double t = double( mFramesRead ) / kSampleRate;
+			const double phase = 2.0 * kPi * mFrom * mSeconds / k * ( std::exp( k * t / mSeconds ) - 1.0 );
+			buffer[2 * i + 0] = float( 0.8 * std::sin( phase ) );
+			buffer[2 * i + 1] = float( 0.5 * std::sin( 2.0 * kPi * 1000.0 * t ) );
+		}
+
+		return numFrames;
+	}
+
+	//! Returns the frequency of the sweep at time \a t.
+	double getFrequency( double t ) const { return mFrom * std::pow( mTo / mFrom, t / mSeconds ); }
+
+  private:
+	uint64_t mNumFrames;
+	uint64_t mFramesRead;
+	double   mSeconds;
+	double   mFrom;
+	double   mTo;
+};
+
+size_t getPeak( const std::vector<float> &magnitudes )
+{
+	return size_t( std::max_element( magnitudes.begin(), magnitudes.end() ) - magnitudes.begin() );
+}
+
+// Compares the FFT with a naive DFT of random input.
+bool testFft( size_t fftSize )
+{
+	FFT                fft( fftSize );
+	std::vector<float> input( fftSize ), real( fftSize / 2 + 1 ), imag( fftSize / 2 + 1 );
+
+	srand( 2015 );
+	for( auto &sample : input )
+		sample = 2.0f * float( rand() ) / float( RAND_MAX ) - 1.0f;
+
+	fft.forward( input.data(), real.data(), imag.data() );
+
+	double error = 0.0;
+	for( size_t k = 0; k <= fftSize / 2; ++k ) {
+		double re = 0.0, im = 0.0;
+		for( size_t n = 0; n < fftSize; ++n ) {
+			const double angle = -2.0 * kPi * double( ( k * n ) % fftSize ) / double( fftSize );
+			re += input[n] * std::cos( angle );
+			im += input[n] * std::sin( angle );
+		}
+		error = std::max( error, std::max( std::abs( re - real[k] ), std::abs( im - imag[k] ) ) );
+	}
+
+	// the error of a float FFT grows with the square root of the size and the logarithm of the size
+	const double tolerance = 1e-5 * std::sqrt( double( fftSize ) ) * std::log( double( fftSize ) );
+	if( error > tolerance ) {
+		std::printf( "  FAILED: FFT differs from DFT by %g\n", error );
+		return false;
+	}
+
+	return true;
+}
+
+// Writes a 16 bit WAV file and verifies that it is decoded correctly.
+bool testWav()
+{
+	const fs::path path = fs::temp_directory_path() / "AudioVisualizerBenchmark.wav";
+
+	SineSweepDecoder   sweep( 1.0, 100.0, 10000.0 );
+	std::vector<float> samples( size_t( sweep.getNumFrames() ) * 2 );
+	sweep.read( samples.data(), size_t( sweep.getNumFrames() ) );
+
+	{
+		std::ofstream file( path.string().c_str(), std::ios::binary );
+
+		auto write16 = [&]( uint32_t value ) { file.put( char( value & 0xFF ) ).put( char( ( value >> 8 ) & 0xFF ) ); };
+		auto write32 = [&]( uint32_t value ) { write16( value & 0xFFFF ), write16( value >> 16 ); };
+
+		const uint32_t dataSize = uint32_t( samples.size() * 2 );
+		file.write( "RIFF", 4 ), write32( 36 + dataSize ), file.write( "WAVE", 4 );
+		file.write( "fmt ", 4 ), write32( 16 ), write16( 1 ), write16( 2 ), write32( 44100 ), write32( 44100 * 4 ), write16( 4 ), write16( 16 );
+		file.write( "data", 4 ), write32( dataSize );
+		for( float sample : samples )
+			write16( uint32_t( int16_t( std::floor( sample * 32767.0f + 0.5f ) ) ) & 0xFFFF );
+	}
+
+	bool isValid = true;
+	try {
+		AudioDecoderRef decoder = AudioDecoder::create( path );
+		if( !decoder || decoder->getSampleRate() != 44100 || decoder->getNumChannels() != 2 || decoder->getNumFrames() != sweep.getNumFrames() ) {
+			std::printf( "  FAILED: WAV header was not decoded correctly\n" );
+			isValid = false;
+		}
+		else {
+			std::vector<float> decoded( samples.size() + 2 );
+			const size_t       numFrames = decoder->read( decoded.data(), size_t( sweep.getNumFrames() ) + 1 );
+
+			double error = 0.0;
+			for( size_t i = 0; i < samples.size(); ++i )
+				error = std::max( error, double( std::abs( decoded[i] - samples[i] ) ) );
+
+			if( numFrames != sweep.getNumFrames() || error > 2.0 / 32768.0 ) {
+				std::printf( "  FAILED: WAV samples were not decoded correctly\n" );
+				isValid = false;
+			}
+		}
+	}
+	catch( const std::exception &e ) {
+		std::printf( "  FAILED: %s\n", e.what() );
+		isValid = false;
+	}
+
+	fs::remove( path );
+	return isValid;
+}
+
+// Analyzes a sine sweep and verifies that the peak of each spectrum follows the sweep.
+bool testSweep( double seconds, size_t fftSize, size_t hopSize )
+{
+	const double from = 50.0, to = 15000.0;
+	auto         decoder = std::make_shared<SineSweepDecoder>( seconds, from, to );
+
+	SpectrumAnalyzer analyzer( fftSize );
+
+	const auto start = std::chrono::steady_clock::now();
+	analyzer.start( decoder, hopSize, false );
+
+	Spectrum spectrum;
+	size_t   numSpectra = 0;
+	size_t   numErrors = 0;
+
+	const double rate = double( SineSweepDecoder::kSampleRate );
+	const double window = double( fftSize ) / rate;
+	const double binsPerHz = double( fftSize ) / rate;
+
+	// the frequency of the sweep changes while it is being windowed, so allow a few bins more
+	const double smear = std::pow( to / from, window / seconds ) - 1.0;
+
+	for( ;; ) {
+		// check before popping, so that we don't miss the last spectrum
+		const bool isRunning = analyzer.isRunning();
+		if( !analyzer.pop( spectrum ) ) {
+			if( !isRunning )
+				break;
+
+			std::this_thread::yield();
+			continue;
+		}
+
+		++numSpectra;
+
+		// skip spectra that contain the start or the end of the sweep
+		if( spectrum.mTime < window || spectrum.mTime > seconds )
+			continue;
+
+		const double expected = binsPerHz * decoder->getFrequency( spectrum.mTime - 0.5 * window );
+		const double tolerance = 2.0 + expected * smear;
+		if( std::abs( double( getPeak( spectrum.mLeft ) ) - expected ) > tolerance )
+			++numErrors;
+
+		const double magnitude = spectrum.mRight[getPeak( spectrum.mRight )];
+		if( std::abs( double( getPeak( spectrum.mRight ) ) - binsPerHz * 1000.0 ) > 1.0 || magnitude < 0.4 || magnitude > 0.55 )
+			++numErrors;
+	}
+
+	const double elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+	std::printf( "%8lu spectra %10.0f FFTs/s on the audio thread %8.1fx real-time\n", (unsigned long)numSpectra, analyzer.getFftsPerSecond(), seconds / elapsed );
+
+	if( numSpectra != size_t( ( decoder->getNumFrames() + hopSize - 1 ) / hopSize ) ) {
+		std::printf( "  FAILED: expected %lu spectra\n", (unsigned long)( ( decoder->getNumFrames() + hopSize - 1 ) / hopSize ) );
+		return false;
+	}
+
+	if( numErrors > 0 ) {
+		std::printf( "  FAILED: %lu spectra do not match the sweep\n", (unsigned long)numErrors );
+		return false;
+	}
+
+	return true;
+}
+
+// Computes the spectrogram of a sine sweep using one and all threads, and verifies that it matches the analyzer.
+bool testSpectrogram( double seconds, size_t fftSize )
+{
+	const double spectraPerSecond = 60.0;
+	const size_t hopSize = size_t( SineSweepDecoder::kSampleRate / spectraPerSecond );
+	const size_t numThreads = std::max<size_t>( 1, std::thread::hardware_concurrency() );
+
+	double elapsed[2] = { 0.0, 0.0 };
+
+	std::shared_ptr<Spectrogram> spectrograms[2];
+	for( size_t i = 0; i < 2; ++i ) {
+		auto decoder = std::make_shared<SineSweepDecoder>( seconds, 50.0, 15000.0 );
+
+		const auto start = std::chrono::steady_clock::now();
+		spectrograms[i] = std::make_shared<Spectrogram>( decoder, spectraPerSecond, fftSize, i == 0 ? 1 : numThreads );
+		elapsed[i] = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	}
+
+	const size_t numSpectra = spectrograms[0]->getNumSpectra();
+	const size_t numBins = spectrograms[0]->getNumBins();
+
+	for( size_t i = 0; i < 2; ++i )
+		std::printf( "%8lu spectra %10.0f FFTs/s in the spectrogram using %lu thread(s), including decoding\n", (unsigned long)numSpectra, 2.0 * double( numSpectra ) / elapsed[i],
+		             (unsigned long)( i == 0 ? 1 : numThreads ) );
+
+	// the result must not depend on the number of threads
+	for( size_t i = 0; i < numSpectra; ++i ) {
+		if( !std::equal( spectrograms[0]->getLeft( i ), spectrograms[0]->getLeft( i ) + numBins, spectrograms[1]->getLeft( i ) ) ) {
+			std::printf( "  FAILED: spectrogram depends on the number of threads\n" );
+			return false;
+		}
+	}
+
+	// and must match the analyzer, which uses the same hop size
+	SpectrumAnalyzer analyzer( fftSize );
+	analyzer.start( std::make_shared<SineSweepDecoder>( seconds, 50.0, 15000.0 ), hopSize, false );
+
+	Spectrum spectrum;
+	size_t   index = 0;
+	double   error = 0.0;
+
+	for( ;; ) {
+		const bool isRunning = analyzer.isRunning();
+		if( !analyzer.pop( spectrum ) ) {
+			if( !isRunning )
+				break;
+
+			std::this_thread::yield();
+			continue;
+		}
+
+		if( index < numSpectra ) {
+			for( size_t k = 0; k < numBins; ++k ) {
+				error = std::max( error, double( std::abs( spectrum.mLeft[k] - spectrograms[0]->getLeft( index )[k] ) ) );
+				error = std::max( error, double( std::abs( spectrum.mRight[k] - spectrograms[0]->getRight( index )[k] ) ) );
+			}
+		}
+
+		++index;
+	}
+
+	if( index != numSpectra || error > 1e-5 ) {
+		std::printf( "  FAILED: spectrogram does not match the analyzer (%lu and %lu spectra, difference %g)\n", (unsigned long)numSpectra, (unsigned long)index, error );
+		return false;
+	}
+
+	return true;
+}
+
+// Verifies that the band mapper preserves levels, puts tones in the right band and smooths over time. Reports its speed.
+bool testBands( size_t fftSize )
+{
+	const double sampleRate = double( SineSweepDecoder::kSampleRate );
+	const size_t numBins = fftSize / 2;
+	const size_t numBands = 256;
+
+	const BandMapper::Scale scales[] = { BandMapper::LOGARITHMIC, BandMapper::MEL, BandMapper::CONSTANT_Q };
+	const char *            names[] = { "logarithmic", "mel", "constant-Q" };
+
+	std::vector<float> magnitudes( numBins );
+	std::vector<float> bands( numBands );
+
+	bool isValid = true;
+	for( size_t s = 0; s < 3; ++s ) {
+		BandMapper mapper( numBins, sampleRate, numBands, scales[s] );
+
+		// a flat spectrum results in flat bands, because the weights of each band add up to one
+		std::fill( magnitudes.begin(), magnitudes.end(), 1.0f );
+		mapper.process( magnitudes.data(), bands.data() );
+
+		for( size_t i = 0; i < numBands; ++i ) {
+			if( std::abs( bands[i] - 1.0f ) > 1e-4f ) {
+				std::printf( "  FAILED: %s band %lu of a flat spectrum is %g\n", names[s], (unsigned long)i, bands[i] );
+				isValid = false;
+				break;
+			}
+		}
+
+		// a single bin ends up in the band whose center is closest to it
+		size_t numErrors = 0;
+		for( size_t i = 1; i + 1 < numBands; i += 17 ) {
+			const size_t bin = size_t( mapper.getFrequency( i ) * double( fftSize ) / sampleRate + 0.5 );
+
+			std::fill( magnitudes.begin(), magnitudes.end(), 0.0f );
+			magnitudes[bin] = 1.0f;
+			mapper.process( magnitudes.data(), bands.data() );
+
+			const size_t peak = getPeak( bands );
+			if( std::abs( mapper.getFrequency( peak ) - double( bin ) * sampleRate / double( fftSize ) ) > std::abs( mapper.getFrequency( i ) - double( bin ) * sampleRate / double( fftSize ) ) + 1e-6 )
+				++numErrors;
+		}
+
+		if( numErrors > 0 ) {
+			std::printf( "  FAILED: %lu %s tones ended up in the wrong band\n", (unsigned long)numErrors, names[s] );
+			isValid = false;
+		}
+
+		// the bands rise immediately without attack and fall by half each spectrum with a release of 0.5
+		mapper.reset();
+		mapper.setSmoothing( 0.0f, 0.5f );
+
+		std::fill( magnitudes.begin(), magnitudes.end(), 1.0f );
+		mapper.process( magnitudes.data(), bands.data() );
+		std::fill( magnitudes.begin(), magnitudes.end(), 0.0f );
+
+		const float expected[] = { 0.5f, 0.25f, 0.125f, 0.0625f };
+		for( size_t i = 0; i < 4; ++i ) {
+			mapper.process( magnitudes.data(), bands.data() );
+			if( std::abs( bands[0] - expected[i] ) > 1e-5f ) {
+				std::printf( "  FAILED: %s band is %g, expected %g\n", names[s], bands[0], expected[i] );
+				isValid = false;
+				break;
+			}
+		}
+
+		// time both channels of a spectrum, which is what the visualizer does each frame
+		for( size_t k = 0; k < numBins; ++k )
+			magnitudes[k] = float( k % 7 ) / 7.0f;
+
+		const size_t numIterations = 20000;
+		const auto   start = std::chrono::steady_clock::now();
+		for( size_t i = 0; i < numIterations; ++i ) {
+			mapper.process( magnitudes.data(), bands.data() );
+			mapper.process( magnitudes.data(), bands.data() );
+		}
+		const double elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+		std::printf( "%8lu bands %10.2f us per stereo spectrum (%s)\n", (unsigned long)numBands, 1e6 * elapsed / double( numIterations ), names[s] );
+	}
+
+	return isValid;
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	const double seconds = argc > 1 ? std::atof( argv[1] ) : 60.0;
+	const size_t fftSize = argc > 2 ? std::strtoul( argv[2], nullptr, 10 ) : 2048;
+	const size_t hopSize = argc > 3 ? std::strtoul( argv[3], nullptr, 10 ) : 512;
+
+	if( seconds <= 0.0 || fftSize < 64 || ( fftSize & ( fftSize - 1 ) ) != 0 || hopSize == 0 ) {
+		std::printf( "Usage: %s [seconds] [fft size (power of two, at least 64)] [hop size]\n", argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	std::printf( "Analyzing %.1f seconds of audio with %lu samples per FFT and a hop size of %lu.\n", seconds, (unsigned long)fftSize, (unsigned long)hopSize );
+
+	bool isValid = testFft( fftSize );
+	isValid = testWav() && isValid;
+	isValid = testSweep( seconds, fftSize, hopSize ) && isValid;
+	isValid = testSpectrogram( seconds, fftSize ) && isValid;
+	isValid = testBands( fftSize ) && isValid;
+
+	std::printf( isValid ? "PASSED\n" : "FAILED\n" );
+	return isValid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,306 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "FFT.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#include <xmmintrin.h>
+#define FFT_USE_SSE 1
+#endif
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Radix-4 butterfly of a single group of four complex values, followed by the twiddle multiplication.
+// T is either a float or an SSE vector holding four floats.
+template <typename T>
+struct Butterfly {
+	T r0, i0, r1, i1, r2, i2, r3, i3;
+
+	Butterfly( T ar, T ai, T br, T bi, T cr, T ci, T dr, T di, T w1r, T w1i, T w2r, T w2i, T w3r, T w3i )
+	{
+		const T apcR = ar + cr, apcI = ai + ci;
+		const T amcR = ar - cr, amcI = ai - ci;
+		const T bpdR = br + dr, bpdI = bi + di;
+		const T bmdR = br - dr, bmdI = bi - di;
+
+		r0 = apcR + bpdR;
+		i0 = apcI + bpdI;
+
+		const T t1r = amcR + bmdI, t1i = amcI - bmdR;
+		r1 = t1r * w1r - t1i * w1i;
+		i1 = t1r * w1i + t1i * w1r;
+
+		const T t2r = apcR - bpdR, t2i = apcI - bpdI;
+		r2 = t2r * w2r - t2i * w2i;
+		i2 = t2r * w2i + t2i * w2r;
+
+		const T t3r = amcR - bmdI, t3i = amcI + bmdR;
+		r3 = t3r * w3r - t3i * w3i;
+		i3 = t3r * w3i + t3i * w3r;
+	}
+};
+
+#if FFT_USE_SSE
+// Minimal wrapper, so that the butterfly can be written once for floats and vectors.
+struct Vec4 {
+	__m128 v;
+
+	Vec4() {}
+	Vec4( __m128 v )
+	    : v( v )
+	{
+	}
+
+	static Vec4 load( const float *ptr ) { return _mm_loadu_ps( ptr ); }
+	static Vec4 splat( float f ) { return _mm_set1_ps( f ); }
+	void        store( float *ptr ) const { _mm_storeu_ps( ptr, v ); }
+
+	friend Vec4 operator+( Vec4 a, Vec4 b ) { return _mm_add_ps( a.v, b.v ); }
+	friend Vec4 operator-( Vec4 a, Vec4 b ) { return _mm_sub_ps( a.v, b.v ); }
+	friend Vec4 operator*( Vec4 a, Vec4 b ) { return _mm_mul_ps( a.v, b.v ); }
+};
+#endif
+
+// Performs one radix-4 pass of the Stockham algorithm: a sequence of length n, repeated with stride s,
+// is split into four sequences of length n / 4. Reads from x, writes to y. The twiddles are stored
+// as six arrays of n / 4 floats: w1 (real, imaginary), w2 (real, imaginary), w3 (real, imaginary).
+void radix4( size_t n, size_t s, const float *xr, const float *xi, float *yr, float *yi, const float *twiddles )
+{
+	const size_t m = n / 4;
+	const float *w1r = twiddles, *w1i = w1r + m, *w2r = w1i + m, *w2i = w2r + m, *w3r = w2i + m, *w3i = w3r + m;
+
+	if( s == 1 ) {
+		// first pass: consecutive values of p use different twiddles, so we vectorize over p
+		// and transpose the results, because the four outputs of each butterfly are adjacent
+		size_t p = 0;
+#if FFT_USE_SSE
+		for( ; p + 4 <= m; p += 4 ) {
+			Butterfly<Vec4> b( Vec4::load( xr + p ), Vec4::load( xi + p ), Vec4::load( xr + p + m ), Vec4::load( xi + p + m ), Vec4::load( xr + p + 2 * m ), Vec4::load( xi + p + 2 * m ),
+			                   Vec4::load( xr + p + 3 * m ), Vec4::load( xi + p + 3 * m ), Vec4::load( w1r + p ), Vec4::load( w1i + p ), Vec4::load( w2r + p ), Vec4::load( w2i + p ),
+			                   Vec4::load( w3r + p ), Vec4::load( w3i + p ) );
+
+			_MM_TRANSPOSE4_PS( b.r0.v, b.r1.v, b.r2.v, b.r3.v );
+			_MM_TRANSPOSE4_PS( b.i0.v, b.i1.v, b.i2.v, b.i3.v );
+
+			b.r0.store( yr + 4 * p );
+			b.r1.store( yr + 4 * p + 4 );
+			b.r2.store( yr + 4 * p + 8 );
+			b.r3.store( yr + 4 * p + 12 );
+			b.i0.store( yi + 4 * p );
+			b.i1.store( yi + 4 * p + 4 );
+			b.i2.store( yi + 4 * p + 8 );
+			b.i3.store( yi + 4 * p + 12 );
+		}
+#endif
+		for( ; p < m; ++p ) {
+			Butterfly<float> b( xr[p], xi[p], xr[p + m], xi[p + m], xr[p + 2 * m], xi[p + 2 * m], xr[p + 3 * m], xi[p + 3 * m], w1r[p], w1i[p], w2r[p], w2i[p], w3r[p], w3i[p] );
+
+			yr[4 * p + 0] = b.r0, yi[4 * p + 0] = b.i0;
+			yr[4 * p + 1] = b.r1, yi[4 * p + 1] = b.i1;
+			yr[4 * p + 2] = b.r2, yi[4 * p + 2] = b.i2;
+			yr[4 * p + 3] = b.r3, yi[4 * p + 3] = b.i3;
+		}
+	}
+	else {
+		// later passes: all values of q share the same twiddles, so we vectorize over q
+		for( size_t p = 0; p < m; ++p ) {
+			const size_t a = s * p, b = s * ( p + m ), c = s * ( p + 2 * m ), d = s * ( p + 3 * m );
+			const size_t y0 = s * ( 4 * p ), y1 = y0 + s, y2 = y1 + s, y3 = y2 + s;
+
+			size_t q = 0;
+#if FFT_USE_SSE
+			const Vec4 v1r = Vec4::splat( w1r[p] ), v1i = Vec4::splat( w1i[p] );
+			const Vec4 v2r = Vec4::splat( w2r[p] ), v2i = Vec4::splat( w2i[p] );
+			const Vec4 v3r = Vec4::splat( w3r[p] ), v3i = Vec4::splat( w3i[p] );
+
+			for( ; q + 4 <= s; q += 4 ) {
+				Butterfly<Vec4> f( Vec4::load( xr + a + q ), Vec4::load( xi + a + q ), Vec4::load( xr + b + q ), Vec4::load( xi + b + q ), Vec4::load( xr + c + q ), Vec4::load( xi + c + q ),
+				                   Vec4::load( xr + d + q ), Vec4::load( xi + d + q ), v1r, v1i, v2r, v2i, v3r, v3i );
+
+				f.r0.store( yr + y0 + q ), f.i0.store( yi + y0 + q );
+				f.r1.store( yr + y1 + q ), f.i1.store( yi + y1 + q );
+				f.r2.store( yr + y2 + q ), f.i2.store( yi + y2 + q );
+				f.r3.store( yr + y3 + q ), f.i3.store( yi + y3 + q );
+			}
+#endif
+			for( ; q < s; ++q ) {
+				Butterfly<float> f( xr[a + q], xi[a + q], xr[b + q], xi[b + q], xr[c + q], xi[c + q], xr[d + q], xi[d + q], w1r[p], w1i[p], w2r[p], w2i[p], w3r[p], w3i[p] );
+
+				yr[y0 + q] = f.r0, yi[y0 + q] = f.i0;
+				yr[y1 + q] = f.r1, yi[y1 + q] = f.i1;
+				yr[y2 + q] = f.r2, yi[y2 + q] = f.i2;
+				yr[y3 + q] = f.r3, yi[y3 + q] = f.i3;
+			}
+		}
+	}
+}
+
+// Performs the final radix-2 pass, needed if the length of the sequence is not a power of four.
+// Reads from x, writes to y, which may be the same buffer.
+void radix2( size_t s, const float *xr, const float *xi, float *yr, float *yi )
+{
+	size_t q = 0;
+#if FFT_USE_SSE
+	for( ; q + 4 <= s; q += 4 ) {
+		const Vec4 ar = Vec4::load( xr + q ), ai = Vec4::load( xi + q );
+		const Vec4 br = Vec4::load( xr + q + s ), bi = Vec4::load( xi + q + s );
+		( ar + br ).store( yr + q ), ( ai + bi ).store( yi + q );
+		( ar - br ).store( yr + q + s ), ( ai - bi ).store( yi + q + s );
+	}
+#endif
+	for( ; q < s; ++q ) {
+		const float ar = xr[q], ai = xi[q];
+		const float br = xr[q + s], bi = xi[q + s];
+		yr[q] = ar + br, yi[q] = ai + bi;
+		yr[q + s] = ar - br, yi[q + s] = ai - bi;
+	}
+}
+
+} // anonymous namespace
+
+FFT::FFT( size_t size )
+    : mSize( size )
+{
+	if( size < 4 || ( size & ( size - 1 ) ) != 0 )
+		throw std::invalid_argument( "FFT size must be a power of two and at least 4." );
+
+	// the real input is transformed as a complex sequence of half the size
+	const size_t half = size / 2;
+	mReal.resize( half );
+	mImag.resize( half );
+	mWorkReal.resize( half );
+	mWorkImag.resize( half );
+
+	// twiddles for each radix-4 pass
+	for( size_t n = half; n > 2; n /= 4 ) {
+		const size_t m = n / 4;
+		for( size_t k = 1; k <= 3; ++k ) {
+			for( size_t p = 0; p < m; ++p )
+				mTwiddles.push_back( float( std::cos( 2.0 * kPi * double( k * p ) / double( n ) ) ) );
+			for( size_t p = 0; p < m; ++p )
+				mTwiddles.push_back( float( -std::sin( 2.0 * kPi * double( k * p ) / double( n ) ) ) );
+		}
+	}
+
+	// twiddles to unpack the spectrum of the real input
+	mPackCos.resize( half + 1 );
+	mPackSin.resize( half + 1 );
+	for( size_t k = 0; k <= half; ++k ) {
+		mPackCos[k] = float( std::cos( 2.0 * kPi * double( k ) / double( size ) ) );
+		mPackSin[k] = float( std::sin( 2.0 * kPi * double( k ) / double( size ) ) );
+	}
+}
+
+void FFT::forward( const float *input, float *real, float *imag )
+{
+	const size_t half = mSize / 2;
+
+	// pack even samples into the real part and odd samples into the imaginary part
+	for( size_t k = 0; k < half; ++k ) {
+		mReal[k] = input[2 * k];
+		mImag[k] = input[2 * k + 1];
+	}
+
+	transform();
+
+	// separate the spectra of the even and odd samples and combine them
+	for( size_t k = 0; k <= half; ++k ) {
+		const size_t i = k % half, j = ( half - k ) % half;
+
+		const float evenR = 0.5f * ( mReal[i] + mReal[j] ), evenI = 0.5f * ( mImag[i] - mImag[j] );
+		const float oddR = 0.5f * ( mImag[i] + mImag[j] ), oddI = -0.5f * ( mReal[i] - mReal[j] );
+
+		real[k] = evenR + mPackCos[k] * oddR + mPackSin[k] * oddI;
+		imag[k] = evenI + mPackCos[k] * oddI - mPackSin[k] * oddR;
+	}
+}
+
+void FFT::magnitudes( const float *input, float *output, float scale )
+{
+	const size_t half = mSize / 2;
+
+	for( size_t k = 0; k < half; ++k ) {
+		mReal[k] = input[2 * k];
+		mImag[k] = input[2 * k + 1];
+	}
+
+	transform();
+
+	for( size_t k = 0; k < half; ++k ) {
+		const size_t i = k, j = ( half - k ) % half;
+
+		const float evenR = 0.5f * ( mReal[i] + mReal[j] ), evenI = 0.5f * ( mImag[i] - mImag[j] );
+		const float oddR = 0.5f * ( mImag[i] + mImag[j] ), oddI = -0.5f * ( mReal[i] - mReal[j] );
+
+		const float re = evenR + mPackCos[k] * oddR + mPackSin[k] * oddI;
+		const float im = evenI + mPackCos[k] * oddI - mPackSin[k] * oddR;
+
+		output[k] = scale * std::sqrt( re * re + im * im );
+	}
+}
+
+void FFT::transform()
+{
+	float *xr = mReal.data(), *xi = mImag.data();
+	float *yr = mWorkReal.data(), *yi = mWorkImag.data();
+
+	// radix-4 passes, alternating between both buffers
+	const float *twiddles = mTwiddles.data();
+
+	size_t n = mSize / 2, s = 1;
+	while( n > 2 ) {
+		radix4( n, s, xr, xi, yr, yi, twiddles );
+		twiddles += 6 * ( n / 4 );
+
+		std::swap( xr, yr );
+		std::swap( xi, yi );
+
+		n /= 4;
+		s *= 4;
+	}
+
+	// final radix-2 pass, or a copy, to make sure the result ends up in mReal and mImag
+	if( n == 2 )
+		radix2( s, xr, xi, mReal.data(), mImag.data() );
+	else if( xr != mReal.data() ) {
+		std::copy( xr, xr + mSize / 2, mReal.data() );
+		std::copy( xi, xi + mSize / 2, mImag.data() );
+	}
+}
+
+float createHannWindow( size_t size, std::vector<float> &window )
+{
+	double sum = 0.0;
+	window.resize( size );
+	for( size_t i = 0; i < size; ++i ) {
+		window[i] = float( 0.5 - 0.5 * std::cos( 2.0 * kPi * double( i ) / double( size ) ) );
+		sum += window[i];
+	}
+
+	return float( 2.0 / sum );
+}
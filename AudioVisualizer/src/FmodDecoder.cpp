@@ -0,0 +1,105 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "FmodDecoder.h"
+
+#include <cstring>
+#include <stdexcept>
+
+FmodDecoder::FmodDecoder( FMOD::System *system, const ci::fs::path &path )
+    : mSound( nullptr )
+    , mSampleRate( 0 )
+    , mNumChannels( 0 )
+    , mBytesPerSample( 0 )
+    , mNumFrames( 0 )
+{
+	FMOD_RESULT err = system->createSound( path.string().c_str(), FMOD_SOFTWARE | FMOD_OPENONLY | FMOD_ACCURATETIME, NULL, &mSound );
+	if( err != FMOD_OK )
+		throw std::runtime_error( "Failed to open audio file: " + path.string() );
+
+	int   channels = 0, bits = 0;
+	float frequency = 0.0f;
+	mSound->getFormat( NULL, &mFormat, &channels, &bits );
+	mSound->getDefaults( &frequency, NULL, NULL, NULL );
+
+	unsigned int length = 0;
+	mSound->getLength( &length, FMOD_TIMEUNIT_PCM );
+
+	mSampleRate = size_t( frequency );
+	mNumChannels = size_t( channels );
+	mBytesPerSample = size_t( bits / 8 );
+	mNumFrames = length;
+
+	const bool isSupported = mFormat == FMOD_SOUND_FORMAT_PCM8 || mFormat == FMOD_SOUND_FORMAT_PCM16 || mFormat == FMOD_SOUND_FORMAT_PCM24 || mFormat == FMOD_SOUND_FORMAT_PCM32 || mFormat == FMOD_SOUND_FORMAT_PCMFLOAT;
+	if( !isSupported || mNumChannels == 0 || mSampleRate == 0 ) {
+		mSound->release();
+		throw std::runtime_error( "Unsupported audio format: " + path.string() );
+	}
+}
+
+FmodDecoder::~FmodDecoder()
+{
+	if( mSound )
+		mSound->release();
+}
+
+size_t FmodDecoder::read( float *buffer, size_t numFrames )
+{
+	mBuffer.resize( numFrames * mNumChannels * mBytesPerSample );
+
+	// FMOD returns FMOD_ERR_FILE_EOF at the end of the file, but still reports the bytes it did read
+	unsigned int bytesRead = 0;
+	mSound->readData( mBuffer.data(), (unsigned int)mBuffer.size(), &bytesRead );
+
+	numFrames = bytesRead / ( mNumChannels * mBytesPerSample );
+
+	// samples are in native byte order
+	const uint8_t *ptr = mBuffer.data();
+	for( size_t i = 0; i < numFrames * mNumChannels; ++i, ptr += mBytesPerSample ) {
+		switch( mFormat ) {
+		case FMOD_SOUND_FORMAT_PCM8:
+			// FMOD uses signed 8 bit samples
+			buffer[i] = int8_t( ptr[0] ) / 128.0f;
+			break;
+		case FMOD_SOUND_FORMAT_PCM16: {
+			int16_t value;
+			memcpy( &value, ptr, sizeof( value ) );
+			buffer[i] = value / 32768.0f;
+			break;
+		}
+		case FMOD_SOUND_FORMAT_PCM24:
+			buffer[i] = ( int32_t( ( uint32_t( ptr[0] ) << 8 ) | ( uint32_t( ptr[1] ) << 16 ) | ( uint32_t( ptr[2] ) << 24 ) ) >> 8 ) / 8388608.0f;
+			break;
+		case FMOD_SOUND_FORMAT_PCM32: {
+			int32_t value;
+			memcpy( &value, ptr, sizeof( value ) );
+			buffer[i] = value / 2147483648.0f;
+			break;
+		}
+		default:
+			memcpy( &buffer[i], ptr, sizeof( float ) );
+			break;
+		}
+	}
+
+	return numFrames;
+}
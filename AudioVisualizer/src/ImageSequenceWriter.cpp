@@ -0,0 +1,125 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImageSequenceWriter.h"
+
+#include "cinder/ImageIo.h"
+#include "cinder/app/App.h"
+
+#include <iomanip>
+#include <sstream>
+
+using namespace ci;
+
+ImageSequenceWriter::ImageSequenceWriter( const fs::path &directory, const std::string &prefix, const std::string &extension, size_t numThreads, size_t capacity )
+    : mDirectory( directory )
+    , mPrefix( prefix )
+    , mExtension( extension )
+    , mCapacity( capacity > 0 ? capacity : 1 )
+    , mNumBusy( 0 )
+    , mNumWritten( 0 )
+    , mNumFailed( 0 )
+    , mIsRunning( true )
+{
+	for( size_t i = 0; i < numThreads || i == 0; ++i )
+		mThreads.emplace_back( &ImageSequenceWriter::work, this );
+}
+
+ImageSequenceWriter::~ImageSequenceWriter()
+{
+	finish();
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mIsRunning = false;
+	}
+	mQueueChanged.notify_all();
+
+	for( auto &thread : mThreads )
+		thread.join();
+}
+
+void ImageSequenceWriter::write( Surface8u surface, size_t index )
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	mQueueChanged.wait( lock, [&] { return mQueue.size() < mCapacity; } );
+
+	mQueue.emplace_back( std::move( surface ), index );
+	mQueueChanged.notify_all();
+}
+
+void ImageSequenceWriter::finish()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	mQueueChanged.wait( lock, [&] { return mQueue.empty() && mNumBusy == 0; } );
+}
+
+size_t ImageSequenceWriter::getNumWritten() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mNumWritten;
+}
+
+size_t ImageSequenceWriter::getNumFailed() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mNumFailed;
+}
+
+void ImageSequenceWriter::work()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+
+	for( ;; ) {
+		mQueueChanged.wait( lock, [&] { return !mQueue.empty() || !mIsRunning; } );
+		if( mQueue.empty() )
+			return;
+
+		auto image = std::move( mQueue.front() );
+		mQueue.pop_front();
+		mNumBusy++;
+
+		// make room for the next image before we start encoding this one
+		mQueueChanged.notify_all();
+		lock.unlock();
+
+		std::ostringstream filename;
+		filename << mPrefix << std::setw( 6 ) << std::setfill( '0' ) << image.second << "." << mExtension;
+
+		bool isWritten = true;
+		try {
+			writeImage( mDirectory / filename.str(), image.first );
+		}
+		catch( const std::exception &e ) {
+			app::console() << "Failed to write " << filename.str() << ": " << e.what() << std::endl;
+			isWritten = false;
+		}
+
+		lock.lock();
+		mNumBusy--;
+		if( isWritten )
+			mNumWritten++;
+		else
+			mNumFailed++;
+		mQueueChanged.notify_all();
+	}
+}
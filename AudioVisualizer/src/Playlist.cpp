@@ -0,0 +1,214 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Playlist.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+using namespace ci;
+
+namespace {
+
+std::string toLower( std::string str )
+{
+	std::transform( str.begin(), str.end(), str.begin(), []( char c ) { return char( std::tolower( (unsigned char)c ) ); } );
+	return str;
+}
+
+} // anonymous namespace
+
+Playlist::Playlist( const std::vector<std::string> &extensions, double refreshInterval )
+    : mRefreshInterval( refreshInterval > 0.0 ? refreshInterval : 2.0 )
+    , mIsRunning( true )
+{
+	for( const auto &extension : extensions )
+		mExtensions.push_back( "." + toLower( extension ) );
+
+	mThread = std::thread( &Playlist::run, this );
+}
+
+Playlist::~Playlist()
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mIsRunning = false;
+	}
+	mChanged.notify_all();
+
+	mThread.join();
+}
+
+void Playlist::setDirectory( const fs::path &directory )
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( directory == mDirectory )
+			return;
+
+		mDirectory = directory;
+	}
+	mChanged.notify_all();
+}
+
+fs::path Playlist::getDirectory() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mDirectory;
+}
+
+bool Playlist::isReady() const
+{
+	return getIndex() != nullptr;
+}
+
+bool Playlist::wait( double timeout ) const
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	return mChanged.wait_for( lock, std::chrono::duration<double>( timeout ), [&] { return mIndex && mIndex->mDirectory == mDirectory; } );
+}
+
+size_t Playlist::getNumFiles() const
+{
+	IndexRef index = getIndex();
+	return index ? index->mFiles.size() : 0;
+}
+
+fs::path Playlist::first() const
+{
+	IndexRef index = getIndex();
+	if( !index || index->mFiles.empty() )
+		return fs::path();
+
+	return index->mFiles.front();
+}
+
+fs::path Playlist::prev( const fs::path &file ) const
+{
+	IndexRef index = getIndex();
+	if( !index || index->mFiles.empty() )
+		return fs::path();
+
+	// if not found, or if it is the first audio file, simply return last audio file
+	auto itr = index->mPositions.find( file.filename().string() );
+	if( itr == index->mPositions.end() || itr->second == 0 )
+		return index->mFiles.back();
+
+	return index->mFiles[itr->second - 1];
+}
+
+fs::path Playlist::next( const fs::path &file ) const
+{
+	IndexRef index = getIndex();
+	if( !index || index->mFiles.empty() )
+		return fs::path();
+
+	// if not found, or if it is the last audio file, simply return first audio file
+	auto itr = index->mPositions.find( file.filename().string() );
+	if( itr == index->mPositions.end() || itr->second + 1 == index->mFiles.size() )
+		return index->mFiles.front();
+
+	return index->mFiles[itr->second + 1];
+}
+
+Playlist::IndexRef Playlist::getIndex() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	if( !mIndex || mIndex->mDirectory != mDirectory )
+		return IndexRef();
+
+	return mIndex;
+}
+
+Playlist::IndexRef Playlist::createIndex( const fs::path &directory ) const
+{
+	auto index = std::make_shared<Index>();
+	index->mDirectory = directory;
+
+	fs::directory_iterator end_itr;
+	for( fs::directory_iterator i( directory ); i != end_itr; ++i ) {
+		// skip if not a file
+		if( !fs::is_regular_file( i->status() ) )
+			continue;
+
+		// skip if extension does not match
+		const std::string extension = toLower( i->path().extension().string() );
+		if( std::find( mExtensions.begin(), mExtensions.end(), extension ) == mExtensions.end() )
+			continue;
+
+		// file matches
+		index->mFiles.push_back( i->path() );
+	}
+
+	// the order of the directory iterator is unspecified
+	std::sort( index->mFiles.begin(), index->mFiles.end() );
+
+	for( size_t i = 0; i < index->mFiles.size(); ++i )
+		index->mPositions[index->mFiles[i].filename().string()] = i;
+
+	return index;
+}
+
+void Playlist::run()
+{
+	// adding, removing or renaming a file updates the modification time of its directory,
+	// so we only have to list the directory again if that has changed
+	fs::path directory;
+	auto     modified = decltype( fs::last_write_time( directory ) )();
+	bool     isIndexed = false;
+
+	std::unique_lock<std::mutex> lock( mMutex );
+	while( mIsRunning ) {
+		const fs::path requested = mDirectory;
+		lock.unlock();
+
+		IndexRef index;
+		try {
+			const auto time = fs::last_write_time( requested );
+			if( !isIndexed || requested != directory || time != modified ) {
+				index = createIndex( requested );
+				modified = time;
+			}
+		}
+		catch( const std::exception & ) {
+			// the directory does not exist or can not be read, which results in an empty playlist
+			if( !isIndexed || requested != directory ) {
+				auto empty = std::make_shared<Index>();
+				empty->mDirectory = requested;
+				index = empty;
+			}
+		}
+
+		directory = requested;
+		isIndexed = true;
+
+		lock.lock();
+		if( index && index->mDirectory == mDirectory ) {
+			mIndex = index;
+			mChanged.notify_all();
+		}
+
+		// wait until it's time to check for changes, or until another directory is requested
+		mChanged.wait_for( lock, std::chrono::duration<double>( mRefreshInterval ), [&] { return !mIsRunning || mDirectory != directory; } );
+	}
+}
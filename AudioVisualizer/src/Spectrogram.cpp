@@ -0,0 +1,112 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Spectrogram.h"
+#include "FFT.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+// Decodes all audio, split into a left and right channel.
+void decode( const AudioDecoderRef &decoder, std::vector<float> &left, std::vector<float> &right )
+{
+	const size_t kFramesPerRead = 65536;
+	const size_t numChannels = decoder->getNumChannels();
+
+	left.clear();
+	right.clear();
+	left.reserve( size_t( decoder->getNumFrames() ) );
+	right.reserve( size_t( decoder->getNumFrames() ) );
+
+	std::vector<float> samples( kFramesPerRead * numChannels );
+	while( size_t numRead = decoder->read( samples.data(), kFramesPerRead ) ) {
+		for( size_t i = 0; i < numRead; ++i ) {
+			left.push_back( samples[i * numChannels] );
+			right.push_back( samples[i * numChannels + ( numChannels > 1 ? 1 : 0 )] );
+		}
+	}
+}
+
+} // anonymous namespace
+
+Spectrogram::Spectrogram( const AudioDecoderRef &decoder, double spectraPerSecond, size_t fftSize, size_t numThreads )
+    : mDuration( 0.0 )
+    , mSpectraPerSecond( spectraPerSecond )
+    , mNumSpectra( 0 )
+    , mNumBins( fftSize / 2 )
+{
+	if( !decoder || spectraPerSecond <= 0.0 )
+		throw std::invalid_argument( "Spectrogram requires a decoder and a positive rate." );
+
+	std::vector<float> left, right;
+	decode( decoder, left, right );
+
+	const double sampleRate = double( decoder->getSampleRate() );
+	mDuration = double( left.size() ) / sampleRate;
+	mNumSpectra = size_t( std::ceil( mDuration * spectraPerSecond ) );
+
+	mLeft.resize( mNumSpectra * mNumBins );
+	mRight.resize( mNumSpectra * mNumBins );
+
+	std::vector<float> window;
+	const float        scale = createHannWindow( fftSize, window );
+
+	// each thread computes a contiguous range of spectra, using its own transform and buffers
+	auto compute = [&]( size_t first, size_t last ) {
+		FFT                fft( fftSize );
+		std::vector<float> windowed( fftSize );
+
+		for( size_t i = first; i < last; ++i ) {
+			const int64_t end = int64_t( std::floor( double( i + 1 ) * sampleRate / spectraPerSecond + 0.5 ) );
+			const int64_t begin = end - int64_t( fftSize );
+
+			// window the left channel, padding with silence before the start and after the end of the audio
+			for( size_t j = 0; j < fftSize; ++j ) {
+				const int64_t k = begin + int64_t( j );
+				windowed[j] = ( k >= 0 && k < int64_t( left.size() ) ) ? left[size_t( k )] * window[j] : 0.0f;
+			}
+			fft.magnitudes( windowed.data(), &mLeft[i * mNumBins], scale );
+
+			// and the right channel
+			for( size_t j = 0; j < fftSize; ++j ) {
+				const int64_t k = begin + int64_t( j );
+				windowed[j] = ( k >= 0 && k < int64_t( right.size() ) ) ? right[size_t( k )] * window[j] : 0.0f;
+			}
+			fft.magnitudes( windowed.data(), &mRight[i * mNumBins], scale );
+		}
+	};
+
+	numThreads = std::max<size_t>( 1, std::min( numThreads, mNumSpectra ) );
+
+	std::vector<std::thread> threads;
+	for( size_t t = 1; t < numThreads; ++t )
+		threads.emplace_back( compute, t * mNumSpectra / numThreads, ( t + 1 ) * mNumSpectra / numThreads );
+
+	compute( 0, mNumSpectra / numThreads );
+
+	for( auto &thread : threads )
+		thread.join();
+}
@@ -0,0 +1,209 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SpectrumAnalyzer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+
+Spectrum createSpectrum( size_t numBins )
+{
+	Spectrum spectrum;
+	spectrum.mTime = 0.0;
+	spectrum.mLeft.assign( numBins, 0.0f );
+	spectrum.mRight.assign( numBins, 0.0f );
+	return spectrum;
+}
+
+} // anonymous namespace
+
+SpectrumAnalyzer::SpectrumAnalyzer( size_t fftSize, size_t capacity )
+    : mFft( fftSize )
+    , mRing( capacity, createSpectrum( fftSize / 2 ) )
+    , mHopSize( 0 )
+    , mIsRealTime( true )
+    , mIsRunning( false )
+    , mShouldStop( false )
+    , mNumFfts( 0 )
+    , mNumDropped( 0 )
+    , mFftNanoseconds( 0 )
+{
+	// Hann window, normalized so that a full scale sine wave has a magnitude of about 1
+	mScale = createHannWindow( fftSize, mWindow );
+	mWindowed.resize( fftSize );
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+	stop();
+}
+
+void SpectrumAnalyzer::start( const AudioDecoderRef &decoder, size_t hopSize, bool isRealTime, const PlaybackClock &playbackClock )
+{
+	stop();
+
+	if( !decoder || hopSize == 0 )
+		throw std::invalid_argument( "SpectrumAnalyzer requires a decoder and a hop size." );
+
+	mDecoder = decoder;
+	mHopSize = hopSize;
+	mIsRealTime = isRealTime;
+	mPlaybackClock = playbackClock;
+
+	mShouldStop = false;
+	mIsRunning = true;
+	mThread = std::thread( &SpectrumAnalyzer::run, this );
+}
+
+void SpectrumAnalyzer::stop()
+{
+	mShouldStop = true;
+	if( mThread.joinable() )
+		mThread.join();
+
+	mIsRunning = false;
+	mDecoder.reset();
+	mPlaybackClock = nullptr;
+	mRing.clear();
+}
+
+bool SpectrumAnalyzer::pop( Spectrum &spectrum )
+{
+	const Spectrum *front = mRing.front();
+	if( !front )
+		return false;
+
+	spectrum.mTime = front->mTime;
+	spectrum.mLeft.assign( front->mLeft.begin(), front->mLeft.end() );
+	spectrum.mRight.assign( front->mRight.begin(), front->mRight.end() );
+	mRing.pop();
+
+	return true;
+}
+
+double SpectrumAnalyzer::getFftsPerSecond() const
+{
+	const uint64_t nanoseconds = mFftNanoseconds;
+	if( nanoseconds == 0 )
+		return 0.0;
+
+	return double( mNumFfts ) / ( 1e-9 * double( nanoseconds ) );
+}
+
+void SpectrumAnalyzer::run()
+{
+	typedef std::chrono::steady_clock clock;
+
+	const size_t fftSize = mFft.getSize();
+	const size_t numChannels = mDecoder->getNumChannels();
+	const double sampleRate = double( mDecoder->getSampleRate() );
+
+	// the most recent fftSize samples of the left and right channel
+	std::vector<float> historyLeft( fftSize, 0.0f );
+	std::vector<float> historyRight( fftSize, 0.0f );
+	std::vector<float> samples( mHopSize * numChannels );
+
+	// only the most recent samples of a hop are needed if the hop is larger than the transform
+	const size_t keep = std::min( mHopSize, fftSize );
+
+	const clock::time_point startTime = clock::now();
+	uint64_t                numFrames = 0;
+
+	while( !mShouldStop ) {
+		// decode the next hop, padding with silence at the end of the file
+		const size_t numRead = mDecoder->read( samples.data(), mHopSize );
+		if( numRead == 0 )
+			break;
+
+		std::fill( samples.begin() + numRead * numChannels, samples.end(), 0.0f );
+		numFrames += mHopSize;
+
+		std::copy( historyLeft.begin() + keep, historyLeft.end(), historyLeft.begin() );
+		std::copy( historyRight.begin() + keep, historyRight.end(), historyRight.begin() );
+
+		const float *src = samples.data() + ( mHopSize - keep ) * numChannels;
+		for( size_t i = 0, j = fftSize - keep; i < keep; ++i, ++j, src += numChannels ) {
+			historyLeft[j] = src[0];
+			historyRight[j] = src[numChannels > 1 ? 1 : 0];
+		}
+
+		// in real-time, wait until the audio has been played back up to this point
+		const double time = double( numFrames ) / sampleRate;
+		if( mIsRealTime )
+			waitForPlayback( time, startTime );
+
+		// find a free slot, or drop the spectrum if we're running in real-time and the consumer is too slow
+		Spectrum *spectrum = mRing.beginPush();
+		while( !spectrum && !mIsRealTime && !mShouldStop ) {
+			std::this_thread::yield();
+			spectrum = mRing.beginPush();
+		}
+
+		if( !spectrum ) {
+			mNumDropped++;
+			continue;
+		}
+
+		const clock::time_point begin = clock::now();
+		analyze( historyLeft, spectrum->mLeft );
+		analyze( historyRight, spectrum->mRight );
+		mFftNanoseconds += uint64_t( std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - begin ).count() );
+		mNumFfts += 2;
+
+		spectrum->mTime = time;
+		mRing.endPush();
+	}
+
+	mIsRunning = false;
+}
+
+void SpectrumAnalyzer::waitForPlayback( double time, std::chrono::steady_clock::time_point startTime )
+{
+	if( !mPlaybackClock ) {
+		std::this_thread::sleep_until( startTime + std::chrono::microseconds( int64_t( 1e6 * time ) ) );
+		return;
+	}
+
+	// sleep in short intervals, so we notice if playback is paused or resumed. If playback is ahead of us,
+	// we don't wait at all until we have caught up.
+	static const double kMaxSleep = 0.005;
+
+	while( !mShouldStop ) {
+		const double remaining = time - mPlaybackClock();
+		if( remaining <= 0.0 )
+			break;
+
+		std::this_thread::sleep_for( std::chrono::microseconds( int64_t( 1e6 * std::min( remaining, kMaxSleep ) ) ) );
+	}
+}
+
+void SpectrumAnalyzer::analyze( const std::vector<float> &history, std::vector<float> &magnitudes )
+{
+	const size_t fftSize = mFft.getSize();
+	for( size_t i = 0; i < fftSize; ++i )
+		mWindowed[i] = history[i] * mWindow[i];
+
+	mFft.magnitudes( mWindowed.data(), magnitudes.data(), mScale );
+}
@@ -0,0 +1,145 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "WavDecoder.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const uint16_t kFormatPcm = 0x0001;
+const uint16_t kFormatFloat = 0x0003;
+const uint16_t kFormatExtensible = 0xFFFE;
+
+// WAV files are little endian, so we assemble values byte by byte
+uint16_t readUint16( const uint8_t *ptr )
+{
+	return uint16_t( ptr[0] | ( ptr[1] << 8 ) );
+}
+
+uint32_t readUint32( const uint8_t *ptr )
+{
+	return uint32_t( ptr[0] ) | ( uint32_t( ptr[1] ) << 8 ) | ( uint32_t( ptr[2] ) << 16 ) | ( uint32_t( ptr[3] ) << 24 );
+}
+
+} // anonymous namespace
+
+WavDecoder::WavDecoder( const ci::fs::path &path )
+    : mStream( path.string().c_str(), std::ios::binary )
+    , mSampleRate( 0 )
+    , mNumChannels( 0 )
+    , mBytesPerSample( 0 )
+    , mIsFloat( false )
+    , mNumFrames( 0 )
+    , mFramesRead( 0 )
+{
+	if( !mStream )
+		throw std::runtime_error( "Failed to open WAV file: " + path.string() );
+
+	uint8_t header[12];
+	if( !mStream.read( (char *)header, sizeof( header ) ) || memcmp( header, "RIFF", 4 ) != 0 || memcmp( header + 8, "WAVE", 4 ) != 0 )
+		throw std::runtime_error( "Not a WAV file: " + path.string() );
+
+	// walk the chunks until we find the sample data, the format chunk always comes first
+	bool hasFormat = false;
+	for( ;; ) {
+		uint8_t chunk[8];
+		if( !mStream.read( (char *)chunk, sizeof( chunk ) ) )
+			throw std::runtime_error( "WAV file has no data: " + path.string() );
+
+		const uint32_t size = readUint32( chunk + 4 );
+
+		if( memcmp( chunk, "fmt ", 4 ) == 0 ) {
+			std::vector<uint8_t> fmt( size + ( size & 1 ) );
+			if( size < 16 || !mStream.read( (char *)fmt.data(), fmt.size() ) )
+				throw std::runtime_error( "Invalid WAV format: " + path.string() );
+
+			uint16_t format = readUint16( &fmt[0] );
+			if( format == kFormatExtensible && size >= 26 )
+				format = readUint16( &fmt[24] );
+
+			mNumChannels = readUint16( &fmt[2] );
+			mSampleRate = readUint32( &fmt[4] );
+			mBytesPerSample = readUint16( &fmt[14] ) / 8;
+			mIsFloat = ( format == kFormatFloat );
+
+			const bool isSupported = ( format == kFormatPcm && mBytesPerSample >= 1 && mBytesPerSample <= 4 ) || ( mIsFloat && mBytesPerSample == 4 );
+			if( !isSupported || mNumChannels == 0 || mSampleRate == 0 )
+				throw std::runtime_error( "Unsupported WAV format: " + path.string() );
+
+			hasFormat = true;
+		}
+		else if( memcmp( chunk, "data", 4 ) == 0 ) {
+			if( !hasFormat )
+				throw std::runtime_error( "Invalid WAV format: " + path.string() );
+
+			mNumFrames = size / ( mBytesPerSample * mNumChannels );
+			break;
+		}
+		else {
+			// skip unknown chunks, which are padded to an even size
+			mStream.seekg( size + ( size & 1 ), std::ios::cur );
+		}
+	}
+}
+
+size_t WavDecoder::read( float *buffer, size_t numFrames )
+{
+	if( mFramesRead + numFrames > mNumFrames )
+		numFrames = size_t( mNumFrames - mFramesRead );
+
+	const size_t numSamples = numFrames * mNumChannels;
+	mBuffer.resize( numSamples * mBytesPerSample );
+	mStream.read( (char *)mBuffer.data(), mBuffer.size() );
+
+	// a truncated file simply ends early
+	numFrames = size_t( mStream.gcount() ) / ( mBytesPerSample * mNumChannels );
+	mFramesRead += numFrames;
+
+	const uint8_t *ptr = mBuffer.data();
+	for( size_t i = 0; i < numFrames * mNumChannels; ++i, ptr += mBytesPerSample ) {
+		if( mIsFloat ) {
+			const uint32_t bits = readUint32( ptr );
+			memcpy( &buffer[i], &bits, sizeof( float ) );
+			continue;
+		}
+
+		switch( mBytesPerSample ) {
+		case 1:
+			// 8 bit samples are unsigned
+			buffer[i] = ( ptr[0] - 128 ) / 128.0f;
+			break;
+		case 2:
+			buffer[i] = int16_t( readUint16( ptr ) ) / 32768.0f;
+			break;
+		case 3:
+			buffer[i] = ( int32_t( ( uint32_t( ptr[0] ) << 8 ) | ( uint32_t( ptr[1] ) << 16 ) | ( uint32_t( ptr[2] ) << 24 ) ) >> 8 ) / 8388608.0f;
+			break;
+		case 4:
+			buffer[i] = int32_t( readUint32( ptr ) ) / 2147483648.0f;
+			break;
+		}
+	}
+
+	return numFrames;
+}
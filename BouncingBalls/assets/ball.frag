@@ -0,0 +1,13 @@
+#version 150
+
+uniform sampler2D uTex0;
+
+in vec2 vertTexCoord0;
+in vec3 vertColor;
+
+out vec4 fragColor;
+
+void main()
+{
+	fragColor = texture( uTex0, vertTexCoord0 ) * vec4( vertColor, 1.0 );
+}
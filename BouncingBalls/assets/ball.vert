@@ -0,0 +1,39 @@
+#version 150
+
+uniform mat4 ciModelViewProjection;
+
+// Number of instances per ball, see Ball::kMaxTrailSize.
+uniform int uMaxTrailSize;
+
+in vec4 ciPosition;
+in vec2 ciTexCoord0;
+
+in vec4 iPositions; // xy = previous position, zw = current position
+in vec4 iColor;     // rgb = color, a = number of trail samples
+
+out vec2 vertTexCoord0;
+out vec3 vertColor;
+
+void main()
+{
+	// Each ball is drawn uMaxTrailSize times, but only uses the first few samples.
+	float index = float( gl_InstanceID % uMaxTrailSize );
+	float trailsize = iColor.a;
+
+	if( index >= trailsize ) {
+		// Collapse unused samples to a single point outside the viewport, so they won't be rasterized.
+		vertTexCoord0 = vec2( 0 );
+		vertColor = vec3( 0 );
+		gl_Position = vec4( 2.0, 2.0, 2.0, 1.0 );
+		return;
+	}
+
+	// Interpolate between previous and current position. Motion blur is created using additive blending.
+	float segments = max( trailsize - 1.0, 1.0 );
+	vec2 offset = mix( iPositions.xy, iPositions.zw, index / segments );
+
+	vertTexCoord0 = ciTexCoord0;
+	vertColor = iColor.rgb / trailsize;
+
+	gl_Position = ciModelViewProjection * vec4( ciPosition.xy + offset, ciPosition.zw );
+}
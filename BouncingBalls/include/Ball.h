@@ -0,0 +1,77 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Color.h"
+#include "cinder/Rand.h"
+#include "cinder/Vector.h"
+
+#include <memory>
+
+typedef std::shared_ptr<class Ball> BallRef;
+
+// Per-instance data, one record per ball. The vertex shader
+// generates the motion blur trail from this record.
+struct BallInstance {
+	ci::vec4 mPositions; // xy = previous position, zw = current position
+	ci::vec4 mColor;     // rgb = color, a = number of trail samples
+};
+
+class Ball {
+  public:
+	Ball( const ci::vec2 &size, ci::Rand &rand );
+
+	void reset( const ci::vec2 &size, ci::Rand &rand );
+
+	// The ball doesn't access the window directly, so it can be simulated on any thread.
+	// A time step of 1 equals 1/60th of a second.
+	void update( const ci::vec2 &size, float timestep );
+	void advance( float time );
+	void finish( const ci::vec2 &size, float timestep );
+	void draw( BallInstance *instance, bool useMotionBlur = true ) const;
+
+	float timeOfImpact( const BallRef &other, float timestep ) const;
+	void  collideWith( const BallRef &other, float time );
+
+	bool isCollidingWithWindow( const ci::vec2 &size ) const;
+	void collideWithWindow( const ci::vec2 &size, float timestep );
+	void keepWithinWindow( const ci::vec2 &size );
+
+  public:
+	static const int kRadius = 10;
+	static const int kMaxTrailSize = 30;
+
+  public:
+	ci::vec2 mPrevPosition;
+	ci::vec2 mPosition;
+	ci::vec2 mVelocity;
+
+	ci::Colorf mColor;
+
+	float mGravity;
+
+	// Time within the current step that corresponds with mPosition.
+	float mTime;
+
+	bool mHasBeenDrawn;
+};
@@ -0,0 +1,180 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Area.h"
+#include "cinder/Rand.h"
+#include "cinder/Rect.h"
+#include "cinder/Vector.h"
+
+#include "Ball.h"
+#include "WorkerPool.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//! The bouncing balls simulation. It does not depend on a window or an OpenGL context,
+//! so it can run on any thread or in a console application.
+class Simulation {
+  public:
+	Simulation();
+
+	//! Sets the size of the area the balls can move in.
+	void            setSize( const ci::vec2 &size ) { mSize = size; }
+	const ci::vec2 &getSize() const { return mSize; }
+
+	//! Sets the number of steps per second. Fewer steps means larger time steps.
+	void setStepsPerSecond( int steps ) { mStepsPerSecond = steps; }
+	int  getStepsPerSecond() const { return mStepsPerSecond; }
+
+	//! Sets the number of threads. The outcome of the simulation does not depend on it.
+	void   setNumThreads( size_t numThreads );
+	size_t getNumThreads() const { return mWorkerPool->getNumThreads(); }
+
+	//! Seeds the random generator used to create and reset balls.
+	void seed( uint32_t seed ) { mRand.seed( seed ); }
+
+	void addBalls( size_t count );
+	void removeBalls( size_t count );
+	void resetBalls();
+
+	const std::vector<BallRef> &getBalls() const { return mBalls; }
+
+	//! Advances the simulation by a single time step.
+	void step();
+
+	//! Returns the number of pairs of balls that were on a collision course during the last step.
+	size_t getNumPairs() const { return mNumPairs; }
+	//! Returns the number of collisions that were resolved during the last step.
+	size_t getNumCollisions() const;
+
+  private:
+	void performCollisions( float timestep );
+	void resolveCollisions( size_t island, float timestep );
+	void findPairs( float timestep, bool isFirstPass );
+	void separateBalls( float timestep );
+
+  private:
+	static const size_t kBallsPerTask = 256;
+	static const size_t kMaxCollisionsPerPair = 8;
+	static const int    kMaxPasses = 4;
+
+	// a collision between balls a and b at time t, used to resolve collisions in time order
+	struct Collision {
+		float    t;
+		uint32_t a, b;
+		uint32_t countA, countB;
+
+		bool operator>( const Collision &other ) const
+		{
+			if( t != other.t )
+				return t > other.t;
+			if( a != other.a )
+				return a > other.a;
+			return b > other.b;
+		}
+	};
+
+	// our list of balls
+	std::vector<BallRef> mBalls;
+
+	// size of the area the balls can move in
+	ci::vec2 mSize;
+
+	// number of simulation steps per second, fewer steps means larger time steps
+	int mStepsPerSecond;
+
+	// used to create and reset balls
+	ci::Rand mRand;
+
+	// distributes the simulation over all cores
+	std::unique_ptr<WorkerPool> mWorkerPool;
+
+	// number of pairs of balls that were on a collision course during the last step
+	size_t mNumPairs;
+
+	// area covered by each ball during the remainder of the current time step, and during all of it
+	std::vector<ci::Rectf> mBounds;
+	std::vector<ci::Rectf> mFirstBounds;
+
+	// balls that are searched for new pairs, in ascending order
+	std::vector<uint32_t> mActive;
+	std::vector<uint8_t>  mIsActive;
+
+	// uniform grid used to find colliding balls, sorted by cell
+	struct CellBall {
+		ci::Rectf bounds;
+		uint32_t  ball;
+		int       column;
+	};
+
+	std::vector<ci::Area> mCells;
+	std::vector<uint32_t> mCellStart;
+	std::vector<CellBall> mCellBalls;
+
+	// scratch buffer used by the counting sorts
+	std::vector<uint32_t> mOffsets;
+
+	// pairs of balls that may collide, found per task
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> mTaskPairs;
+
+	// pairs of balls that may touch, found per task and combined for all passes
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> mTaskContacts;
+	std::vector<std::pair<uint32_t, uint32_t>>              mContacts;
+	size_t                                                  mNumFirstContacts;
+
+	// for each ball, the balls it may collide with
+	std::vector<uint32_t> mNeighborStart;
+	std::vector<uint32_t> mNeighbors;
+
+	// groups of balls that may collide with each other, but not with balls from other groups
+	std::vector<uint32_t>                      mIslandRoot;
+	std::vector<uint32_t>                      mIslandIndex;
+	std::vector<uint32_t>                      mIslandStart;
+	std::vector<std::pair<uint32_t, uint32_t>> mIslandPairs;
+
+	// number of collisions per ball, used to discard outdated collisions
+	std::vector<uint32_t> mCollisionCount;
+
+	// pairs of balls that may touch at the end of a step, sorted from the bottom of the window up
+	struct Support {
+		float    y;
+		uint32_t lower;
+		uint32_t upper;
+
+		bool operator<( const Support &other ) const
+		{
+			if( y != other.y )
+				return y > other.y;
+			if( lower != other.lower )
+				return lower < other.lower;
+			return upper < other.upper;
+		}
+	};
+
+	std::vector<Support> mSupports;
+
+	// for each ball, whether it rests on the floor or on another supported ball
+	std::vector<uint8_t> mIsSupported;
+};
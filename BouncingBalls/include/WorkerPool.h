@@ -0,0 +1,65 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! A minimal pool of worker threads. Work is submitted as a number of tasks, which are
+//! executed by the workers and the calling thread. The caller blocks until all tasks are done.
+//! Tasks are identified by their index, so results can be stored in a deterministic order.
+class WorkerPool {
+  public:
+	//! Creates a pool that executes tasks on \a numThreads threads, including the calling thread.
+	explicit WorkerPool( size_t numThreads = std::thread::hardware_concurrency() );
+	~WorkerPool();
+
+	//! Returns the number of threads executing tasks, including the calling thread.
+	size_t getNumThreads() const { return mThreads.size() + 1; }
+
+	//! Calls \a task( index ) for every index in [0, numTasks) and waits until all calls have returned.
+	void run( size_t numTasks, const std::function<void( size_t )> &task );
+
+  private:
+	void work();
+	void execute();
+
+  private:
+	std::vector<std::thread> mThreads;
+
+	std::mutex              mMutex;
+	std::condition_variable mWorkAvailable;
+	std::condition_variable mWorkDone;
+
+	const std::function<void( size_t )> *mTask;
+	size_t                               mNumTasks;
+	std::atomic<size_t>                  mNextTask;
+	size_t                               mNumBusy;
+	size_t                               mGeneration;
+	bool                                 mIsRunning;
+};
@@ -0,0 +1,234 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Ball.h"
+
+#include "cinder/CinderMath.h"
+
+using namespace ci;
+
+Ball::Ball( const vec2 &size, Rand &rand )
+{
+	// Pick a random color.
+	float h = rand.nextFloat( 0.0f, 1.0f );
+	float s = rand.nextFloat( 0.75f, 1.0f );
+	float v = rand.nextFloat( 0.75f, 1.0f );
+	mColor = Colorf( CM_HSV, h, s, v );
+
+	reset( size, rand );
+}
+
+void Ball::reset( const vec2 &size, Rand &rand )
+{
+	// Pick a random position.
+	float x = rand.nextFloat() * size.x;
+	float y = -0.1f * size.y;
+	mPosition = vec2( x, y );
+	mPrevPosition = mPosition;
+
+	// Note: you can use the multiplier to tweak the speed of the system.
+	float multiplier = 0.5f;
+
+	// Note: set gravity to zero for outer space.
+	mGravity = 0.981f * multiplier;
+
+	// Pick a random velocity.
+	x = rand.nextFloat( -15.0f, 15.0f ) * multiplier;
+	y = rand.nextFloat( -15.0f, 0.0f ) * multiplier;
+	mVelocity = vec2( x, y );
+
+	//
+	mTime = 0.0f;
+	mHasBeenDrawn = false;
+}
+
+void Ball::update( const vec2 &size, float timestep )
+{
+	// Store current position.
+	if( mHasBeenDrawn )
+		mPrevPosition = mPosition;
+
+	// First, update the ball's velocity. The position will be updated
+	// after we have found all collisions during this time step.
+	if( !isCollidingWithWindow( size ) )
+		mVelocity.y += mGravity * timestep;
+
+	//
+	mTime = 0.0f;
+	mHasBeenDrawn = false;
+}
+
+void Ball::advance( float time )
+{
+	// Move the ball to the given moment within the current time step.
+	mPosition += ( time - mTime ) * mVelocity;
+	mTime = time;
+}
+
+void Ball::finish( const vec2 &size, float timestep )
+{
+	// Move the ball to the end of the time step.
+	advance( timestep );
+
+	// Finally, perform collision detection.
+	collideWithWindow( size, timestep );
+}
+
+void Ball::draw( BallInstance *instance, bool useMotionBlur ) const
+{
+	if( useMotionBlur ) {
+		// Determine the number of balls that make up the motion blur trail (minimum of 3, maximum of 30).
+		float trailsize = math<float>::clamp( math<float>::floor( glm::distance( mPrevPosition, mPosition ) ), 3.0f, float( kMaxTrailSize ) );
+
+		// The vertex shader will interpolate between both positions and divide the color by the trail size.
+		instance->mPositions = vec4( mPrevPosition, mPosition );
+		instance->mColor = vec4( mColor.r, mColor.g, mColor.b, trailsize );
+	}
+	else {
+		// Draw ball without motion blur.
+		instance->mPositions = vec4( mPosition, mPosition );
+		instance->mColor = vec4( mColor.r, mColor.g, mColor.b, 1.0f );
+	}
+}
+
+float Ball::timeOfImpact( const BallRef &other, float timestep ) const
+{
+	static const float kMinimal = 2.0f * kRadius;
+
+	// 1) both balls may have been moved to a different moment in time,
+	//	so start at the latest of the two
+	float time = math<float>::max( mTime, other->mTime );
+
+	vec2 a = mPosition + ( time - mTime ) * mVelocity;
+	vec2 b = other->mPosition + ( time - other->mTime ) * other->mVelocity;
+
+	// 2) look at the motion of the other ball relative to this one
+	vec2 line = b - a;
+	vec2 velocity = other->mVelocity - mVelocity;
+
+	// 3) if the balls are moving apart, no collision will happen. Neither will it if they
+	//	approach each other so slowly that gravity alone could explain it: this is a ball
+	//	resting on another one, which is handled by Simulation::separateBalls() instead
+	float resting = ( mGravity + other->mGravity ) * timestep;
+	float approach = glm::dot( line, velocity );
+	if( approach >= 0.0f || approach * approach <= resting * resting * glm::dot( line, line ) )
+		return -1.0f;
+
+	// 4) if the balls are already touching, they collide right away
+	float c = glm::dot( line, line ) - kMinimal * kMinimal;
+	if( c <= 0.0f )
+		return time;
+
+	// 5) otherwise, solve |line + t * velocity| = kMinimal for the first t
+	float a2 = glm::dot( velocity, velocity );
+	float discriminant = approach * approach - a2 * c;
+	if( discriminant < 0.0f )
+		return -1.0f; // the balls will pass each other
+
+	float t = time + ( -approach - math<float>::sqrt( discriminant ) ) / a2;
+	if( t > timestep )
+		return -1.0f; // collision will happen during a later time step
+
+	return t;
+}
+
+void Ball::collideWith( const BallRef &other, float time )
+{
+	// 1) move both balls to the moment of collision
+	advance( time );
+	other->advance( time );
+
+	// 2) convert to simple 1-dimensional collision
+	//	by projecting onto line through both centers
+	vec2 line = other->mPosition - mPosition;
+	if( line == vec2( 0 ) )
+		return; // can't determine direction of collision
+
+	vec2 unit = glm::normalize( line );
+
+	float velocity_a = glm::dot( mVelocity, unit );
+	float velocity_b = glm::dot( other->mVelocity, unit );
+
+	// 3) exchange velocities
+	mVelocity -= velocity_a * unit;
+	mVelocity += velocity_b * unit;
+
+	other->mVelocity -= velocity_b * unit;
+	other->mVelocity += velocity_a * unit;
+}
+
+bool Ball::isCollidingWithWindow( const vec2 &size ) const
+{
+	if( mPosition.x < ( 0.0f + kRadius ) || mPosition.x > ( size.x - kRadius ) )
+		return true;
+	if( mPosition.y > ( size.y - kRadius ) )
+		return true;
+
+	return false;
+}
+
+void Ball::collideWithWindow( const vec2 &size, float timestep )
+{
+	//	1) check if the ball hits the left or right side of the window
+	if( mPosition.x < ( 0.0f + kRadius ) || mPosition.x > ( size.x - kRadius ) ) {
+		// to reduce the visual effect of the ball missing the border,
+		// set the previous position to where we are now
+		mPrevPosition = mPosition;
+		// move the ball back into window without adding energy,
+		// by placing it where it would have been without friction
+		mPosition.x -= mVelocity.x * timestep;
+		// reduce velocity due to friction
+		mVelocity.x *= -0.95f;
+	}
+	//	2) check if the ball this the bottom of the window
+	if( mPosition.y > ( size.y - kRadius ) ) {
+		// to reduce the visual effect of the ball missing the border,
+		// set the previous position to where we are now
+		mPrevPosition = mPosition;
+		// move the ball back into window without adding energy,
+		// by placing it where it would have been without friction
+		mPosition.y -= mVelocity.y * timestep;
+		// reduce velocity due to friction
+		mVelocity.x *= 0.95f;
+		mVelocity.y *= -0.9f;
+	}
+
+	//  3) if ball is still outside window,
+	//		it was probably moving very slow or fast. Let's reset it then.
+	keepWithinWindow( size );
+}
+
+void Ball::keepWithinWindow( const vec2 &size )
+{
+	if( mPosition.x < ( 0.0f + kRadius ) ) {
+		mPosition.x = 0.0f + (float)kRadius;
+		mVelocity.x = 0.0f;
+	}
+	else if( mPosition.x > ( size.x - kRadius ) ) {
+		mPosition.x = size.x - (float)kRadius;
+		mVelocity.x = 0.0f;
+	}
+	if( mPosition.y > ( size.y - kRadius ) ) {
+		mPosition.y = size.y - (float)kRadius;
+		mVelocity.y = 0.0f;
+	}
+}
@@ -0,0 +1,277 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Headless benchmark of the bouncing balls simulation. It does not need a window
+// or a graphics card, so it can be run on any machine. Usage:
+//
+//   BouncingBallsBenchmark [balls] [steps] [threads] [steps per second]
+//
+// Reports the time per ball per step and the number of pairs and collisions, and verifies
+// that balls stay within bounds, that energy does not increase and that the outcome
+// does not depend on the number of threads. With a thousand balls or more, it also verifies
+// that simulating a second takes less time than the original brute force search, which
+// checks every pair of balls 60 times per second. Returns a non-zero exit code on failure.
+
+#include "Simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace ci;
+
+namespace {
+
+// The uniform grid only pays off if there are enough balls.
+const size_t kMinBallsForComparison = 1000;
+
+struct Result {
+	double   seconds;
+	double   pairs;
+	double   collisions;
+	uint64_t hash;
+	bool     isValid;
+};
+
+// Total kinetic and potential energy of all balls.
+double getEnergy( const Simulation &simulation )
+{
+	double energy = 0.0;
+	for( const auto &ball : simulation.getBalls() ) {
+		const double height = simulation.getSize().y - ball->mPosition.y;
+		energy += 0.5 * glm::dot( ball->mVelocity, ball->mVelocity ) + ball->mGravity * height;
+	}
+	return energy;
+}
+
+// Checks that all balls are inside the window. Balls start above the window, so we don't check the top.
+bool isWithinBounds( const Simulation &simulation )
+{
+	const vec2 &size = simulation.getSize();
+	for( const auto &ball : simulation.getBalls() ) {
+		const vec2 &p = ball->mPosition;
+		if( !std::isfinite( p.x ) || !std::isfinite( p.y ) )
+			return false;
+		if( p.x < Ball::kRadius || p.x > size.x - Ball::kRadius || p.y > size.y - Ball::kRadius )
+			return false;
+	}
+	return true;
+}
+
+// FNV-1a hash of all positions and velocities, used to compare results bit for bit.
+uint64_t getHash( const Simulation &simulation )
+{
+	uint64_t hash = 14695981039346656037ull;
+	for( const auto &ball : simulation.getBalls() ) {
+		const float values[] = { ball->mPosition.x, ball->mPosition.y, ball->mVelocity.x, ball->mVelocity.y };
+		uint32_t    bits[4];
+		std::memcpy( bits, values, sizeof( bits ) );
+		for( uint32_t b : bits )
+			hash = ( hash ^ b ) * 1099511628211ull;
+	}
+	return hash;
+}
+
+Result run( size_t numBalls, size_t numSteps, size_t numThreads, int stepsPerSecond )
+{
+	Simulation simulation;
+	simulation.setSize( vec2( 1920, 1080 ) );
+	simulation.setStepsPerSecond( stepsPerSecond );
+	simulation.setNumThreads( numThreads );
+	simulation.seed( 2015 );
+	simulation.addBalls( numBalls );
+
+	Result result = { 0.0, 0.0, 0.0, 0, true };
+
+	// Collisions between balls preserve energy, walls only take it away. Allow for a bit of integration error.
+	const double energy = getEnergy( simulation );
+	const double tolerance = 0.01 * energy;
+
+	for( size_t i = 0; i < numSteps; ++i ) {
+		auto start = std::chrono::steady_clock::now();
+		simulation.step();
+		auto end = std::chrono::steady_clock::now();
+
+		result.seconds += std::chrono::duration<double>( end - start ).count();
+		result.pairs += double( simulation.getNumPairs() );
+		result.collisions += double( simulation.getNumCollisions() );
+
+		if( !isWithinBounds( simulation ) ) {
+			std::printf( "  FAILED: ball outside of bounds after step %lu\n", (unsigned long)i );
+			result.isValid = false;
+			break;
+		}
+	}
+
+	if( getEnergy( simulation ) > energy + tolerance ) {
+		std::printf( "  FAILED: energy increased from %.1f to %.1f\n", energy, getEnergy( simulation ) );
+		result.isValid = false;
+	}
+
+	result.pairs /= double( numSteps );
+	result.collisions /= double( numSteps );
+	result.hash = getHash( simulation );
+
+	return result;
+}
+
+// The collision response of the original sample, which moves both balls back in time by a full step.
+void collideBruteForce( Ball &a, Ball &b, const vec2 &size )
+{
+	static const float kMinimal = 2.0f * Ball::kRadius;
+
+	a.mPosition -= a.mVelocity;
+	b.mPosition -= b.mVelocity;
+
+	vec2 line = b.mPosition - a.mPosition;
+	if( line == vec2( 0 ) )
+		return;
+
+	vec2 unit = glm::normalize( line );
+
+	float distance = glm::dot( line, unit );
+	float velocity_a = glm::dot( a.mVelocity, unit );
+	float velocity_b = glm::dot( b.mVelocity, unit );
+	if( velocity_a == velocity_b )
+		return;
+
+	float t = ( kMinimal - distance ) / ( velocity_b - velocity_a );
+
+	a.mPosition += t * a.mVelocity;
+	b.mPosition += t * b.mVelocity;
+
+	a.mVelocity -= velocity_a * unit;
+	a.mVelocity += velocity_b * unit;
+
+	b.mVelocity -= velocity_b * unit;
+	b.mVelocity += velocity_a * unit;
+
+	a.mPosition += ( 1.0f - t ) * a.mVelocity;
+	b.mPosition += ( 1.0f - t ) * b.mVelocity;
+
+	a.collideWithWindow( size, 1.0f );
+	b.collideWithWindow( size, 1.0f );
+}
+
+// Simulates the same balls using the original brute force search at 60 steps per second.
+// Its cost hardly depends on the positions of the balls, so a limited number of steps will do.
+Result runBruteForce( size_t numBalls, size_t numSteps )
+{
+	Simulation simulation;
+	simulation.setSize( vec2( 1920, 1080 ) );
+	simulation.seed( 2015 );
+	simulation.addBalls( numBalls );
+
+	Result result = { 0.0, 0.0, 0.0, 0, true };
+
+	const vec2 &size = simulation.getSize();
+	const auto &balls = simulation.getBalls();
+
+	for( size_t i = 0; i < numSteps; ++i ) {
+		auto start = std::chrono::steady_clock::now();
+
+		for( const auto &ball : balls ) {
+			ball->update( size, 1.0f );
+			ball->finish( size, 1.0f );
+		}
+
+		for( size_t a = 0; a + 1 < balls.size(); ++a ) {
+			for( size_t b = a + 1; b < balls.size(); ++b ) {
+				if( glm::distance( balls[a]->mPosition, balls[b]->mPosition ) < 2 * Ball::kRadius ) {
+					collideBruteForce( *balls[a], *balls[b], size );
+					result.collisions += 1.0;
+				}
+			}
+		}
+
+		auto end = std::chrono::steady_clock::now();
+		result.seconds += std::chrono::duration<double>( end - start ).count();
+	}
+
+	result.pairs = 0.5 * double( numBalls ) * double( numBalls - 1 );
+	result.collisions /= double( numSteps );
+
+	return result;
+}
+
+void report( size_t numThreads, const Result &result, size_t numBalls, size_t numSteps )
+{
+	const double ns = 1.0e9 * result.seconds / double( numBalls * numSteps );
+	std::printf( "%3lu thread(s) %8.1f ns/ball/step  %10.1f pairs/step  %10.1f collisions/step  %8.1f ms total\n", (unsigned long)numThreads, ns, result.pairs, result.collisions, 1000.0 * result.seconds );
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	const size_t numBalls = argc > 1 ? std::strtoul( argv[1], nullptr, 10 ) : 5000;
+	const size_t numSteps = argc > 2 ? std::strtoul( argv[2], nullptr, 10 ) : 1000;
+	const size_t numThreads = argc > 3 ? std::strtoul( argv[3], nullptr, 10 ) : std::thread::hardware_concurrency();
+	const int    stepsPerSecond = argc > 4 ? std::atoi( argv[4] ) : 60;
+
+	if( numBalls == 0 || numSteps == 0 || stepsPerSecond <= 0 ) {
+		std::printf( "Usage: %s [balls] [steps] [threads] [steps per second]\n", argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	std::printf( "Simulating %lu balls for %lu steps at %d steps per second.\n", (unsigned long)numBalls, (unsigned long)numSteps, stepsPerSecond );
+
+	Result single = run( numBalls, numSteps, 1, stepsPerSecond );
+	report( 1, single, numBalls, numSteps );
+
+	bool isValid = single.isValid;
+
+	// compare the time it takes to simulate a second, because the brute force search needs more steps
+	const size_t bruteForceSteps = std::min<size_t>( numSteps, 100 );
+	Result       bruteForce = runBruteForce( numBalls, bruteForceSteps );
+	std::printf( "brute force   " );
+	report( 1, bruteForce, numBalls, bruteForceSteps );
+
+	const double seconds = single.seconds * stepsPerSecond / double( numSteps );
+	const double bruteForceSeconds = bruteForce.seconds * 60.0 / double( bruteForceSteps );
+	std::printf( "Simulating a second takes %.1f ms, the brute force search takes %.1f ms.\n", 1000.0 * seconds, 1000.0 * bruteForceSeconds );
+
+	if( numBalls >= kMinBallsForComparison && seconds > bruteForceSeconds ) {
+		std::printf( "  FAILED: slower than the brute force search\n" );
+		isValid = false;
+	}
+
+	if( numThreads > 1 ) {
+		Result multi = run( numBalls, numSteps, numThreads, stepsPerSecond );
+		report( numThreads, multi, numBalls, numSteps );
+
+		isValid = isValid && multi.isValid;
+
+		if( multi.hash != single.hash ) {
+			std::printf( "  FAILED: results depend on the number of threads\n" );
+			isValid = false;
+		}
+	}
+
+	std::printf( isValid ? "PASSED\n" : "FAILED\n" );
+	return isValid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
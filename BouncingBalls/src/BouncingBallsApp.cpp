@@ -29,288 +29,108 @@
 #include "cinder/gl/Context.h"
 #include "cinder/gl/GlslProg.h"
 #include "cinder/gl/Texture.h"
+#include "cinder/gl/Vbo.h"
 #include "cinder/gl/VboMesh.h"
 #include "cinder/gl/gl.h"
 
+#include "Simulation.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
 
 
-//////////////////////////////////////////
-
-typedef shared_ptr<class Ball> BallRef;
-
-class Ball {
-  public:
-	Ball();
-
-	void reset();
-
-	void update();
-	void draw( const gl::BatchRef &batch, bool useMotionBlur = true );
-
-	bool isCollidingWith( BallRef other );
-	void collideWith( BallRef other );
-
-	bool isCollidingWithWindow();
-	void collideWithWindow();
-
-  public:
-	static const int kRadius = 10;
-
-  public:
-	vec2 mPrevPosition;
-	vec2 mPosition;
-	vec2 mVelocity;
-
-	Colorf mColor;
-
-	float mGravity;
-
-	bool mHasBeenDrawn;
-};
-
-Ball::Ball()
-{
-	// Pick a random color.
-	float h = Rand::randFloat( 0.0f, 1.0f );
-	float s = Rand::randFloat( 0.75f, 1.0f );
-	float v = Rand::randFloat( 0.75f, 1.0f );
-	mColor = Colorf( CM_HSV, h, s, v );
-
-	reset();
-}
-
-void Ball::reset()
-{
-	// Pick a random position.
-	float x = Rand::randFloat() * getWindowWidth();
-	float y = -0.1f * getWindowHeight();
-	mPosition = vec2( x, y );
-	mPrevPosition = mPosition;
-
-	// Note: you can use the multiplier to tweak the speed of the system.
-	float multiplier = 0.5f;
-
-	// Note: set gravity to zero for outer space.
-	mGravity = 0.981f * multiplier;
-
-	// Pick a random velocity.
-	x = Rand::randFloat( -15.0f, 15.0f ) * multiplier;
-	y = Rand::randFloat( -15.0f, 0.0f ) * multiplier;
-	mVelocity = vec2( x, y );
-
-	//
-	mHasBeenDrawn = false;
-}
-
-void Ball::update()
-{
-	// Store current position.
-	if( mHasBeenDrawn )
-		mPrevPosition = mPosition;
-
-	// First, update the ball's velocity.
-	if( !isCollidingWithWindow() )
-		mVelocity.y += mGravity;
-
-	// Next, update the ball's position.
-	mPosition += mVelocity;
-
-	// Finally, perform collision detection.
-	collideWithWindow();
-
-	//
-	mHasBeenDrawn = false;
-}
-
-void Ball::draw( const gl::BatchRef &batch, bool useMotionBlur )
-{
-	// Store the current model matrix.
-	gl::pushModelMatrix();
-
-	if( useMotionBlur ) {
-		// Determine the number of balls that make up the motion blur trail (minimum of 3, maximum of 30).
-		float trailsize = math<float>::clamp( math<float>::floor( glm::distance( mPrevPosition, mPosition ) ), 3.0f, 30.0f );
-		float segments = trailsize - 1.0f;
-
-		// Draw ball with motion blur (using additive blending).
-		gl::ScopedColor color( mColor / trailsize );
-
-		vec2 offset( 0.0f, 0.0f );
-		for( size_t i = 0; i < trailsize; ++i ) {
-			vec2 difference = ci::lerp<vec2>( mPrevPosition, mPosition, i / segments ) - offset;
-			offset += difference;
-
-			gl::translate( difference );
-			batch->draw();
-		}
-	}
-	else {
-		// Draw ball without motion blur.
-		gl::ScopedColor color( mColor );
-		gl::translate( mPosition );
-		batch->draw();
-	}
-
-	// Restore the model matrix.
-	gl::popModelMatrix();
-
-	//
-	mHasBeenDrawn = true;
-}
-
-bool Ball::isCollidingWith( BallRef other )
-{
-	// This is a simplification: there is a change we will miss the collision.
-	return ( glm::distance( mPosition, other->mPosition ) < ( 2 * kRadius ) );
-}
-
-void Ball::collideWith( BallRef other )
-{
-	static const float kMinimal = 2.0f * kRadius;
-
-	// 1) we have already established that the two balls are colliding,
-	// let's move back in time to the moment before collision
-	mPosition -= mVelocity;
-	other->mPosition -= other->mVelocity;
-
-	// 2) convert to simple 1-dimensional collision
-	//	by projecting onto line through both centers
-	vec2 line = other->mPosition - mPosition;
-	vec2 unit = glm::normalize( line );
-
-	float distance = glm::dot( line, unit );
-	float velocity_a = glm::dot( mVelocity, unit );
-	float velocity_b = glm::dot( other->mVelocity, unit );
-	if( velocity_a == velocity_b )
-		return; // no collision will happen
-
-	// 3) find time of collision
-	float t = ( kMinimal - distance ) / ( velocity_b - velocity_a );
-
-	// 4) move to that moment in time
-	mPosition += t * mVelocity;
-	other->mPosition += t * other->mVelocity;
-
-	// 5) exchange velocities
-	mVelocity -= velocity_a * unit;
-	mVelocity += velocity_b * unit;
-
-	other->mVelocity -= velocity_b * unit;
-	other->mVelocity += velocity_a * unit;
-
-	// 6) move forward to current time
-	mPosition += ( 1.0f - t ) * mVelocity;
-	other->mPosition += ( 1.0f - t ) * other->mVelocity;
-
-	// 7) make sure the balls stay within window
-	collideWithWindow();
-	other->collideWithWindow();
-}
-
-bool Ball::isCollidingWithWindow()
-{
-	if( mPosition.x < ( 0.0f + kRadius ) || mPosition.x > ( getWindowWidth() - kRadius ) )
-		return true;
-	if( mPosition.y > ( getWindowHeight() - kRadius ) )
-		return true;
-
-	return false;
-}
-
-void Ball::collideWithWindow()
-{
-	//	1) check if the ball hits the left or right side of the window
-	if( mPosition.x < ( 0.0f + kRadius ) || mPosition.x > ( getWindowWidth() - kRadius ) ) {
-		// to reduce the visual effect of the ball missing the border,
-		// set the previous position to where we are now
-		mPrevPosition = mPosition;
-		// move the ball back into window without adding energy,
-		// by placing it where it would have been without friction
-		mPosition.x -= mVelocity.x;
-		// reduce velocity due to friction
-		mVelocity.x *= -0.95f;
-	}
-	//	2) check if the ball this the bottom of the window
-	if( mPosition.y > ( getWindowHeight() - kRadius ) ) {
-		// to reduce the visual effect of the ball missing the border,
-		// set the previous position to where we are now
-		mPrevPosition = mPosition;
-		// move the ball back into window without adding energy,
-		// by placing it where it would have been without friction
-		mPosition.y -= mVelocity.y;
-		// reduce velocity due to friction
-		mVelocity.x *= 0.95f;
-		mVelocity.y *= -0.9f;
-	}
-
-	//  3) if ball is still outside window,
-	//		it was probably moving very slow or fast. Let's reset it then.
-	if( mPosition.x < ( 0.0f + kRadius ) ) {
-		mPosition.x = 0.0f + (float)kRadius;
-		mVelocity.x = 0.0f;
-	}
-	else if( mPosition.x > ( getWindowWidth() - kRadius ) ) {
-		mPosition.x = getWindowWidth() - (float)kRadius;
-		mVelocity.x = 0.0f;
-	}
-	if( mPosition.y > ( getWindowHeight() - kRadius ) ) {
-		mPosition.y = getWindowHeight() - (float)kRadius;
-		mVelocity.y = 0.0f;
-	}
-}
-
-
 //////////////////////////////////////////
 
 class BouncingBallsApp : public App {
   public:
 	void setup();
+	void cleanup();
 	void update();
 	void draw();
 
+	void resize();
+
 	void keyDown( KeyEvent event );
 
   private:
-	void performCollisions();
+	void startSimulation();
+	void stopSimulation();
+	void simulate();
+
+	void createBatch( size_t capacity );
 
   private:
 	bool mUseMotionBlur;
 	bool mIsPaused;
 
-	// our list of balls
-	std::vector<BallRef> mBalls;
+	// the balls and their physics
+	Simulation mSimulation;
+
+	// optionally runs the simulation on a separate thread
+	std::thread       mSimulationThread;
+	std::mutex        mSimulationMutex;
+	std::atomic<bool> mIsSimulating;
+
+	// snapshots of the simulation, written by the simulation thread and drawn by the main thread
+	std::vector<BallInstance> mBackBuffer;
+	std::vector<BallInstance> mPendingBuffer;
+	std::vector<BallInstance> mFrontBuffer;
+	std::mutex                mSnapshotMutex;
+	bool                      mHasSnapshot;
+	std::atomic<bool>         mSnapshotDrawn;
 
 	// mesh and texture
 	gl::VboMeshRef mMesh;
 	gl::BatchRef   mBatch;
 	gl::TextureRef mTexture;
 
-	// default shader
+	// per-instance data and the number of balls it can hold
+	gl::VboRef mInstanceVbo;
+	size_t     mInstanceCapacity;
+
+	// instancing shader
 	gl::GlslProgRef mShader;
 };
 
 void BouncingBallsApp::setup()
 {
 	// randomize the random generator
-	Rand::randSeed( clock() );
+	mSimulation.seed( uint32_t( clock() ) );
 
 	//
 	mUseMotionBlur = true;
 	mIsPaused = false;
+	mInstanceCapacity = 0;
+
+	mSimulation.setSize( vec2( getWindowSize() ) );
+
+	mIsSimulating = false;
+	mHasSnapshot = false;
+	mSnapshotDrawn = false;
 
 	// allow maximum frame rate
 	disableFrameRate();
 	gl::enableVerticalSync( false );
 
 	// create a few balls
-	for( size_t i = 0; i < 25; ++i )
-		mBalls.push_back( BallRef( new Ball() ) );
+	mSimulation.addBalls( 25 );
 
-	// create a default shader with color and texture support
-	mShader = gl::context()->getStockShader( gl::ShaderDef().color().texture() );
+	// load the instancing shader, which draws the motion blur trails of all balls in one go
+	try {
+		mShader = gl::GlslProg::create( loadAsset( "ball.vert" ), loadAsset( "ball.frag" ) );
+	}
+	catch( const std::exception &e ) {
+		console() << e.what() << std::endl;
+		quit();
+		return;
+	}
 
 	// create ball mesh ( much faster than using gl::drawSolidCircle() )
 	size_t slices = 20;
@@ -339,17 +159,22 @@ void BouncingBallsApp::setup()
 	mMesh->bufferAttrib( geom::POSITION, positions.size() * sizeof( vec3 ), positions.data() );
 	mMesh->bufferAttrib( geom::TEX_COORD_0, texcoords.size() * sizeof( vec2 ), texcoords.data() );
 
-	// combine mesh and shader into batch for much better performance
-	mBatch = gl::Batch::create( mMesh, mShader );
+	// combine mesh, instance data and shader into batch for much better performance
+	createBatch( 1024 );
 
 	// load texture
 	mTexture = gl::Texture::create( loadImage( loadAsset( "ball.png" ) ) );
 }
 
+void BouncingBallsApp::cleanup()
+{
+	stopSimulation();
+}
+
 void BouncingBallsApp::update()
 {
-	// Use a fixed time step for a steady 60 updates per second.
-	static const double timestep = 1.0 / 60.0;
+	// Use a fixed time step for a steady number of updates per second.
+	const double timestep = 1.0 / mSimulation.getStepsPerSecond();
 
 	// Keep track of time.
 	static double time = getElapsedSeconds();
@@ -359,19 +184,17 @@ void BouncingBallsApp::update()
 	double elapsed = getElapsedSeconds() - time;
 	time += elapsed;
 
+	// The simulation thread keeps its own time.
+	if( mIsSimulating )
+		return;
+
 	// Update the simulation.
 	accumulator += math<double>::min( elapsed, 0.1 ); // prevents 'spiral of death'
 	while( accumulator >= timestep ) {
 		accumulator -= timestep;
 
-		if( !mIsPaused ) {
-			// Move the balls.
-			for( auto &ball : mBalls )
-				ball->update();
-
-			// Perform collision detection and response.
-			performCollisions();
-		}
+		if( !mIsPaused )
+			mSimulation.step();
 	}
 }
 
@@ -379,15 +202,56 @@ void BouncingBallsApp::draw()
 {
 	gl::clear();
 
+	if( !mBatch )
+		return;
+
+	// grab the latest snapshot from the simulation thread
+	if( mIsSimulating ) {
+		std::lock_guard<std::mutex> lock( mSnapshotMutex );
+		if( mHasSnapshot ) {
+			std::swap( mPendingBuffer, mFrontBuffer );
+			mHasSnapshot = false;
+			mSnapshotDrawn = true;
+		}
+	}
+
+	size_t count = mIsSimulating ? mFrontBuffer.size() : mSimulation.getBalls().size();
+	if( count == 0 )
+		return;
+
+	// make sure our instance buffer is large enough
+	if( count > mInstanceCapacity )
+		createBatch( 2 * count );
+
+	// write the instance data of all balls
+	BallInstance *ptr = static_cast<BallInstance *>( mInstanceVbo->mapReplace() );
+	if( mIsSimulating ) {
+		std::memcpy( ptr, mFrontBuffer.data(), count * sizeof( BallInstance ) );
+	}
+	else {
+		for( auto &ball : mSimulation.getBalls() ) {
+			ball->draw( ptr++, mUseMotionBlur );
+			ball->mHasBeenDrawn = true;
+		}
+	}
+	mInstanceVbo->unmap();
+
 	gl::ScopedBlendAdditive blend;
 
 	gl::ScopedGlslProg shader( mShader );
 	mShader->uniform( "uTex0", 0 );
+	mShader->uniform( "uMaxTrailSize", Ball::kMaxTrailSize );
 
 	gl::ScopedTextureBind tex0( mTexture );
 
-	for( auto &ball : mBalls )
-		ball->draw( mBatch, mUseMotionBlur );
+	// each ball is drawn as kMaxTrailSize instances, unused samples are discarded by the vertex shader
+	mBatch->drawInstanced( GLsizei( count * Ball::kMaxTrailSize ) );
+}
+
+void BouncingBallsApp::resize()
+{
+	std::lock_guard<std::mutex> lock( mSimulationMutex );
+	mSimulation.setSize( vec2( getWindowSize() ) );
 }
 
 void BouncingBallsApp::keyDown( KeyEvent event )
@@ -397,39 +261,64 @@ void BouncingBallsApp::keyDown( KeyEvent event )
 		// quit the application
 		quit();
 		break;
-	case KeyEvent::KEY_SPACE:
+	case KeyEvent::KEY_SPACE: {
 		// reset all balls
-		for( auto &ball : mBalls )
-			ball->reset();
-		break;
-	case KeyEvent::KEY_RETURN:
+		std::lock_guard<std::mutex> lock( mSimulationMutex );
+		mSimulation.resetBalls();
+	} break;
+	case KeyEvent::KEY_RETURN: {
 		// pause/resume simulation
+		std::lock_guard<std::mutex> lock( mSimulationMutex );
 		mIsPaused = !mIsPaused;
-		break;
+	} break;
 	case KeyEvent::KEY_EQUALS: // For Macs without a keypad or a plus key
 		if( !event.isShiftDown() ) {
 			break;
 		}
 	case KeyEvent::KEY_PLUS:
-	case KeyEvent::KEY_KP_PLUS:
-		// create a new ball
-		mBalls.push_back( BallRef( new Ball() ) );
-		break;
+	case KeyEvent::KEY_KP_PLUS: {
+		// create a new ball, or a thousand if CONTROL is down
+		std::lock_guard<std::mutex> lock( mSimulationMutex );
+		mSimulation.addBalls( event.isControlDown() ? 1000 : 1 );
+	} break;
 	case KeyEvent::KEY_MINUS:
-	case KeyEvent::KEY_KP_MINUS:
-		// remove the oldest ball
-		if( !mBalls.empty() )
-			mBalls.erase( mBalls.begin() );
-		break;
+	case KeyEvent::KEY_KP_MINUS: {
+		// remove the oldest ball, or a thousand if CONTROL is down
+		std::lock_guard<std::mutex> lock( mSimulationMutex );
+		mSimulation.removeBalls( event.isControlDown() ? 1000 : 1 );
+	} break;
 	case KeyEvent::KEY_f:
 		setFullScreen( !isFullScreen() );
 		break;
 	case KeyEvent::KEY_v:
 		gl::enableVerticalSync( !gl::isVerticalSyncEnabled() );
 		break;
-	case KeyEvent::KEY_m:
+	case KeyEvent::KEY_m: {
+		std::lock_guard<std::mutex> lock( mSimulationMutex );
 		mUseMotionBlur = !mUseMotionBlur;
+	} break;
+	case KeyEvent::KEY_LEFTBRACKET: {
+		// use larger time steps
+		std::lock_guard<std::mutex> lock( mSimulationMutex );
+		mSimulation.setStepsPerSecond( math<int>::max( mSimulation.getStepsPerSecond() / 2, 15 ) );
+	} break;
+	case KeyEvent::KEY_RIGHTBRACKET: {
+		// use smaller time steps
+		std::lock_guard<std::mutex> lock( mSimulationMutex );
+		mSimulation.setStepsPerSecond( math<int>::min( mSimulation.getStepsPerSecond() * 2, 240 ) );
+	} break;
+	case KeyEvent::KEY_t:
+		// run the simulation on a separate thread, or on the main thread
+		if( mIsSimulating )
+			stopSimulation();
+		else
+			startSimulation();
 		break;
+	case KeyEvent::KEY_w: {
+		// use all cores or a single core, results will be identical
+		std::lock_guard<std::mutex> lock( mSimulationMutex );
+		mSimulation.setNumThreads( mSimulation.getNumThreads() > 1 ? 1 : std::thread::hardware_concurrency() );
+	} break;
 	case KeyEvent::KEY_1:
 		setFrameRate( 10.0f );
 		break;
@@ -445,20 +334,84 @@ void BouncingBallsApp::keyDown( KeyEvent event )
 	}
 }
 
-void BouncingBallsApp::performCollisions()
+void BouncingBallsApp::createBatch( size_t capacity )
+{
+	mInstanceCapacity = capacity;
+	mInstanceVbo = gl::Vbo::create( GL_ARRAY_BUFFER, mInstanceCapacity * sizeof( BallInstance ), nullptr, GL_DYNAMIC_DRAW );
+
+	// every record is used for kMaxTrailSize consecutive instances
+	geom::BufferLayout instanceDataLayout;
+	instanceDataLayout.append( geom::Attrib::CUSTOM_0, 4, sizeof( BallInstance ), offsetof( BallInstance, mPositions ), Ball::kMaxTrailSize );
+	instanceDataLayout.append( geom::Attrib::CUSTOM_1, 4, sizeof( BallInstance ), offsetof( BallInstance, mColor ), Ball::kMaxTrailSize );
+
+	// create a new mesh that shares the ball's vertex data, so we can safely replace the instance buffer
+	auto mesh = gl::VboMesh::create( mMesh->getNumVertices(), mMesh->getGlPrimitive(), mMesh->getVertexArrayLayoutVbos() );
+	mesh->appendVbo( instanceDataLayout, mInstanceVbo );
+
+	mBatch = gl::Batch::create( mesh, mShader, { { geom::Attrib::CUSTOM_0, "iPositions" }, { geom::Attrib::CUSTOM_1, "iColor" } } );
+}
+
+void BouncingBallsApp::startSimulation()
 {
-	// determine which balls are colliding,
-	// by checking every pair of balls only once
-	std::vector<BallRef>::iterator itr1, itr2;
-	for( itr1 = mBalls.begin(); itr1 < mBalls.end() - 1; ++itr1 ) {
-		for( itr2 = itr1 + 1; itr2 < mBalls.end(); ++itr2 ) {
-			// do quick check
-			if( ( *itr1 )->isCollidingWith( *itr2 ) ) {
-				// do collision
-				( *itr1 )->collideWith( *itr2 );
+	if( mIsSimulating )
+		return;
+
+	mIsSimulating = true;
+	mSimulationThread = std::thread( &BouncingBallsApp::simulate, this );
+}
+
+void BouncingBallsApp::stopSimulation()
+{
+	if( !mIsSimulating )
+		return;
+
+	mIsSimulating = false;
+	mSimulationThread.join();
+}
+
+void BouncingBallsApp::simulate()
+{
+	// Use a fixed time step for a steady number of updates per second.
+	typedef std::chrono::steady_clock clock;
+	clock::duration                   timestep;
+
+	clock::time_point time = clock::now();
+
+	while( mIsSimulating ) {
+		{
+			std::lock_guard<std::mutex> lock( mSimulationMutex );
+			timestep = std::chrono::microseconds( 1000000 / mSimulation.getStepsPerSecond() );
+
+			// If the previous snapshot has been drawn, start new motion blur trails.
+			if( mSnapshotDrawn.exchange( false ) ) {
+				for( auto &ball : mSimulation.getBalls() )
+					ball->mHasBeenDrawn = true;
+			}
+
+			if( !mIsPaused )
+				mSimulation.step();
+
+			// Write a snapshot of the simulation and hand it over to the main thread.
+			const auto &balls = mSimulation.getBalls();
+			mBackBuffer.resize( balls.size() );
+			for( size_t i = 0; i < balls.size(); ++i )
+				balls[i]->draw( &mBackBuffer[i], mUseMotionBlur );
+
+			{
+				std::lock_guard<std::mutex> lock( mSnapshotMutex );
+				std::swap( mBackBuffer, mPendingBuffer );
+				mHasSnapshot = true;
 			}
 		}
+
+		// Wait for the next step. If we can't keep up, skip ahead to prevent the 'spiral of death'.
+		time += timestep;
+		clock::time_point now = clock::now();
+		if( now - time > std::chrono::milliseconds( 100 ) )
+			time = now;
+
+		std::this_thread::sleep_until( time );
 	}
 }
 
-CINDER_APP( BouncingBallsApp, RendererGl )
\ No newline at end of file
+CINDER_APP( BouncingBallsApp, RendererGl )
@@ -0,0 +1,469 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Simulation.h"
+
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+using namespace ci;
+
+Simulation::Simulation()
+    : mSize( 640, 480 )
+    , mStepsPerSecond( 60 )
+    , mWorkerPool( new WorkerPool() )
+    , mNumPairs( 0 )
+    , mNumFirstContacts( 0 )
+{
+}
+
+void Simulation::setNumThreads( size_t numThreads )
+{
+	mWorkerPool.reset( new WorkerPool( numThreads ) );
+}
+
+void Simulation::addBalls( size_t count )
+{
+	for( size_t i = 0; i < count; ++i )
+		mBalls.push_back( BallRef( new Ball( mSize, mRand ) ) );
+}
+
+void Simulation::removeBalls( size_t count )
+{
+	// remove the oldest balls
+	count = math<size_t>::min( count, mBalls.size() );
+	mBalls.erase( mBalls.begin(), mBalls.begin() + count );
+}
+
+void Simulation::resetBalls()
+{
+	for( auto &ball : mBalls )
+		ball->reset( mSize, mRand );
+}
+
+size_t Simulation::getNumCollisions() const
+{
+	// each collision involves two balls
+	return std::accumulate( mCollisionCount.begin(), mCollisionCount.end(), size_t( 0 ) ) / 2;
+}
+
+void Simulation::step()
+{
+	// A time step of 1 equals 1/60th of a second.
+	const float timestep = 60.0f / mStepsPerSecond;
+
+	const size_t count = mBalls.size();
+	const size_t numTasks = ( count + kBallsPerTask - 1 ) / kBallsPerTask;
+
+	// Accelerate the balls. Each ball is independent, so we can simply divide them over the threads.
+	mWorkerPool->run( numTasks, [&]( size_t task ) {
+		const size_t end = math<size_t>::min( count, ( task + 1 ) * kBallsPerTask );
+		for( size_t i = task * kBallsPerTask; i < end; ++i )
+			mBalls[i]->update( mSize, timestep );
+	} );
+
+	// Perform collision detection and response.
+	mNumPairs = 0;
+	mCollisionCount.assign( count, 0 );
+	performCollisions( timestep );
+
+	// Move the balls to the end of the time step.
+	mWorkerPool->run( numTasks, [&]( size_t task ) {
+		const size_t end = math<size_t>::min( count, ( task + 1 ) * kBallsPerTask );
+		for( size_t i = task * kBallsPerTask; i < end; ++i )
+			mBalls[i]->finish( mSize, timestep );
+	} );
+
+	// Push apart balls that rest on each other or still overlap for another reason.
+	separateBalls( timestep );
+}
+
+void Simulation::performCollisions( float timestep )
+{
+	const size_t count = mBalls.size();
+	const size_t numTasks = ( count + kBallsPerTask - 1 ) / kBallsPerTask;
+
+	mContacts.clear();
+	mNumFirstContacts = 0;
+	if( count < 2 )
+		return;
+
+	// During the first pass, we search all balls for collisions. A ball that changed direction
+	// may hit balls it could not reach on its original path, so the next pass searches again
+	// for those balls only. If collisions are left after the last pass, the balls will overlap
+	// and are pushed apart by separateBalls().
+	mActive.resize( count );
+	std::iota( mActive.begin(), mActive.end(), 0 );
+	mIsActive.assign( count, 1 );
+
+	for( int pass = 0; pass < kMaxPasses && !mActive.empty(); ++pass ) {
+		// 1) determine the area each ball will cover during the remainder of this step
+		mBounds.resize( count );
+		mWorkerPool->run( numTasks, [&]( size_t task ) {
+			const size_t end = math<size_t>::min( count, ( task + 1 ) * kBallsPerTask );
+			for( size_t i = task * kBallsPerTask; i < end; ++i ) {
+				const vec2 &from = mBalls[i]->mPosition;
+				const vec2  to = from + ( timestep - mBalls[i]->mTime ) * mBalls[i]->mVelocity;
+				mBounds[i] = Rectf( from, to ).inflated( vec2( float( Ball::kRadius ) ) );
+			}
+		} );
+
+		// 2) find the pairs of balls that will collide during this step
+		findPairs( timestep, pass == 0 );
+
+		// 3) group the balls into islands that can't affect each other during this pass,
+		//    using a union-find. Islands can be resolved in parallel. Because the islands
+		//    do not depend on the number of threads, the results are always identical.
+		//    Balls that merely touch are not on a collision course, so a pile of balls
+		//    resting on each other does not turn into a single island.
+		mIslandRoot.resize( count );
+		for( size_t i = 0; i < count; ++i )
+			mIslandRoot[i] = uint32_t( i );
+
+		auto findRoot = [&]( uint32_t i ) {
+			while( mIslandRoot[i] != i )
+				i = mIslandRoot[i] = mIslandRoot[mIslandRoot[i]];
+			return i;
+		};
+
+		mNeighborStart.assign( count + 1, 0 );
+		for( const auto &pairs : mTaskPairs ) {
+			for( const auto &pair : pairs ) {
+				const uint32_t a = findRoot( pair.first );
+				const uint32_t b = findRoot( pair.second );
+				mIslandRoot[math<uint32_t>::max( a, b )] = math<uint32_t>::min( a, b );
+
+				mNeighborStart[pair.first + 1]++;
+				mNeighborStart[pair.second + 1]++;
+			}
+		}
+
+		for( size_t i = 1; i <= count; ++i )
+			mNeighborStart[i] += mNeighborStart[i - 1];
+
+		if( mNeighborStart.back() == 0 )
+			break;
+
+		mOffsets.assign( mNeighborStart.begin(), mNeighborStart.end() - 1 );
+		mNeighbors.resize( mNeighborStart.back() );
+
+		// number the islands in order of appearance and count their pairs
+		static const uint32_t kNone = ~0u;
+		mIslandIndex.assign( count, kNone );
+		mIslandStart.assign( 1, 0 );
+		for( const auto &pairs : mTaskPairs ) {
+			for( const auto &pair : pairs ) {
+				mNeighbors[mOffsets[pair.first]++] = pair.second;
+				mNeighbors[mOffsets[pair.second]++] = pair.first;
+
+				const uint32_t root = findRoot( pair.first );
+				if( mIslandIndex[root] == kNone ) {
+					mIslandIndex[root] = uint32_t( mIslandStart.size() - 1 );
+					mIslandStart.push_back( 0 );
+				}
+				mIslandStart[mIslandIndex[root] + 1]++;
+			}
+		}
+
+		for( size_t i = 1; i < mIslandStart.size(); ++i )
+			mIslandStart[i] += mIslandStart[i - 1];
+
+		mOffsets.assign( mIslandStart.begin(), mIslandStart.end() - 1 );
+		mIslandPairs.resize( mIslandStart.back() );
+		for( const auto &pairs : mTaskPairs )
+			for( const auto &pair : pairs )
+				mIslandPairs[mOffsets[mIslandIndex[findRoot( pair.first )]]++] = pair;
+
+		mNumPairs += mIslandPairs.size();
+
+		// 4) perform collision response, marking the balls that changed direction
+		mIsActive.assign( count, 0 );
+		mWorkerPool->run( mIslandStart.size() - 1, [&]( size_t island ) { resolveCollisions( island, timestep ); } );
+
+		mActive.clear();
+		for( size_t i = 0; i < count; ++i )
+			if( mIsActive[i] )
+				mActive.push_back( uint32_t( i ) );
+	}
+
+	// a pair may have been found during multiple later passes
+	std::sort( mContacts.begin() + mNumFirstContacts, mContacts.end() );
+	mContacts.erase( std::unique( mContacts.begin() + mNumFirstContacts, mContacts.end() ), mContacts.end() );
+}
+
+void Simulation::findPairs( float timestep, bool isFirstPass )
+{
+	const size_t count = mBalls.size();
+
+	// 1) sort the balls into a grid of cells, each as large as a ball. Balls travel further during larger
+	//    time steps, so we use larger cells for those. Most balls are added to a single cell, the one containing
+	//    the top left corner of their bounds, so we need to search the cells to the left and top of a ball as far
+	//    as the largest of those bounds extends. Fast balls would extend the search for all balls, so we add them
+	//    to every cell their bounds overlap instead. Balls outside the window are clamped to the border cells,
+	//    which is fine because we still check the bounds.
+	const float cellSize = 2.0f * Ball::kRadius * math<float>::max( 1.0f, 0.5f * timestep );
+	const float maxExtent = 2.0f * cellSize;
+
+	const int columns = math<int>::max( 1, int( math<float>::ceil( mSize.x / cellSize ) ) );
+	const int rows = math<int>::max( 1, int( math<float>::ceil( mSize.y / cellSize ) ) );
+
+	auto column = [&]( float x ) { return math<int>::clamp( int( math<float>::floor( x / cellSize ) ), 0, columns - 1 ); };
+	auto row = [&]( float y ) { return math<int>::clamp( int( math<float>::floor( y / cellSize ) ), 0, rows - 1 ); };
+
+	float extent = 0.0f;
+	mCells.resize( count );
+	mCellStart.assign( columns * rows + 1, 0 );
+	for( size_t i = 0; i < count; ++i ) {
+		const Rectf &bounds = mBounds[i];
+		if( bounds.getWidth() <= maxExtent && bounds.getHeight() <= maxExtent ) {
+			extent = math<float>::max( extent, math<float>::max( bounds.getWidth(), bounds.getHeight() ) );
+			mCells[i] = Area( column( bounds.x1 ), row( bounds.y1 ), column( bounds.x1 ), row( bounds.y1 ) );
+		}
+		else {
+			mCells[i] = Area( column( bounds.x1 ), row( bounds.y1 ), column( bounds.x2 ), row( bounds.y2 ) );
+		}
+
+		const Area &area = mCells[i];
+		for( int y = area.y1; y <= area.y2; ++y )
+			for( int x = area.x1; x <= area.x2; ++x )
+				mCellStart[y * columns + x + 1]++;
+	}
+
+	for( size_t i = 1; i < mCellStart.size(); ++i )
+		mCellStart[i] += mCellStart[i - 1];
+
+	// counting sort keeps the balls within each cell in ascending order. We store a copy
+	// of the bounds, so most balls can be rejected without looking any further.
+	mOffsets.assign( mCellStart.begin(), mCellStart.end() - 1 );
+	mCellBalls.resize( mCellStart.back() );
+	for( size_t i = 0; i < count; ++i ) {
+		const Area &area = mCells[i];
+		for( int y = area.y1; y <= area.y2; ++y ) {
+			for( int x = area.x1; x <= area.x2; ++x ) {
+				CellBall &entry = mCellBalls[mOffsets[y * columns + x]++];
+				entry.bounds = mBounds[i];
+				entry.ball = uint32_t( i );
+				entry.column = x;
+			}
+		}
+	}
+
+	// 2) find the pairs of balls in parallel, searching the active balls only. We check every pair
+	//    of balls only once and store them in the same order, regardless of the number of threads.
+	const size_t numActive = mActive.size();
+	const size_t numTasks = ( numActive + kBallsPerTask - 1 ) / kBallsPerTask;
+	mTaskPairs.resize( numTasks );
+	mTaskContacts.resize( numTasks );
+
+	mWorkerPool->run( numTasks, [&]( size_t task ) {
+		auto &pairs = mTaskPairs[task];
+		auto &contacts = mTaskContacts[task];
+		pairs.clear();
+		contacts.clear();
+
+		const CellBall *cellBalls = mCellBalls.data();
+
+		const size_t end = math<size_t>::min( numActive, ( task + 1 ) * kBallsPerTask );
+		for( size_t n = task * kBallsPerTask; n < end; ++n ) {
+			const uint32_t i = mActive[n];
+			const Rectf    bounds = mBounds[i];
+			const Area     area( column( bounds.x1 - extent ), row( bounds.y1 - extent ), column( bounds.x2 ), row( bounds.y2 ) );
+
+			// the cells of a single row are stored one after the other
+			for( int y = area.y1; y <= area.y2; ++y ) {
+				const uint32_t last = mCellStart[y * columns + area.x2 + 1];
+				for( uint32_t k = mCellStart[y * columns + area.x1]; k < last; ++k ) {
+					const CellBall &entry = cellBalls[k];
+					if( !bounds.intersects( entry.bounds ) )
+						continue;
+
+					// if both balls are active, the pair is found by the first one
+					const uint32_t j = entry.ball;
+					if( j == i || ( j < i && mIsActive[j] ) )
+						continue;
+
+					// fast balls are found in multiple cells, only check them in the first one
+					const Area &other = mCells[j];
+					if( entry.column != math<int>::max( area.x1, other.x1 ) || y != math<int>::max( area.y1, other.y1 ) )
+						continue;
+
+					// during later passes, we may find pairs that touch once more
+					const uint32_t a = math<uint32_t>::min( i, j );
+					const uint32_t b = math<uint32_t>::max( i, j );
+					if( isFirstPass || !mFirstBounds[a].intersects( mFirstBounds[b] ) )
+						contacts.push_back( std::make_pair( a, b ) );
+
+					if( mBalls[a]->timeOfImpact( mBalls[b], timestep ) >= 0.0f )
+						pairs.push_back( std::make_pair( a, b ) );
+				}
+			}
+		}
+	} );
+
+	// balls that may touch at the end of the step are checked by separateBalls()
+	for( const auto &contacts : mTaskContacts )
+		mContacts.insert( mContacts.end(), contacts.begin(), contacts.end() );
+
+	if( isFirstPass ) {
+		mFirstBounds.swap( mBounds );
+		mNumFirstContacts = mContacts.size();
+	}
+}
+
+void Simulation::resolveCollisions( size_t island, float timestep )
+{
+	const uint32_t first = mIslandStart[island];
+	const uint32_t last = mIslandStart[island + 1];
+
+	// most islands consist of just two balls
+	if( last - first == 1 ) {
+		const auto &pair = mIslandPairs[first];
+		const float t = mBalls[pair.first]->timeOfImpact( mBalls[pair.second], timestep );
+		if( t >= 0.0f ) {
+			mBalls[pair.first]->collideWith( mBalls[pair.second], t );
+			mCollisionCount[pair.first]++;
+			mCollisionCount[pair.second]++;
+			mIsActive[pair.first] = mIsActive[pair.second] = 1;
+		}
+		return;
+	}
+
+	// find the first collision of each pair
+	std::vector<Collision> collisions;
+	for( uint32_t i = first; i < last; ++i ) {
+		const auto &pair = mIslandPairs[i];
+		const float t = mBalls[pair.first]->timeOfImpact( mBalls[pair.second], timestep );
+		if( t >= 0.0f ) {
+			Collision collision = { t, pair.first, pair.second, 0, 0 };
+			collisions.push_back( collision );
+		}
+	}
+
+	// resolve them in time order. Each collision changes the paths of two balls,
+	// so we need to discard their outdated collisions and find new ones. If we run out
+	// of budget, the remaining balls will overlap and are pushed apart by separateBalls().
+	std::make_heap( collisions.begin(), collisions.end(), std::greater<Collision>() );
+
+	size_t budget = kMaxCollisionsPerPair * ( last - first );
+	while( !collisions.empty() && budget > 0 ) {
+		std::pop_heap( collisions.begin(), collisions.end(), std::greater<Collision>() );
+		const Collision collision = collisions.back();
+		collisions.pop_back();
+
+		if( collision.countA != mCollisionCount[collision.a] || collision.countB != mCollisionCount[collision.b] )
+			continue; // outdated
+
+		mBalls[collision.a]->collideWith( mBalls[collision.b], collision.t );
+		mCollisionCount[collision.a]++;
+		mCollisionCount[collision.b]++;
+		mIsActive[collision.a] = mIsActive[collision.b] = 1;
+		budget--;
+
+		const uint32_t balls[] = { collision.a, collision.b };
+		for( uint32_t ball : balls ) {
+			for( uint32_t k = mNeighborStart[ball]; k < mNeighborStart[ball + 1]; ++k ) {
+				const uint32_t a = math<uint32_t>::min( ball, mNeighbors[k] );
+				const uint32_t b = math<uint32_t>::max( ball, mNeighbors[k] );
+				const float    t = mBalls[a]->timeOfImpact( mBalls[b], timestep );
+				if( t >= 0.0f ) {
+					Collision next = { t, a, b, mCollisionCount[a], mCollisionCount[b] };
+					collisions.push_back( next );
+					std::push_heap( collisions.begin(), collisions.end(), std::greater<Collision>() );
+				}
+			}
+		}
+	}
+}
+
+void Simulation::separateBalls( float timestep )
+{
+	static const float kMinimal = 2.0f * Ball::kRadius;
+	static const float kTouching = kMinimal + 1.0f;
+
+	// 1) order the pairs from the bottom of the window up. Pushing a ball apart from one ball may
+	//    push it into another one, so we look at every pair that may touch, not just the overlapping ones.
+	mSupports.resize( mContacts.size() );
+	for( size_t i = 0; i < mContacts.size(); ++i ) {
+		const auto &pair = mContacts[i];
+		const bool  isFirstLower = mBalls[pair.first]->mPosition.y >= mBalls[pair.second]->mPosition.y;
+
+		Support &support = mSupports[i];
+		support.lower = isFirstLower ? pair.first : pair.second;
+		support.upper = isFirstLower ? pair.second : pair.first;
+		support.y = mBalls[support.lower]->mPosition.y;
+	}
+
+	std::sort( mSupports.begin(), mSupports.end() );
+
+	// 2) push the balls apart and make their contact inelastic, so balls resting on each other do not keep
+	//    bouncing. A ball that reaches the floor during this step, or that rests on a supported ball, is
+	//    supported itself: it does not budge, so the ball on top of it is moved instead. Because we start
+	//    at the bottom, a whole pile is supported in a single pass.
+	const size_t count = mBalls.size();
+	mIsSupported.resize( count );
+	for( size_t i = 0; i < count; ++i ) {
+		const Ball &ball = *mBalls[i];
+		mIsSupported[i] = ball.mPosition.y + math<float>::abs( ball.mVelocity.y ) * timestep >= mSize.y - Ball::kRadius;
+	}
+
+	for( const auto &support : mSupports ) {
+		Ball &lower = *mBalls[support.lower];
+		Ball &upper = *mBalls[support.upper];
+
+		const vec2  line = upper.mPosition - lower.mPosition;
+		const float distanceSquared = glm::dot( line, line );
+		if( distanceSquared >= kTouching * kTouching || distanceSquared == 0.0f )
+			continue; // not touching or can't determine direction of separation
+
+		if( distanceSquared >= kMinimal * kMinimal ) {
+			// merely touching
+			if( mIsSupported[support.lower] )
+				mIsSupported[support.upper] = 1;
+			continue;
+		}
+
+		const float distance = math<float>::sqrt( distanceSquared );
+		const vec2  unit = line / distance;
+		const float approach = math<float>::min( 0.0f, glm::dot( upper.mVelocity - lower.mVelocity, unit ) );
+
+		if( mIsSupported[support.lower] ) {
+			upper.mPosition += ( kMinimal - distance ) * unit;
+			upper.mVelocity -= approach * unit;
+			mIsSupported[support.upper] = 1;
+		}
+		else {
+			const vec2 offset = 0.5f * ( kMinimal - distance ) * unit;
+			const vec2 impulse = 0.5f * approach * unit;
+
+			lower.mPosition -= offset;
+			lower.mVelocity += impulse;
+			upper.mPosition += offset;
+			upper.mVelocity -= impulse;
+		}
+
+		lower.keepWithinWindow( mSize );
+		upper.keepWithinWindow( mSize );
+	}
+}
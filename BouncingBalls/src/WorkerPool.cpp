@@ -0,0 +1,115 @@
+/*
+ Copyright (c) 2015, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool( size_t numThreads )
+    : mTask( nullptr )
+    , mNumTasks( 0 )
+    , mNextTask( 0 )
+    , mNumBusy( 0 )
+    , mGeneration( 0 )
+    , mIsRunning( true )
+{
+	// The calling thread also executes tasks, so we need one thread less.
+	numThreads = std::max<size_t>( numThreads, 1 );
+	for( size_t i = 1; i < numThreads; ++i )
+		mThreads.emplace_back( &WorkerPool::work, this );
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mIsRunning = false;
+	}
+	mWorkAvailable.notify_all();
+
+	for( auto &thread : mThreads )
+		thread.join();
+}
+
+void WorkerPool::run( size_t numTasks, const std::function<void( size_t )> &task )
+{
+	if( numTasks == 0 )
+		return;
+
+	// Don't bother waking up the workers if there is only one task.
+	if( mThreads.empty() || numTasks == 1 ) {
+		for( size_t i = 0; i < numTasks; ++i )
+			task( i );
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mTask = &task;
+		mNumTasks = numTasks;
+		mNextTask = 0;
+		mNumBusy = mThreads.size();
+		mGeneration++;
+	}
+	mWorkAvailable.notify_all();
+
+	// Help out while we wait.
+	execute();
+
+	// Wait until all workers are done, so the task can safely go out of scope.
+	std::unique_lock<std::mutex> lock( mMutex );
+	mWorkDone.wait( lock, [&] { return mNumBusy == 0; } );
+	mTask = nullptr;
+}
+
+void WorkerPool::work()
+{
+	size_t generation = 0;
+
+	while( true ) {
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			mWorkAvailable.wait( lock, [&] { return !mIsRunning || mGeneration != generation; } );
+
+			if( !mIsRunning )
+				return;
+
+			generation = mGeneration;
+		}
+
+		execute();
+
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			if( --mNumBusy == 0 )
+				mWorkDone.notify_one();
+		}
+	}
+}
+
+void WorkerPool::execute()
+{
+	// Grab tasks until there are none left.
+	size_t index;
+	while( ( index = mNextTask++ ) < mNumTasks )
+		( *mTask )( index );
+}
@@ -11,9 +11,11 @@
 uniform sampler2D uBlurSource;
 uniform sampler2D uNearSource;
 
-uniform int       uMaxCoCRadiusPixels;
-uniform int       uNearBlurRadiusPixels;
-uniform float     uInvNearBlurRadiusPixels;
+#include "frame.glsl"
+
+// The near field is blurred by the maximum radius.
+#define uNearBlurRadiusPixels    uMaxCoCRadiusPixels
+#define uInvNearBlurRadiusPixels uInvMaxCoCRadiusPixels
 
 layout(location = 0) out vec4 nearResult;
 layout(location = 1) out vec4 blurResult;
@@ -2,14 +2,16 @@
 
 #define saturate(s) clamp( s, 0.0, 1.0 )
 
+#include "frame.glsl"
+
 uniform sampler2D uInputSource;
-uniform vec2      uInputSourceInvSize;
 uniform sampler2D uBlurSource;
 uniform sampler2D uNearSource;
 uniform vec2      uOffset;
-uniform float     uFarRadiusRescale = 1.0;
 uniform int		  uDebugOption = 0;
 
+flat in int vertTileClass;
+
 out vec3 result;
 
 const vec2 kCocReadScaleBias = vec2(2.0, -1.0);
@@ -66,6 +68,7 @@ void main( void )
     const int SHOW_INPUT        = 5;
     const int SHOW_MID_AND_FAR  = 6;
     const int SHOW_SIGNED_COC   = 7;
+    const int SHOW_TILES        = 8;
 
     switch (uDebugOption) {
     case SHOW_COC:
@@ -110,6 +113,15 @@ void main( void )
         result = sharp;
         break;
 
+    case SHOW_TILES:
+        // Near field tiles: yellow, far field tiles: blue, sharp tiles: unchanged
+        if ( vertTileClass == 1 ) {
+            result.rgb = mix( result.rgb, vec3( 1.0, 1.0, 0.15 ), 0.3 );
+        } else if ( vertTileClass == 2 ) {
+            result.rgb = mix( result.rgb, vec3( 0.0, 0.14, 0.8 ), 0.3 );
+        }
+        break;
+
     case SHOW_MID_AND_FAR:
         // Just mix based on this pixel's blurriness. Works well in the background, less well in the foreground
         result = mix( sharp, blurred, abs( normRadius ) );
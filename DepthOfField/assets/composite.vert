@@ -1,10 +0,0 @@
-#version 150
-
-uniform mat4 ciModelViewProjection;
-
-in vec4 ciPosition;
-
-void main(void)
-{
-	gl_Position = ciModelViewProjection * ciPosition;
-}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 150
+
+// Copies the sharp input of tiles that are in focus.
+
+uniform sampler2D uInputSource;
+uniform vec2      uOffset;
+
+out vec3 result;
+
+void main( void )
+{
+    result = texelFetch( uInputSource, ivec2( gl_FragCoord.xy - uOffset ), 0 ).rgb;
+}
\ No newline at end of file
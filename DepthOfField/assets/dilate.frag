@@ -0,0 +1,30 @@
+#version 150
+
+// Spreads the circle of confusion of each tile to its neighbors, because blurry pixels affect their
+// surroundings. The blue channel is spread twice as far, to find the tiles the blur passes read from.
+
+uniform sampler2D uTileSource;
+uniform int       uRadius; // In tiles.
+
+out vec3 result;
+
+void main( void )
+{
+    ivec2 tile = ivec2( gl_FragCoord.xy );
+    ivec2 last = textureSize( uTileSource, 0 ) - ivec2( 1 );
+
+    vec2  inner = vec2( 0.0 );
+    float outer = 0.0;
+
+    for( int y = -2 * uRadius; y <= 2 * uRadius; ++y ) {
+        for( int x = -2 * uRadius; x <= 2 * uRadius; ++x ) {
+            vec2 coc = texelFetch( uTileSource, clamp( tile + ivec2( x, y ), ivec2( 0 ), last ), 0 ).rg;
+            outer = max( outer, max( coc.r, coc.g ) );
+
+            if( abs( x ) <= uRadius && abs( y ) <= uRadius )
+                inner = max( inner, coc );
+        }
+    }
+
+    result = vec3( inner, outer );
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+// Per-frame camera and lens parameters, shared by all passes. Updated once per frame by the application.
+// The layout must match the FrameData struct in DepthOfFieldApp.cpp.
+layout(std140) uniform Frame {
+    mat4  uViewMatrix;
+    mat4  uProjectionMatrix;
+    vec2  uInputSourceInvSize;    // 1 / size of the full resolution scene.
+    ivec2 uTileCount;             // Number of tiles horizontally and vertically.
+    vec2  uTileScale;             // Size of a tile relative to the screen.
+    float uAperture;
+    float uFocalDistance;
+    float uFocalLength;
+    float uTime;                  // Animation time in seconds.
+    float uFarRadiusRescale;      // Should usually be set to 1.
+    float uThreshold;             // Normalized CoC below which a tile is considered sharp.
+    int   uMaxCoCRadiusPixels;    // Maximum blur in pixels.
+    float uInvMaxCoCRadiusPixels;
+};
\ No newline at end of file
@@ -1,26 +1,52 @@
 #version 150
 
-uniform mat4 ciViewMatrix;
-uniform mat4 ciProjectionMatrix;
+#include "frame.glsl"
 
 in vec4 ciPosition;
 in vec3 ciNormal;
 in vec4 ciColor;
 
-in mat4 vInstanceMatrix; // per instance
+uniform samplerBuffer  uInstances; // per instance, 2 texels: xyz = center of rotation, w = initial angle in degrees; xyz = axis of rotation, w = angular speed in degrees per second
+uniform usamplerBuffer uVisible; // indices of the visible instances
 
 out vec4 vertPosition; // in view space
 out vec3 vertNormal; // in view space
 out vec4 vertColor;
 
+// Same as glm::rotate().
+mat3 rotationMatrix( float angle, vec3 axis )
+{
+    axis = normalize( axis );
+
+    float c = cos( angle );
+    float s = sin( angle );
+    vec3  t = ( 1.0 - c ) * axis;
+
+    return mat3( c + t.x * axis.x, t.x * axis.y + s * axis.z, t.x * axis.z - s * axis.y,
+                 t.y * axis.x - s * axis.z, c + t.y * axis.y, t.y * axis.z + s * axis.x,
+                 t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x, c + t.z * axis.z );
+}
+
 void main()
 {
-    vertPosition = ciViewMatrix * vInstanceMatrix * ciPosition;
+    // Fetch the animation parameters of this instance.
+    int  index = int( texelFetch( uVisible, gl_InstanceID ).r );
+    vec4 vInstancePosition = texelFetch( uInstances, 2 * index );
+    vec4 vInstanceAxis = texelFetch( uInstances, 2 * index + 1 );
+
+    // Calculate the model matrix from the animation parameters.
+    float angle = radians( mod( vInstancePosition.w + vInstanceAxis.w * uTime, 360.0 ) );
+    mat3  rotation = rotationMatrix( angle, vInstanceAxis.xyz );
+
+    mat4 instanceMatrix = mat4( rotation );
+    instanceMatrix[3] = vec4( vInstancePosition.xyz, 1.0 );
+
+    vertPosition = uViewMatrix * instanceMatrix * ciPosition;
 
-    mat3 normalMatrix = mat3( ciViewMatrix * vInstanceMatrix ); // assumes homogenous scaling.
+    mat3 normalMatrix = mat3( uViewMatrix ) * rotation; // rotation only, no scaling.
     vertNormal = normalize( normalMatrix * ciNormal );
 
     vertColor = ciColor;
 
-    gl_Position = ciProjectionMatrix * vertPosition;
+    gl_Position = uProjectionMatrix * vertPosition;
 }
\ No newline at end of file
@@ -2,10 +2,7 @@
 
 uniform sampler2D uTex;
 
-uniform int   uMaxCoCRadiusPixels = 5;
-uniform float uAperture = 1.0;
-uniform float uFocalDistance = 5.0;
-uniform float uFocalLength = 1.0;
+#include "frame.glsl"
 
 in vec4 vertPosition; // in view space
 in vec3 vertNormal; // in view space
@@ -0,0 +1,28 @@
+#version 150
+
+// Finds the largest near and far field circle of confusion in each 16x16 pixel tile.
+
+#include "frame.glsl"
+
+const int kTileSize = 16;
+
+uniform sampler2D uInputSource;
+
+out vec2 result;
+
+void main( void )
+{
+    ivec2 origin = ivec2( gl_FragCoord.xy ) * kTileSize;
+    ivec2 last = textureSize( uInputSource, 0 ) - ivec2( 1 );
+
+    vec2 coc = vec2( 0.0 );
+    for( int y = 0; y < kTileSize; ++y ) {
+        for( int x = 0; x < kTileSize; ++x ) {
+            // Signed, normalized radius of the circle of confusion. Positive in the near field.
+            float r = texelFetch( uInputSource, min( origin + ivec2( x, y ), last ), 0 ).a * 2.0 - 1.0;
+            coc = max( coc, vec2( r, -r * uFarRadiusRescale ) );
+        }
+    }
+
+    result = coc;
+}
\ No newline at end of file
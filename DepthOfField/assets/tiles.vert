@@ -0,0 +1,46 @@
+#version 150
+
+// Draws a quad for each 16x16 pixel tile of the screen, without any vertex buffers. Tiles that should
+// not be drawn in this pass are collapsed, so they don't generate any fragments.
+
+#include "frame.glsl"
+
+const int TILES_SHARP = 0;       // Only tiles that are in focus.
+const int TILES_BLURRED = 1;     // Only tiles that are out of focus.
+const int TILES_BLUR_SOURCE = 2; // Only tiles that are read by the blur passes.
+const int TILES_ALL = 3;         // All tiles.
+const int TILES_FULL_SCREEN = 4; // A single quad, used to render into the tile buffers themselves.
+
+uniform sampler2D uTileSource;                  // r = max near CoC, g = max far CoC, b = max CoC in the wider neighborhood.
+uniform int       uTileMode = TILES_FULL_SCREEN; // Which tiles to draw.
+
+flat out int vertTileClass; // 0 = sharp, 1 = near field, 2 = far field.
+
+void main()
+{
+    ivec2 tileCount = ( uTileMode == TILES_FULL_SCREEN ) ? ivec2( 1 ) : uTileCount;
+    vec2  tileScale = ( uTileMode == TILES_FULL_SCREEN ) ? vec2( 1.0 ) : uTileScale;
+
+    ivec2 tile = ivec2( gl_InstanceID % tileCount.x, gl_InstanceID / tileCount.x );
+
+    bool visible = true;
+    vertTileClass = 0;
+
+    if( uTileMode != TILES_FULL_SCREEN ) {
+        vec3 coc = texelFetch( uTileSource, tile, 0 ).rgb;
+        vertTileClass = ( coc.r > uThreshold ) ? 1 : ( coc.g > uThreshold ) ? 2 : 0;
+
+        if( uTileMode == TILES_SHARP )
+            visible = ( vertTileClass == 0 );
+        else if( uTileMode == TILES_BLURRED )
+            visible = ( vertTileClass != 0 );
+        else if( uTileMode == TILES_BLUR_SOURCE )
+            visible = ( coc.b > uThreshold );
+    }
+
+    // Triangle strip: (0,0), (1,0), (0,1), (1,1).
+    vec2 corner = vec2( gl_VertexID & 1, gl_VertexID >> 1 );
+    vec2 position = min( ( vec2( tile ) + corner ) * tileScale, vec2( 1.0 ) );
+
+    gl_Position = visible ? vec4( position * 2.0 - 1.0, 0.0, 1.0 ) : vec4( -2.0, -2.0, -2.0, 1.0 );
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "cinder/Matrix.h"
+#include "cinder/Vector.h"
+
+#include <cstdint>
+#include <vector>
+
+//! Culls a set of bounding spheres against a view frustum and writes the indices of the visible spheres, in their
+//! original order, to a compact list. Spheres are stored in groups of four, which are tested using SSE.
+class FrustumCuller {
+  public:
+	FrustumCuller() {}
+
+	//! Sets the \a count spheres to cull. Call again whenever they move.
+	void setSpheres( const ci::vec3 *centers, const float *radii, size_t count );
+
+	//! Writes the index of each sphere that intersects the frustum of \a viewProjection to \a indices,
+	//! which must have room for all spheres, and returns the number of visible spheres.
+	size_t cull( const ci::mat4 &viewProjection, uint32_t *indices ) const;
+
+	//! Returns the number of spheres.
+	size_t getNumSpheres() const { return mNumSpheres; }
+
+  private:
+	size_t mNumSpheres = 0;
+
+	// Spheres, padded to a multiple of four with spheres that are never visible.
+	std::vector<float> mX, mY, mZ, mRadius;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "cinder/Ray.h"
+#include "cinder/Vector.h"
+
+#include <cstdint>
+#include <vector>
+
+//! Bounding volume hierarchy over a set of spheres, used to quickly find the nearest sphere hit by a ray.
+//! The hierarchy is built once in O(n log n). When the spheres move, it can be refitted in O(n), which keeps
+//! the topology and only updates the bounds. Spheres are stored in groups of four, which are tested using SSE.
+class SphereBvh {
+  public:
+	SphereBvh() {}
+
+	//! Builds the hierarchy over \a count spheres.
+	void build( const ci::vec3 *centers, const float *radii, size_t count );
+	//! Updates the bounds of the hierarchy after the spheres have moved. The number of spheres must not change.
+	//! Works best if the spheres have not moved too far from where they were when the hierarchy was built.
+	void refit( const ci::vec3 *centers, const float *radii );
+
+	//! Returns the index of the nearest sphere hit by \a ray and its \a distance along the ray, or -1 if none was hit.
+	int intersect( const ci::Ray &ray, float *distance ) const;
+
+	//! Returns the number of spheres.
+	size_t getNumSpheres() const { return mNumSpheres; }
+	//! Returns the number of nodes in the hierarchy.
+	size_t getNumNodes() const { return mNodes.size(); }
+
+  private:
+	// 32 bytes. Leaf nodes refer to a group of four spheres, the children of other nodes are stored next to each other.
+	struct Node {
+		float    mMin[3];
+		uint32_t mIndex; // Index of first child or group.
+		float    mMax[3];
+		uint32_t mIsLeaf;
+	};
+
+	void buildNode( uint32_t index, size_t first, size_t count, const ci::vec3 *centers );
+
+	size_t                mNumSpheres = 0;
+	std::vector<Node>     mNodes;
+	std::vector<uint32_t> mOrder; // Sphere index of each slot, padded to a multiple of four.
+
+	// Spheres in the order of the leaves, four per group.
+	std::vector<float> mX, mY, mZ, mRadius;
+};
@@ -0,0 +1,158 @@
+// Headless microbenchmark of the bounding volume hierarchy that is used for auto-focus. It does not
+// need a window or a graphics card, so it can be run on any machine. Usage:
+//
+//   DepthOfFieldBenchmark [number of rays]
+//
+// For 1k, 100k and 1M spheres, spread out like the teapots in the sample, measures the time it takes to build
+// and refit the hierarchy and the number of rays per second, compared to testing every sphere. Verifies that
+// the hierarchy finds the same nearest hit as testing every sphere. Returns a non-zero exit code on failure.
+
+#include "SphereBvh.h"
+
+#include "cinder/Rand.h"
+
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace ci;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double getSeconds( Clock::time_point start )
+{
+	return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+// Returns the index of the nearest sphere hit by the ray, by testing all of them.
+int intersectLinear( const Ray &ray, const std::vector<vec3> &centers, const std::vector<float> &radii, float *distance )
+{
+	const vec3  origin = ray.getOrigin();
+	const vec3  direction = ray.getDirection();
+	const float a = glm::dot( direction, direction );
+
+	float best = FLT_MAX;
+	int   hit = -1;
+
+	for( size_t i = 0; i < centers.size(); ++i ) {
+		const vec3  oc = centers[i] - origin;
+		const float b = glm::dot( oc, direction );
+		const float c = glm::dot( oc, oc ) - radii[i] * radii[i];
+		const float disc = b * b - a * c;
+		if( disc < 0.0f )
+			continue;
+
+		const float root = std::sqrt( disc );
+		const float t = ( b - root ) / a >= 0.0f ? ( b - root ) / a : ( b + root ) / a;
+		if( t >= 0.0f && t < best ) {
+			best = t;
+			hit = int( i );
+		}
+	}
+
+	*distance = best;
+	return hit;
+}
+
+bool testBvh( size_t numSpheres, size_t numRays )
+{
+	Rand rand( 12345 );
+
+	// Spread the spheres out with the same density as the teapots: one every 5 units.
+	const float size = 5.0f * std::cbrt( float( numSpheres ) );
+
+	std::vector<vec3>  positions( numSpheres );
+	std::vector<vec3>  offsets( numSpheres );
+	std::vector<vec3>  centers( numSpheres );
+	std::vector<float> radii( numSpheres );
+	for( size_t i = 0; i < numSpheres; ++i ) {
+		positions[i] = vec3( rand.nextFloat( -0.5f, 0.5f ), rand.nextFloat( -0.5f, 0.5f ), rand.nextFloat( -0.5f, 0.5f ) ) * size;
+		offsets[i] = 0.5f * rand.nextVec3();
+		centers[i] = positions[i] + offsets[i];
+		radii[i] = rand.nextFloat( 1.0f, 1.5f );
+	}
+
+	SphereBvh bvh;
+
+	auto start = Clock::now();
+	bvh.build( centers.data(), radii.data(), numSpheres );
+	const double buildTime = getSeconds( start );
+
+	// Move the spheres around their positions, like rotating teapots, and refit.
+	const size_t numRefits = 10;
+	double       refitTime = 0.0;
+	for( size_t r = 0; r < numRefits; ++r ) {
+		const float angle = 0.1f * float( r + 1 );
+		for( size_t i = 0; i < numSpheres; ++i )
+			centers[i] = positions[i] + vec3( offsets[i].x * std::cos( angle ) - offsets[i].z * std::sin( angle ), offsets[i].y, offsets[i].x * std::sin( angle ) + offsets[i].z * std::cos( angle ) );
+
+		start = Clock::now();
+		bvh.refit( centers.data(), radii.data() );
+		refitTime += getSeconds( start );
+	}
+	refitTime /= double( numRefits );
+
+	// Shoot rays from outside the field towards random points inside it.
+	std::vector<Ray> rays( numRays );
+	for( auto &ray : rays ) {
+		const vec3 origin = rand.nextVec3() * size;
+		const vec3 target = vec3( rand.nextFloat( -0.5f, 0.5f ), rand.nextFloat( -0.5f, 0.5f ), rand.nextFloat( -0.5f, 0.5f ) ) * size;
+		ray = Ray( origin, glm::normalize( target - origin ) );
+	}
+
+	std::vector<int>   hits( numRays );
+	std::vector<float> distances( numRays );
+
+	start = Clock::now();
+	for( size_t i = 0; i < numRays; ++i )
+		hits[i] = bvh.intersect( rays[i], &distances[i] );
+	const double bvhTime = getSeconds( start );
+
+	// Testing every sphere is slow, so only do that for a limited number of rays.
+	const size_t numLinearRays = std::max<size_t>( 1, std::min<size_t>( numRays, 100000000 / numSpheres ) );
+	size_t       numErrors = 0;
+
+	start = Clock::now();
+	for( size_t i = 0; i < numLinearRays; ++i ) {
+		float      distance;
+		const int  hit = intersectLinear( rays[i], centers, radii, &distance );
+		const bool isSame = ( hit < 0 && hits[i] < 0 ) || ( hit >= 0 && hits[i] >= 0 && std::abs( distance - distances[i] ) <= 1e-4f * distance );
+		if( !isSame )
+			++numErrors;
+	}
+	const double linearTime = getSeconds( start );
+
+	std::printf( "%8lu spheres %6lu nodes %8.2f ms build %8.3f ms refit %12.0f rays/s %10.0f rays/s linear %8.1fx\n", (unsigned long)numSpheres, (unsigned long)bvh.getNumNodes(), 1e3 * buildTime,
+	             1e3 * refitTime, double( numRays ) / bvhTime, double( numLinearRays ) / linearTime, ( linearTime / double( numLinearRays ) ) / ( bvhTime / double( numRays ) ) );
+
+	if( numErrors > 0 ) {
+		std::printf( "  FAILED: %lu of %lu rays differ from the linear search\n", (unsigned long)numErrors, (unsigned long)numLinearRays );
+		return false;
+	}
+
+	return true;
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	const size_t numRays = argc > 1 ? std::strtoul( argv[1], nullptr, 10 ) : 100000;
+	if( numRays == 0 ) {
+		std::printf( "Usage: %s [number of rays]\n", argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	bool isValid = true;
+	isValid = testBvh( 1000, numRays ) && isValid;
+	isValid = testBvh( 100000, numRays ) && isValid;
+	isValid = testBvh( 1000000, numRays ) && isValid;
+
+	std::printf( isValid ? "PASSED\n" : "FAILED\n" );
+	return isValid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -4,9 +4,15 @@
 #include "cinder/Sphere.h"
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
+#include "cinder/gl/BufferTexture.h"
+#include "cinder/gl/Pbo.h"
+#include "cinder/gl/Ubo.h"
 #include "cinder/gl/gl.h"
 #include "cinder/params/Params.h"
 
+#include "FrustumCuller.h"
+#include "SphereBvh.h"
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
@@ -19,15 +25,33 @@ class DepthOfFieldApp : public App {
 	    , mFocalPlane( 35 )
 	    , mFocalLength( 1.0f )
 	    , mFoV( 10 )
+	    , mInstancesPerAxis( 9 )
+	    , mNumInstances( 0 )
+	    , mNumVisible( 0 )
 	    , mMaxCoCRadiusPixels( 11 )
 	    , mFarRadiusRescale( 1.0f )
 	    , mDebugOption( 0 )
+	    , mSharpThreshold( 0.5f )
+	    , mAutoFocusMode( AUTO_FOCUS_RAY_CASTING )
+	    , mDepthReadIndex( 0 )
+	    , mDepthWriteIndex( 0 )
+	    , mFrameIndex( 0 )
+	    , mQualityLevel( 0 )
+	    , mNumGpuTimes( 0 )
+	    , mTimerReadIndex( 0 )
+	    , mTimerWriteIndex( 0 )
+	    , mTargetFrameTime( 1000.0f / 60.0f )
+	    , mGpuTime( 0 )
+	    , mRenderScale( 1 )
+	    , mSamples( 0 )
 	    , mTime( 0 )
         , mTimeDemo( 0 )
 	    , mPaused( false )
 	    , mResized( true )
 	    , mShiftDown( false )
 	    , mShowBounds( false )
+	    , mSkipSharpTiles( true )
+	    , mDynamicResolution( true )
         , mEnableDemo( false )
 	{
 	}
@@ -35,6 +59,7 @@ class DepthOfFieldApp : public App {
 	static void prepare( Settings *settings );
 
 	void setup() override;
+	void cleanup() override;
 	void update() override;
 	void update( double timestep ); // Will be called a fixed number of times per second.
 	void draw() override;
@@ -50,18 +75,101 @@ class DepthOfFieldApp : public App {
 
 	void reload();
 
+  private:
+	// Animation parameters of a single teapot. The vertex shader calculates the model matrix from these.
+	// Stored in a buffer texture as two RGBA32F texels.
+	struct Instance {
+		vec3  position; // Center of rotation.
+		float phase;    // Initial angle in degrees.
+		vec3  axis;     // Axis of rotation, not normalized.
+		float speed;    // Angular speed in degrees per second.
+	};
+
+	// Per-frame camera and lens parameters, shared by all shaders. Must match the std140 layout of the Frame block in frame.glsl.
+	struct FrameData {
+		mat4  viewMatrix;
+		mat4  projectionMatrix;
+		vec2  inputSourceInvSize;
+		ivec2 tileCount;
+		vec2  tileScale;
+		float aperture;
+		float focalDistance;
+		float focalLength;
+		float time;
+		float farRadiusRescale;
+		float threshold;
+		int   maxCoCRadiusPixels;
+		float invMaxCoCRadiusPixels;
+		vec2  padding; // The size of a std140 block is rounded up to a multiple of 16 bytes.
+	};
+	static_assert( sizeof( FrameData ) == 192, "FrameData does not match the std140 layout." );
+
+	// Render targets for a single quality level.
+	struct RenderTargets {
+		gl::FboRef source;    // Multisampled scene.
+		gl::FboRef blur[2];   // Horizontal and vertical blur.
+		gl::FboRef tiles[2];  // Tile classification, before and after dilation.
+		gl::FboRef composite; // Final image, if it has to be upscaled to the window.
+	};
+
+	// Internal resolution and number of samples of the scene.
+	struct QualityLevel {
+		float scale;
+		int   samples;
+	};
+
+	typedef enum { AUTO_FOCUS_RAY_CASTING, AUTO_FOCUS_DEPTH_BUFFER } AutoFocusMode;
+	typedef enum { TILES_SHARP, TILES_BLURRED, TILES_BLUR_SOURCE, TILES_ALL, TILES_FULL_SCREEN } TileMode; // Must match tiles.vert.
+
+	// Draws a quad for each tile of the given mode, or a single full screen quad. The tile classification must be bound to texture unit 3.
+	void drawTiles( const gl::GlslProgRef &glsl, TileMode mode );
+
+	// Reads back the GPU time of previous frames and selects the quality level that best matches the target frame time.
+	void updateQuality();
+	// Creates the render targets for the given quality level.
+	RenderTargets createRenderTargets( const QualityLevel &quality ) const;
+
+	// Writes the camera and lens parameters to the next uniform buffer and binds it.
+	void updateFrameData();
+	// Returns the maximum blur in pixels at the current render scale, so that the blur on screen does not depend on it.
+	int getMaxCoCRadius() const { return math<int>::max( 1, int( mMaxCoCRadiusPixels * mRenderScale + 0.5f ) ); }
+	// Copies the depth around the cursor to a pixel buffer and reads back the result of an earlier frame, if available.
+	void readFocusDepth();
+
+	// (Re-)creates the animation parameters for all teapots.
+	void createInstances();
+	// Finds the teapots inside the view frustum and uploads their indices.
+	void cullInstances();
+	// Returns the model matrix of a teapot at the given time. Must match the calculation in instanced.vert.
+	static mat4 getTransform( const Instance &instance, double time );
+
   private:
 	CameraPersp            mCamera;                         // Our main camera.
 	CameraPersp            mCameraUser;                     // Our user camera. We'll smoothly interpolate the main camera using the user camera as reference.
 	CameraUi               mCameraUi;                       // Allows us to control the user camera.
 	Sphere                 mBounds;                         // Bounding sphere of a single teapot, allows us to easily find the object under the cursor.
-	gl::VboRef             mInstances;                      // Buffer containing the model matrix for each teapot.
+	float                  mCullRadius;                     // Radius of a sphere around the center of rotation of a teapot that contains it in any orientation.
+	std::vector<Instance>  mInstanceData;                   // Animation parameters for each teapot, used for ray casting.
+	std::vector<vec3>      mBoundsCenters;                  // Center of the bounding sphere of each teapot, updated while ray casting.
+	std::vector<float>     mBoundsRadii;                    // Radius of the bounding sphere of each teapot.
+	SphereBvh              mBvh;                            // Bounding volume hierarchy of the bounding spheres, for fast ray casting.
+	gl::VboRef             mInstances;                      // Buffer containing the animation parameters for each teapot.
+	gl::BufferTextureRef   mInstancesTexture;               // Allows the vertex shader to fetch the animation parameters of any teapot.
+	FrustumCuller          mCuller;                         // Bounding spheres of the teapots, which do not change as they rotate in place.
+	std::vector<uint32_t>  mVisibleIndices;                 // Indices of the teapots inside the view frustum.
+	gl::VboRef             mVisible;                        // Buffer containing the indices of the visible teapots.
+	gl::BufferTextureRef   mVisibleTexture;                 // Allows the vertex shader to fetch the index of each drawn instance.
 	gl::BatchRef           mTeapots, mBackground, mSpheres; // Batches to draw our objects.
 	gl::TextureRef         mTexGold, mTexClay;              // Textures.
 	gl::FboRef             mFboSource;                      // We render the scene to this Fbo, which is then used as input to the Depth-of-Field pass.
 	gl::FboRef             mFboBlur[2];                     // Downsampled and blurred versions of our scene.
 	gl::GlslProgRef        mGlslBlur[2];                    // Horizontal and vertical blur shaders.
 	gl::GlslProgRef        mGlslComposite;                  // Composite shader.
+	gl::FboRef             mFboTiles[2];                    // Maximum circle of confusion of each tile, before and after dilation.
+	gl::FboRef             mFboComposite;                   // Final image at the internal resolution, or null if we can draw directly to the window.
+	gl::GlslProgRef        mGlslTiles, mGlslDilate;         // Tile classification shaders.
+	gl::GlslProgRef        mGlslCopy;                       // Copies the input of tiles that are in focus.
+	gl::VaoRef             mVaoTiles;                       // Empty, the tiles are generated in the vertex shader.
 	params::InterfaceGlRef mParams;                         // Debug parameters.
 
 	float mAperture;           // Calculated from F-Stop and Focal Length.
@@ -69,9 +177,57 @@ class DepthOfFieldApp : public App {
 	float mFocalPlane;         // Distance to object in perfect focus.
 	float mFocalLength;        // Calculated from Field of View.
 	float mFoV;                // In degrees.
-	int   mMaxCoCRadiusPixels; // Maximum blur in pixels.
+	int   mInstancesPerAxis;   // The teapots are arranged in a cube.
+	int   mNumInstances;       // Total number of teapots.
+	int   mNumVisible;         // Number of teapots inside the view frustum.
+	int   mMaxCoCRadiusPixels; // Maximum blur in window pixels.
 	float mFarRadiusRescale;   // Should usually be set to 1.
 	int   mDebugOption;        // Debug render modes.
+	float mSharpThreshold;     // Tiles with a smaller circle of confusion (in pixels) are not blurred.
+	int   mAutoFocusMode;      // Ray casting or depth buffer.
+
+	// To auto-focus using the depth buffer, a small region around the cursor is copied to one of a few pixel buffers
+	// and read back a couple of frames later, once a fence tells us the GPU is done with it. This never stalls the pipeline.
+	static const int kDepthRegionSize = 8;
+	static const int kNumDepthReadbacks = 3;
+
+	// The screen is divided into tiles, which are classified by their maximum circle of confusion. Tiles that are in focus
+	// skip the blur and composite passes and are simply copied, which saves a lot of bandwidth if most of the scene is sharp.
+	static const int kTileSize = 16; // Must match tiles.frag.
+
+	// The frame data is written to a small ring of uniform buffers, so we never have to wait for the GPU to finish reading the previous one.
+	static const int    kNumFrameBuffers = 3;
+	static const GLuint kFrameBinding = 0;
+
+	gl::UboRef mUboFrame[kNumFrameBuffers]; // Uniform buffers containing the frame data.
+	int        mFrameIndex;                 // Buffer used for the current frame.
+
+	// To hold the target frame time, the scene is rendered at a lower resolution and with fewer samples if the GPU can't keep up.
+	// The GPU time is measured with timer queries, which are read back a few frames later. The render targets of each quality
+	// level are kept in a pool, so switching back and forth between levels does not reallocate them.
+	static const int          kNumQualityLevels = 8;
+	static const QualityLevel kQualityLevels[kNumQualityLevels];
+	static const int          kNumTimerQueries = 4;
+	static const int          kMinGpuTimes = 30; // Number of measurements before the quality level can change again.
+
+	std::vector<RenderTargets> mRenderTargets;                  // Pool of render targets, one for each quality level. Created when first needed.
+	int                        mQualityLevel;                   // Current quality level, 0 is the highest.
+	int                        mNumGpuTimes;                    // Number of measurements since the last change of quality level.
+	GLuint                     mTimerQueries[kNumTimerQueries]; // Timer queries measuring the GPU time of a frame.
+	bool                       mTimerPending[kNumTimerQueries]; // Whether the query has been issued but not read back yet.
+	int                        mTimerReadIndex;                 // Oldest pending query.
+	int                        mTimerWriteIndex;                // Next query to issue.
+	float                      mTargetFrameTime;                // In milliseconds.
+	float                      mGpuTime;                        // Smoothed GPU time per frame in milliseconds.
+	float                      mRenderScale;                    // Internal resolution relative to the window.
+	int                        mSamples;                        // Number of samples of the scene.
+
+	gl::FboRef mFboDepth;                        // Resolved depth of the region around the cursor.
+	gl::PboRef mPboDepth[kNumDepthReadbacks];    // Pixel buffers to read the depth into.
+	GLsync     mSyncDepth[kNumDepthReadbacks];   // Fences that signal when the pixel buffers can be read.
+	vec3       mDepthParams[kNumDepthReadbacks]; // Near and far clipping planes, and the cosine of the angle between the cursor ray and the view direction.
+	int        mDepthReadIndex;                  // Oldest pending readback.
+	int        mDepthWriteIndex;                 // Next readback to request.
 
 	double mTime;
     double mTimeDemo;
@@ -82,11 +238,15 @@ class DepthOfFieldApp : public App {
 	bool mResized;
 	bool mShiftDown;
 	bool mShowBounds;
+	bool mSkipSharpTiles;
+	bool mDynamicResolution;
     bool mEnableDemo;
 
 	vec2 mMousePos;
 };
 
+const DepthOfFieldApp::QualityLevel DepthOfFieldApp::kQualityLevels[] = { { 1.0f, 16 }, { 1.0f, 8 }, { 1.0f, 4 }, { 0.85f, 4 }, { 0.75f, 4 }, { 0.75f, 2 }, { 0.6f, 2 }, { 0.5f, 0 } };
+
 void DepthOfFieldApp::prepare( Settings *settings )
 {
 	settings->setWindowSize( 960, 540 );
@@ -104,44 +264,36 @@ void DepthOfFieldApp::setup()
 	mTexGold = gl::Texture2d::create( loadImage( loadAsset( "gold.png" ) ) );
 	mTexClay = gl::Texture2d::create( loadImage( loadAsset( "clay.png" ) ) );
 
-	// Initialize model matrices (one for each instance).
-	std::vector<mat4> matrices;
-	for( int z = -4; z <= 4; z++ ) {
-		for( int y = -4; y <= 4; y++ ) {
-			for( int x = -4; x <= 4; x++ ) {
-				vec3  axis = Rand::randVec3();
-				float angle = Rand::randFloat( -180.0f, 180.0f );
-
-				mat4 transform = glm::translate( vec3( x, y, z ) * 5.0f );
-				transform *= glm::rotate( glm::radians( angle ), axis );
-
-				matrices.emplace_back( transform );
-			}
-		}
-	}
-
-	// Setup per-instance data buffer.
-	geom::BufferLayout layout;
-	layout.append( geom::Attrib::CUSTOM_0, sizeof( mat4 ) / sizeof( float ) /* dims */, sizeof( mat4 ) /* stride */, 0, 1 /* per instance */ );
-
-	mInstances = gl::Vbo::create( GL_ARRAY_BUFFER, matrices.size() * sizeof( mat4 ), matrices.data(), GL_STREAM_DRAW );
-
-	// Create mesh and append per-instance data.
+	// Create mesh.
 	AxisAlignedBox bounds;
 
 	auto mesh = gl::VboMesh::create( geom::Teapot().subdivisions( 9 ) >> geom::Translate( 0, -0.5f, 0 ) >> geom::Bounds( &bounds ) );
-	mesh->appendVbo( layout, mInstances );
 
 	mBounds.setCenter( bounds.getCenter() );
 	mBounds.setRadius( 0.5f * glm::length( bounds.getExtents() ) ); // Scale down for a better fit.
 
+	// For culling, we need a sphere around the center of rotation that contains the teapot in any orientation.
+	mCullRadius = 0.0f;
+	for( int i = 0; i < 8; ++i ) {
+		const vec3 corner( ( i & 1 ) ? bounds.getMax().x : bounds.getMin().x, ( i & 2 ) ? bounds.getMax().y : bounds.getMin().y, ( i & 4 ) ? bounds.getMax().z : bounds.getMin().z );
+		mCullRadius = glm::max( mCullRadius, glm::length( corner ) );
+	}
+
+	// Setup per-instance data buffer. It only contains the animation parameters, which never change,
+	// so we don't have to update it every frame. The actual animation is done in the vertex shader.
+	// The indices of the visible teapots are uploaded every frame, so only those will be drawn.
+	mInstances = gl::Vbo::create( GL_TEXTURE_BUFFER, 0, nullptr, GL_STATIC_DRAW );
+	mVisible = gl::Vbo::create( GL_TEXTURE_BUFFER, 0, nullptr, GL_STREAM_DRAW );
+	createInstances();
+
+	mInstancesTexture = gl::BufferTexture::create( mInstances, GL_RGBA32F );
+	mVisibleTexture = gl::BufferTexture::create( mVisible, GL_R32UI );
+
 	// Create batches.
-	mTeapots = gl::Batch::create( mesh, glsl, { { geom::Attrib::CUSTOM_0, "vInstanceMatrix" } } );
+	mTeapots = gl::Batch::create( mesh, glsl );
 
 	mesh = gl::VboMesh::create( geom::WireSphere().center( mBounds.getCenter() ).radius( mBounds.getRadius() ) );
-	mesh->appendVbo( layout, mInstances );
-
-	mSpheres = gl::Batch::create( mesh, glsl, { { geom::Attrib::CUSTOM_0, "vInstanceMatrix" } } );
+	mSpheres = gl::Batch::create( mesh, glsl );
 
 	// Create background.
     mesh = gl::VboMesh::create( geom::Sphere().subdivisions( 60 ).radius( 50.0f ) >> geom::Invert( geom::NORMAL ) );
@@ -169,56 +321,93 @@ void DepthOfFieldApp::setup()
 	mParams->addSeparator();
 	mParams->addParam( "Max. CoC Radius", &mMaxCoCRadiusPixels ).min( 1 ).max( 20 ).step( 1 );
 	mParams->addParam( "Far Radius Rescale", &mFarRadiusRescale ).min( 0.1f ).max( 20.0f ).step( 0.1f );
-	mParams->addParam( "Debug Option", { "Off", "Show CoC", "Show Region", "Show Near", "Show Blurry", "Show Input", "Show Mid & Far", "Show Signed CoC" }, &mDebugOption );
+	mParams->addParam( "Instances per Axis", &mInstancesPerAxis ).min( 1 ).max( 48 ).step( 1 ).updateFn( [&]() { createInstances(); } );
+	mParams->addParam( "Instances", &mNumInstances, true );
+	mParams->addParam( "Visible", &mNumVisible, true );
+	mParams->addParam( "Debug Option", { "Off", "Show CoC", "Show Region", "Show Near", "Show Blurry", "Show Input", "Show Mid & Far", "Show Signed CoC", "Show Tiles" }, &mDebugOption );
+	mParams->addParam( "Skip Sharp Tiles", &mSkipSharpTiles );
+	mParams->addParam( "Sharp Threshold", &mSharpThreshold ).min( 0.0f ).max( 4.0f ).step( 0.1f );
+	mParams->addSeparator();
+	mParams->addParam( "Dynamic Resolution", &mDynamicResolution );
+	mParams->addParam( "Target Frame Time", &mTargetFrameTime ).min( 1.0f ).max( 100.0f ).step( 0.5f );
+	mParams->addParam( "GPU Time", &mGpuTime, true ).step( 0.1f );
+	mParams->addParam( "Render Scale", &mRenderScale, true ).step( 0.01f );
+	mParams->addParam( "Samples", &mSamples, true );
 	mParams->addSeparator();
     mParams->addButton( "Pause", [&]() { mPaused = !mPaused; } );
     mParams->addButton( "Demo", [&]() { mEnableDemo = !mEnableDemo; } );
+	mParams->addParam( "Auto-focus", { "Ray Casting", "Depth Buffer" }, &mAutoFocusMode );
 	mParams->addText( "Hold SHIFT to auto-focus." );
 
 	// Note: the Fbo's will be created in the update() function after the window has been resized.
 
+	// Create the buffers for auto-focus using the depth buffer. The depth format must match that of the scene, so that we can blit it.
+	auto fmt = gl::Fbo::Format()
+	               .disableColor()
+	               .attachment( GL_DEPTH_STENCIL_ATTACHMENT, gl::Texture2d::create( kDepthRegionSize, kDepthRegionSize, gl::Texture2d::Format().internalFormat( GL_DEPTH24_STENCIL8 ).dataType( GL_UNSIGNED_INT_24_8 ) ) );
+	mFboDepth = gl::Fbo::create( kDepthRegionSize, kDepthRegionSize, fmt );
+
+	for( int i = 0; i < kNumDepthReadbacks; ++i ) {
+		mPboDepth[i] = gl::Pbo::create( GL_PIXEL_PACK_BUFFER, kDepthRegionSize * kDepthRegionSize * sizeof( float ), nullptr, GL_STREAM_READ );
+		mSyncDepth[i] = nullptr;
+	}
+
+	// Create the timer queries.
+	glGenQueries( kNumTimerQueries, mTimerQueries );
+	for( auto &pending : mTimerPending )
+		pending = false;
+
+	// Create the uniform buffers for the frame data.
+	for( int i = 0; i < kNumFrameBuffers; ++i )
+		mUboFrame[i] = gl::Ubo::create( sizeof( FrameData ), nullptr, GL_DYNAMIC_DRAW );
+
+	// The tile shaders don't need any vertex attributes, but we still need to bind a vertex array.
+	mVaoTiles = gl::Vao::create();
+
 	// Now load and assign the actual shaders.
 	reload();
 }
 
+void DepthOfFieldApp::cleanup()
+{
+	for( auto &sync : mSyncDepth ) {
+		if( sync )
+			glDeleteSync( sync );
+		sync = nullptr;
+	}
+
+	glDeleteQueries( kNumTimerQueries, mTimerQueries );
+}
+
 void DepthOfFieldApp::update()
 {
 	mFPS = getAverageFps();
 
-	// Create or resize Fbo's.
+	// Adjust the internal resolution to the GPU load.
+	updateQuality();
+
+	// All render targets have to be recreated after the window has been resized.
 	if( mResized ) {
 		mResized = false;
 
-		int width = getWindowWidth();
-		int height = getWindowHeight();
-
-		// Our input Fbo will contain the full resolution scene. RGB = color, A = Signed CoC (Circle of Confusion).
-		auto fmt = gl::Fbo::Format()
-		               .samples( 16 )
-		               .attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGBA16F ) ) )
-		               .attachment( GL_DEPTH_STENCIL_ATTACHMENT, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_DEPTH24_STENCIL8 ).dataType( GL_UNSIGNED_INT_24_8 ) ) );
-		mFboSource = gl::Fbo::create( width, height, fmt );
-
-		// The horizontal blur Fbo will contain a downsampled and blurred version of the scene.
-		// The first attachment contains the foreground. RGB = premultiplied color, A = coverage.
-		// The second attachments contains the blurred scene. RGB = color, A = Signed CoC.
-		width >>= 2;
+		mRenderTargets.clear();
+		mRenderTargets.resize( kNumQualityLevels );
+	}
 
-		fmt = gl::Fbo::Format()
-		          .attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGBA16F ) ) )
-		          .attachment( GL_COLOR_ATTACHMENT1, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGBA16F ) ) );
-		mFboBlur[0] = gl::Fbo::create( width, height, fmt );
+	// Take the render targets of the current quality level from the pool, creating them if needed.
+	auto &targets = mRenderTargets[mQualityLevel];
+	if( !targets.source )
+		targets = createRenderTargets( kQualityLevels[mQualityLevel] );
 
-		// The vertical blur Fbo will contain a downsampled and blurred version of the scene.
-		// The first attachment contains the foreground. RGB = premultiplied color, A = coverage.
-		// The second attachments contains the blurred scene. RGB = color, A = discarded.
-		height >>= 2;
+	mFboSource = targets.source;
+	mFboBlur[0] = targets.blur[0];
+	mFboBlur[1] = targets.blur[1];
+	mFboTiles[0] = targets.tiles[0];
+	mFboTiles[1] = targets.tiles[1];
+	mFboComposite = targets.composite;
 
-		fmt = gl::Fbo::Format()
-		          .attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGBA16F ) ) )
-		          .attachment( GL_COLOR_ATTACHMENT1, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGB16F ) ) );
-		mFboBlur[1] = gl::Fbo::create( width, height, fmt );
-	}
+	mRenderScale = float( mFboSource->getWidth() ) / getWindowWidth();
+	mSamples = mFboSource->getFormat().getSamples();
 
 	// Use a fixed time step for a steady 60 updates per second.
 	static const double timestep = 1.0 / 60.0;
@@ -241,6 +430,108 @@ void DepthOfFieldApp::update()
 	}
 }
 
+void DepthOfFieldApp::updateQuality()
+{
+	// Collect the results of all timer queries that have completed, oldest first. Never wait for the GPU.
+	while( mTimerPending[mTimerReadIndex] ) {
+		const GLuint query = mTimerQueries[mTimerReadIndex];
+
+		GLint available = 0;
+		glGetQueryObjectiv( query, GL_QUERY_RESULT_AVAILABLE, &available );
+		if( !available )
+			break;
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v( query, GL_QUERY_RESULT, &elapsed );
+
+		mTimerPending[mTimerReadIndex] = false;
+		mTimerReadIndex = ( mTimerReadIndex + 1 ) % kNumTimerQueries;
+
+		// Convert from nanoseconds to milliseconds and smooth out the measurements.
+		mGpuTime = glm::mix( mGpuTime, float( elapsed * 1e-6 ), mNumGpuTimes > 0 ? 0.1f : 1.0f );
+		mNumGpuTimes++;
+	}
+
+	if( !mDynamicResolution ) {
+		mQualityLevel = 0;
+		return;
+	}
+
+	// Wait for enough measurements at the current level, then step down if we're too slow, or up if there's plenty of headroom.
+	// The thresholds are far apart, so we don't keep switching between two levels.
+	if( mNumGpuTimes < kMinGpuTimes )
+		return;
+
+	if( mGpuTime > 1.1f * mTargetFrameTime && mQualityLevel < kNumQualityLevels - 1 ) {
+		mQualityLevel++;
+		mNumGpuTimes = 0;
+	}
+	else if( mGpuTime < 0.6f * mTargetFrameTime && mQualityLevel > 0 ) {
+		mQualityLevel--;
+		mNumGpuTimes = 0;
+	}
+}
+
+DepthOfFieldApp::RenderTargets DepthOfFieldApp::createRenderTargets( const QualityLevel &quality ) const
+{
+	RenderTargets targets;
+
+	int width = glm::max( kTileSize, int( quality.scale * getWindowWidth() ) );
+	int height = glm::max( kTileSize, int( quality.scale * getWindowHeight() ) );
+
+	// Our input Fbo will contain the scene at the internal resolution. RGB = color, A = Signed CoC (Circle of Confusion).
+	auto fmt = gl::Fbo::Format()
+	               .samples( glm::min( quality.samples, gl::Fbo::getMaxSamples() ) )
+	               .attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGBA16F ) ) )
+	               .attachment( GL_DEPTH_STENCIL_ATTACHMENT, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_DEPTH24_STENCIL8 ).dataType( GL_UNSIGNED_INT_24_8 ) ) );
+	targets.source = gl::Fbo::create( width, height, fmt );
+
+	// If the internal resolution is lower than that of the window, we composite to an Fbo first and then upscale it.
+	if( width != getWindowWidth() || height != getWindowHeight() ) {
+		fmt = gl::Fbo::Format()
+		          .disableDepth()
+		          .attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGBA8 ) ) );
+		targets.composite = gl::Fbo::create( width, height, fmt );
+	}
+
+	// The tile Fbo's contain one pixel per tile. The first contains the maximum near and far CoC of the tile.
+	// The second contains the same, but dilated to neighboring tiles. Its blue channel is dilated even further.
+	const int tilesX = ( width + kTileSize - 1 ) / kTileSize;
+	const int tilesY = ( height + kTileSize - 1 ) / kTileSize;
+
+	fmt = gl::Fbo::Format()
+	          .disableDepth()
+	          .attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( tilesX, tilesY, gl::Texture2d::Format().internalFormat( GL_RG16F ).minFilter( GL_NEAREST ).magFilter( GL_NEAREST ) ) );
+	targets.tiles[0] = gl::Fbo::create( tilesX, tilesY, fmt );
+
+	fmt = gl::Fbo::Format()
+	          .disableDepth()
+	          .attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( tilesX, tilesY, gl::Texture2d::Format().internalFormat( GL_RGB16F ).minFilter( GL_NEAREST ).magFilter( GL_NEAREST ) ) );
+	targets.tiles[1] = gl::Fbo::create( tilesX, tilesY, fmt );
+
+	// The horizontal blur Fbo will contain a downsampled and blurred version of the scene.
+	// The first attachment contains the foreground. RGB = premultiplied color, A = coverage.
+	// The second attachments contains the blurred scene. RGB = color, A = Signed CoC.
+	width >>= 2;
+
+	fmt = gl::Fbo::Format()
+	          .attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGBA16F ) ) )
+	          .attachment( GL_COLOR_ATTACHMENT1, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGBA16F ) ) );
+	targets.blur[0] = gl::Fbo::create( width, height, fmt );
+
+	// The vertical blur Fbo will contain a downsampled and blurred version of the scene.
+	// The first attachment contains the foreground. RGB = premultiplied color, A = coverage.
+	// The second attachments contains the blurred scene. RGB = color, A = discarded.
+	height >>= 2;
+
+	fmt = gl::Fbo::Format()
+	          .attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGBA16F ) ) )
+	          .attachment( GL_COLOR_ATTACHMENT1, gl::Texture2d::create( width, height, gl::Texture2d::Format().internalFormat( GL_RGB16F ) ) );
+	targets.blur[1] = gl::Fbo::create( width, height, fmt );
+
+	return targets;
+}
+
 void DepthOfFieldApp::update( double timestep )
 {
 	mTime += timestep;
@@ -291,43 +582,27 @@ void DepthOfFieldApp::update( double timestep )
 	static const float fstops[] = { 0.7f, 0.8f, 1.0f, 1.2f, 1.4f, 1.7f, 2.0f, 2.4f, 2.8f, 3.3f, 4.0f, 4.8f, 5.6f, 6.7f, 8.0f, 9.5f, 11.0f, 16.0f, 22.0f };
 	mAperture = mFocalLength / fstops[mFocalStop];
 
-	// Initialize ray-casting.
-	auto  ray = mCamera.generateRay( mMousePos, getWindowSize() );
-	float min, max, dist = FLT_MAX;
-
-	// Reset random number generator.
-	Rand::randSeed( 12345 );
+	// Perform ray casting. The teapots are animated on the GPU, so we only calculate their bounds when needed.
+	if( mShiftDown && mAutoFocusMode == AUTO_FOCUS_RAY_CASTING ) {
+		const vec4 center = vec4( mBounds.getCenter(), 1 );
+		for( size_t i = 0; i < mInstanceData.size(); ++i )
+			mBoundsCenters[i] = vec3( getTransform( mInstanceData[i], mTime ) * center );
 
-	// Animate teapots and perform ray casting at the same time.
-	auto ptr = (mat4 *)mInstances->mapReplace();
-	for( int z = -4; z <= 4; z++ ) {
-		for( int y = -4; y <= 4; y++ ) {
-			for( int x = -4; x <= 4; x++ ) {
-				vec3  position = vec3( x, y, z ) * 5.0f + Rand::randVec3();
-				vec3  axis = Rand::randVec3();
-				float angle = Rand::randFloat( -180.0f, 180.0f ) + Rand::randFloat( 1.0f, 90.0f ) * float( mTime );
-
-				mat4 transform = glm::translate( position );
-				transform *= glm::rotate( glm::radians( angle ), axis );
-
-				( *ptr++ ) = transform;
-
-				// Ray-casting.
-				if( mShiftDown ) {
-					auto bounds = mBounds.transformed( transform );
-					if( bounds.intersect( ray, &min, &max ) > 0 ) {
-						if( min < dist )
-							dist = min;
-					}
-				}
-			}
+		// The teapots rotate in place, so we only have to build the hierarchy once and can then simply refit it.
+		if( mBvh.getNumSpheres() != mInstanceData.size() ) {
+			mBoundsRadii.assign( mBoundsCenters.size(), mBounds.getRadius() );
+			mBvh.build( mBoundsCenters.data(), mBoundsRadii.data(), mBoundsCenters.size() );
 		}
-	}
-	mInstances->unmap();
+		else
+			mBvh.refit( mBoundsCenters.data(), mBoundsRadii.data() );
 
-	// Auto-focus.
-	if( mShiftDown && dist < FLT_MAX ) {
-		mFocus = dist;
+		auto  ray = mCamera.generateRay( mMousePos, getWindowSize() );
+		float dist;
+
+		// Auto-focus.
+		if( mBvh.intersect( ray, &dist ) >= 0 ) {
+			mFocus = dist;
+		}
 	}
 }
 
@@ -335,6 +610,18 @@ void DepthOfFieldApp::draw()
 {
 	gl::clear();
 
+	// Measure the GPU time of this frame, unless all queries are still pending.
+	const int  timerIndex = mTimerWriteIndex;
+	const bool timed = !mTimerPending[timerIndex];
+	if( timed )
+		glBeginQuery( GL_TIME_ELAPSED, mTimerQueries[timerIndex] );
+
+	// Update and bind the uniform buffer, which is used by all passes.
+	updateFrameData();
+
+	// Only draw the teapots inside the view frustum.
+	cullInstances();
+
 	// Render RGB and normalized CoC (in alpha channel) to Fbo.
 	if( true ) {
 		gl::ScopedFramebuffer scpFbo( mFboSource );
@@ -354,13 +641,11 @@ void DepthOfFieldApp::draw()
 			gl::ScopedColor       scpColor( 1, 1, 1 );
 
 			gl::ScopedTextureBind scpTex0( mTexGold );
+			gl::ScopedTextureBind scpTex4( GL_TEXTURE_BUFFER, mInstancesTexture->getId(), 4 );
+			gl::ScopedTextureBind scpTex5( GL_TEXTURE_BUFFER, mVisibleTexture->getId(), 5 );
 			gl::ScopedGlslProg    scpGlsl( mTeapots->getGlslProg() );
-			mTeapots->getGlslProg()->uniform( "uAperture", mAperture );
-			mTeapots->getGlslProg()->uniform( "uFocalDistance", mFocalPlane );
-			mTeapots->getGlslProg()->uniform( "uFocalLength", mFocalLength );
-			mTeapots->getGlslProg()->uniform( "uMaxCoCRadiusPixels", mMaxCoCRadiusPixels );
 
-			mTeapots->drawInstanced( 9 * 9 * 9 );
+			mTeapots->drawInstanced( mNumVisible );
 		}
 
 		if( true ) {
@@ -370,10 +655,6 @@ void DepthOfFieldApp::draw()
 
 			gl::ScopedTextureBind scpTex0( mTexClay );
 			gl::ScopedGlslProg    scpGlsl( mBackground->getGlslProg() );
-			mBackground->getGlslProg()->uniform( "uAperture", mAperture );
-			mBackground->getGlslProg()->uniform( "uFocalDistance", mFocalPlane );
-			mBackground->getGlslProg()->uniform( "uFocalLength", mFocalLength );
-			mBackground->getGlslProg()->uniform( "uMaxCoCRadiusPixels", mMaxCoCRadiusPixels );
 
 			mBackground->draw();
 		}
@@ -383,15 +664,44 @@ void DepthOfFieldApp::draw()
 			gl::ScopedColor     scpColor( 0, 1, 1 );
 			gl::ScopedLineWidth scpLineWidth( 4.0f ); // To counter sparse downsampling.
 
-			gl::ScopedGlslProg scpGlsl( mSpheres->getGlslProg() );
-			mSpheres->getGlslProg()->uniform( "uAperture", mAperture );
-			mSpheres->getGlslProg()->uniform( "uFocalDistance", mFocalPlane );
-			mSpheres->getGlslProg()->uniform( "uFocalLength", mFocalLength );
-			mSpheres->getGlslProg()->uniform( "uMaxCoCRadiusPixels", mMaxCoCRadiusPixels );
-			mSpheres->drawInstanced( 9 * 9 * 9 );
+			gl::ScopedTextureBind scpTex4( GL_TEXTURE_BUFFER, mInstancesTexture->getId(), 4 );
+			gl::ScopedTextureBind scpTex5( GL_TEXTURE_BUFFER, mVisibleTexture->getId(), 5 );
+			gl::ScopedGlslProg    scpGlsl( mSpheres->getGlslProg() );
+			mSpheres->drawInstanced( mNumVisible );
 		}
 	}
 
+	// Auto-focus using the depth buffer.
+	readFocusDepth();
+
+	// Find the maximum circle of confusion of each tile.
+	if( true ) {
+		gl::ScopedFramebuffer scpFbo( mFboTiles[0] );
+		gl::ScopedViewport    scpViewport( mFboTiles[0]->getSize() );
+		gl::ScopedBlend       scpBlend( false );
+
+		gl::ScopedTextureBind scpTex0( mFboSource->getColorTexture(), 0 );
+		gl::ScopedGlslProg    scpGlsl( mGlslTiles );
+
+		drawTiles( mGlslTiles, TILES_FULL_SCREEN );
+	}
+
+	// Spread it to neighboring tiles, as far as the blur passes reach: 4 times the maximum radius, because they run at a quarter resolution.
+	if( true ) {
+		gl::ScopedFramebuffer scpFbo( mFboTiles[1] );
+		gl::ScopedViewport    scpViewport( mFboTiles[1]->getSize() );
+		gl::ScopedBlend       scpBlend( false );
+
+		gl::ScopedTextureBind scpTex3( mFboTiles[0]->getColorTexture(), 3 );
+		gl::ScopedGlslProg    scpGlsl( mGlslDilate );
+		mGlslDilate->uniform( "uRadius", ( 4 * getMaxCoCRadius() + 4 + kTileSize - 1 ) / kTileSize );
+
+		drawTiles( mGlslDilate, TILES_FULL_SCREEN );
+	}
+
+	// From here on, all passes need the tile classification.
+	gl::ScopedTextureBind scpTiles( mFboTiles[1]->getColorTexture(), 3 );
+
 	// Perform horizontal blur and downsampling. Output 2 targets.
 	if( true ) {
 		gl::ScopedFramebuffer scpFbo( mFboBlur[0] );
@@ -399,19 +709,12 @@ void DepthOfFieldApp::draw()
 
 		gl::clear( ColorA( 0, 0, 0, 0 ) );
 
-		gl::ScopedMatrices scpMatrices;
-		gl::setMatricesWindow( mFboBlur[0]->getSize() );
-
-		gl::ScopedColor        scpColor( 1, 1, 1 );
 		gl::ScopedBlendPremult scpBlend;
 
 		gl::ScopedTextureBind scpTex0( mFboSource->getColorTexture() );
 		gl::ScopedGlslProg    scpGlsl( mGlslBlur[0] );
-		mGlslBlur[0]->uniform( "uMaxCoCRadiusPixels", mMaxCoCRadiusPixels );
-		mGlslBlur[0]->uniform( "uNearBlurRadiusPixels", mMaxCoCRadiusPixels );
-		mGlslBlur[0]->uniform( "uInvNearBlurRadiusPixels", 1.0f / mMaxCoCRadiusPixels );
 
-		gl::drawSolidRect( mFboBlur[0]->getBounds() );
+		drawTiles( mGlslBlur[0], TILES_BLUR_SOURCE );
 	}
 
 	// Perform vertical blur.
@@ -421,36 +724,53 @@ void DepthOfFieldApp::draw()
 
 		gl::clear( ColorA( 0, 0, 0, 0 ) );
 
-		gl::ScopedMatrices scpMatrices;
-		gl::setMatricesWindow( mFboBlur[1]->getSize() );
-
-		gl::ScopedColor        scpColor( 1, 1, 1 );
 		gl::ScopedBlendPremult scpBlend;
 
 		gl::ScopedTextureBind scpTex0( mFboBlur[0]->getTexture2d( GL_COLOR_ATTACHMENT0 ), 0 );
 		gl::ScopedTextureBind scpTex1( mFboBlur[0]->getTexture2d( GL_COLOR_ATTACHMENT1 ), 1 );
 		gl::ScopedGlslProg    scpGlsl( mGlslBlur[1] );
-		mGlslBlur[1]->uniform( "uMaxCoCRadiusPixels", mMaxCoCRadiusPixels );
-		mGlslBlur[1]->uniform( "uNearBlurRadiusPixels", mMaxCoCRadiusPixels );
-		// mGlslBlur[1]->uniform( "uInvNearBlurRadiusPixels", 1.0f / mMaxCoCRadiusPixels ); // Not used in this pass.
 
-		gl::drawSolidRect( mFboBlur[1]->getBounds() );
+		// The composite pass samples the blurred image bilinearly, so also blur the tiles bordering the blurred ones.
+		drawTiles( mGlslBlur[1], TILES_BLUR_SOURCE );
 	}
 
-	// Perform compositing.
+	// When rendering at a lower resolution, composite to an Fbo of the same size and upscale it to the window afterwards.
 	if( true ) {
-		gl::ScopedColor scpColor( 1, 1, 1 );
-		gl::ScopedBlend scpBlend( false );
+		gl::ScopedFramebuffer scpFbo( GL_FRAMEBUFFER, mFboComposite ? mFboComposite->getId() : 0 );
+		gl::ScopedViewport    scpViewport( mFboSource->getSize() );
 
-		gl::ScopedTextureBind scpTex0( mFboSource->getColorTexture(), 0 );
-		gl::ScopedTextureBind scpTex1( mFboBlur[1]->getTexture2d( GL_COLOR_ATTACHMENT0 ), 1 );
-		gl::ScopedTextureBind scpTex2( mFboBlur[1]->getTexture2d( GL_COLOR_ATTACHMENT1 ), 2 );
-		gl::ScopedGlslProg    scpGlsl( mGlslComposite );
-		mGlslComposite->uniform( "uInputSourceInvSize", 1.0f / vec2( mFboSource->getSize() ) );
-		mGlslComposite->uniform( "uFarRadiusRescale", mFarRadiusRescale );
-		mGlslComposite->uniform( "uDebugOption", mDebugOption );
+		// Perform compositing. Debug options need all tiles.
+		if( true ) {
+			gl::ScopedBlend scpBlend( false );
+
+			gl::ScopedTextureBind scpTex0( mFboSource->getColorTexture(), 0 );
+			gl::ScopedTextureBind scpTex1( mFboBlur[1]->getTexture2d( GL_COLOR_ATTACHMENT0 ), 1 );
+			gl::ScopedTextureBind scpTex2( mFboBlur[1]->getTexture2d( GL_COLOR_ATTACHMENT1 ), 2 );
+			gl::ScopedGlslProg    scpGlsl( mGlslComposite );
+			mGlslComposite->uniform( "uDebugOption", mDebugOption );
+
+			drawTiles( mGlslComposite, mDebugOption == 0 ? TILES_BLURRED : TILES_ALL );
+		}
+
+		// Copy the tiles that are in focus. Without tile skipping, the composite pass has drawn them already.
+		if( mDebugOption == 0 && mSkipSharpTiles ) {
+			gl::ScopedBlend scpBlend( false );
+
+			gl::ScopedTextureBind scpTex0( mFboSource->getColorTexture(), 0 );
+			gl::ScopedGlslProg    scpGlsl( mGlslCopy );
+
+			drawTiles( mGlslCopy, TILES_SHARP );
+		}
+	}
+
+	if( mFboComposite )
+		mFboComposite->blitToScreen( mFboComposite->getBounds(), getWindowBounds(), GL_LINEAR );
 
-		gl::drawSolidRect( getWindowBounds() );
+	if( timed ) {
+		glEndQuery( GL_TIME_ELAPSED );
+
+		mTimerPending[timerIndex] = true;
+		mTimerWriteIndex = ( timerIndex + 1 ) % kNumTimerQueries;
 	}
 
 	// Draw parameters.
@@ -490,6 +810,9 @@ void DepthOfFieldApp::keyDown( KeyEvent event )
 	case KeyEvent::KEY_SPACE:
 		mPaused = !mPaused;
 		break;
+	case KeyEvent::KEY_a:
+		mAutoFocusMode = ( mAutoFocusMode == AUTO_FOCUS_RAY_CASTING ) ? AUTO_FOCUS_DEPTH_BUFFER : AUTO_FOCUS_RAY_CASTING;
+		break;
 	case KeyEvent::KEY_b:
 		mShowBounds = !mShowBounds;
         break;
@@ -518,13 +841,192 @@ void DepthOfFieldApp::resize()
 	mResized = true;
 }
 
+void DepthOfFieldApp::updateFrameData()
+{
+	FrameData data;
+	data.viewMatrix = mCamera.getViewMatrix();
+	data.projectionMatrix = mCamera.getProjectionMatrix();
+	data.inputSourceInvSize = 1.0f / vec2( mFboSource->getSize() );
+	data.tileCount = mFboTiles[1]->getSize();
+	data.tileScale = vec2( kTileSize ) * data.inputSourceInvSize;
+	data.aperture = mAperture;
+	data.focalDistance = mFocalPlane;
+	data.focalLength = mFocalLength;
+	data.time = float( mTime );
+	data.farRadiusRescale = mFarRadiusRescale;
+	data.threshold = mSharpThreshold * mRenderScale / getMaxCoCRadius();
+	data.maxCoCRadiusPixels = getMaxCoCRadius();
+	data.invMaxCoCRadiusPixels = 1.0f / getMaxCoCRadius();
+	data.padding = vec2( 0 );
+
+	mFrameIndex = ( mFrameIndex + 1 ) % kNumFrameBuffers;
+
+	auto &ubo = mUboFrame[mFrameIndex];
+	ubo->bufferSubData( 0, sizeof( FrameData ), &data );
+	ubo->bindBufferBase( kFrameBinding );
+}
+
+void DepthOfFieldApp::drawTiles( const gl::GlslProgRef &glsl, TileMode mode )
+{
+	// Without tile skipping, the blur and composite passes simply draw all tiles. They are still classified, so we can show them.
+	if( !mSkipSharpTiles && ( mode == TILES_BLURRED || mode == TILES_BLUR_SOURCE ) )
+		mode = TILES_ALL;
+
+	// The tile count and size are part of the frame data.
+	const ivec2 count = ( mode == TILES_FULL_SCREEN ) ? ivec2( 1 ) : mFboTiles[1]->getSize();
+
+	glsl->uniform( "uTileMode", int( mode ) );
+
+	gl::ScopedVao scpVao( mVaoTiles );
+	gl::drawArraysInstanced( GL_TRIANGLE_STRIP, 0, 4, count.x * count.y );
+}
+
+void DepthOfFieldApp::readFocusDepth()
+{
+	// Process all readbacks that have completed, oldest first. Never wait for the GPU.
+	while( mSyncDepth[mDepthReadIndex] ) {
+		const int index = mDepthReadIndex;
+
+		GLenum status = glClientWaitSync( mSyncDepth[index], GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+		if( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED )
+			break;
+
+		glDeleteSync( mSyncDepth[index] );
+		mSyncDepth[index] = nullptr;
+		mDepthReadIndex = ( index + 1 ) % kNumDepthReadbacks;
+
+		// Find the nearest depth in the region.
+		float depth = 1.0f;
+		{
+			gl::ScopedBuffer scpPbo( mPboDepth[index] );
+
+			auto ptr = (const float *)mPboDepth[index]->map( GL_READ_ONLY );
+			if( ptr ) {
+				for( int i = 0; i < kDepthRegionSize * kDepthRegionSize; ++i )
+					depth = glm::min( depth, ptr[i] );
+			}
+			mPboDepth[index]->unmap();
+		}
+
+		// Convert to linear view space depth, then to distance along the cursor ray, which is how the shaders calculate the circle of confusion.
+		if( mShiftDown && mAutoFocusMode == AUTO_FOCUS_DEPTH_BUFFER && depth < 1.0f ) {
+			const float n = mDepthParams[index].x;
+			const float f = mDepthParams[index].y;
+			const float z = 2.0f * n * f / ( f + n - ( 2.0f * depth - 1.0f ) * ( f - n ) );
+
+			mFocus = z / mDepthParams[index].z;
+		}
+	}
+
+	// Request the depth of the current frame, unless all pixel buffers are still in use.
+	const ivec2 size = mFboSource->getSize();
+	if( !mShiftDown || mAutoFocusMode != AUTO_FOCUS_DEPTH_BUFFER || mSyncDepth[mDepthWriteIndex] || size.x < kDepthRegionSize || size.y < kDepthRegionSize )
+		return;
+
+	const int index = mDepthWriteIndex;
+	mDepthWriteIndex = ( index + 1 ) % kNumDepthReadbacks;
+
+	const vec2 scale = vec2( size ) / vec2( getWindowSize() );
+
+	ivec2 origin = ivec2( vec2( mMousePos.x, getWindowHeight() - mMousePos.y ) * scale ) - ivec2( kDepthRegionSize / 2 );
+	origin = glm::clamp( origin, ivec2( 0 ), size - ivec2( kDepthRegionSize ) );
+
+	// Resolve the multisampled depth of the region.
+	{
+		gl::ScopedFramebuffer scpRead( GL_READ_FRAMEBUFFER, mFboSource->getMultisampleId() ? mFboSource->getMultisampleId() : mFboSource->getId() );
+		gl::ScopedFramebuffer scpDraw( GL_DRAW_FRAMEBUFFER, mFboDepth->getId() );
+
+		glBlitFramebuffer( origin.x, origin.y, origin.x + kDepthRegionSize, origin.y + kDepthRegionSize, 0, 0, kDepthRegionSize, kDepthRegionSize, GL_DEPTH_BUFFER_BIT, GL_NEAREST );
+	}
+
+	// Copy it to the pixel buffer. This returns immediately.
+	{
+		gl::ScopedFramebuffer scpRead( GL_READ_FRAMEBUFFER, mFboDepth->getId() );
+		gl::ScopedBuffer      scpPbo( mPboDepth[index] );
+
+		glReadPixels( 0, 0, kDepthRegionSize, kDepthRegionSize, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr );
+	}
+
+	mSyncDepth[index] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+
+	// Remember the camera parameters, because they might have changed by the time we read the result.
+	auto ray = mCamera.generateRay( mMousePos, getWindowSize() );
+	mDepthParams[index] = vec3( mCamera.getNearClip(), mCamera.getFarClip(), glm::dot( glm::normalize( ray.getDirection() ), mCamera.getViewDirection() ) );
+}
+
+void DepthOfFieldApp::createInstances()
+{
+	// Reset random number generator, so that the teapots end up in the same place each time.
+	Rand::randSeed( 12345 );
+
+	// Center the cube of teapots around the origin.
+	const float offset = 0.5f * float( mInstancesPerAxis - 1 );
+
+	mInstanceData.clear();
+	mInstanceData.reserve( mInstancesPerAxis * mInstancesPerAxis * mInstancesPerAxis );
+
+	for( int z = 0; z < mInstancesPerAxis; z++ ) {
+		for( int y = 0; y < mInstancesPerAxis; y++ ) {
+			for( int x = 0; x < mInstancesPerAxis; x++ ) {
+				Instance instance;
+				instance.position = ( vec3( x, y, z ) - offset ) * 5.0f + Rand::randVec3();
+				instance.axis = Rand::randVec3();
+				instance.phase = Rand::randFloat( -180.0f, 180.0f );
+				instance.speed = Rand::randFloat( 1.0f, 90.0f );
+
+				mInstanceData.push_back( instance );
+			}
+		}
+	}
+
+	mNumInstances = int( mInstanceData.size() );
+
+	// The bounding volume hierarchy will be rebuilt on first use.
+	mBoundsCenters.resize( mInstanceData.size() );
+	mBvh = SphereBvh();
+
+	mInstances->bufferData( mInstanceData.size() * sizeof( Instance ), mInstanceData.data(), GL_STATIC_DRAW );
+
+	// The teapots rotate in place, so their culling spheres never move.
+	std::vector<vec3>  centers( mInstanceData.size() );
+	std::vector<float> radii( mInstanceData.size(), mCullRadius );
+	for( size_t i = 0; i < mInstanceData.size(); ++i )
+		centers[i] = mInstanceData[i].position;
+
+	mCuller.setSpheres( centers.data(), radii.data(), centers.size() );
+	mVisibleIndices.resize( mInstanceData.size() );
+	mVisible->bufferData( mVisibleIndices.size() * sizeof( uint32_t ), nullptr, GL_STREAM_DRAW );
+}
+
+void DepthOfFieldApp::cullInstances()
+{
+	mNumVisible = int( mCuller.cull( mCamera.getProjectionMatrix() * mCamera.getViewMatrix(), mVisibleIndices.data() ) );
+
+	// Orphan the buffer, so we don't have to wait until the GPU is done with the indices of the previous frame.
+	mVisible->bufferData( mVisibleIndices.size() * sizeof( uint32_t ), nullptr, GL_STREAM_DRAW );
+	if( mNumVisible > 0 )
+		mVisible->bufferSubData( 0, mNumVisible * sizeof( uint32_t ), mVisibleIndices.data() );
+}
+
+mat4 DepthOfFieldApp::getTransform( const Instance &instance, double time )
+{
+	float angle = float( std::fmod( instance.phase + instance.speed * time, 360.0 ) );
+
+	mat4 transform = glm::translate( instance.position );
+	transform *= glm::rotate( glm::radians( angle ), instance.axis );
+
+	return transform;
+}
+
 void DepthOfFieldApp::reload()
 {
 	if( mTeapots ) {
 		try {
 			auto glsl = gl::GlslProg::create( loadAsset( "instanced.vert" ), loadAsset( "scene.frag" ) );
 			glsl->uniform( "uTex", 0 );
-			glsl->uniform( "uMaxCoCRadiusPixels", mMaxCoCRadiusPixels );
+			glsl->uniform( "uInstances", 4 );
+			glsl->uniform( "uVisible", 5 );
+			glsl->uniformBlock( "Frame", kFrameBinding );
 
 			mTeapots->replaceGlslProg( glsl );
 		}
@@ -536,6 +1038,9 @@ void DepthOfFieldApp::reload()
 	if( mSpheres ) {
 		try {
 			auto glsl = gl::GlslProg::create( loadAsset( "instanced.vert" ), loadAsset( "debug.frag" ) );
+			glsl->uniform( "uInstances", 4 );
+			glsl->uniform( "uVisible", 5 );
+			glsl->uniformBlock( "Frame", kFrameBinding );
 
 			mSpheres->replaceGlslProg( glsl );
 		}
@@ -548,7 +1053,7 @@ void DepthOfFieldApp::reload()
 		try {
 			auto glsl = gl::GlslProg::create( loadAsset( "single.vert" ), loadAsset( "scene.frag" ) );
 			glsl->uniform( "uTex", 0 );
-			glsl->uniform( "uMaxCoCRadiusPixels", mMaxCoCRadiusPixels );
+			glsl->uniformBlock( "Frame", kFrameBinding );
 
 			mBackground->replaceGlslProg( glsl );
 		}
@@ -557,40 +1062,81 @@ void DepthOfFieldApp::reload()
 		}
 	}
 
-	// Load DoF shaders.
+	// Load DoF shaders. They all use the same vertex shader, which draws the tiles.
+	try {
+		auto fmt = gl::GlslProg::Format().vertex( loadAsset( "tiles.vert" ) ).fragment( loadAsset( "tiles.frag" ) );
+
+		mGlslTiles = gl::GlslProg::create( fmt );
+		mGlslTiles->uniformBlock( "Frame", kFrameBinding );
+		mGlslTiles->uniform( "uInputSource", 0 );
+	}
+	catch( const std::exception &exc ) {
+		console() << "Failed to load tiles shader: " << exc.what() << std::endl;
+	}
+
+	try {
+		auto fmt = gl::GlslProg::Format().vertex( loadAsset( "tiles.vert" ) ).fragment( loadAsset( "dilate.frag" ) );
+
+		mGlslDilate = gl::GlslProg::create( fmt );
+		mGlslDilate->uniformBlock( "Frame", kFrameBinding );
+		mGlslDilate->uniform( "uTileSource", 3 );
+	}
+	catch( const std::exception &exc ) {
+		console() << "Failed to load dilate shader: " << exc.what() << std::endl;
+	}
+
 	try {
-		auto fmt = gl::GlslProg::Format().vertex( loadAsset( "blur.vert" ) ).fragment( loadAsset( "blur.frag" ) ).define( "HORIZONTAL", "1" );
+		auto fmt = gl::GlslProg::Format().vertex( loadAsset( "tiles.vert" ) ).fragment( loadAsset( "blur.frag" ) ).define( "HORIZONTAL", "1" );
 
 		mGlslBlur[0] = gl::GlslProg::create( fmt );
+		mGlslBlur[0]->uniformBlock( "Frame", kFrameBinding );
 		mGlslBlur[0]->uniform( "uBlurSource", 0 );
+		mGlslBlur[0]->uniform( "uTileSource", 3 );
 	}
 	catch( const std::exception &exc ) {
 		console() << "Failed to load horizontal blur shader: " << exc.what() << std::endl;
 	}
 
 	try {
-		auto fmt = gl::GlslProg::Format().vertex( loadAsset( "blur.vert" ) ).fragment( loadAsset( "blur.frag" ) ).define( "HORIZONTAL", "0" );
+		auto fmt = gl::GlslProg::Format().vertex( loadAsset( "tiles.vert" ) ).fragment( loadAsset( "blur.frag" ) ).define( "HORIZONTAL", "0" );
 
 		mGlslBlur[1] = gl::GlslProg::create( fmt );
+		mGlslBlur[1]->uniformBlock( "Frame", kFrameBinding );
 		mGlslBlur[1]->uniform( "uNearSource", 0 );
 		mGlslBlur[1]->uniform( "uBlurSource", 1 );
+		mGlslBlur[1]->uniform( "uTileSource", 3 );
 	}
 	catch( const std::exception &exc ) {
 		console() << "Failed to load vertical blur shader: " << exc.what() << std::endl;
 	}
 
 	try {
-		auto fmt = gl::GlslProg::Format().vertex( loadAsset( "composite.vert" ) ).fragment( loadAsset( "composite.frag" ) );
+		auto fmt = gl::GlslProg::Format().vertex( loadAsset( "tiles.vert" ) ).fragment( loadAsset( "composite.frag" ) );
 
 		mGlslComposite = gl::GlslProg::create( fmt );
+		mGlslComposite->uniformBlock( "Frame", kFrameBinding );
 		mGlslComposite->uniform( "uInputSource", 0 );
 		mGlslComposite->uniform( "uBlurSource", 2 );
 		mGlslComposite->uniform( "uNearSource", 1 );
+		mGlslComposite->uniform( "uTileSource", 3 );
 		mGlslComposite->uniform( "uOffset", vec2( 0 ) );
 	}
 	catch( const std::exception &exc ) {
 		console() << "Failed to load composite shader: " << exc.what() << std::endl;
 	}
+
+	try {
+		auto fmt = gl::GlslProg::Format().vertex( loadAsset( "tiles.vert" ) ).fragment( loadAsset( "copy.frag" ) );
+
+		mGlslCopy = gl::GlslProg::create( fmt );
+		mGlslCopy->uniformBlock( "Frame", kFrameBinding );
+		mGlslCopy->uniform( "uInputSource", 0 );
+		mGlslCopy->uniform( "uTileSource", 3 );
+		mGlslCopy->uniform( "uOffset", vec2( 0 ) );
+	}
+	catch( const std::exception &exc ) {
+		console() << "Failed to load copy shader: " << exc.what() << std::endl;
+	}
 }
 
 CINDER_APP( DepthOfFieldApp, RendererGl, DepthOfFieldApp::prepare )
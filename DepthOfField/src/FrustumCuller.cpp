@@ -0,0 +1,89 @@
+#include "FrustumCuller.h"
+
+#include <cfloat>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#include <xmmintrin.h>
+#define FRUSTUM_CULLER_USE_SSE 1
+#endif
+
+using namespace ci;
+
+void FrustumCuller::setSpheres( const vec3 *centers, const float *radii, size_t count )
+{
+	mNumSpheres = count;
+
+	const size_t numSlots = ( count + 3 ) & ~size_t( 3 );
+
+	mX.resize( numSlots );
+	mY.resize( numSlots );
+	mZ.resize( numSlots );
+	mRadius.resize( numSlots );
+
+	for( size_t i = 0; i < count; ++i ) {
+		mX[i] = centers[i].x;
+		mY[i] = centers[i].y;
+		mZ[i] = centers[i].z;
+		mRadius[i] = radii[i];
+	}
+
+	// A negative radius this large places the padding outside of every plane.
+	for( size_t i = count; i < numSlots; ++i ) {
+		mX[i] = mY[i] = mZ[i] = 0.0f;
+		mRadius[i] = -FLT_MAX;
+	}
+}
+
+size_t FrustumCuller::cull( const mat4 &viewProjection, uint32_t *indices ) const
+{
+	// Extract the planes from the matrix. Their normals point inwards, so a sphere is visible if it is not completely behind any plane.
+	const mat4 m = glm::transpose( viewProjection );
+
+	vec4 planes[6] = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2] };
+	for( auto &plane : planes )
+		plane /= glm::length( vec3( plane ) );
+
+	size_t numVisible = 0;
+
+#if FRUSTUM_CULLER_USE_SSE
+	__m128 px[6], py[6], pz[6], pw[6];
+	for( int p = 0; p < 6; ++p ) {
+		px[p] = _mm_set1_ps( planes[p].x );
+		py[p] = _mm_set1_ps( planes[p].y );
+		pz[p] = _mm_set1_ps( planes[p].z );
+		pw[p] = _mm_set1_ps( planes[p].w );
+	}
+
+	for( size_t i = 0; i < mX.size(); i += 4 ) {
+		const __m128 x = _mm_loadu_ps( &mX[i] );
+		const __m128 y = _mm_loadu_ps( &mY[i] );
+		const __m128 z = _mm_loadu_ps( &mZ[i] );
+		const __m128 r = _mm_loadu_ps( &mRadius[i] );
+
+		__m128 visible = _mm_cmpeq_ps( x, x ); // All bits set.
+		for( int p = 0; p < 6; ++p ) {
+			const __m128 d = _mm_add_ps( _mm_add_ps( _mm_mul_ps( px[p], x ), _mm_mul_ps( py[p], y ) ), _mm_add_ps( _mm_mul_ps( pz[p], z ), pw[p] ) );
+			visible = _mm_and_ps( visible, _mm_cmpge_ps( _mm_add_ps( d, r ), _mm_setzero_ps() ) );
+		}
+
+		// Append the visible spheres of this group.
+		int mask = _mm_movemask_ps( visible );
+		while( mask ) {
+			const int lane = ( mask & 1 ) ? 0 : ( mask & 2 ) ? 1 : ( mask & 4 ) ? 2 : 3;
+			indices[numVisible++] = uint32_t( i + lane );
+			mask &= mask - 1;
+		}
+	}
+#else
+	for( size_t i = 0; i < mNumSpheres; ++i ) {
+		bool visible = true;
+		for( int p = 0; p < 6 && visible; ++p )
+			visible = planes[p].x * mX[i] + planes[p].y * mY[i] + planes[p].z * mZ[i] + planes[p].w + mRadius[i] >= 0.0f;
+
+		if( visible )
+			indices[numVisible++] = uint32_t( i );
+	}
+#endif
+
+	return numVisible;
+}
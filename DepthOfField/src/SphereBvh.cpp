@@ -0,0 +1,271 @@
+#include "SphereBvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#include <xmmintrin.h>
+#define SPHERE_BVH_USE_SSE 1
+#endif
+
+using namespace ci;
+
+namespace {
+
+#if SPHERE_BVH_USE_SSE
+inline float horizontalMin( __m128 v )
+{
+	v = _mm_min_ps( v, _mm_movehl_ps( v, v ) );
+	v = _mm_min_ss( v, _mm_shuffle_ps( v, v, 1 ) );
+	return _mm_cvtss_f32( v );
+}
+
+inline float horizontalMax( __m128 v )
+{
+	v = _mm_max_ps( v, _mm_movehl_ps( v, v ) );
+	v = _mm_max_ss( v, _mm_shuffle_ps( v, v, 1 ) );
+	return _mm_cvtss_f32( v );
+}
+#endif
+
+} // anonymous namespace
+
+void SphereBvh::build( const vec3 *centers, const float *radii, size_t count )
+{
+	mNumSpheres = count;
+	mNodes.clear();
+	mOrder.clear();
+
+	if( count == 0 )
+		return;
+
+	// Pad the last group by repeating the last sphere, so that it does not affect the bounds or the result.
+	const size_t numSlots = ( count + 3 ) & ~size_t( 3 );
+
+	mOrder.resize( numSlots );
+	for( size_t i = 0; i < numSlots; ++i )
+		mOrder[i] = uint32_t( std::min( i, count - 1 ) );
+
+	mX.resize( numSlots );
+	mY.resize( numSlots );
+	mZ.resize( numSlots );
+	mRadius.resize( numSlots );
+
+	mNodes.reserve( numSlots / 2 );
+	mNodes.resize( 1 );
+	buildNode( 0, 0, count, centers );
+
+	refit( centers, radii );
+}
+
+void SphereBvh::buildNode( uint32_t index, size_t first, size_t count, const vec3 *centers )
+{
+	if( count <= 4 ) {
+		mNodes[index].mIndex = uint32_t( first / 4 );
+		mNodes[index].mIsLeaf = 1;
+		return;
+	}
+
+	// Split along the longest axis of the centers.
+	vec3 min( FLT_MAX ), max( -FLT_MAX );
+	for( size_t i = first; i < first + count; ++i ) {
+		min = glm::min( min, centers[mOrder[i]] );
+		max = glm::max( max, centers[mOrder[i]] );
+	}
+
+	const vec3 extents = max - min;
+	const int  axis = ( extents.x > extents.y && extents.x > extents.z ) ? 0 : ( extents.y > extents.z ? 1 : 2 );
+
+	// Split at the median, rounded up to a multiple of four, so that each leaf is exactly one group.
+	const size_t half = ( ( count / 2 ) + 3 ) & ~size_t( 3 );
+
+	uint32_t *order = mOrder.data() + first;
+	std::nth_element( order, order + half, order + count, [&]( uint32_t a, uint32_t b ) { return centers[a][axis] < centers[b][axis]; } );
+
+	// Children are stored next to each other, after their parent.
+	const uint32_t left = uint32_t( mNodes.size() );
+	mNodes[index].mIndex = left;
+	mNodes[index].mIsLeaf = 0;
+	mNodes.resize( mNodes.size() + 2 );
+
+	buildNode( left, first, half, centers );
+	buildNode( left + 1, first + half, count - half, centers );
+}
+
+void SphereBvh::refit( const vec3 *centers, const float *radii )
+{
+	// Copy the spheres in leaf order.
+	for( size_t i = 0; i < mOrder.size(); ++i ) {
+		const uint32_t index = mOrder[i];
+		mX[i] = centers[index].x;
+		mY[i] = centers[index].y;
+		mZ[i] = centers[index].z;
+		mRadius[i] = radii[index];
+	}
+
+	// Update the bounds bottom-up. Children are always stored after their parent.
+	for( size_t i = mNodes.size(); i-- > 0; ) {
+		Node &node = mNodes[i];
+
+		if( node.mIsLeaf ) {
+			const size_t group = node.mIndex * 4;
+
+#if SPHERE_BVH_USE_SSE
+			const __m128 r = _mm_loadu_ps( &mRadius[group] );
+			const __m128 x = _mm_loadu_ps( &mX[group] );
+			const __m128 y = _mm_loadu_ps( &mY[group] );
+			const __m128 z = _mm_loadu_ps( &mZ[group] );
+
+			node.mMin[0] = horizontalMin( _mm_sub_ps( x, r ) );
+			node.mMin[1] = horizontalMin( _mm_sub_ps( y, r ) );
+			node.mMin[2] = horizontalMin( _mm_sub_ps( z, r ) );
+			node.mMax[0] = horizontalMax( _mm_add_ps( x, r ) );
+			node.mMax[1] = horizontalMax( _mm_add_ps( y, r ) );
+			node.mMax[2] = horizontalMax( _mm_add_ps( z, r ) );
+#else
+			const float *coords[3] = { &mX[group], &mY[group], &mZ[group] };
+			for( int k = 0; k < 3; ++k ) {
+				node.mMin[k] = FLT_MAX;
+				node.mMax[k] = -FLT_MAX;
+				for( int j = 0; j < 4; ++j ) {
+					node.mMin[k] = std::min( node.mMin[k], coords[k][j] - mRadius[group + j] );
+					node.mMax[k] = std::max( node.mMax[k], coords[k][j] + mRadius[group + j] );
+				}
+			}
+#endif
+		}
+		else {
+			const Node &left = mNodes[node.mIndex];
+			const Node &right = mNodes[node.mIndex + 1];
+
+			for( int k = 0; k < 3; ++k ) {
+				node.mMin[k] = std::min( left.mMin[k], right.mMin[k] );
+				node.mMax[k] = std::max( left.mMax[k], right.mMax[k] );
+			}
+		}
+	}
+}
+
+int SphereBvh::intersect( const Ray &ray, float *distance ) const
+{
+	if( mNodes.empty() )
+		return -1;
+
+	const vec3  origin = ray.getOrigin();
+	const vec3  direction = ray.getDirection();
+	const float a = glm::dot( direction, direction );
+	if( a <= 0.0f )
+		return -1;
+
+	const float invA = 1.0f / a;
+	const vec3  invDirection = 1.0f / direction;
+
+	float best = FLT_MAX;
+	int   hit = -1;
+
+	// Returns the distance at which the ray enters the node, or FLT_MAX if it misses or is further away than the best hit so far.
+	auto enter = [&]( const Node &node ) {
+		float tmin = 0.0f, tmax = best;
+		for( int k = 0; k < 3; ++k ) {
+			float t0 = ( node.mMin[k] - origin[k] ) * invDirection[k];
+			float t1 = ( node.mMax[k] - origin[k] ) * invDirection[k];
+			if( t0 > t1 )
+				std::swap( t0, t1 );
+
+			tmin = std::max( tmin, t0 );
+			tmax = std::min( tmax, t1 );
+		}
+		return tmin <= tmax ? tmin : FLT_MAX;
+	};
+
+	if( enter( mNodes[0] ) == FLT_MAX )
+		return -1;
+
+	uint32_t stack[64];
+	int      size = 0;
+	stack[size++] = 0;
+
+#if SPHERE_BVH_USE_SSE
+	const __m128 ox = _mm_set1_ps( origin.x ), oy = _mm_set1_ps( origin.y ), oz = _mm_set1_ps( origin.z );
+	const __m128 dx = _mm_set1_ps( direction.x ), dy = _mm_set1_ps( direction.y ), dz = _mm_set1_ps( direction.z );
+	const __m128 va = _mm_set1_ps( a ), vInvA = _mm_set1_ps( invA ), zero = _mm_setzero_ps();
+#endif
+
+	while( size > 0 ) {
+		const Node &node = mNodes[stack[--size]];
+
+		if( node.mIsLeaf ) {
+			// Test all four spheres of the group at once.
+			const size_t group = node.mIndex * 4;
+			float        t[4];
+			int          mask = 0;
+
+#if SPHERE_BVH_USE_SSE
+			const __m128 ocx = _mm_sub_ps( _mm_loadu_ps( &mX[group] ), ox );
+			const __m128 ocy = _mm_sub_ps( _mm_loadu_ps( &mY[group] ), oy );
+			const __m128 ocz = _mm_sub_ps( _mm_loadu_ps( &mZ[group] ), oz );
+			const __m128 r = _mm_loadu_ps( &mRadius[group] );
+
+			const __m128 b = _mm_add_ps( _mm_add_ps( _mm_mul_ps( ocx, dx ), _mm_mul_ps( ocy, dy ) ), _mm_mul_ps( ocz, dz ) );
+			const __m128 c = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( ocx, ocx ), _mm_mul_ps( ocy, ocy ) ), _mm_mul_ps( ocz, ocz ) ), _mm_mul_ps( r, r ) );
+			const __m128 disc = _mm_sub_ps( _mm_mul_ps( b, b ), _mm_mul_ps( va, c ) );
+			const __m128 root = _mm_sqrt_ps( _mm_max_ps( disc, zero ) );
+
+			// Use the far intersection if the ray starts inside the sphere.
+			const __m128 t0 = _mm_mul_ps( _mm_sub_ps( b, root ), vInvA );
+			const __m128 t1 = _mm_mul_ps( _mm_add_ps( b, root ), vInvA );
+			const __m128 isFront = _mm_cmpge_ps( t0, zero );
+			const __m128 vt = _mm_or_ps( _mm_and_ps( isFront, t0 ), _mm_andnot_ps( isFront, t1 ) );
+
+			const __m128 isHit = _mm_and_ps( _mm_cmpge_ps( disc, zero ), _mm_and_ps( _mm_cmpge_ps( vt, zero ), _mm_cmplt_ps( vt, _mm_set1_ps( best ) ) ) );
+
+			mask = _mm_movemask_ps( isHit );
+			_mm_storeu_ps( t, vt );
+#else
+			for( int j = 0; j < 4; ++j ) {
+				const vec3  oc = vec3( mX[group + j], mY[group + j], mZ[group + j] ) - origin;
+				const float b = glm::dot( oc, direction );
+				const float c = glm::dot( oc, oc ) - mRadius[group + j] * mRadius[group + j];
+				const float disc = b * b - a * c;
+				if( disc < 0.0f )
+					continue;
+
+				const float root = std::sqrt( disc );
+				t[j] = ( b - root ) * invA >= 0.0f ? ( b - root ) * invA : ( b + root ) * invA;
+				if( t[j] >= 0.0f && t[j] < best )
+					mask |= 1 << j;
+			}
+#endif
+
+			for( int j = 0; mask != 0; ++j, mask >>= 1 ) {
+				if( ( mask & 1 ) && t[j] < best ) {
+					best = t[j];
+					hit = int( mOrder[group + j] );
+				}
+			}
+		}
+		else {
+			// Visit the nearest child first, so that we can skip the other one more often.
+			uint32_t first = node.mIndex;
+			uint32_t second = node.mIndex + 1;
+
+			float tFirst = enter( mNodes[first] );
+			float tSecond = enter( mNodes[second] );
+			if( tSecond < tFirst ) {
+				std::swap( first, second );
+				std::swap( tFirst, tSecond );
+			}
+
+			if( tSecond < FLT_MAX )
+				stack[size++] = second;
+			if( tFirst < FLT_MAX )
+				stack[size++] = first;
+		}
+	}
+
+	if( hit >= 0 && distance )
+		*distance = best;
+
+	return hit;
+}
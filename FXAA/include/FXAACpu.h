@@ -0,0 +1,60 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "CpuFilter.h"
+
+#include <cstdint>
+#include <vector>
+
+// Applies FXAA 3.11 to a Surface on the CPU, so frames can be anti-aliased on machines without a GPU.
+// This is a port of the FXAA Quality pixel shader in Fxaa3_11.h, with the same preset (39) and settings
+// as fxaa.frag, so the result matches FXAA::apply to within rounding. Like the shader, it reads the
+// luminance of each pixel from the alpha channel. Surfaces without alpha use the luminance of their color.
+//
+// The rows of the image are divided into bands, which are processed by multiple threads. Most pixels are not
+// on an edge and fail the contrast test. The SSE4.1 and AVX2 kernels test 4 or 8 pixels at once and find the
+// direction of the edge for those that pass. They then follow each edge one pixel at a time. The scalar
+// kernel is the reference implementation.
+class FXAACpu : public CpuFilter {
+  public:
+	FXAACpu();
+	~FXAACpu() {}
+
+	// Applies FXAA to the source and writes the result to the destination. The destination should have the same
+	// size and channel order, and can not be the same surface.
+	void apply( ci::Surface8u &destination, const ci::Surface8u &source ) override;
+
+	// Same settings as in fxaa.frag. Sub-pixel aliasing removal ranges from 0 (off) to 1 (softest).
+	void setSubpix( float subpix ) { mSubpix = subpix; }
+	void setEdgeThreshold( float threshold ) { mEdgeThreshold = threshold; }
+	void setEdgeThresholdMin( float threshold ) { mEdgeThresholdMin = threshold; }
+
+  private:
+	float mSubpix;
+	float mEdgeThreshold;
+	float mEdgeThresholdMin;
+
+	// Luminance of each pixel, bottom row first like the texture that the shader samples
+	std::vector<uint8_t> mLuma;
+};
\ No newline at end of file
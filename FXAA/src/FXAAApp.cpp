@@ -24,13 +24,16 @@
 #include "cinder/Camera.h"
 #include "cinder/ImageIo.h"
 #include "cinder/Rand.h"
+#include "cinder/Timer.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/Fbo.h"
 #include "cinder/gl/GlslProg.h"
 #include "cinder/gl/Texture.h"
 #include "cinder/gl/gl.h"
 
+#include "CpuFilterTest.h"
 #include "FXAA.h"
+#include "FXAACpu.h"
 #include "Pistons.h"
 
 using namespace ci;
@@ -52,6 +55,8 @@ class FXAAApp : public App {
 
   private:
 	void render();
+	void applyCpu();
+	void compareWithGpu();
 
   private:
 	CameraPersp mCamera;
@@ -63,6 +68,12 @@ class FXAAApp : public App {
 
 	Pistons mPistons;
 	FXAA    mFXAA;
+	FXAACpu mFXAACpu;
+
+	// If true, FXAA is applied on the CPU to a copy of the frame
+	bool             mUseCpu;
+	Surface8u        mSurfaceCpu;
+	gl::Texture2dRef mTextureCpu;
 
 	Timer  mTimer;
 	double mTime;
@@ -95,6 +106,7 @@ void FXAAApp::setup()
 	// initialize member variables and start the timer
 	mDividerX = getWindowWidth() / 2;
 	mTimeOffset = 0.0;
+	mUseCpu = false;
 	mTimer.start();
 }
 
@@ -126,7 +138,10 @@ void FXAAApp::draw()
 	render();
 
 	// Perform FXAA
-	mFXAA.apply( mFboResult, mFboOriginal );
+	if( mUseCpu )
+		applyCpu();
+	else
+		mFXAA.apply( mFboResult, mFboOriginal );
 
 	// Draw the frame buffer...
 	gl::clear();
@@ -136,7 +151,8 @@ void FXAAApp::draw()
 	int h = getWindowHeight();
 
 	// ...while applying FXAA for the left side
-	gl::draw( mFboResult->getColorTexture(), Area( 0, 0, mDividerX, h ), Rectf( 0, 0, (float)mDividerX, (float)h ) );
+	gl::Texture2dRef result = ( mUseCpu && mTextureCpu ) ? mTextureCpu : mFboResult->getColorTexture();
+	gl::draw( result, Area( 0, 0, mDividerX, h ), Rectf( 0, 0, (float)mDividerX, (float)h ) );
 
 	// ...and without FXAA for the right side
 	gl::draw( mFboOriginal->getColorTexture(), Area( mDividerX, 0, w, h ), Rectf( (float)mDividerX, 0, (float)w, (float)h ) );
@@ -173,6 +189,15 @@ void FXAAApp::keyDown( KeyEvent event )
 		else
 			mTimer.stop();
 		break;
+	case KeyEvent::KEY_c:
+		// Toggle between FXAA on the GPU and on the CPU
+		mUseCpu = !mUseCpu;
+		console() << "FXAA on the " << ( mUseCpu ? "CPU" : "GPU" ) << std::endl;
+		break;
+	case KeyEvent::KEY_t:
+		// Compare the result on the CPU with the result on the GPU
+		compareWithGpu();
+		break;
 	case KeyEvent::KEY_v:
 		if( gl::isVerticalSyncEnabled() )
 			gl::enableVerticalSync( false );
@@ -211,4 +236,44 @@ void FXAAApp::render()
 	mPistons.draw( mCamera );
 }
 
+void FXAAApp::applyCpu()
+{
+	// Read the frame back, apply FXAA and upload the result
+	const Surface8u source = mFboOriginal->readPixels8u( mFboOriginal->getBounds() );
+	if( mSurfaceCpu.getSize() != source.getSize() )
+		mSurfaceCpu = Surface8u( source.getWidth(), source.getHeight(), source.hasAlpha(), source.getChannelOrder() );
+
+	mFXAACpu.apply( mSurfaceCpu, source );
+
+	if( !mTextureCpu || mTextureCpu->getSize() != mSurfaceCpu.getSize() )
+		mTextureCpu = gl::Texture2d::create( mSurfaceCpu );
+	else
+		mTextureCpu->update( mSurfaceCpu );
+}
+
+void FXAAApp::compareWithGpu()
+{
+	// Apply FXAA to the current frame on both the GPU and the CPU
+	mFXAA.apply( mFboResult, mFboOriginal );
+
+	const Surface8u source = mFboOriginal->readPixels8u( mFboOriginal->getBounds() );
+	const Surface8u gpu = mFboResult->readPixels8u( mFboResult->getBounds() );
+	Surface8u       cpu( source.getWidth(), source.getHeight(), source.hasAlpha(), source.getChannelOrder() );
+
+	Timer timer( true );
+	mFXAACpu.apply( cpu, source );
+	timer.stop();
+
+	// Rounding differs a little between the GPU and the CPU, so we count the pixels that differ by more than one level.
+	//  Rounding can also break a tie between two directions differently, but that should be rare.
+	size_t    numDifferent;
+	const int maxDifference = compareSurfaces( gpu, cpu, 1, &numDifferent, false );
+
+	const double total = double( source.getWidth() ) * source.getHeight();
+	const double percentage = 100.0 * numDifferent / total;
+	console() << "FXAA on the CPU (" << FXAACpu::getKernelName( mFXAACpu.getKernel() ) << ", " << mFXAACpu.getNumThreads() << " threads) took " << timer.getSeconds() * 1000.0 << " ms ("
+	          << 1e-6 * total / timer.getSeconds() << " MP/s). Largest difference with the GPU is " << maxDifference << ", " << percentage << "% of the pixels differ by more than 1 ("
+	          << ( percentage <= kGpuTolerancePercentage ? "PASSED" : "FAILED" ) << ", tolerance " << kGpuTolerancePercentage << "%)." << std::endl;
+}
+
 CINDER_APP( FXAAApp, RendererGl )
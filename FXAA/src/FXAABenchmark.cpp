@@ -0,0 +1,82 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Headless benchmark of the CPU implementation of FXAA. It does not need a window or a graphics card,
+// so it can be run on any machine. Usage:
+//
+//   FXAABenchmark [seconds per measurement]
+//
+// Renders a test image with lots of aliased edges at 1920x1080 and 3840x2160 and measures how many
+// megapixels per second each kernel processes, on a single thread and on all cores. Verifies that
+// every kernel produces exactly the same image as the scalar kernel on a single thread. Returns a
+// non-zero exit code on failure.
+
+#include "FXAACpu.h"
+#include "CpuFilterTest.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace ci;
+
+namespace {
+
+// Like the Pistons shader, the test image stores the luminance in the alpha channel
+const bool kHasAlpha = true;
+
+bool testResolution( int width, int height, double seconds )
+{
+	const Surface8u source = createTestImage( width, height, kHasAlpha );
+
+	// The scalar kernel on a single thread is the reference
+	Surface8u reference( width, height, kHasAlpha );
+
+	FXAACpu fxaa;
+	fxaa.setKernel( FXAACpu::SCALAR );
+	fxaa.setNumThreads( 1 );
+	fxaa.apply( reference, source );
+
+	size_t numChanged;
+	compareSurfaces( source, reference, 0, &numChanged, true );
+
+	std::printf( "%dx%d, %.1f%% of the pixels changed by FXAA\n", width, height, 100.0 * double( numChanged ) / ( double( width ) * height ) );
+
+	return benchmarkKernels( fxaa, source, reference, seconds );
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	const double seconds = argc > 1 ? std::atof( argv[1] ) : 1.0;
+	if( seconds <= 0.0 ) {
+		std::printf( "Usage: %s [seconds per measurement]\n", argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	bool isValid = true;
+	isValid = testResolution( 1920, 1080, seconds ) && isValid;
+	isValid = testResolution( 3840, 2160, seconds ) && isValid;
+
+	std::printf( isValid ? "PASSED\n" : "FAILED\n" );
+	return isValid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
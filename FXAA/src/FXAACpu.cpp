@@ -0,0 +1,592 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "FXAACpu.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if CPU_FILTER_USE_SIMD
+#include <immintrin.h>
+#endif
+
+using namespace ci;
+
+namespace {
+
+// Search steps of FXAA_QUALITY__PRESET 39, which is used by fxaa.frag, in half pixels
+const int kNumSteps = 12;
+const int kHalfSteps[kNumSteps] = { 2, 2, 2, 2, 2, 3, 4, 4, 4, 4, 8, 16 };
+
+struct Params {
+	float subpix;
+	float edgeThreshold;
+	float edgeThresholdMin;
+};
+
+// The image that is being processed. Coordinates are in pixels and, as in texture space, y points up.
+struct Image {
+	uint8_t       *luma;
+	const uint8_t *source;
+	uint8_t       *destination;
+	ptrdiff_t      sourceRowBytes;
+	ptrdiff_t      destinationRowBytes;
+	int            width;
+	int            height;
+	int            pixelInc;
+	int            red, green, blue, alpha;
+	float          lumaToFloat[256];
+
+	const uint8_t *getLumaRow( int y ) const { return luma + ptrdiff_t( std::min( std::max( y, 0 ), height - 1 ) ) * width; }
+
+	// Like texture2DLod, clamps to the edge and converts to floating point by dividing by 255
+	float getLuma( int x, int y ) const { return lumaToFloat[getLumaRow( y )[std::min( std::max( x, 0 ), width - 1 )]]; }
+
+	// The surfaces store the top row first
+	const uint8_t *getSourcePixel( int x, int y ) const { return source + ( height - 1 - y ) * sourceRowBytes + x * pixelInc; }
+	uint8_t       *getDestinationPixel( int x, int y ) const { return destination + ( height - 1 - y ) * destinationRowBytes + x * pixelInc; }
+};
+
+// What the first half of the shader finds out about an edge, which the second half needs to follow it
+struct Edge {
+	float lumaM;
+	float lumaNN;
+	float gradientScaled;
+	float subpixF;
+	float lengthSign;
+	bool  horzSpan;
+};
+
+// Performs the contrast test and finds the direction of the edge. Returns false if the pixel is not on an edge.
+//  Unlike the shader, this also skips areas of a single luminance, which the shader leaves unchanged too,
+//  to avoid dividing by zero.
+bool analyze( const Image &image, int x, int y, const Params &params, Edge *edge )
+{
+	const float lumaM = image.getLuma( x, y );
+	float       lumaS = image.getLuma( x, y + 1 );
+	const float lumaE = image.getLuma( x + 1, y );
+	float       lumaN = image.getLuma( x, y - 1 );
+	const float lumaW = image.getLuma( x - 1, y );
+
+	const float maxSM = std::max( lumaS, lumaM );
+	const float minSM = std::min( lumaS, lumaM );
+	const float maxESM = std::max( lumaE, maxSM );
+	const float minESM = std::min( lumaE, minSM );
+	const float maxWN = std::max( lumaN, lumaW );
+	const float minWN = std::min( lumaN, lumaW );
+	const float rangeMax = std::max( maxWN, maxESM );
+	const float rangeMin = std::min( minWN, minESM );
+	const float rangeMaxScaled = rangeMax * params.edgeThreshold;
+	const float range = rangeMax - rangeMin;
+	const float rangeMaxClamped = std::max( params.edgeThresholdMin, rangeMaxScaled );
+	if( range < rangeMaxClamped || range <= 0.0f )
+		return false;
+
+	const float lumaNW = image.getLuma( x - 1, y - 1 );
+	const float lumaSE = image.getLuma( x + 1, y + 1 );
+	const float lumaNE = image.getLuma( x + 1, y - 1 );
+	const float lumaSW = image.getLuma( x - 1, y + 1 );
+
+	const float lumaNS = lumaN + lumaS;
+	const float lumaWE = lumaW + lumaE;
+	const float subpixRcpRange = 1.0f / range;
+	const float subpixNSWE = lumaNS + lumaWE;
+	const float edgeHorz1 = ( -2.0f * lumaM ) + lumaNS;
+	const float edgeVert1 = ( -2.0f * lumaM ) + lumaWE;
+	const float lumaNESE = lumaNE + lumaSE;
+	const float lumaNWNE = lumaNW + lumaNE;
+	const float edgeHorz2 = ( -2.0f * lumaE ) + lumaNESE;
+	const float edgeVert2 = ( -2.0f * lumaN ) + lumaNWNE;
+	const float lumaNWSW = lumaNW + lumaSW;
+	const float lumaSWSE = lumaSW + lumaSE;
+	const float edgeHorz4 = ( std::abs( edgeHorz1 ) * 2.0f ) + std::abs( edgeHorz2 );
+	const float edgeVert4 = ( std::abs( edgeVert1 ) * 2.0f ) + std::abs( edgeVert2 );
+	const float edgeHorz3 = ( -2.0f * lumaW ) + lumaNWSW;
+	const float edgeVert3 = ( -2.0f * lumaS ) + lumaSWSE;
+	const float edgeHorz = std::abs( edgeHorz3 ) + edgeHorz4;
+	const float edgeVert = std::abs( edgeVert3 ) + edgeVert4;
+	const float subpixNWSWNESE = lumaNWSW + lumaNESE;
+	const bool  horzSpan = edgeHorz >= edgeVert;
+	const float subpixA = subpixNSWE * 2.0f + subpixNWSWNESE;
+
+	if( !horzSpan ) {
+		lumaN = lumaW;
+		lumaS = lumaE;
+	}
+
+	const float subpixB = ( subpixA * ( 1.0f / 12.0f ) ) - lumaM;
+	const float gradientN = lumaN - lumaM;
+	const float gradientS = lumaS - lumaM;
+	const bool  pairN = std::abs( gradientN ) >= std::abs( gradientS );
+	const float gradient = std::max( std::abs( gradientN ), std::abs( gradientS ) );
+	const float subpixC = std::min( std::max( std::abs( subpixB ) * subpixRcpRange, 0.0f ), 1.0f );
+	const float subpixD = ( -2.0f * subpixC ) + 3.0f;
+	const float subpixE = subpixC * subpixC;
+
+	edge->lumaM = lumaM;
+	edge->lumaNN = pairN ? ( lumaN + lumaM ) : ( lumaS + lumaM );
+	edge->gradientScaled = gradient * ( 1.0f / 4.0f );
+	edge->subpixF = subpixD * subpixE;
+	edge->lengthSign = pairN ? -1.0f : 1.0f;
+	edge->horzSpan = horzSpan;
+
+	return true;
+}
+
+// Follows the edge in both directions to find out how far the pixel is from its ends, then blends the pixel
+//  with its neighbor across the edge.
+void resolve( const Image &image, int x, int y, const Edge &edge, const Params &params )
+{
+	// The shader searches along the border between the pixel and its neighbor across the edge. Its steps are
+	//  multiples of half a pixel, so we count them in half pixels. Each sample is then the average of two or
+	//  four pixels, which we calculate the same way as bilinear filtering, so ties are broken the same way.
+	const int along = edge.horzSpan ? x : y;
+	const int across = edge.horzSpan ? std::min( y, y + int( edge.lengthSign ) ) : std::min( x, x + int( edge.lengthSign ) );
+
+	auto sample = [&]( int halfPixels ) -> float {
+		const int  position = along + ( halfPixels - ( halfPixels & 1 ) ) / 2;
+		const bool isHalf = ( halfPixels & 1 ) != 0;
+
+		if( edge.horzSpan ) {
+			float bottom = image.getLuma( position, across );
+			float top = image.getLuma( position, across + 1 );
+			if( isHalf ) {
+				bottom += ( image.getLuma( position + 1, across ) - bottom ) * 0.5f;
+				top += ( image.getLuma( position + 1, across + 1 ) - top ) * 0.5f;
+			}
+			return bottom + ( top - bottom ) * 0.5f;
+		}
+		else {
+			const float left = image.getLuma( across, position );
+			const float bottom = left + ( image.getLuma( across + 1, position ) - left ) * 0.5f;
+			if( !isHalf )
+				return bottom;
+
+			const float right = image.getLuma( across, position + 1 );
+			const float top = right + ( image.getLuma( across + 1, position + 1 ) - right ) * 0.5f;
+			return bottom + ( top - bottom ) * 0.5f;
+		}
+	};
+
+	const float lumaHalf = edge.lumaNN * 0.5f;
+	const bool  lumaMLTZero = ( edge.lumaM - lumaHalf ) < 0.0f;
+
+	int   stepsN = kHalfSteps[0];
+	int   stepsP = kHalfSteps[0];
+	float lumaEndN = sample( -stepsN ) - lumaHalf;
+	float lumaEndP = sample( stepsP ) - lumaHalf;
+	bool  doneN = std::abs( lumaEndN ) >= edge.gradientScaled;
+	bool  doneP = std::abs( lumaEndP ) >= edge.gradientScaled;
+
+	// The shader takes one more step after its last sample
+	for( int i = 1; i < kNumSteps; ++i ) {
+		if( !doneN )
+			stepsN += kHalfSteps[i];
+		if( !doneP )
+			stepsP += kHalfSteps[i];
+
+		if( ( doneN && doneP ) || i == kNumSteps - 1 )
+			break;
+
+		if( !doneN )
+			lumaEndN = sample( -stepsN ) - lumaHalf;
+		if( !doneP )
+			lumaEndP = sample( stepsP ) - lumaHalf;
+
+		doneN = std::abs( lumaEndN ) >= edge.gradientScaled;
+		doneP = std::abs( lumaEndP ) >= edge.gradientScaled;
+	}
+
+	const float dstN = stepsN * 0.5f;
+	const float dstP = stepsP * 0.5f;
+	const bool  goodSpanN = ( lumaEndN < 0.0f ) != lumaMLTZero;
+	const float spanLength = ( dstP + dstN );
+	const bool  goodSpanP = ( lumaEndP < 0.0f ) != lumaMLTZero;
+	const float spanLengthRcp = 1.0f / spanLength;
+	const bool  directionN = dstN < dstP;
+	const float dst = std::min( dstN, dstP );
+	const bool  goodSpan = directionN ? goodSpanN : goodSpanP;
+	const float subpixG = edge.subpixF * edge.subpixF;
+	const float pixelOffset = ( dst * ( -spanLengthRcp ) ) + 0.5f;
+	const float subpixH = subpixG * params.subpix;
+	const float pixelOffsetGood = goodSpan ? pixelOffset : 0.0f;
+	const float pixelOffsetSubpix = std::max( pixelOffsetGood, subpixH );
+
+	// The destination already contains the unfiltered pixel
+	if( pixelOffsetSubpix <= 0.0f )
+		return;
+
+	// Blend the color with the neighbor across the edge. The alpha channel keeps the luminance of the pixel.
+	int nx = x;
+	int ny = y;
+	if( !edge.horzSpan )
+		nx = std::min( std::max( x + int( edge.lengthSign ), 0 ), image.width - 1 );
+	else
+		ny = std::min( std::max( y + int( edge.lengthSign ), 0 ), image.height - 1 );
+
+	const uint8_t *a = image.getSourcePixel( x, y );
+	const uint8_t *b = image.getSourcePixel( nx, ny );
+	uint8_t       *d = image.getDestinationPixel( x, y );
+
+	d[image.red] = uint8_t( a[image.red] + ( b[image.red] - a[image.red] ) * pixelOffsetSubpix + 0.5f );
+	d[image.green] = uint8_t( a[image.green] + ( b[image.green] - a[image.green] ) * pixelOffsetSubpix + 0.5f );
+	d[image.blue] = uint8_t( a[image.blue] + ( b[image.blue] - a[image.blue] ) * pixelOffsetSubpix + 0.5f );
+}
+
+void filterPixel( const Image &image, int x, int y, const Params &params )
+{
+	Edge edge;
+	if( analyze( image, x, y, params, &edge ) )
+		resolve( image, x, y, edge, params );
+}
+
+void filterRowScalar( const Image &image, int y, const Params &params )
+{
+	for( int x = 0; x < image.width; ++x )
+		filterPixel( image, x, y, params );
+}
+
+#if CPU_FILTER_USE_SIMD
+
+// Resolves the lanes of a vector of pixels that are on an edge
+void resolveLanes( const Image &image, int x, int y, int lanes, int horzSpan, int pairN, const float *lumaM, const float *lumaNN, const float *gradientScaled, const float *subpixF, const Params &params )
+{
+	for( int i = 0; lanes; ++i, lanes >>= 1 ) {
+		if( !( lanes & 1 ) )
+			continue;
+
+		Edge edge;
+		edge.lumaM = lumaM[i];
+		edge.lumaNN = lumaNN[i];
+		edge.gradientScaled = gradientScaled[i];
+		edge.subpixF = subpixF[i];
+		edge.lengthSign = ( pairN & ( 1 << i ) ) ? -1.0f : 1.0f;
+		edge.horzSpan = ( horzSpan & ( 1 << i ) ) != 0;
+
+		resolve( image, x + i, y, edge, params );
+	}
+}
+
+CPU_FILTER_TARGET_SSE41 inline __m128 loadLuma4( const uint8_t *luma )
+{
+	int32_t bytes;
+	std::memcpy( &bytes, luma, sizeof( bytes ) );
+	return _mm_div_ps( _mm_cvtepi32_ps( _mm_cvtepu8_epi32( _mm_cvtsi32_si128( bytes ) ) ), _mm_set1_ps( 255.0f ) );
+}
+
+// Same as analyze(), for 4 pixels at once
+CPU_FILTER_TARGET_SSE41 void filterRowSse41( const Image &image, int y, const Params &params )
+{
+	const uint8_t *rowN = image.getLumaRow( y - 1 );
+	const uint8_t *rowM = image.getLumaRow( y );
+	const uint8_t *rowS = image.getLumaRow( y + 1 );
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps( 1.0f );
+	const __m128 two = _mm_set1_ps( 2.0f );
+	const __m128 minusTwo = _mm_set1_ps( -2.0f );
+	const __m128 sign = _mm_set1_ps( -0.0f );
+	const __m128 edgeThreshold = _mm_set1_ps( params.edgeThreshold );
+	const __m128 edgeThresholdMin = _mm_set1_ps( params.edgeThresholdMin );
+
+	// The first and last pixel of the row need clamped neighbors
+	filterPixel( image, 0, y, params );
+
+	int x = 1;
+	for( ; x + 4 < image.width; x += 4 ) {
+		const __m128 lumaM = loadLuma4( rowM + x );
+		__m128       lumaS = loadLuma4( rowS + x );
+		const __m128 lumaE = loadLuma4( rowM + x + 1 );
+		__m128       lumaN = loadLuma4( rowN + x );
+		const __m128 lumaW = loadLuma4( rowM + x - 1 );
+
+		const __m128 maxSM = _mm_max_ps( lumaS, lumaM );
+		const __m128 minSM = _mm_min_ps( lumaS, lumaM );
+		const __m128 maxESM = _mm_max_ps( lumaE, maxSM );
+		const __m128 minESM = _mm_min_ps( lumaE, minSM );
+		const __m128 maxWN = _mm_max_ps( lumaN, lumaW );
+		const __m128 minWN = _mm_min_ps( lumaN, lumaW );
+		const __m128 rangeMax = _mm_max_ps( maxWN, maxESM );
+		const __m128 rangeMin = _mm_min_ps( minWN, minESM );
+		const __m128 rangeMaxScaled = _mm_mul_ps( rangeMax, edgeThreshold );
+		const __m128 range = _mm_sub_ps( rangeMax, rangeMin );
+		const __m128 rangeMaxClamped = _mm_max_ps( edgeThresholdMin, rangeMaxScaled );
+
+		const int lanes = _mm_movemask_ps( _mm_and_ps( _mm_cmpge_ps( range, rangeMaxClamped ), _mm_cmpgt_ps( range, zero ) ) );
+		if( !lanes )
+			continue;
+
+		const __m128 lumaNW = loadLuma4( rowN + x - 1 );
+		const __m128 lumaSE = loadLuma4( rowS + x + 1 );
+		const __m128 lumaNE = loadLuma4( rowN + x + 1 );
+		const __m128 lumaSW = loadLuma4( rowS + x - 1 );
+
+		const __m128 lumaNS = _mm_add_ps( lumaN, lumaS );
+		const __m128 lumaWE = _mm_add_ps( lumaW, lumaE );
+		const __m128 subpixRcpRange = _mm_div_ps( one, range );
+		const __m128 subpixNSWE = _mm_add_ps( lumaNS, lumaWE );
+		const __m128 edgeHorz1 = _mm_add_ps( _mm_mul_ps( minusTwo, lumaM ), lumaNS );
+		const __m128 edgeVert1 = _mm_add_ps( _mm_mul_ps( minusTwo, lumaM ), lumaWE );
+		const __m128 lumaNESE = _mm_add_ps( lumaNE, lumaSE );
+		const __m128 lumaNWNE = _mm_add_ps( lumaNW, lumaNE );
+		const __m128 edgeHorz2 = _mm_add_ps( _mm_mul_ps( minusTwo, lumaE ), lumaNESE );
+		const __m128 edgeVert2 = _mm_add_ps( _mm_mul_ps( minusTwo, lumaN ), lumaNWNE );
+		const __m128 lumaNWSW = _mm_add_ps( lumaNW, lumaSW );
+		const __m128 lumaSWSE = _mm_add_ps( lumaSW, lumaSE );
+		const __m128 edgeHorz4 = _mm_add_ps( _mm_mul_ps( _mm_andnot_ps( sign, edgeHorz1 ), two ), _mm_andnot_ps( sign, edgeHorz2 ) );
+		const __m128 edgeVert4 = _mm_add_ps( _mm_mul_ps( _mm_andnot_ps( sign, edgeVert1 ), two ), _mm_andnot_ps( sign, edgeVert2 ) );
+		const __m128 edgeHorz3 = _mm_add_ps( _mm_mul_ps( minusTwo, lumaW ), lumaNWSW );
+		const __m128 edgeVert3 = _mm_add_ps( _mm_mul_ps( minusTwo, lumaS ), lumaSWSE );
+		const __m128 edgeHorz = _mm_add_ps( _mm_andnot_ps( sign, edgeHorz3 ), edgeHorz4 );
+		const __m128 edgeVert = _mm_add_ps( _mm_andnot_ps( sign, edgeVert3 ), edgeVert4 );
+		const __m128 subpixNWSWNESE = _mm_add_ps( lumaNWSW, lumaNESE );
+		const __m128 horzSpan = _mm_cmpge_ps( edgeHorz, edgeVert );
+		const __m128 subpixA = _mm_add_ps( _mm_mul_ps( subpixNSWE, two ), subpixNWSWNESE );
+
+		lumaN = _mm_blendv_ps( lumaW, lumaN, horzSpan );
+		lumaS = _mm_blendv_ps( lumaE, lumaS, horzSpan );
+
+		const __m128 subpixB = _mm_sub_ps( _mm_mul_ps( subpixA, _mm_set1_ps( 1.0f / 12.0f ) ), lumaM );
+		const __m128 gradientN = _mm_andnot_ps( sign, _mm_sub_ps( lumaN, lumaM ) );
+		const __m128 gradientS = _mm_andnot_ps( sign, _mm_sub_ps( lumaS, lumaM ) );
+		const __m128 pairN = _mm_cmpge_ps( gradientN, gradientS );
+		const __m128 gradient = _mm_max_ps( gradientN, gradientS );
+		const __m128 subpixC = _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_andnot_ps( sign, subpixB ), subpixRcpRange ), zero ), one );
+		const __m128 subpixD = _mm_add_ps( _mm_mul_ps( minusTwo, subpixC ), _mm_set1_ps( 3.0f ) );
+		const __m128 subpixE = _mm_mul_ps( subpixC, subpixC );
+
+		float lumaMs[4], lumaNNs[4], gradientsScaled[4], subpixFs[4];
+		_mm_storeu_ps( lumaMs, lumaM );
+		_mm_storeu_ps( lumaNNs, _mm_blendv_ps( _mm_add_ps( lumaS, lumaM ), _mm_add_ps( lumaN, lumaM ), pairN ) );
+		_mm_storeu_ps( gradientsScaled, _mm_mul_ps( gradient, _mm_set1_ps( 1.0f / 4.0f ) ) );
+		_mm_storeu_ps( subpixFs, _mm_mul_ps( subpixD, subpixE ) );
+
+		resolveLanes( image, x, y, lanes, _mm_movemask_ps( horzSpan ), _mm_movemask_ps( pairN ), lumaMs, lumaNNs, gradientsScaled, subpixFs, params );
+	}
+
+	for( ; x < image.width; ++x )
+		filterPixel( image, x, y, params );
+}
+
+CPU_FILTER_TARGET_AVX2 inline __m256 loadLuma8( const uint8_t *luma )
+{
+	return _mm256_div_ps( _mm256_cvtepi32_ps( _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i *)luma ) ) ), _mm256_set1_ps( 255.0f ) );
+}
+
+// Same as analyze(), for 8 pixels at once
+CPU_FILTER_TARGET_AVX2 void filterRowAvx2( const Image &image, int y, const Params &params )
+{
+	const uint8_t *rowN = image.getLumaRow( y - 1 );
+	const uint8_t *rowM = image.getLumaRow( y );
+	const uint8_t *rowS = image.getLumaRow( y + 1 );
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps( 1.0f );
+	const __m256 two = _mm256_set1_ps( 2.0f );
+	const __m256 minusTwo = _mm256_set1_ps( -2.0f );
+	const __m256 sign = _mm256_set1_ps( -0.0f );
+	const __m256 edgeThreshold = _mm256_set1_ps( params.edgeThreshold );
+	const __m256 edgeThresholdMin = _mm256_set1_ps( params.edgeThresholdMin );
+
+	// The first and last pixel of the row need clamped neighbors
+	filterPixel( image, 0, y, params );
+
+	int x = 1;
+	for( ; x + 8 < image.width; x += 8 ) {
+		const __m256 lumaM = loadLuma8( rowM + x );
+		__m256       lumaS = loadLuma8( rowS + x );
+		const __m256 lumaE = loadLuma8( rowM + x + 1 );
+		__m256       lumaN = loadLuma8( rowN + x );
+		const __m256 lumaW = loadLuma8( rowM + x - 1 );
+
+		const __m256 maxSM = _mm256_max_ps( lumaS, lumaM );
+		const __m256 minSM = _mm256_min_ps( lumaS, lumaM );
+		const __m256 maxESM = _mm256_max_ps( lumaE, maxSM );
+		const __m256 minESM = _mm256_min_ps( lumaE, minSM );
+		const __m256 maxWN = _mm256_max_ps( lumaN, lumaW );
+		const __m256 minWN = _mm256_min_ps( lumaN, lumaW );
+		const __m256 rangeMax = _mm256_max_ps( maxWN, maxESM );
+		const __m256 rangeMin = _mm256_min_ps( minWN, minESM );
+		const __m256 rangeMaxScaled = _mm256_mul_ps( rangeMax, edgeThreshold );
+		const __m256 range = _mm256_sub_ps( rangeMax, rangeMin );
+		const __m256 rangeMaxClamped = _mm256_max_ps( edgeThresholdMin, rangeMaxScaled );
+
+		const int lanes = _mm256_movemask_ps( _mm256_and_ps( _mm256_cmp_ps( range, rangeMaxClamped, _CMP_GE_OQ ), _mm256_cmp_ps( range, zero, _CMP_GT_OQ ) ) );
+		if( !lanes )
+			continue;
+
+		const __m256 lumaNW = loadLuma8( rowN + x - 1 );
+		const __m256 lumaSE = loadLuma8( rowS + x + 1 );
+		const __m256 lumaNE = loadLuma8( rowN + x + 1 );
+		const __m256 lumaSW = loadLuma8( rowS + x - 1 );
+
+		const __m256 lumaNS = _mm256_add_ps( lumaN, lumaS );
+		const __m256 lumaWE = _mm256_add_ps( lumaW, lumaE );
+		const __m256 subpixRcpRange = _mm256_div_ps( one, range );
+		const __m256 subpixNSWE = _mm256_add_ps( lumaNS, lumaWE );
+		const __m256 edgeHorz1 = _mm256_add_ps( _mm256_mul_ps( minusTwo, lumaM ), lumaNS );
+		const __m256 edgeVert1 = _mm256_add_ps( _mm256_mul_ps( minusTwo, lumaM ), lumaWE );
+		const __m256 lumaNESE = _mm256_add_ps( lumaNE, lumaSE );
+		const __m256 lumaNWNE = _mm256_add_ps( lumaNW, lumaNE );
+		const __m256 edgeHorz2 = _mm256_add_ps( _mm256_mul_ps( minusTwo, lumaE ), lumaNESE );
+		const __m256 edgeVert2 = _mm256_add_ps( _mm256_mul_ps( minusTwo, lumaN ), lumaNWNE );
+		const __m256 lumaNWSW = _mm256_add_ps( lumaNW, lumaSW );
+		const __m256 lumaSWSE = _mm256_add_ps( lumaSW, lumaSE );
+		const __m256 edgeHorz4 = _mm256_add_ps( _mm256_mul_ps( _mm256_andnot_ps( sign, edgeHorz1 ), two ), _mm256_andnot_ps( sign, edgeHorz2 ) );
+		const __m256 edgeVert4 = _mm256_add_ps( _mm256_mul_ps( _mm256_andnot_ps( sign, edgeVert1 ), two ), _mm256_andnot_ps( sign, edgeVert2 ) );
+		const __m256 edgeHorz3 = _mm256_add_ps( _mm256_mul_ps( minusTwo, lumaW ), lumaNWSW );
+		const __m256 edgeVert3 = _mm256_add_ps( _mm256_mul_ps( minusTwo, lumaS ), lumaSWSE );
+		const __m256 edgeHorz = _mm256_add_ps( _mm256_andnot_ps( sign, edgeHorz3 ), edgeHorz4 );
+		const __m256 edgeVert = _mm256_add_ps( _mm256_andnot_ps( sign, edgeVert3 ), edgeVert4 );
+		const __m256 subpixNWSWNESE = _mm256_add_ps( lumaNWSW, lumaNESE );
+		const __m256 horzSpan = _mm256_cmp_ps( edgeHorz, edgeVert, _CMP_GE_OQ );
+		const __m256 subpixA = _mm256_add_ps( _mm256_mul_ps( subpixNSWE, two ), subpixNWSWNESE );
+
+		lumaN = _mm256_blendv_ps( lumaW, lumaN, horzSpan );
+		lumaS = _mm256_blendv_ps( lumaE, lumaS, horzSpan );
+
+		const __m256 subpixB = _mm256_sub_ps( _mm256_mul_ps( subpixA, _mm256_set1_ps( 1.0f / 12.0f ) ), lumaM );
+		const __m256 gradientN = _mm256_andnot_ps( sign, _mm256_sub_ps( lumaN, lumaM ) );
+		const __m256 gradientS = _mm256_andnot_ps( sign, _mm256_sub_ps( lumaS, lumaM ) );
+		const __m256 pairN = _mm256_cmp_ps( gradientN, gradientS, _CMP_GE_OQ );
+		const __m256 gradient = _mm256_max_ps( gradientN, gradientS );
+		const __m256 subpixC = _mm256_min_ps( _mm256_max_ps( _mm256_mul_ps( _mm256_andnot_ps( sign, subpixB ), subpixRcpRange ), zero ), one );
+		const __m256 subpixD = _mm256_add_ps( _mm256_mul_ps( minusTwo, subpixC ), _mm256_set1_ps( 3.0f ) );
+		const __m256 subpixE = _mm256_mul_ps( subpixC, subpixC );
+
+		float lumaMs[8], lumaNNs[8], gradientsScaled[8], subpixFs[8];
+		_mm256_storeu_ps( lumaMs, lumaM );
+		_mm256_storeu_ps( lumaNNs, _mm256_blendv_ps( _mm256_add_ps( lumaS, lumaM ), _mm256_add_ps( lumaN, lumaM ), pairN ) );
+		_mm256_storeu_ps( gradientsScaled, _mm256_mul_ps( gradient, _mm256_set1_ps( 1.0f / 4.0f ) ) );
+		_mm256_storeu_ps( subpixFs, _mm256_mul_ps( subpixD, subpixE ) );
+
+		const int horzSpans = _mm256_movemask_ps( horzSpan );
+		const int pairsN = _mm256_movemask_ps( pairN );
+
+		// Following the edges is scalar code, which runs a lot slower while the upper halves of the AVX registers are in use
+		_mm256_zeroupper();
+
+		resolveLanes( image, x, y, lanes, horzSpans, pairsN, lumaMs, lumaNNs, gradientsScaled, subpixFs, params );
+	}
+
+	for( ; x < image.width; ++x )
+		filterPixel( image, x, y, params );
+}
+
+#endif // CPU_FILTER_USE_SIMD
+
+// Copies the luminance of the rows in [begin, end) to the luminance buffer
+void extractLuma( const Image &image, int begin, int end )
+{
+	for( int y = begin; y < end; ++y ) {
+		const uint8_t *pixel = image.getSourcePixel( 0, y );
+		uint8_t       *luma = image.luma + ptrdiff_t( y ) * image.width;
+
+		if( image.alpha >= 0 ) {
+			for( int x = 0; x < image.width; ++x, pixel += image.pixelInc )
+				luma[x] = pixel[image.alpha];
+		}
+		else {
+			// Same weights as the Pistons shader
+			for( int x = 0; x < image.width; ++x, pixel += image.pixelInc )
+				luma[x] = uint8_t( ( 299 * pixel[image.red] + 587 * pixel[image.green] + 114 * pixel[image.blue] + 500 ) / 1000 );
+		}
+	}
+}
+
+} // anonymous namespace
+
+FXAACpu::FXAACpu()
+    : mSubpix( 0.75f )
+    , mEdgeThreshold( 0.033f )
+    , mEdgeThresholdMin( 0.0f )
+{
+}
+
+void FXAACpu::apply( Surface8u &destination, const Surface8u &source )
+{
+	// Source and destination should have the same size and layout
+	assert( destination.getWidth() == source.getWidth() );
+	assert( destination.getHeight() == source.getHeight() );
+	assert( destination.getPixelInc() == source.getPixelInc() );
+	assert( destination.getData() != source.getData() );
+
+	const int width = source.getWidth();
+	const int height = source.getHeight();
+	if( width <= 0 || height <= 0 )
+		return;
+
+	mLuma.resize( size_t( width ) * height );
+
+	Image image;
+	image.luma = mLuma.data();
+	image.source = source.getData();
+	image.destination = destination.getData();
+	image.sourceRowBytes = source.getRowBytes();
+	image.destinationRowBytes = destination.getRowBytes();
+	image.width = width;
+	image.height = height;
+	image.pixelInc = source.getPixelInc();
+	image.red = source.getRedOffset();
+	image.green = source.getGreenOffset();
+	image.blue = source.getBlueOffset();
+	image.alpha = source.hasAlpha() ? source.getAlphaOffset() : -1;
+
+	for( int i = 0; i < 256; ++i )
+		image.lumaToFloat[i] = i / 255.0f;
+
+	Params params;
+	params.subpix = mSubpix;
+	params.edgeThreshold = mEdgeThreshold;
+	params.edgeThresholdMin = mEdgeThresholdMin;
+
+	void ( *filterRow )( const Image &, int, const Params & ) = filterRowScalar;
+#if CPU_FILTER_USE_SIMD
+	switch( getKernel() ) {
+	case SSE41:
+		filterRow = filterRowSse41;
+		break;
+	case AVX2:
+		filterRow = filterRowAvx2;
+		break;
+	default:
+		break;
+	}
+#endif
+
+	// Following an edge reads the luminance of other bands, so the luminance of all bands is extracted
+	//  in a separate pass before filtering.
+	processBands( height, 2, [&]( int pass, int, int begin, int end ) {
+		if( pass == 0 ) {
+			extractLuma( image, begin, end );
+			return;
+		}
+
+		for( int y = begin; y < end; ++y ) {
+			// Pixels that are not on an edge are copied unchanged
+			std::memcpy( image.getDestinationPixel( 0, y ), image.getSourcePixel( 0, y ), size_t( width ) * image.pixelInc );
+			filterRow( image, y, params );
+		}
+	} );
+}
\ No newline at end of file
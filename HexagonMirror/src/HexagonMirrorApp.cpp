@@ -24,9 +24,7 @@
 #include "cinder/Camera.h"
 #include "cinder/CameraUi.h"
 #include "cinder/ImageIo.h"
-#include "cinder/ObjLoader.h"
 #include "cinder/Rand.h"
-#include "cinder/TriMesh.h"
 #include "cinder/Utilities.h"
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
@@ -35,6 +33,8 @@
 #include "cinder/gl/Vbo.h"
 #include "cinder/gl/gl.h"
 
+#include "MeshFile.h"
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
@@ -67,7 +67,7 @@ class HexagonMirrorApp : public App {
 	void drawRangeInstanced( const gl::VboMesh &vbo, size_t startIndex, size_t indexCount, size_t instanceCount );
 	void drawArraysInstanced( const gl::VboMesh &vbo, GLint first, GLsizei count, size_t instanceCount );
 
-	// loads the hexagon mesh into a VBO using ObjLoader
+	// loads the hexagon mesh into a VBO from a memory-mapped binary mesh file, which is created from the OBJ file if needed
 	void loadMesh();
 	// creates a Vertex Array Object containing a transform matrix for each instance
 	void initializeBuffer();
@@ -179,11 +179,9 @@ void HexagonMirrorApp::draw()
 
 void HexagonMirrorApp::loadMesh()
 {
-	ObjLoader loader( loadAsset( "hexagon.obj" ) );
-
 	try {
-		TriMeshRef mesh = TriMesh::create( loader );
-		mVboMesh = gl::VboMesh::create( *mesh );
+		MeshFileRef file = MeshFile::load( getAssetPath( "hexagon.obj" ), getAssetPath( "" ) / "hexagon.mesh" );
+		mVboMesh = file->createVboMesh();
 	}
 	catch( const std::exception &e ) {
 		console() << e.what() << std::endl;
@@ -0,0 +1,22 @@
+#version 150
+
+uniform usampler2D uObjectIds;
+
+in vec2 vTexCoord0;
+
+out vec4 oColor;
+
+// turns an object ID into a random, but consistent color
+vec3 idToColor( uint id )
+{
+	if( id == 0u )
+		return vec3( 0 );
+
+	uint h = id * 2654435761u;
+	return vec3( ( h >> 24 ) & 255u, ( h >> 16 ) & 255u, ( h >> 8 ) & 255u ) / 255.0;
+}
+
+void main()
+{
+	oColor = vec4( idToColor( texture( uObjectIds, vTexCoord0 ).r ), 1.0 );
+}
\ No newline at end of file
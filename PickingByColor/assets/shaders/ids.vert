@@ -3,8 +3,13 @@
 uniform mat4 ciModelViewProjection;
 
 in vec4 ciPosition;
+in vec2 ciTexCoord0;
 
-void main(void)
+out vec2 vTexCoord0;
+
+void main()
 {
+	vTexCoord0 = ciTexCoord0;
+
 	gl_Position = ciModelViewProjection * ciPosition;
-}
\ No newline at end of file
+}
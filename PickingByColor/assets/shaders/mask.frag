@@ -0,0 +1,10 @@
+#version 150
+
+out uvec4 oMask;
+
+void main()
+{
+	// the lasso is drawn as a triangle fan with a logical XOR, so pixels that are covered
+	//  an odd number of times end up inside the lasso (even-odd rule), whatever its shape
+	oMask = uvec4( 1u );
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 150
+
+// size of the mask in pixels
+uniform vec2 uSize;
+
+in vec2 ciPosition;
+
+void main()
+{
+	// the lasso is specified in pixels
+	gl_Position = vec4( 2.0 * ciPosition / uSize - 1.0, 0.0, 1.0 );
+}
\ No newline at end of file
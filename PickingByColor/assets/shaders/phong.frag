@@ -1,14 +1,15 @@
 #version 150
 
 uniform sampler2D	tex0;
-uniform vec3 		pickingColor;
 
 in vec4 vPosition;
 in vec3 vNormal;
 in vec2 vTexCoord0;
 in vec3 vColor;
+flat in uint vObjectId;
 
-out vec4 [2] oColor;
+out vec4  oColor;
+out uvec2 oObjectId;
 
 void main()
 {
@@ -33,10 +34,9 @@ void main()
 	specular = clamp( specular, 0.0, 1.0 );
 
 	// write final color in first color target 
-	oColor[0].rgb = ambient + diffuse + specular;
-	oColor[0].a = 1.0;
+	oColor.rgb = ambient + diffuse + specular;
+	oColor.a = 1.0;
 
-	// write color code in second color target
-	//  note:  use texture2D(tex0, uv).a for the alpha value if you use textures
-	oColor[1] = vec4( pickingColor, 1.0 );
+	// write object ID and triangle index in second color target
+	oObjectId = uvec2( vObjectId, uint( gl_PrimitiveID ) );
 }
\ No newline at end of file
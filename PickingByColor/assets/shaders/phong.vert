@@ -3,6 +3,7 @@
 uniform mat4 ciModelViewProjection;
 uniform mat4 ciModelView;
 uniform mat3 ciNormalMatrix;
+uniform uint uObjectId;
 
 in vec4 ciPosition;
 in vec3 ciNormal;
@@ -13,6 +14,7 @@ out vec4 vPosition;
 out vec3 vNormal;
 out vec2 vTexCoord0;
 out vec3 vColor;
+flat out uint vObjectId;
 
 void main()
 {
@@ -21,5 +23,8 @@ void main()
 	vTexCoord0 = ciTexCoord0;
 	vColor = ciColor;
 
+	// each instance has its own ID
+	vObjectId = uObjectId + uint( gl_InstanceID );
+
 	gl_Position = ciModelViewProjection * ciPosition;
 }
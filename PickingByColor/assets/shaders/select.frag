@@ -0,0 +1,11 @@
+#version 150
+
+flat in uint vBit;
+
+out uvec4 oBits;
+
+void main()
+{
+	// the bitmask is drawn with a logical OR, which combines the bits of all points that hit the same word
+	oBits = uvec4( vBit, 0u, 0u, 0u );
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 150
+
+uniform usampler2D uObjectIds;
+uniform usampler2D uMask;
+uniform bool       uUseMask;
+
+// selected region in pixels (x, y, width, height)
+uniform ivec4 uBounds;
+// size of the bitmask in 32-bit words
+uniform ivec2 uTargetSize;
+
+flat out uint vBit;
+
+bool isSelected( ivec2 pixel )
+{
+	return !uUseMask || texelFetch( uMask, pixel, 0 ).r != 0u;
+}
+
+void main()
+{
+	// one vertex is drawn for each pixel of the region
+	ivec2 pixel = uBounds.xy + ivec2( gl_VertexID % uBounds.z, gl_VertexID / uBounds.z );
+	uint  id = texelFetch( uObjectIds, pixel, 0 ).r;
+
+	// neighboring pixels usually belong to the same object. Only the first selected pixel of each run
+	//  of equal IDs has to mark its ID, so all other points are moved outside the viewport and clipped.
+	ivec2 left = pixel - ivec2( 1, 0 );
+	bool  isFirst = pixel.x == uBounds.x || texelFetch( uObjectIds, left, 0 ).r != id || !isSelected( left );
+
+	if( id == 0u || !isFirst || !isSelected( pixel ) ) {
+		vBit = 0u;
+		gl_Position = vec4( 2.0, 2.0, 2.0, 1.0 );
+		return;
+	}
+
+	// each 32-bit word of the bitmask holds 32 IDs
+	int   word = int( id >> 5u );
+	ivec2 texel = ivec2( word % uTargetSize.x, word / uTargetSize.x );
+
+	vBit = 1u << ( id & 31u );
+	gl_Position = vec4( 2.0 * ( vec2( texel ) + 0.5 ) / vec2( uTargetSize ) - 1.0, 0.0, 1.0 );
+}
\ No newline at end of file
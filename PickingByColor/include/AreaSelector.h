@@ -0,0 +1,92 @@
+/*
+ Copyright (c) 2010-2016, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cinder/Area.h"
+#include "cinder/Vector.h"
+#include "cinder/gl/Fbo.h"
+#include "cinder/gl/GlslProg.h"
+#include "cinder/gl/Pbo.h"
+#include "cinder/gl/Vao.h"
+#include "cinder/gl/Vbo.h"
+
+#include <cstdint>
+#include <vector>
+
+//! Finds the set of object IDs inside a rectangle or lasso on the GPU. Each pixel of the selected region marks the bit
+//!  of its object ID in a small integer framebuffer, which holds one bit for every ID. Bits are combined with a
+//!  logical OR while rendering, so the framebuffer ends up containing the presence bitmask of the region.
+//!  Only that bitmask is read back, asynchronously, so a large region costs a few bytes of readback instead of megabytes.
+class AreaSelector {
+  public:
+	AreaSelector();
+	~AreaSelector();
+
+	//! \a maskShader fills the lasso, \a markShader marks the bits of the object IDs in the region
+	void setShaders( const ci::gl::GlslProgRef &maskShader, const ci::gl::GlslProgRef &markShader );
+
+	//! requests the IDs inside \a area of the \a ids texture (an unsigned integer texture with the ID in the red channel).
+	//!  \a numIds is the number of IDs in use, so that the bitmask can be large enough.
+	void select( const ci::gl::Texture2dRef &ids, const ci::Area &area, uint32_t numIds );
+	//! requests the IDs inside the \a lasso polygon, in pixels of the \a ids texture
+	void select( const ci::gl::Texture2dRef &ids, const std::vector<ci::vec2> &lasso, uint32_t numIds );
+
+	//! processes the readbacks that have completed, without waiting for the GPU. Returns true if there is a new result.
+	bool update();
+
+	//! returns the IDs found by the most recent selection that has been read back, sorted and without the background (0)
+	const std::vector<uint32_t> &getIds() const { return mIds; }
+	//! returns the number of bytes that are read back per selection
+	size_t getReadbackSize() const { return mMarkFbo ? size_t( mMarkFbo->getWidth() * mMarkFbo->getHeight() ) * sizeof( uint32_t ) : 0; }
+
+  private:
+	void select( const ci::gl::Texture2dRef &ids, const ci::Area &bounds, const std::vector<ci::vec2> *lasso, uint32_t numIds );
+	void releaseReadbacks();
+
+	//! number of pixel buffers used for the readback
+	static const int kNumBuffers = 3;
+	//! width of the bitmask framebuffer in 32-bit words
+	static const int kMaxWidth = 1024;
+
+	ci::gl::GlslProgRef mMaskShader;
+	ci::gl::GlslProgRef mMarkShader;
+
+	//! lasso mask (8-bit unsigned integer, same size as the ID texture)
+	ci::gl::FboRef mMaskFbo;
+	//! presence bitmask (32-bit unsigned integer, one bit per object ID)
+	ci::gl::FboRef mMarkFbo;
+
+	//! the marking pass generates its vertices from gl_VertexID, but still needs a vertex array object
+	ci::gl::VaoRef mEmptyVao;
+	//! vertices of the lasso
+	ci::gl::VaoRef mLassoVao;
+	ci::gl::VboRef mLassoVbo;
+
+	//! pixel buffers and fences of pending readbacks
+	ci::gl::PboRef mPbo[kNumBuffers];
+	GLsync         mSync[kNumBuffers];
+	int            mReadIndex;
+	int            mWriteIndex;
+
+	std::vector<uint32_t> mIds;
+};
@@ -0,0 +1,62 @@
+/*
+ Copyright (c) 2010-2016, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! Maps the object IDs written to the picking buffer back to the objects they belong to.
+//!  Each object reserves a contiguous range of IDs, one for each of its instances, so an instanced
+//!  batch of millions of objects only needs a single entry and finding an ID is a binary search.
+//!  ID 0 is reserved for the background.
+class ObjectRegistry {
+  public:
+	struct Object {
+		std::string mName;
+		uint32_t    mFirstId;
+		uint32_t    mCount; //!< number of instances
+	};
+
+	ObjectRegistry()
+	    : mNextId( 1 )
+	{
+	}
+
+	//! reserves \a count consecutive IDs for an object and returns the first one. The shader adds the instance index to it.
+	uint32_t add( const std::string &name, uint32_t count = 1 );
+	//! returns the object that owns \a id, or nullptr if there is none. If \a instance is not null, it receives the instance index.
+	const Object *find( uint32_t id, uint32_t *instance = nullptr ) const;
+	//! removes all objects
+	void clear();
+
+	//! returns the number of objects
+	size_t getNumObjects() const { return mObjects.size(); }
+	//! returns the number of IDs in use, including the background
+	uint32_t getNumIds() const { return mNextId; }
+
+  private:
+	//! sorted by ID, because IDs are handed out in increasing order
+	std::vector<Object> mObjects;
+	uint32_t            mNextId;
+};
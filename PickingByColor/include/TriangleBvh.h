@@ -0,0 +1,92 @@
+/*
+ Copyright (c) 2010-2016, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cinder/DataSource.h"
+#include "cinder/DataTarget.h"
+#include "cinder/Ray.h"
+#include "cinder/Vector.h"
+
+#include <cstdint>
+#include <vector>
+
+//! Bounding volume hierarchy over the triangles of a mesh, used to pick objects on the CPU without reading back
+//!  anything from the GPU. The hierarchy is built with the surface area heuristic, which takes a while for large
+//!  meshes, so it can be written to and read from a binary file. Leaves store their triangles in groups of four,
+//!  which are tested against the ray at once using SSE.
+class TriangleBvh {
+  public:
+	TriangleBvh() {}
+
+	//! builds the hierarchy over \a numTriangles triangles. Each triangle consists of 3 \a indices into \a positions.
+	void build( const ci::vec3 *positions, size_t numVertices, const uint32_t *indices, size_t numTriangles );
+	//! removes all triangles
+	void clear();
+
+	//! reads the hierarchy from a file written by write(). Returns false if the file is invalid or was built
+	//!  for a mesh with a different number of vertices or triangles, in which case the hierarchy should be rebuilt.
+	bool read( const ci::DataSourceRef &source, size_t numVertices, size_t numTriangles );
+	//! writes the hierarchy to a binary file
+	void write( const ci::DataTargetRef &target ) const;
+
+	//! returns true if \a ray hits a triangle. If so, \a distance receives the distance along the ray
+	//!  to the nearest hit and \a triangle the index of the triangle that was hit.
+	bool intersect( const ci::Ray &ray, float *distance = nullptr, uint32_t *triangle = nullptr ) const;
+
+	//! returns the number of triangles
+	size_t getNumTriangles() const { return mNumTriangles; }
+	//! returns the number of nodes in the hierarchy
+	size_t getNumNodes() const { return mNodes.size(); }
+	//! returns the number of groups of four triangles, including padding
+	size_t getNumGroups() const { return mGroups.size(); }
+
+  private:
+	//! 32 bytes. Leaf nodes refer to one or more groups of triangles, the children of other nodes are stored next to each other.
+	struct Node {
+		float    mMin[3];
+		uint32_t mIndex; //!< index of first child or group
+		float    mMax[3];
+		uint32_t mCount; //!< number of groups, or 0 if this is not a leaf
+	};
+
+	//! four triangles in SoA form: the first vertex and two edges. Unused slots have zero edges, so they are never hit.
+	struct Group {
+		float    mV0[3][4];
+		float    mE1[3][4];
+		float    mE2[3][4];
+		uint32_t mTriangle[4];
+	};
+
+	//! bounds and centroid of a triangle, only needed while building
+	struct Primitive {
+		ci::vec3 mMin, mMax, mCentroid;
+	};
+
+	//! recursively splits the triangles in \a order, starting at \a first. Leaves refer to a range of \a order until the groups are created.
+	void buildNode( uint32_t index, uint32_t first, uint32_t count, uint32_t depth, const std::vector<Primitive> &primitives, std::vector<uint32_t> &order );
+
+	size_t             mNumVertices = 0;
+	size_t             mNumTriangles = 0;
+	std::vector<Node>  mNodes;
+	std::vector<Group> mGroups;
+};
@@ -0,0 +1,250 @@
+/*
+ Copyright (c) 2010-2016, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AreaSelector.h"
+
+#include "cinder/gl/scoped.h"
+#include "cinder/gl/wrapper.h"
+
+#include <algorithm>
+
+using namespace ci;
+
+AreaSelector::AreaSelector()
+    : mReadIndex( 0 )
+    , mWriteIndex( 0 )
+{
+	for( auto &sync : mSync )
+		sync = nullptr;
+}
+
+AreaSelector::~AreaSelector()
+{
+	releaseReadbacks();
+}
+
+void AreaSelector::setShaders( const gl::GlslProgRef &maskShader, const gl::GlslProgRef &markShader )
+{
+	mMaskShader = maskShader;
+	mMarkShader = markShader;
+
+	mMarkShader->uniform( "uObjectIds", 0 );
+	mMarkShader->uniform( "uMask", 1 );
+}
+
+void AreaSelector::select( const gl::Texture2dRef &ids, const Area &area, uint32_t numIds )
+{
+	select( ids, area, nullptr, numIds );
+}
+
+void AreaSelector::select( const gl::Texture2dRef &ids, const std::vector<vec2> &lasso, uint32_t numIds )
+{
+	// a lasso needs at least 3 points to enclose anything
+	if( lasso.size() < 3 )
+		return;
+
+	const Rectf bounds( lasso );
+	select( ids, Area( ivec2( glm::floor( bounds.getUpperLeft() ) ), ivec2( glm::ceil( bounds.getLowerRight() ) ) ), &lasso, numIds );
+}
+
+void AreaSelector::select( const gl::Texture2dRef &ids, const Area &bounds, const std::vector<vec2> *lasso, uint32_t numIds )
+{
+	if( !ids || !mMarkShader || ( lasso && !mMaskShader ) )
+		return;
+
+	// only the part of the region that is inside the texture can be selected
+	Area area = bounds.getCanonical();
+	area.clipBy( ids->getBounds() );
+	if( area.getWidth() <= 0 || area.getHeight() <= 0 )
+		return;
+
+	// create the bitmask framebuffer, with one bit for each ID. If the number of IDs has changed,
+	//  the layout of the bitmask changes too, so any pending readbacks are discarded.
+	const int words = int( ( uint64_t( numIds ) + 31 ) / 32 );
+	const int width = std::min( std::max( words, 1 ), kMaxWidth );
+	const int height = std::max( ( words + kMaxWidth - 1 ) / kMaxWidth, 1 );
+
+	if( !mMarkFbo || mMarkFbo->getWidth() != width || mMarkFbo->getHeight() != height ) {
+		releaseReadbacks();
+
+		gl::Texture2d::Format tfmt;
+		tfmt.setInternalFormat( GL_R32UI );
+		tfmt.setDataType( GL_UNSIGNED_INT );
+		tfmt.setMinFilter( GL_NEAREST );
+		tfmt.setMagFilter( GL_NEAREST );
+
+		gl::Fbo::Format fmt;
+		fmt.setColorTextureFormat( tfmt );
+		fmt.disableDepth();
+		fmt.setSamples( 0 );
+
+		mMarkFbo = gl::Fbo::create( width, height, fmt );
+	}
+
+	const GLuint none[] = { 0, 0, 0, 0 };
+
+	gl::ScopedDepth depth( false );
+	gl::ScopedBlend blend( false );
+	gl::ScopedState logicOp( GL_COLOR_LOGIC_OP, true );
+
+	// fill the lasso. Its triangle fan covers pixels outside the lasso an even number of times,
+	//  so a logical XOR leaves exactly the pixels inside it set.
+	if( lasso ) {
+		if( !mMaskFbo || mMaskFbo->getSize() != ids->getSize() ) {
+			gl::Texture2d::Format tfmt;
+			tfmt.setInternalFormat( GL_R8UI );
+			tfmt.setDataType( GL_UNSIGNED_BYTE );
+			tfmt.setMinFilter( GL_NEAREST );
+			tfmt.setMagFilter( GL_NEAREST );
+
+			gl::Fbo::Format fmt;
+			fmt.setColorTextureFormat( tfmt );
+			fmt.disableDepth();
+			fmt.setSamples( 0 );
+
+			mMaskFbo = gl::Fbo::create( ids->getWidth(), ids->getHeight(), fmt );
+		}
+
+		if( !mLassoVao ) {
+			mLassoVbo = gl::Vbo::create( GL_ARRAY_BUFFER, lasso->size() * sizeof( vec2 ), lasso->data(), GL_STREAM_DRAW );
+			mLassoVao = gl::Vao::create();
+
+			gl::ScopedVao    vao( mLassoVao );
+			gl::ScopedBuffer vbo( mLassoVbo );
+
+			const GLint location = mMaskShader->getAttribLocation( "ciPosition" );
+			gl::enableVertexAttribArray( location );
+			gl::vertexAttribPointer( location, 2, GL_FLOAT, GL_FALSE, 0, nullptr );
+		}
+		else {
+			mLassoVbo->ensureMinimumSize( lasso->size() * sizeof( vec2 ) );
+			mLassoVbo->bufferSubData( 0, lasso->size() * sizeof( vec2 ), lasso->data() );
+		}
+
+		gl::ScopedFramebuffer fbo( mMaskFbo );
+		gl::ScopedViewport    viewport( ivec2( 0 ), mMaskFbo->getSize() );
+		gl::ScopedGlslProg    shader( mMaskShader );
+		gl::ScopedVao         vao( mLassoVao );
+
+		mMaskShader->uniform( "uSize", vec2( mMaskFbo->getSize() ) );
+
+		glClearBufferuiv( GL_COLOR, 0, none );
+		glLogicOp( GL_XOR );
+		gl::drawArrays( GL_TRIANGLE_FAN, 0, GLsizei( lasso->size() ) );
+	}
+
+	// mark the bit of each ID in the region, using one point per pixel
+	{
+		if( !mEmptyVao )
+			mEmptyVao = gl::Vao::create();
+
+		gl::ScopedFramebuffer fbo( mMarkFbo );
+		gl::ScopedViewport    viewport( ivec2( 0 ), mMarkFbo->getSize() );
+		gl::ScopedGlslProg    shader( mMarkShader );
+		gl::ScopedVao         vao( mEmptyVao );
+		gl::ScopedTextureBind tex0( ids, 0 );
+		gl::ScopedTextureBind tex1( lasso ? mMaskFbo->getColorTexture() : ids, 1 );
+
+		mMarkShader->uniform( "uUseMask", lasso != nullptr );
+		mMarkShader->uniform( "uBounds", ivec4( area.x1, area.y1, area.getWidth(), area.getHeight() ) );
+		mMarkShader->uniform( "uTargetSize", mMarkFbo->getSize() );
+
+		glClearBufferuiv( GL_COLOR, 0, none );
+		glLogicOp( GL_OR );
+		gl::drawArrays( GL_POINTS, 0, area.getWidth() * area.getHeight() );
+
+		glLogicOp( GL_COPY );
+	}
+
+	// read back the bitmask, unless all pixel buffers are still in use. In that case
+	//  the selection has not changed much since the previous request anyway.
+	if( !mSync[mWriteIndex] ) {
+		const int index = mWriteIndex;
+		mWriteIndex = ( index + 1 ) % kNumBuffers;
+
+		if( !mPbo[index] )
+			mPbo[index] = gl::Pbo::create( GL_PIXEL_PACK_BUFFER, getReadbackSize(), nullptr, GL_STREAM_READ );
+
+		gl::ScopedBuffer      pbo( mPbo[index] );
+		gl::ScopedFramebuffer fbo( mMarkFbo );
+
+		// with a pixel buffer bound, glReadPixels returns immediately and copies the pixels in the background
+		glReadBuffer( GL_COLOR_ATTACHMENT0 );
+		glReadPixels( 0, 0, width, height, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr );
+
+		mSync[index] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	}
+}
+
+bool AreaSelector::update()
+{
+	bool isUpdated = false;
+
+	// process all readbacks that have completed, oldest first, without waiting for the GPU
+	while( mSync[mReadIndex] ) {
+		const int index = mReadIndex;
+
+		GLenum status = glClientWaitSync( mSync[index], GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+		if( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED )
+			break;
+
+		glDeleteSync( mSync[index] );
+		mSync[index] = nullptr;
+		mReadIndex = ( index + 1 ) % kNumBuffers;
+
+		gl::ScopedBuffer pbo( mPbo[index] );
+
+		auto words = (const GLuint *)mPbo[index]->map( GL_READ_ONLY );
+		if( words ) {
+			// turn the bitmask into a list of IDs. Most words are zero, so they are skipped quickly.
+			mIds.clear();
+
+			const size_t count = getReadbackSize() / sizeof( GLuint );
+			for( size_t i = 0; i < count; ++i ) {
+				for( GLuint bits = words[i]; bits; bits &= bits - 1 ) {
+					uint32_t bit = 0;
+					while( !( bits & ( 1u << bit ) ) )
+						++bit;
+
+					mIds.push_back( uint32_t( i * 32 + bit ) );
+				}
+			}
+
+			isUpdated = true;
+		}
+		mPbo[index]->unmap();
+	}
+
+	return isUpdated;
+}
+
+void AreaSelector::releaseReadbacks()
+{
+	for( int i = 0; i < kNumBuffers; ++i ) {
+		if( mSync[i] )
+			glDeleteSync( mSync[i] );
+		mSync[i] = nullptr;
+		mPbo[i].reset();
+	}
+
+	mReadIndex = mWriteIndex = 0;
+}
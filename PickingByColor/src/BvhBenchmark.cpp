@@ -0,0 +1,235 @@
+/*
+ Copyright (c) 2010-2016, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Headless benchmark of the triangle hierarchy that is used for picking on the CPU. It does not
+// need a window or a graphics card, so it can be run on any machine. Usage:
+//
+//   PickingByColorBenchmark [number of rays] [path to the models folder]
+//
+// For each of the models in the sample, measures the time it takes to load the model with Cinder's ObjLoader,
+// with the multithreaded ObjParser and from a memory-mapped binary mesh file. Then measures the time it takes
+// to build the hierarchy and to read it from a cache file, and the number of rays per second, compared to
+// testing every triangle. Verifies that the hierarchy finds the same nearest hit as testing every triangle.
+// Returns a non-zero exit code on failure.
+
+#include "MeshFile.h"
+#include "TriangleBvh.h"
+
+#include "cinder/ObjLoader.h"
+#include "cinder/Rand.h"
+#include "cinder/TriMesh.h"
+
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ci;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double getSeconds( Clock::time_point start )
+{
+	return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+// Returns true if the ray hits a triangle, by testing all of them.
+bool intersectLinear( const Ray &ray, const MeshFile &mesh, float *distance, uint32_t *triangle )
+{
+	const vec3     *positions = mesh.getPositions();
+	const uint32_t *indices = mesh.getIndices();
+	const vec3      origin = ray.getOrigin();
+	const vec3      direction = ray.getDirection();
+
+	float    best = FLT_MAX;
+	uint32_t hit = UINT32_MAX;
+
+	for( size_t i = 0; i < mesh.getNumTriangles(); ++i ) {
+		const vec3 &a = positions[indices[i * 3 + 0]];
+		const vec3  e1 = positions[indices[i * 3 + 1]] - a;
+		const vec3  e2 = positions[indices[i * 3 + 2]] - a;
+
+		const vec3  p = glm::cross( direction, e2 );
+		const float det = glm::dot( e1, p );
+		if( std::abs( det ) <= 1e-12f )
+			continue;
+
+		const float invDet = 1.0f / det;
+		const vec3  s = origin - a;
+		const float u = glm::dot( s, p ) * invDet;
+		const vec3  q = glm::cross( s, e1 );
+		const float v = glm::dot( direction, q ) * invDet;
+		const float t = glm::dot( e2, q ) * invDet;
+		if( u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t < best ) {
+			best = t;
+			hit = uint32_t( i );
+		}
+	}
+
+	*distance = best;
+	*triangle = hit;
+	return hit != UINT32_MAX;
+}
+
+bool testModel( const fs::path &path, size_t numRays )
+{
+	const fs::path meshPath = fs::temp_directory_path() / ( path.stem().string() + ".mesh" );
+	const fs::path bvhPath = fs::temp_directory_path() / ( path.stem().string() + ".bvh" );
+
+	double      objLoaderTime, parserTime, writeTime, mapTime;
+	MeshFileRef mesh;
+
+	try {
+		auto start = Clock::now();
+		TriMesh::create( ObjLoader( loadFile( path ) ) );
+		objLoaderTime = getSeconds( start );
+
+		start = Clock::now();
+		const MeshData data = ObjParser::load( path );
+		parserTime = getSeconds( start );
+
+		start = Clock::now();
+		MeshFile::write( meshPath, data );
+		writeTime = getSeconds( start );
+
+		start = Clock::now();
+		mesh = MeshFile::open( meshPath );
+		mapTime = getSeconds( start );
+	}
+	catch( const std::exception &e ) {
+		std::printf( "%s: %s\n", path.filename().string().c_str(), e.what() );
+		return false;
+	}
+
+	std::printf( "%-16s %6lu triangles %8.1f ms ObjLoader %7.1f ms ObjParser (%u threads) %6.1f ms write %6.3f ms mapped %6.1fx faster\n", path.filename().string().c_str(),
+	             (unsigned long)mesh->getNumTriangles(), 1e3 * objLoaderTime, 1e3 * parserTime, std::max( 1u, std::thread::hardware_concurrency() ), 1e3 * writeTime, 1e3 * mapTime,
+	             objLoaderTime / parserTime );
+
+	TriangleBvh bvh;
+
+	auto start = Clock::now();
+	bvh.build( mesh->getPositions(), mesh->getNumVertices(), mesh->getIndices(), mesh->getNumTriangles() );
+	const double buildTime = getSeconds( start );
+
+	// Write the hierarchy to a cache file and read it back, like the sample does.
+	bvh.write( writeFile( bvhPath ) );
+
+	TriangleBvh cached;
+
+	start = Clock::now();
+	const bool isCached = cached.read( loadFile( bvhPath ), mesh->getNumVertices(), mesh->getNumTriangles() );
+	const double readTime = getSeconds( start );
+
+	fs::remove( bvhPath );
+
+	if( !isCached ) {
+		std::printf( "%s: FAILED to read the cache file\n", path.filename().string().c_str() );
+		return false;
+	}
+
+	// Find the bounds of the model.
+	vec3 min( FLT_MAX ), max( -FLT_MAX );
+	for( uint32_t i = 0; i < mesh->getNumVertices(); ++i ) {
+		min = glm::min( min, mesh->getPositions()[i] );
+		max = glm::max( max, mesh->getPositions()[i] );
+	}
+
+	// Shoot rays from all around the model towards random points inside its bounds, so that some of them miss.
+	const vec3  center = 0.5f * ( min + max );
+	const float radius = 0.5f * glm::length( max - min );
+
+	Rand             rand( 12345 );
+	std::vector<Ray> rays( numRays );
+	for( auto &ray : rays ) {
+		const vec3 origin = center + rand.nextVec3() * 2.0f * radius;
+		const vec3 target = min + vec3( rand.nextFloat(), rand.nextFloat(), rand.nextFloat() ) * ( max - min );
+		ray = Ray( origin, glm::normalize( target - origin ) );
+	}
+
+	std::vector<uint32_t> triangles( numRays, UINT32_MAX );
+	std::vector<float>    distances( numRays, FLT_MAX );
+	size_t                numHits = 0;
+
+	start = Clock::now();
+	for( size_t i = 0; i < numRays; ++i ) {
+		if( cached.intersect( rays[i], &distances[i], &triangles[i] ) )
+			++numHits;
+	}
+	const double bvhTime = getSeconds( start );
+
+	// Testing every triangle is slow, so only do that for a limited number of rays.
+	const size_t numLinearRays = std::max<size_t>( 1, std::min<size_t>( numRays, 50000000 / mesh->getNumTriangles() ) );
+	size_t       numErrors = 0;
+
+	start = Clock::now();
+	for( size_t i = 0; i < numLinearRays; ++i ) {
+		float      distance;
+		uint32_t   triangle;
+		const bool isHit = intersectLinear( rays[i], *mesh, &distance, &triangle );
+		const bool isSame = ( !isHit && triangles[i] == UINT32_MAX ) || ( isHit && triangles[i] != UINT32_MAX && std::abs( distance - distances[i] ) <= 1e-4f * distance );
+		if( !isSame )
+			++numErrors;
+	}
+	const double linearTime = getSeconds( start );
+
+	// The file can only be removed once it is no longer mapped.
+	mesh.reset();
+	fs::remove( meshPath );
+
+	std::printf( "%-16s %6lu nodes %7.2f ms build %6.3f ms cached %10.0f rays/s %8.0f rays/s linear %7.1fx %3.0f%% hits\n", path.filename().string().c_str(),
+	             (unsigned long)cached.getNumNodes(), 1e3 * buildTime, 1e3 * readTime, double( numRays ) / bvhTime, double( numLinearRays ) / linearTime, ( linearTime / double( numLinearRays ) ) / ( bvhTime / double( numRays ) ),
+	             100.0 * double( numHits ) / double( numRays ) );
+
+	if( numErrors > 0 ) {
+		std::printf( "  FAILED: %lu of %lu rays differ from the linear search\n", (unsigned long)numErrors, (unsigned long)numLinearRays );
+		return false;
+	}
+
+	return true;
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	const size_t numRays = argc > 1 ? std::strtoul( argv[1], nullptr, 10 ) : 1000000;
+	if( numRays == 0 ) {
+		std::printf( "Usage: %s [number of rays] [path to the models folder]\n", argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	// The benchmark is copied next to the assets folder when it is built.
+	const fs::path models = argc > 2 ? fs::path( argv[2] ) : fs::path( "assets" ) / "models";
+
+	bool isValid = true;
+	isValid = testModel( models / "pitcher.obj", numRays ) && isValid;
+	isValid = testModel( models / "watering_can.obj", numRays ) && isValid;
+
+	std::printf( isValid ? "PASSED\n" : "FAILED\n" );
+	return isValid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
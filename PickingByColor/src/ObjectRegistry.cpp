@@ -0,0 +1,65 @@
+/*
+ Copyright (c) 2010-2016, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ObjectRegistry.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+uint32_t ObjectRegistry::add( const std::string &name, uint32_t count )
+{
+	if( count == 0 || count > UINT32_MAX - mNextId )
+		throw std::out_of_range( "ObjectRegistry: not enough IDs left for " + name );
+
+	Object object;
+	object.mName = name;
+	object.mFirstId = mNextId;
+	object.mCount = count;
+	mObjects.push_back( object );
+
+	mNextId += count;
+
+	return object.mFirstId;
+}
+
+const ObjectRegistry::Object *ObjectRegistry::find( uint32_t id, uint32_t *instance ) const
+{
+	// find the last object that starts at or before the ID
+	auto itr = std::upper_bound( mObjects.begin(), mObjects.end(), id, []( uint32_t id, const Object &object ) { return id < object.mFirstId; } );
+	if( itr == mObjects.begin() )
+		return nullptr;
+
+	--itr;
+	if( id - itr->mFirstId >= itr->mCount )
+		return nullptr;
+
+	if( instance )
+		*instance = id - itr->mFirstId;
+
+	return &( *itr );
+}
+
+void ObjectRegistry::clear()
+{
+	mObjects.clear();
+	mNextId = 1;
+}
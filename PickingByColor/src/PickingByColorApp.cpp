@@ -22,23 +22,46 @@
 
 #include "cinder/CameraUi.h"
 #include "cinder/Font.h"
-#include "cinder/ObjLoader.h"
-#include "cinder/TriMesh.h"
+#include "cinder/Timer.h"
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/Batch.h"
 #include "cinder/gl/Fbo.h"
 #include "cinder/gl/GlslProg.h"
+#include "cinder/gl/Pbo.h"
 #include "cinder/gl/Shader.h"
+#include "cinder/gl/VertBatch.h"
 #include "cinder/gl/draw.h"
 #include "cinder/gl/scoped.h"
 
+#include "AreaSelector.h"
+#include "MeshFile.h"
+#include "ObjectRegistry.h"
+#include "TriangleBvh.h"
+
+#include <cfloat>
+#include <iomanip>
+#include <sstream>
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
 
 class PickingByColorApp : public App {
   public:
+	PickingByColorApp()
+	    : mPickingRegionSize( 10 )
+	    , mPickingCpu( false )
+	    , mPickingAsync( true )
+	    , mPickingReadIndex( 0 )
+	    , mPickingWriteIndex( 0 )
+	    , mPickingTime( 0 )
+	    , mPickingLatency( 0 )
+	    , mIsSelecting( false )
+	    , mIsSelectingLasso( false )
+	{
+	}
+
 	static void prepare( Settings *settings );
 
 	void setup();
@@ -58,58 +81,96 @@ class PickingByColorApp : public App {
 
 	//! renders the scene
 	void render();
-	//! samples the color buffer to determine which object is under the mouse
+	//! samples the color buffer to determine which object is under the mouse.
+	//!  In asynchronous mode, returns the most recent result that is available.
 	std::string pick( const ivec2 &position );
-	//! loads an OBJ file, writes it to a much faster binary file and loads the mesh
-	void loadMesh( const std::string &objFile, const std::string &meshFile, gl::BatchRef &mesh );
+	//! determines which object covers the majority of a \a width by \a height region, centered on the cursor.
+	//!  Each pixel consists of an object ID and a triangle index. Pixels closer to the cursor carry more weight.
+	std::string identify( const GLuint *pixels, int width, int height ) const;
+	//! shoots a ray through the cursor and finds the nearest triangle it hits, without using the GPU
+	std::string pickRay( const ivec2 &position ) const;
+	//! requests the IDs of all objects inside the rectangle or lasso that is being dragged
+	void select();
+	//! lists the objects that were found by the most recent selection
+	std::string describeSelection() const;
+	//! loads an OBJ file, writes it to a much faster binary file and loads the mesh.
+	//!  Also loads or builds the hierarchy that is used for picking on the CPU.
+	void loadMesh( const std::string &objFile, const std::string &meshFile, gl::BatchRef &mesh, TriangleBvh &bvh );
 	//! loads the shaders
 	void loadShaders();
 	//! draws a grid on the floor
 	void drawGrid( float size = 100.0f, float step = 10.0f );
 
-  public:
-	// utility functions to translate colors to and from ints or chars
-	static Color charToColor( unsigned char r, unsigned char g, unsigned char b ) { return Color( r / 255.0f, g / 255.0f, b / 255.0f ); };
-
-	static unsigned int charToInt( unsigned char r, unsigned char g, unsigned char b ) { return b + ( g << 8 ) + ( r << 16 ); };
-
-	static Color intToColor( unsigned int i )
-	{
-		unsigned char r = ( i >> 16 ) & 0xFF;
-		unsigned char g = ( i >> 8 ) & 0xFF;
-		unsigned char b = ( i >> 0 ) & 0xFF;
-		return Color( r / 255.0f, g / 255.0f, b / 255.0f );
-	};
-
-	static unsigned int colorToInt( const Color &color )
-	{
-		unsigned char r = (unsigned char)( color.r * 255 );
-		unsigned char g = (unsigned char)( color.g * 255 );
-		unsigned char b = (unsigned char)( color.b * 255 );
-		return b + ( g << 8 ) + ( r << 16 );
-	};
-
   protected:
 	//! our camera
 	CameraPersp mCamera;
 	CameraUi    mCameraUi;
 
-	//! mesh and picking color of the pitcher object
+	//! mesh, object ID, triangle hierarchy and transform of the pitcher object
 	gl::BatchRef mMeshPitcher;
-	Color        mColorPitcher;
+	uint32_t     mIdPitcher;
+	TriangleBvh  mBvhPitcher;
+	mat4         mTransformPitcher;
 
-	//! mesh and picking color of the watering can object
+	//! mesh, object ID, triangle hierarchy and transform of the watering can object
 	gl::BatchRef mMeshCan;
-	Color        mColorCan;
+	uint32_t     mIdCan;
+	TriangleBvh  mBvhCan;
+	mat4         mTransformCan;
+
+	//! keeps track of which object owns which IDs
+	ObjectRegistry mRegistry;
 
 	//! our Phong shader, which supports multiple targets
 	gl::GlslProgRef mPhongShader;
+	//! displays the object ID buffer
+	gl::GlslProgRef mIdShader;
 
-	//! our main framebuffer (AA, containing 2 color buffers)
+	//! our main framebuffer (containing a color buffer and an integer object ID buffer)
 	gl::FboRef mFbo;
 	//! our little picking framebuffer (non-AA)
 	gl::FboRef mPickingFbo;
 
+	//! maximum width and height of the picking region. Larger regions are useful for touch input.
+	static const int kMaxPickingRegionSize = 64;
+	//! width and height of the picking region in pixels
+	int mPickingRegionSize;
+	//! pixels of the picking region, for the synchronous readback
+	std::vector<GLuint> mPickingPixels;
+
+	//! if true, objects are picked on the CPU by intersecting a ray with their triangles.
+	//!  This needs no second color target or readback, so it also works without a (capable) GPU.
+	bool mPickingCpu;
+
+	//! number of pixel buffers used for asynchronous picking
+	static const int kNumPickingBuffers = 3;
+
+	//! if true, the picking framebuffer is read into a pixel buffer and the result
+	//!  is read back a frame or two later, once a fence tells us the GPU is done with it.
+	//!  If false, glReadPixels waits until the GPU has finished rendering the current frame.
+	bool mPickingAsync;
+	//! pixel buffers, fences and the frame at which each readback was requested
+	gl::PboRef mPickingPbo[kNumPickingBuffers];
+	GLsync     mPickingSync[kNumPickingBuffers];
+	uint32_t   mPickingFrame[kNumPickingBuffers];
+	int        mPickingReadIndex;
+	int        mPickingWriteIndex;
+	//! most recent picking result
+	std::string mPickingResult;
+	//! average time spent in the pick() function in milliseconds and latency of the last result in frames
+	double   mPickingTime;
+	uint32_t mPickingLatency;
+
+	//! finds the objects inside a rectangle or lasso on the GPU
+	AreaSelector mSelector;
+	//! if true, a rectangle (shift) or lasso (control) is being dragged
+	bool mIsSelecting;
+	bool mIsSelectingLasso;
+	//! corners of the rectangle or points of the lasso, in window coordinates
+	std::vector<vec2> mSelection;
+	//! objects found by the most recent selection
+	std::string mSelectionResult;
+
 	//! keeping track of our cursor position
 	ivec2 mMousePos;
 
@@ -147,24 +208,36 @@ void PickingByColorApp::setup()
 	loadShaders();
 
 	// load meshes
-	loadMesh( "models/pitcher.obj", "models/pitcher.msh", mMeshPitcher );
-	loadMesh( "models/watering_can.obj", "models/watering_can.msh", mMeshCan );
+	loadMesh( "models/pitcher.obj", "models/pitcher.mesh", mMeshPitcher, mBvhPitcher );
+	loadMesh( "models/watering_can.obj", "models/watering_can.mesh", mMeshCan, mBvhCan );
+
+	// position the objects
+	mTransformPitcher = glm::translate( mat4(), vec3( 10.0f, 0.0f, 0.0f ) );
+	mTransformCan = glm::translate( mat4(), vec3( -10.0f, 0.0f, 0.0f ) );
 
-	// each object should have a unique picking color.
-	// To make sure the colors are pickable, you should use
-	// the intToColor() and colorToInt() functions.
-	mColorPitcher = intToColor( 0x0000FF ); // blue
-	mColorCan = intToColor( 0x00FF00 );     // green
+	// each object should have a unique ID. An instanced mesh
+	//  reserves an ID for each of its instances.
+	mIdPitcher = mRegistry.add( "Pitcher" );
+	mIdCan = mRegistry.add( "Watering Can" );
 
 	// load font
 	mFont = Font( loadAsset( "font/b2sq.ttf" ), 32 );
 
 	// set background color
 	mColorBackground = Color( 0.1f, 0.1f, 0.1f );
+
+	// no readbacks are pending yet
+	for( auto &sync : mPickingSync )
+		sync = nullptr;
 }
 
 void PickingByColorApp::shutdown()
 {
+	for( auto &sync : mPickingSync ) {
+		if( sync )
+			glDeleteSync( sync );
+		sync = nullptr;
+	}
 }
 
 void PickingByColorApp::update()
@@ -183,20 +256,62 @@ void PickingByColorApp::draw()
 	gl::ScopedColor color( Color::white() );
 	gl::draw( mFbo->getTexture2d( GL_COLOR_ATTACHMENT0 ), getWindowBounds() );
 
-	// draw the color coded scene in the upper left corner
-	gl::draw( mFbo->getTexture2d( GL_COLOR_ATTACHMENT1 ), Rectf( getWindowBounds() ) * 0.2f );
+	// draw the object IDs in the upper left corner and the picking framebuffer in the upper right corner.
+	//  Integer textures can not be drawn directly, so we use a shader that turns the IDs into colors.
+	if( mIdShader ) {
+		gl::ScopedGlslProg shader( mIdShader );
+
+		gl::ScopedTextureBind tex( mFbo->getTexture2d( GL_COLOR_ATTACHMENT1 ) );
+		gl::drawSolidRect( Rectf( getWindowBounds() ) * 0.2f );
 
-	// draw the picking framebuffer in the upper right corner
-	if( mPickingFbo ) {
-		Rectf rct = (Rectf)mPickingFbo->getBounds() * 5.0f;
-		rct.offset( vec2( (float)getWindowWidth() - rct.getWidth(), 0 ) );
-		gl::draw( mPickingFbo->getColorTexture(), rct );
+		if( mPickingFbo ) {
+			Rectf rct = (Rectf)mPickingFbo->getBounds() * 5.0f;
+			rct.offset( vec2( (float)getWindowWidth() - rct.getWidth(), 0 ) );
+
+			gl::ScopedTextureBind tex( mPickingFbo->getColorTexture() );
+			gl::drawSolidRect( rct );
+		}
+	}
+
+	// select the objects inside the rectangle or lasso while it is being dragged. The result
+	//  of a selection becomes available a few frames later and is kept until the next one.
+	if( mIsSelecting )
+		select();
+
+	if( mSelector.update() )
+		mSelectionResult = describeSelection();
+
+	if( mIsSelecting ) {
+		gl::ScopedColor color( Color( 1.0f, 0.8f, 0.2f ) );
+
+		if( mIsSelectingLasso ) {
+			gl::VertBatch lasso( GL_LINE_LOOP );
+			for( const auto &point : mSelection )
+				lasso.vertex( point );
+			lasso.draw();
+		}
+		else
+			gl::drawStrokedRect( Rectf( mSelection[0], mSelection[1] ) );
 	}
 
 	// perform picking and display the results
 	//  (alternatively you can do it in the 'mouseMove' or 'mouseDown' function)
 	gl::ScopedBlendAlpha blend;
 	gl::drawStringCentered( pick( mMousePos ), vec2( 0.5f * getWindowWidth(), getWindowHeight() - 50.0f ), Color::white(), mFont );
+
+	// display the cost of picking, so we can compare both methods
+	std::stringstream str;
+	str << ( mPickingCpu ? "CPU ray" : ( mPickingAsync ? "Asynchronous readback" : "Synchronous readback" ) ) << ": " << std::fixed << std::setprecision( 3 ) << mPickingTime << " ms per frame, "
+	    << mPickingLatency << " frame(s) latency, " << mPickingRegionSize << "x" << mPickingRegionSize << " pixels. Press A to toggle, C for CPU, +/- to resize.";
+	gl::drawString( str.str(), vec2( 10.0f, getWindowHeight() - 20.0f ), Color::gray( 0.75f ) );
+
+	// display the selection and the amount of data that is read back for it
+	std::stringstream sel;
+	sel << "Shift+drag to select a rectangle, Ctrl+drag to select a lasso";
+	if( mSelector.getReadbackSize() > 0 )
+		sel << " (" << mSelector.getReadbackSize() << " bytes read back per selection)";
+	gl::drawStringCentered( mSelectionResult, vec2( 0.5f * getWindowWidth(), 10.0f ), Color::white() );
+	gl::drawStringCentered( sel.str(), vec2( 0.5f * getWindowWidth(), 28.0f ), Color::gray( 0.75f ) );
 }
 
 void PickingByColorApp::mouseMove( MouseEvent event )
@@ -206,6 +321,19 @@ void PickingByColorApp::mouseMove( MouseEvent event )
 
 void PickingByColorApp::mouseDown( MouseEvent event )
 {
+	// start a selection if shift or control is down
+	if( event.isLeftDown() && ( event.isShiftDown() || event.isControlDown() ) ) {
+		mIsSelecting = true;
+		mIsSelectingLasso = event.isControlDown();
+
+		mSelection.clear();
+		mSelection.push_back( vec2( event.getPos() ) );
+		if( !mIsSelectingLasso )
+			mSelection.push_back( vec2( event.getPos() ) );
+
+		return;
+	}
+
 	// handle the camera
 	mCameraUi.mouseDown( event.getPos() );
 }
@@ -214,12 +342,27 @@ void PickingByColorApp::mouseDrag( MouseEvent event )
 {
 	mMousePos = event.getPos();
 
+	// extend the selection. The lasso only needs a new point if the cursor has moved far enough.
+	if( mIsSelecting ) {
+		if( !mIsSelectingLasso )
+			mSelection[1] = vec2( event.getPos() );
+		else if( glm::distance( mSelection.back(), vec2( event.getPos() ) ) > 2.0f )
+			mSelection.push_back( vec2( event.getPos() ) );
+
+		return;
+	}
+
 	// move the camera
 	mCameraUi.mouseDrag( event.getPos(), event.isLeftDown(), event.isMiddleDown(), event.isRightDown() );
 }
 
 void PickingByColorApp::mouseUp( MouseEvent event )
 {
+	// request the final selection, in case the cursor moved after the last frame was drawn
+	if( mIsSelecting )
+		select();
+
+	mIsSelecting = false;
 }
 
 void PickingByColorApp::keyDown( KeyEvent event )
@@ -228,6 +371,21 @@ void PickingByColorApp::keyDown( KeyEvent event )
 	case KeyEvent::KEY_ESCAPE:
 		quit();
 		break;
+	case KeyEvent::KEY_a:
+		mPickingAsync = !mPickingAsync;
+		break;
+	case KeyEvent::KEY_c:
+		mPickingCpu = !mPickingCpu;
+		break;
+	case KeyEvent::KEY_PLUS:
+	case KeyEvent::KEY_EQUALS:
+	case KeyEvent::KEY_KP_PLUS:
+		mPickingRegionSize = math<int>::min( mPickingRegionSize * 2, kMaxPickingRegionSize );
+		break;
+	case KeyEvent::KEY_MINUS:
+	case KeyEvent::KEY_KP_MINUS:
+		mPickingRegionSize = math<int>::max( mPickingRegionSize / 2, 2 );
+		break;
 	case KeyEvent::KEY_f:
 		setFullScreen( !isFullScreen() );
 		break;
@@ -252,14 +410,21 @@ void PickingByColorApp::resize()
 
 		// we create multiple color targets:
 		//  -one for the scene as we will view it
-		//  -one to contain a color coded version of the scene that we can use for picking
-		// fmt.enableColorBuffer( true, 2 );
+		//  -one to contain the object ID and triangle index of each pixel, that we can use for picking
 		gl::Texture2d::Format tfmt;
 		tfmt.setInternalFormat( GL_RGBA );
 
 		gl::Texture2dRef tex0 = gl::Texture2d::create( w, h, tfmt );
 		fmt.attachment( GL_COLOR_ATTACHMENT0, tex0 );
-		gl::Texture2dRef tex1 = gl::Texture2d::create( w, h, tfmt );
+
+		// integer textures can not be filtered
+		gl::Texture2d::Format ifmt;
+		ifmt.setInternalFormat( GL_RG32UI );
+		ifmt.setDataType( GL_UNSIGNED_INT );
+		ifmt.setMinFilter( GL_NEAREST );
+		ifmt.setMagFilter( GL_NEAREST );
+
+		gl::Texture2dRef tex1 = gl::Texture2d::create( w, h, ifmt );
 		fmt.attachment( GL_COLOR_ATTACHMENT1, tex1 );
 
 		// this sample does not work if the fbo uses multi-sampling
@@ -274,8 +439,13 @@ void PickingByColorApp::resize()
 
 void PickingByColorApp::render()
 {
-	// clear background
-	gl::clear( mColorBackground );
+	// clear background. The object ID buffer has to be cleared separately,
+	//  because it is an integer buffer. ID 0 means there is no object.
+	const GLfloat background[] = { mColorBackground.r, mColorBackground.g, mColorBackground.b, 1.0f };
+	const GLuint  none[] = { 0, 0, 0, 0 };
+	glClearBufferfv( GL_COLOR, 0, background );
+	glClearBufferuiv( GL_COLOR, 1, none );
+	gl::clear( GL_DEPTH_BUFFER_BIT );
 
 	// specify the camera matrices
 	gl::pushMatrices();
@@ -284,8 +454,16 @@ void PickingByColorApp::render()
 	// specify render states
 	gl::ScopedDepth depth( true, true );
 
-	// draw a grid on the floor
-	drawGrid();
+	// draw a grid on the floor. It has no object ID, so only draw it to the first target
+	{
+		const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_NONE };
+		glDrawBuffers( 2, buffers );
+
+		drawGrid();
+
+		const GLenum all[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers( 2, all );
+	}
 
 	// draw meshes:
 	// -bind phong shader, which renders to both our color targets.
@@ -294,24 +472,24 @@ void PickingByColorApp::render()
 
 	// -draw pitcher
 	{
-		// -each mesh should have a unique picking color that we can use to
+		// -each mesh should have a unique object ID that we can use to
 		//  find out which object is under the cursor.
-		mPhongShader->uniform( "pickingColor", mColorPitcher );
+		mPhongShader->uniform( "uObjectId", mIdPitcher );
 
 		gl::ScopedColor color( 0.45f, 0.45f, 0.5f );
 		gl::pushModelMatrix();
-		gl::translate( 10.0f, 0.0f, 0.0f );
+		gl::multModelMatrix( mTransformPitcher );
 		mMeshPitcher->draw();
 		gl::popModelMatrix();
 	}
 
 	// -draw can
 	{
-		mPhongShader->uniform( "pickingColor", mColorCan );
+		mPhongShader->uniform( "uObjectId", mIdCan );
 
 		gl::color( 0.40f, 0.60f, 0.50f );
 		gl::pushModelMatrix();
-		gl::translate( -10.0f, 0.0f, 0.0f );
+		gl::multModelMatrix( mTransformCan );
 		mMeshCan->draw();
 		gl::popModelMatrix();
 	}
@@ -324,7 +502,19 @@ std::string PickingByColorApp::pick( const ivec2 &position )
 {
 	// this is the main section of the demo:
 	//  here we sample the second color target to find out
-	//  which color is under the cursor.
+	//  which object is under the cursor.
+
+	// measure how long picking takes, including any stalls
+	Timer timer( true );
+
+	// picking on the CPU does not need the framebuffer at all
+	if( mPickingCpu ) {
+		mPickingResult = pickRay( position );
+		mPickingLatency = 0;
+		mPickingTime = glm::mix( mPickingTime, 1000.0 * timer.getSeconds(), 0.05 );
+
+		return mPickingResult;
+	}
 
 	// prevent errors if framebuffer does not exist
 	if( !mFbo )
@@ -334,7 +524,21 @@ std::string PickingByColorApp::pick( const ivec2 &position )
 	float scaleX = mFbo->getWidth() / (float)getWindowWidth();
 	float scaleY = mFbo->getHeight() / (float)getWindowHeight();
 	ivec2 pixel( (int)( position.x * scaleX ), (int)( ( getWindowHeight() - position.y ) * scaleY ) );
-	Area  area( pixel.x - 5, pixel.y - 5, pixel.x + 5, pixel.y + 5 );
+	Area  area( pixel - ivec2( mPickingRegionSize / 2 ), pixel - ivec2( mPickingRegionSize / 2 ) + ivec2( mPickingRegionSize ) );
+
+	// if the size of the region has changed, discard the picking framebuffer and any pending readbacks
+	if( mPickingFbo && mPickingFbo->getSize() != area.getSize() ) {
+		mPickingFbo.reset();
+
+		for( int i = 0; i < kNumPickingBuffers; ++i ) {
+			if( mPickingSync[i] )
+				glDeleteSync( mPickingSync[i] );
+			mPickingSync[i] = nullptr;
+			mPickingPbo[i].reset();
+		}
+
+		mPickingReadIndex = mPickingWriteIndex = 0;
+	}
 
 	// next, we need to copy this region to a non-anti-aliased framebuffer
 	//  because sadly we can not sample colors from an anti-aliased one. However,
@@ -347,10 +551,12 @@ std::string PickingByColorApp::pick( const ivec2 &position )
 		fmt.setSamples( 0 );
 		fmt.setCoverageSamples( 0 );
 
-		// you can omit these lines if you don't intent to display the picking framebuffer
+		// the picking framebuffer has the same integer format as the object ID buffer
 		gl::Texture2d::Format tfmt;
+		tfmt.setInternalFormat( GL_RG32UI );
+		tfmt.setDataType( GL_UNSIGNED_INT );
 		tfmt.setMagFilter( GL_NEAREST );
-		tfmt.setMinFilter( GL_LINEAR );
+		tfmt.setMinFilter( GL_NEAREST );
 
 		fmt.setColorTextureFormat( tfmt );
 
@@ -366,96 +572,346 @@ std::string PickingByColorApp::pick( const ivec2 &position )
 
 	mFbo->blitTo( mPickingFbo, area, mPickingFbo->getBounds() );
 
-	// bind the picking framebuffer, so we can read its pixels
-	mPickingFbo->bindFramebuffer();
+	const int    width = mPickingFbo->getWidth();
+	const int    height = mPickingFbo->getHeight();
+	const size_t total = size_t( width * height );
+
+	if( !mPickingAsync ) {
+		// bind the picking framebuffer, so we can read its pixels
+		mPickingFbo->bindFramebuffer();
+
+		// read pixel value(s) in the area. This stalls until the GPU has rendered the frame.
+		mPickingPixels.resize( total * 2 );
+
+		glReadBuffer( GL_COLOR_ATTACHMENT0_EXT );
+		glReadPixels( 0, 0, width, height, GL_RG_INTEGER, GL_UNSIGNED_INT, (void *)mPickingPixels.data() );
 
-	// read pixel value(s) in the area
-	GLubyte buffer[400]; // make sure this is large enough to hold 4 bytes for every pixel!
+		// unbind the picking framebuffer
+		mPickingFbo->unbindFramebuffer();
 
-	glReadBuffer( GL_COLOR_ATTACHMENT0_EXT );
-	glReadPixels( 0, 0, mPickingFbo->getWidth(), mPickingFbo->getHeight(), GL_RGBA, GL_UNSIGNED_BYTE, (void *)buffer );
+		mPickingResult = identify( mPickingPixels.data(), width, height );
+		mPickingLatency = 0;
+	}
+	else {
+		// process all readbacks that have completed, oldest first, without waiting for the GPU
+		while( mPickingSync[mPickingReadIndex] ) {
+			const int index = mPickingReadIndex;
+
+			GLenum status = glClientWaitSync( mPickingSync[index], GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+			if( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED )
+				break;
+
+			glDeleteSync( mPickingSync[index] );
+			mPickingSync[index] = nullptr;
+			mPickingReadIndex = ( index + 1 ) % kNumPickingBuffers;
+
+			gl::ScopedBuffer pbo( mPickingPbo[index] );
+
+			auto pixels = (const GLuint *)mPickingPbo[index]->map( GL_READ_ONLY );
+			if( pixels )
+				mPickingResult = identify( pixels, width, height );
+			mPickingPbo[index]->unmap();
+
+			mPickingLatency = getElapsedFrames() - mPickingFrame[index];
+		}
 
-	// unbind the picking framebuffer
-	mPickingFbo->unbindFramebuffer();
+		// request a readback of the current frame, unless all pixel buffers are still in use
+		if( !mPickingSync[mPickingWriteIndex] ) {
+			const int index = mPickingWriteIndex;
+			mPickingWriteIndex = ( index + 1 ) % kNumPickingBuffers;
 
-	// calculate the total number of pixels
-	unsigned int total = ( mPickingFbo->getWidth() * mPickingFbo->getHeight() );
+			if( !mPickingPbo[index] )
+				mPickingPbo[index] = gl::Pbo::create( GL_PIXEL_PACK_BUFFER, total * 2 * sizeof( GLuint ), nullptr, GL_STREAM_READ );
 
-	// now that we have the color information, count each occuring color
-	unsigned int color;
+			gl::ScopedBuffer pbo( mPickingPbo[index] );
+			mPickingFbo->bindFramebuffer();
 
-	std::map<unsigned int, unsigned int> occurences;
-	for( size_t i = 0; i < total; ++i ) {
-		color = charToInt( buffer[( i * 4 ) + 0], buffer[( i * 4 ) + 1], buffer[( i * 4 ) + 2] );
-		occurences[color]++;
+			// with a pixel buffer bound, glReadPixels returns immediately and copies the pixels in the background
+			glReadBuffer( GL_COLOR_ATTACHMENT0_EXT );
+			glReadPixels( 0, 0, width, height, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr );
+
+			mPickingFbo->unbindFramebuffer();
+
+			mPickingSync[index] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+			mPickingFrame[index] = getElapsedFrames();
+		}
 	}
 
-	// find the most occuring color by calling std::max_element using a custom comparator.
-	unsigned int max = 0;
+	// keep track of the average time spent picking
+	mPickingTime = glm::mix( mPickingTime, 1000.0 * timer.getSeconds(), 0.05 );
 
-	auto itr = std::max_element( occurences.begin(), occurences.end(), []( const std::pair<unsigned int, unsigned int> &a, const std::pair<unsigned int, unsigned int> &b ) { return a.second < b.second; } );
+	return mPickingResult;
+}
 
-	if( itr != occurences.end() ) {
-		color = itr->first;
-		max = itr->second;
+std::string PickingByColorApp::identify( const GLuint *pixels, int width, int height ) const
+{
+	// pixels near the cursor count more than those at the edge of the region. The falloff is separable,
+	//  so we only have to calculate it once for each column and row.
+	float columnWeights[kMaxPickingRegionSize];
+	for( int x = 0; x < width; ++x ) {
+		const float dx = ( x - 0.5f * ( width - 1 ) ) / width;
+		columnWeights[x] = 1.0f / ( 1.0f + 4.0f * dx * dx );
 	}
 
-	// if this color is present in at least 50% of the pixels,
+	float rowWeights[kMaxPickingRegionSize];
+	for( int y = 0; y < height; ++y ) {
+		const float dy = ( y - 0.5f * ( height - 1 ) ) / height;
+		rowWeights[y] = 1.0f / ( 1.0f + 4.0f * dy * dy );
+	}
+
+	// we only care about an ID that has at least half of the total weight. A weighted majority vote
+	//  (Boyer-Moore) would only find an ID with more than half, so we keep two candidates instead (Misra-Gries):
+	//  any ID with more than a third of the weight is guaranteed to be one of them. This needs no memory at all.
+	//  Neighboring pixels usually belong to the same object, so we vote with runs of equal IDs.
+	GLuint ids[2] = { 0, 0 };
+	float  counts[2] = { 0.0f, 0.0f };
+
+	for( int y = 0; y < height; ++y ) {
+		const GLuint *row = pixels + y * width * 2;
+
+		for( int x = 0; x < width; ) {
+			const GLuint run = row[x * 2];
+
+			float weight = 0.0f;
+			for( ; x < width && row[x * 2] == run; ++x )
+				weight += columnWeights[x];
+			weight *= rowWeights[y];
+
+			if( counts[0] > 0.0f && run == ids[0] )
+				counts[0] += weight;
+			else if( counts[1] > 0.0f && run == ids[1] )
+				counts[1] += weight;
+			else {
+				// take away the same weight from both candidates and this run. At least one of them drops to zero,
+				//  so if the run has weight left, it replaces that candidate.
+				const float common = math<float>::min( weight, math<float>::min( counts[0], counts[1] ) );
+				counts[0] -= common;
+				counts[1] -= common;
+				weight -= common;
+
+				if( weight > 0.0f ) {
+					const int i = ( counts[0] == 0.0f ) ? 0 : 1;
+					ids[i] = run;
+					counts[i] = weight;
+				}
+			}
+		}
+	}
+
+	// a second pass tells us the actual weight of both candidates
+	float candidates[2] = { 0.0f, 0.0f };
+	float totalWeight = 0.0f;
+
+	for( int y = 0; y < height; ++y ) {
+		const GLuint *row = pixels + y * width * 2;
+
+		float candidate[2] = { 0.0f, 0.0f };
+		float total = 0.0f;
+		for( int x = 0; x < width; ++x ) {
+			candidate[0] += ( row[x * 2] == ids[0] ) ? columnWeights[x] : 0.0f;
+			candidate[1] += ( row[x * 2] == ids[1] ) ? columnWeights[x] : 0.0f;
+			total += columnWeights[x];
+		}
+
+		candidates[0] += candidate[0] * rowWeights[y];
+		candidates[1] += candidate[1] * rowWeights[y];
+		totalWeight += total * rowWeights[y];
+	}
+
+	// if both candidates have exactly half of the weight, prefer the lowest ID, like a histogram would
+	const int    best = ( candidates[1] > candidates[0] || ( candidates[1] == candidates[0] && ids[1] < ids[0] ) ) ? 1 : 0;
+	const GLuint id = ids[best];
+	const float  max = candidates[best];
+
+	// if this ID has at least 50% of the weight,
 	//  we can safely assume that it is indeed belonging to one object
-	if( max >= ( total / 2 ) ) {
-		if( color == colorToInt( mColorCan ) )
-			return "Watering Can";
-		else if( color == colorToInt( mColorPitcher ) )
-			return "Pitcher";
-		else if( color == colorToInt( mColorBackground ) )
+	if( max >= 0.5f * totalWeight ) {
+		if( id == 0 )
 			return "Background";
-		else
+
+		uint32_t instance = 0;
+		auto     object = mRegistry.find( id, &instance );
+		if( !object )
 			return "Nothing";
+
+		std::stringstream str;
+		str << object->mName;
+		if( object->mCount > 1 )
+			str << " #" << instance;
+
+		// the triangle index is only meaningful if the object is directly under the cursor
+		const size_t center = size_t( ( height / 2 ) * width + width / 2 );
+		if( pixels[center * 2] == id )
+			str << " (triangle " << pixels[center * 2 + 1] << ")";
+
+		return str.str();
 	}
 	else {
-		// we can't be sure about the color, we probably are on an object's edge
+		// we can't be sure about the object, we probably are on an object's edge
 		return "Uncertain";
 	}
 }
 
-void PickingByColorApp::loadMesh( const std::string &objFile, const std::string &meshFile, gl::BatchRef &mesh )
+std::string PickingByColorApp::pickRay( const ivec2 &position ) const
 {
-	TriMeshRef triMesh;
+	// create a ray from the camera through the cursor
+	const float u = position.x / (float)getWindowWidth();
+	const float v = 1.0f - position.y / (float)getWindowHeight();
+	const Ray   ray = mCamera.generateRay( u, v, mCamera.getAspectRatio() );
+
+	std::string result = "Background";
+	float       nearest = FLT_MAX;
+
+	// intersect the ray with each object in its own coordinate space. The direction is not normalized
+	//  after the transformation, so that the distances of all objects can still be compared.
+	auto intersect = [&]( const TriangleBvh &bvh, const mat4 &transform, uint32_t id ) {
+		const mat4 inverse = glm::inverse( transform );
+		const Ray  local( vec3( inverse * vec4( ray.getOrigin(), 1.0f ) ), vec3( inverse * vec4( ray.getDirection(), 0.0f ) ) );
+
+		float    distance;
+		uint32_t triangle;
+		if( !bvh.intersect( local, &distance, &triangle ) || distance >= nearest )
+			return;
+
+		nearest = distance;
+
+		std::stringstream str;
+		str << mRegistry.find( id )->mName << " (triangle " << triangle << ")";
+		result = str.str();
+	};
+
+	intersect( mBvhPitcher, mTransformPitcher, mIdPitcher );
+	intersect( mBvhCan, mTransformCan, mIdCan );
+
+	return result;
+}
+
+void PickingByColorApp::select()
+{
+	if( !mFbo || mSelection.empty() )
+		return;
+
+	// the selection is specified in window coordinates, but the object ID buffer has its origin in the lower left corner
+	const vec2 scale( mFbo->getWidth() / (float)getWindowWidth(), mFbo->getHeight() / (float)getWindowHeight() );
+
+	std::vector<vec2> points;
+	points.reserve( mSelection.size() );
+	for( const auto &point : mSelection )
+		points.push_back( vec2( point.x * scale.x, ( getWindowHeight() - point.y ) * scale.y ) );
+
+	auto ids = mFbo->getTexture2d( GL_COLOR_ATTACHMENT1 );
+	if( mIsSelectingLasso )
+		mSelector.select( ids, points, mRegistry.getNumIds() );
+	else
+		mSelector.select( ids, Area( ivec2( points[0] ), ivec2( points[1] ) ), mRegistry.getNumIds() );
+}
+
+std::string PickingByColorApp::describeSelection() const
+{
+	const auto &ids = mSelector.getIds();
+	if( ids.empty() )
+		return "Nothing selected";
+
+	// the IDs are sorted, so the instances of each object are next to each other
+	std::stringstream str;
+	str << "Selected: ";
+
+	const ObjectRegistry::Object *object = nullptr;
+	uint32_t                      count = 0;
+	bool                          isFirst = true;
+
+	auto append = [&]() {
+		if( !object )
+			return;
+
+		str << ( isFirst ? "" : ", " ) << object->mName;
+		if( object->mCount > 1 )
+			str << " (" << count << " of " << object->mCount << ")";
+
+		isFirst = false;
+	};
+
+	for( uint32_t id : ids ) {
+		auto found = mRegistry.find( id );
+		if( found != object ) {
+			append();
+			object = found;
+			count = 0;
+		}
+
+		++count;
+	}
+
+	append();
+
+	return str.str();
+}
+
+void PickingByColorApp::loadMesh( const std::string &objFile, const std::string &meshFile, gl::BatchRef &mesh, TriangleBvh &bvh )
+{
+	MeshFileRef file;
 
 	try {
-		// try to load a binary mesh file - sadly the following line does not work:
-		// mMesh.read( loadAsset(meshfile) );
+		// load the binary mesh file. If it does not exist yet or is out of date, the OBJ file is parsed
+		//  (on multiple threads) and written to a binary mesh file for future use. The binary file is
+		//  memory-mapped, so the vertices are copied straight to the GPU without parsing them.
+		file = MeshFile::load( getAssetPath( objFile ), getAssetPath( "" ) / meshFile );
+		mesh = gl::Batch::create( file->createVboMesh(), mPhongShader );
+	}
+	catch( const std::exception &e ) {
+		console() << e.what() << std::endl;
+		return;
+	}
 
-		// note: instead of throwing an exception, Cinder crashes if the
-		//   file does not exist. Hopefully this will be changed in future versions.
-		DataSourceRef file = loadAsset( meshFile );
-		if( !file->createStream() )
-			throw std::exception();
+	// building the triangle hierarchy takes a while, so it is cached next to the binary mesh file.
+	//  If the cache does not exist, is older than the mesh or does not match it, it is rebuilt.
+	const fs::path bvhFile = fs::path( meshFile ).replace_extension( ".bvh" );
+	const fs::path bvhPath = getAssetPath( "" ) / bvhFile;
 
-		triMesh = TriMesh::create();
-		triMesh->read( file );
+	bool isCached = false;
+	try {
+		if( fs::exists( bvhPath ) && fs::last_write_time( bvhPath ) >= fs::last_write_time( getAssetPath( "" ) / meshFile ) )
+			isCached = bvh.read( loadFile( bvhPath ), file->getNumVertices(), file->getNumTriangles() );
 	}
 	catch( ... ) {
-		// if it failed or didn't exist, load an obj file...
-		DataSourceRef file = loadAsset( objFile );
-		if( file->createStream() ) {
-			ObjLoader loader( file );
-			// ...create a mesh...
-			triMesh = TriMesh::create( loader );
-			// ...and write it to a binary mesh file for future use
-			triMesh->write( writeFile( getAssetPath( "" ) / meshFile ) );
-		}
 	}
 
-	if( triMesh ) {
-		mesh = gl::Batch::create( *triMesh, mPhongShader );
+	if( !isCached ) {
+		bvh.build( file->getPositions(), file->getNumVertices(), file->getIndices(), file->getNumTriangles() );
+
+		try {
+			bvh.write( writeFile( bvhPath ) );
+		}
+		catch( const std::exception &e ) {
+			console() << e.what() << std::endl;
+		}
 	}
 }
 
 void PickingByColorApp::loadShaders()
 {
 	try {
-		mPhongShader = gl::GlslProg::create( loadAsset( "shaders/phong.vert" ), loadAsset( "shaders/phong.frag" ) );
+		// the color goes to the first target, the object ID to the second
+		auto fmt = gl::GlslProg::Format().vertex( loadAsset( "shaders/phong.vert" ) ).fragment( loadAsset( "shaders/phong.frag" ) ).fragDataLocation( 0, "oColor" ).fragDataLocation( 1, "oObjectId" );
+		mPhongShader = gl::GlslProg::create( fmt );
+	}
+	catch( const std::exception &e ) {
+		console() << e.what() << std::endl;
+	}
+
+	try {
+		mIdShader = gl::GlslProg::create( loadAsset( "shaders/ids.vert" ), loadAsset( "shaders/ids.frag" ) );
+		mIdShader->uniform( "uObjectIds", 0 );
+	}
+	catch( const std::exception &e ) {
+		console() << e.what() << std::endl;
+	}
+
+	try {
+		// both passes write unsigned integers, which are combined with a logical operation
+		auto mask = gl::GlslProg::Format().vertex( loadAsset( "shaders/mask.vert" ) ).fragment( loadAsset( "shaders/mask.frag" ) ).fragDataLocation( 0, "oMask" );
+		auto mark = gl::GlslProg::Format().vertex( loadAsset( "shaders/select.vert" ) ).fragment( loadAsset( "shaders/select.frag" ) ).fragDataLocation( 0, "oBits" );
+		mSelector.setShaders( gl::GlslProg::create( mask ), gl::GlslProg::create( mark ) );
 	}
 	catch( const std::exception &e ) {
 		console() << e.what() << std::endl;
@@ -0,0 +1,495 @@
+/*
+ Copyright (c) 2010-2016, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TriangleBvh.h"
+
+#include "cinder/Stream.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#include <xmmintrin.h>
+#define TRIANGLE_BVH_USE_SSE 1
+#endif
+
+using namespace ci;
+
+namespace {
+
+//! number of bins used to evaluate the surface area heuristic along each axis
+const int kNumBins = 16;
+//! leaves with more triangles than this are always split
+const uint32_t kMaxLeafSize = 16;
+//! beyond this depth, nodes are split in half, so that traversal never runs out of stack
+const uint32_t kMaxDepth = 48;
+//! halving at most 2^32 triangles adds fewer than 32 levels, and traversal needs one stack entry per level plus one
+const uint32_t kMaxStackSize = kMaxDepth + 32;
+//! cost of visiting a node, relative to testing a group of four triangles
+const float kTraversalCost = 1.0f;
+
+//! identifies the cache file and its version. Increase the version whenever the layout changes.
+const char     kMagic[4] = { 'T', 'B', 'V', 'H' };
+const uint32_t kVersion = 1;
+
+struct FileHeader {
+	char     mMagic[4];
+	uint32_t mVersion;
+	uint32_t mNumVertices;
+	uint32_t mNumTriangles;
+	uint32_t mNumNodes;
+	uint32_t mNumGroups;
+};
+
+//! half the surface area of a box, which is all the heuristic needs
+inline float getArea( const vec3 &min, const vec3 &max )
+{
+	const vec3 d = glm::max( max - min, vec3( 0.0f ) );
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+//! number of groups needed for \a count triangles
+inline uint32_t getGroupCount( uint32_t count )
+{
+	return ( count + 3 ) / 4;
+}
+
+} // anonymous namespace
+
+void TriangleBvh::build( const vec3 *positions, size_t numVertices, const uint32_t *indices, size_t numTriangles )
+{
+	clear();
+
+	if( numTriangles == 0 )
+		return;
+
+	mNumVertices = numVertices;
+	mNumTriangles = numTriangles;
+
+	std::vector<Primitive> primitives( numTriangles );
+	std::vector<uint32_t>  order( numTriangles );
+	for( size_t i = 0; i < numTriangles; ++i ) {
+		const vec3 &a = positions[indices[i * 3 + 0]];
+		const vec3 &b = positions[indices[i * 3 + 1]];
+		const vec3 &c = positions[indices[i * 3 + 2]];
+
+		primitives[i].mMin = glm::min( a, glm::min( b, c ) );
+		primitives[i].mMax = glm::max( a, glm::max( b, c ) );
+		primitives[i].mCentroid = ( a + b + c ) * ( 1.0f / 3.0f );
+		order[i] = uint32_t( i );
+	}
+
+	mNodes.reserve( 2 * numTriangles / 4 + 1 );
+	mNodes.resize( 1 );
+	buildNode( 0, 0, uint32_t( numTriangles ), 0, primitives, order );
+
+	// now that the order of the triangles is known, copy them to the groups of each leaf
+	for( auto &node : mNodes ) {
+		if( node.mCount == 0 )
+			continue;
+
+		const uint32_t first = node.mIndex;
+		const uint32_t count = node.mCount;
+
+		node.mIndex = uint32_t( mGroups.size() );
+		node.mCount = getGroupCount( count );
+
+		for( uint32_t i = 0; i < node.mCount * 4; ++i ) {
+			if( ( i & 3 ) == 0 ) {
+				mGroups.push_back( Group() );
+				std::memset( &mGroups.back(), 0, sizeof( Group ) );
+			}
+
+			Group         &group = mGroups.back();
+			const uint32_t slot = i & 3;
+
+			if( i >= count ) {
+				group.mTriangle[slot] = UINT32_MAX;
+				continue;
+			}
+
+			const uint32_t triangle = order[first + i];
+			const vec3    &a = positions[indices[triangle * 3 + 0]];
+			const vec3     e1 = positions[indices[triangle * 3 + 1]] - a;
+			const vec3     e2 = positions[indices[triangle * 3 + 2]] - a;
+
+			for( int k = 0; k < 3; ++k ) {
+				group.mV0[k][slot] = a[k];
+				group.mE1[k][slot] = e1[k];
+				group.mE2[k][slot] = e2[k];
+			}
+			group.mTriangle[slot] = triangle;
+		}
+	}
+}
+
+void TriangleBvh::buildNode( uint32_t index, uint32_t first, uint32_t count, uint32_t depth, const std::vector<Primitive> &primitives, std::vector<uint32_t> &order )
+{
+	// calculate the bounds of the triangles and of their centroids
+	vec3 min( FLT_MAX ), max( -FLT_MAX );
+	vec3 centroidMin( FLT_MAX ), centroidMax( -FLT_MAX );
+	for( uint32_t i = first; i < first + count; ++i ) {
+		const Primitive &primitive = primitives[order[i]];
+		min = glm::min( min, primitive.mMin );
+		max = glm::max( max, primitive.mMax );
+		centroidMin = glm::min( centroidMin, primitive.mCentroid );
+		centroidMax = glm::max( centroidMax, primitive.mCentroid );
+	}
+
+	for( int k = 0; k < 3; ++k ) {
+		mNodes[index].mMin[k] = min[k];
+		mNodes[index].mMax[k] = max[k];
+	}
+
+	// until the groups are created, leaves refer to a range of triangles
+	auto makeLeaf = [&]() {
+		mNodes[index].mIndex = first;
+		mNodes[index].mCount = count;
+	};
+
+	if( count <= 4 ) {
+		makeLeaf();
+		return;
+	}
+
+	// find the split with the lowest cost. A leaf costs a test for each group of four triangles,
+	//  so it does not pay off to split a node into children that have fewer than four triangles.
+	const float leafCost = getArea( min, max ) * getGroupCount( count );
+
+	float    bestCost = FLT_MAX;
+	int      bestAxis = -1;
+	int      bestBin = 0;
+	uint32_t mid = first + count / 2;
+
+	if( depth < kMaxDepth ) {
+		for( int axis = 0; axis < 3; ++axis ) {
+			const float extent = centroidMax[axis] - centroidMin[axis];
+			if( extent <= 0.0f )
+				continue;
+
+			const float scale = kNumBins / extent;
+
+			uint32_t binCounts[kNumBins] = {};
+			vec3     binMin[kNumBins], binMax[kNumBins];
+			for( int b = 0; b < kNumBins; ++b ) {
+				binMin[b] = vec3( FLT_MAX );
+				binMax[b] = vec3( -FLT_MAX );
+			}
+
+			for( uint32_t i = first; i < first + count; ++i ) {
+				const Primitive &primitive = primitives[order[i]];
+				const int        b = std::min( kNumBins - 1, int( ( primitive.mCentroid[axis] - centroidMin[axis] ) * scale ) );
+				binCounts[b]++;
+				binMin[b] = glm::min( binMin[b], primitive.mMin );
+				binMax[b] = glm::max( binMax[b], primitive.mMax );
+			}
+
+			// sweep from the right to find the cost of everything to the right of each split
+			float    rightCosts[kNumBins];
+			vec3     rightMin( FLT_MAX ), rightMax( -FLT_MAX );
+			uint32_t rightCount = 0;
+			for( int b = kNumBins - 1; b > 0; --b ) {
+				rightMin = glm::min( rightMin, binMin[b] );
+				rightMax = glm::max( rightMax, binMax[b] );
+				rightCount += binCounts[b];
+				rightCosts[b] = rightCount > 0 ? getArea( rightMin, rightMax ) * getGroupCount( rightCount ) : 0.0f;
+			}
+
+			// then sweep from the left and combine both
+			vec3     leftMin( FLT_MAX ), leftMax( -FLT_MAX );
+			uint32_t leftCount = 0;
+			for( int b = 0; b < kNumBins - 1; ++b ) {
+				leftMin = glm::min( leftMin, binMin[b] );
+				leftMax = glm::max( leftMax, binMax[b] );
+				leftCount += binCounts[b];
+				if( leftCount == 0 || leftCount == count )
+					continue;
+
+				const float cost = getArea( leftMin, leftMax ) * getGroupCount( leftCount ) + rightCosts[b + 1];
+				if( cost < bestCost ) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+	}
+
+	if( bestAxis >= 0 ) {
+		// stop splitting if that is cheaper, unless the leaf would become too large
+		if( kTraversalCost * getArea( min, max ) + bestCost >= leafCost && count <= kMaxLeafSize ) {
+			makeLeaf();
+			return;
+		}
+
+		const int   axis = bestAxis;
+		const float scale = kNumBins / ( centroidMax[axis] - centroidMin[axis] );
+
+		uint32_t *begin = order.data() + first;
+		uint32_t *split = std::partition( begin, begin + count, [&]( uint32_t i ) {
+			return std::min( kNumBins - 1, int( ( primitives[i].mCentroid[axis] - centroidMin[axis] ) * scale ) ) <= bestBin;
+		} );
+		mid = uint32_t( split - order.data() );
+	}
+	else {
+		// all centroids are in the same spot or the tree is getting too deep: split in half along the longest axis
+		const vec3 extents = centroidMax - centroidMin;
+		const int  axis = ( extents.x > extents.y && extents.x > extents.z ) ? 0 : ( extents.y > extents.z ? 1 : 2 );
+
+		uint32_t *begin = order.data() + first;
+		std::nth_element( begin, order.data() + mid, begin + count, [&]( uint32_t a, uint32_t b ) { return primitives[a].mCentroid[axis] < primitives[b].mCentroid[axis]; } );
+	}
+
+	// children are stored next to each other, after their parent
+	const uint32_t left = uint32_t( mNodes.size() );
+	mNodes[index].mIndex = left;
+	mNodes[index].mCount = 0;
+	mNodes.resize( mNodes.size() + 2 );
+
+	buildNode( left, first, mid - first, depth + 1, primitives, order );
+	buildNode( left + 1, mid, first + count - mid, depth + 1, primitives, order );
+}
+
+void TriangleBvh::clear()
+{
+	mNumVertices = 0;
+	mNumTriangles = 0;
+	mNodes.clear();
+	mGroups.clear();
+}
+
+bool TriangleBvh::read( const DataSourceRef &source, size_t numVertices, size_t numTriangles )
+{
+	clear();
+
+	try {
+		IStreamRef stream = source->createStream();
+		if( !stream )
+			return false;
+
+		FileHeader header;
+		stream->readData( &header, sizeof( header ) );
+
+		if( std::memcmp( header.mMagic, kMagic, sizeof( kMagic ) ) != 0 || header.mVersion != kVersion )
+			return false;
+		if( header.mNumVertices != numVertices || header.mNumTriangles != numTriangles || header.mNumNodes == 0 )
+			return false;
+
+		mNodes.resize( header.mNumNodes );
+		mGroups.resize( header.mNumGroups );
+		stream->readData( mNodes.data(), mNodes.size() * sizeof( Node ) );
+		stream->readData( mGroups.data(), mGroups.size() * sizeof( Group ) );
+
+		// make sure a damaged file can not make us read outside of our arrays, or overflow the traversal stack.
+		//  Children always come after their parent, so a single pass finds the depth of every node.
+		std::vector<uint32_t> depths( mNodes.size(), 0 );
+		for( size_t i = 0; i < mNodes.size(); ++i ) {
+			const Node &node = mNodes[i];
+			const bool  isValid = node.mCount > 0 ? ( size_t( node.mIndex ) + node.mCount <= mGroups.size() ) : ( node.mIndex > i && size_t( node.mIndex ) + 2 <= mNodes.size() && depths[i] + 2 <= kMaxStackSize );
+			if( !isValid ) {
+				clear();
+				return false;
+			}
+
+			if( node.mCount == 0 ) {
+				depths[node.mIndex] = std::max( depths[node.mIndex], depths[i] + 1 );
+				depths[node.mIndex + 1] = std::max( depths[node.mIndex + 1], depths[i] + 1 );
+			}
+		}
+
+		mNumVertices = numVertices;
+		mNumTriangles = numTriangles;
+
+		return true;
+	}
+	catch( ... ) {
+		clear();
+		return false;
+	}
+}
+
+void TriangleBvh::write( const DataTargetRef &target ) const
+{
+	FileHeader header;
+	std::memcpy( header.mMagic, kMagic, sizeof( kMagic ) );
+	header.mVersion = kVersion;
+	header.mNumVertices = uint32_t( mNumVertices );
+	header.mNumTriangles = uint32_t( mNumTriangles );
+	header.mNumNodes = uint32_t( mNodes.size() );
+	header.mNumGroups = uint32_t( mGroups.size() );
+
+	OStreamRef stream = target->getStream();
+	stream->writeData( &header, sizeof( header ) );
+	stream->writeData( mNodes.data(), mNodes.size() * sizeof( Node ) );
+	stream->writeData( mGroups.data(), mGroups.size() * sizeof( Group ) );
+}
+
+bool TriangleBvh::intersect( const Ray &ray, float *distance, uint32_t *triangle ) const
+{
+	if( mNodes.empty() )
+		return false;
+
+	const vec3 origin = ray.getOrigin();
+	const vec3 direction = ray.getDirection();
+	const vec3 invDirection = 1.0f / direction;
+
+	float    best = FLT_MAX;
+	uint32_t hit = UINT32_MAX;
+
+	// returns the distance at which the ray enters the node, or FLT_MAX if it misses or is further away than the best hit so far
+	auto enter = [&]( const Node &node ) {
+		float tmin = 0.0f, tmax = best;
+		for( int k = 0; k < 3; ++k ) {
+			float t0 = ( node.mMin[k] - origin[k] ) * invDirection[k];
+			float t1 = ( node.mMax[k] - origin[k] ) * invDirection[k];
+			if( t0 > t1 )
+				std::swap( t0, t1 );
+
+			tmin = std::max( tmin, t0 );
+			tmax = std::min( tmax, t1 );
+		}
+		return tmin <= tmax ? tmin : FLT_MAX;
+	};
+
+	if( enter( mNodes[0] ) == FLT_MAX )
+		return false;
+
+	uint32_t stack[kMaxStackSize];
+	int      size = 0;
+	stack[size++] = 0;
+
+#if TRIANGLE_BVH_USE_SSE
+	const __m128 ox = _mm_set1_ps( origin.x ), oy = _mm_set1_ps( origin.y ), oz = _mm_set1_ps( origin.z );
+	const __m128 dx = _mm_set1_ps( direction.x ), dy = _mm_set1_ps( direction.y ), dz = _mm_set1_ps( direction.z );
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps( 1.0f ), epsilon = _mm_set1_ps( 1e-12f );
+	const __m128 signMask = _mm_set1_ps( -0.0f );
+#endif
+
+	while( size > 0 ) {
+		const Node &node = mNodes[stack[--size]];
+
+		if( node.mCount > 0 ) {
+			for( uint32_t g = node.mIndex; g < node.mIndex + node.mCount; ++g ) {
+				const Group &group = mGroups[g];
+
+				// test all four triangles of the group at once (Moller-Trumbore)
+				float t[4];
+				int   mask = 0;
+
+#if TRIANGLE_BVH_USE_SSE
+				const __m128 e1x = _mm_loadu_ps( group.mE1[0] ), e1y = _mm_loadu_ps( group.mE1[1] ), e1z = _mm_loadu_ps( group.mE1[2] );
+				const __m128 e2x = _mm_loadu_ps( group.mE2[0] ), e2y = _mm_loadu_ps( group.mE2[1] ), e2z = _mm_loadu_ps( group.mE2[2] );
+
+				// p = direction x e2
+				const __m128 px = _mm_sub_ps( _mm_mul_ps( dy, e2z ), _mm_mul_ps( dz, e2y ) );
+				const __m128 py = _mm_sub_ps( _mm_mul_ps( dz, e2x ), _mm_mul_ps( dx, e2z ) );
+				const __m128 pz = _mm_sub_ps( _mm_mul_ps( dx, e2y ), _mm_mul_ps( dy, e2x ) );
+
+				const __m128 det = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e1x, px ), _mm_mul_ps( e1y, py ) ), _mm_mul_ps( e1z, pz ) );
+				const __m128 invDet = _mm_div_ps( one, det );
+
+				// s = origin - v0
+				const __m128 sx = _mm_sub_ps( ox, _mm_loadu_ps( group.mV0[0] ) );
+				const __m128 sy = _mm_sub_ps( oy, _mm_loadu_ps( group.mV0[1] ) );
+				const __m128 sz = _mm_sub_ps( oz, _mm_loadu_ps( group.mV0[2] ) );
+
+				const __m128 u = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( sx, px ), _mm_mul_ps( sy, py ) ), _mm_mul_ps( sz, pz ) ), invDet );
+
+				// q = s x e1
+				const __m128 qx = _mm_sub_ps( _mm_mul_ps( sy, e1z ), _mm_mul_ps( sz, e1y ) );
+				const __m128 qy = _mm_sub_ps( _mm_mul_ps( sz, e1x ), _mm_mul_ps( sx, e1z ) );
+				const __m128 qz = _mm_sub_ps( _mm_mul_ps( sx, e1y ), _mm_mul_ps( sy, e1x ) );
+
+				const __m128 v = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, qx ), _mm_mul_ps( dy, qy ) ), _mm_mul_ps( dz, qz ) ), invDet );
+				const __m128 vt = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( e2x, qx ), _mm_mul_ps( e2y, qy ) ), _mm_mul_ps( e2z, qz ) ), invDet );
+
+				// both sides of the triangle count, because the meshes are not necessarily closed
+				__m128 isHit = _mm_cmpgt_ps( _mm_andnot_ps( signMask, det ), epsilon );
+				isHit = _mm_and_ps( isHit, _mm_cmpge_ps( u, zero ) );
+				isHit = _mm_and_ps( isHit, _mm_cmpge_ps( v, zero ) );
+				isHit = _mm_and_ps( isHit, _mm_cmple_ps( _mm_add_ps( u, v ), one ) );
+				isHit = _mm_and_ps( isHit, _mm_cmpge_ps( vt, zero ) );
+				isHit = _mm_and_ps( isHit, _mm_cmplt_ps( vt, _mm_set1_ps( best ) ) );
+
+				mask = _mm_movemask_ps( isHit );
+				_mm_storeu_ps( t, vt );
+#else
+				for( int j = 0; j < 4; ++j ) {
+					const vec3 e1( group.mE1[0][j], group.mE1[1][j], group.mE1[2][j] );
+					const vec3 e2( group.mE2[0][j], group.mE2[1][j], group.mE2[2][j] );
+
+					const vec3  p = glm::cross( direction, e2 );
+					const float det = glm::dot( e1, p );
+					if( std::abs( det ) <= 1e-12f )
+						continue;
+
+					const float invDet = 1.0f / det;
+					const vec3  s = origin - vec3( group.mV0[0][j], group.mV0[1][j], group.mV0[2][j] );
+					const float u = glm::dot( s, p ) * invDet;
+					const vec3  q = glm::cross( s, e1 );
+					const float v = glm::dot( direction, q ) * invDet;
+
+					t[j] = glm::dot( e2, q ) * invDet;
+					if( u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t[j] >= 0.0f && t[j] < best )
+						mask |= 1 << j;
+				}
+#endif
+
+				for( int j = 0; mask != 0; ++j, mask >>= 1 ) {
+					if( ( mask & 1 ) && t[j] < best ) {
+						best = t[j];
+						hit = group.mTriangle[j];
+					}
+				}
+			}
+		}
+		else {
+			// visit the nearest child first, so that we can skip the other one more often
+			uint32_t first = node.mIndex;
+			uint32_t second = node.mIndex + 1;
+
+			float tFirst = enter( mNodes[first] );
+			float tSecond = enter( mNodes[second] );
+			if( tSecond < tFirst ) {
+				std::swap( first, second );
+				std::swap( tFirst, tSecond );
+			}
+
+			if( tSecond < FLT_MAX )
+				stack[size++] = second;
+			if( tFirst < FLT_MAX )
+				stack[size++] = first;
+		}
+	}
+
+	if( hit == UINT32_MAX )
+		return false;
+
+	if( distance )
+		*distance = best;
+	if( triangle )
+		*triangle = hit;
+
+	return true;
+}
@@ -0,0 +1,72 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "CpuFilter.h"
+
+#include <cstdint>
+#include <vector>
+
+// Applies SMAA 1x to a Surface on the CPU, so image sequences can be anti-aliased on machines without a GPU.
+// This is a port of the three passes in SMAA.glsl, with the same preset (ULTRA) and the same area and
+// search textures as the shaders, so the result matches SMAA::apply to within rounding. The scalar kernel
+// is the reference implementation.
+//
+// The rows of the image are divided into bands, which are processed by multiple threads. The luma edge
+// detection is done for 4 or 8 pixels at once by the SSE4.1 and AVX2 kernels. Each band keeps a list
+// of the pixels that are on an edge, so the expensive blending weight calculation only visits those.
+// Neighborhood blending skips pixels that have no blending weights, again 4 or 8 at a time.
+class SMAACpu : public CpuFilter {
+  public:
+	SMAACpu();
+	~SMAACpu() {}
+
+	// Applies SMAA to the source and writes the result to the destination. The destination should have the same
+	// size and channel order, and can not be the same surface.
+	void apply( ci::Surface8u &destination, const ci::Surface8u &source ) override;
+
+	// Copies the result of the first two passes of the last call to apply, like SMAA::getEdgePass()
+	// and SMAA::getBlendPass(). The destination should have the same size as the source.
+	void copyEdgePass( ci::Surface8u &destination ) const;
+	void copyBlendPass( ci::Surface8u &destination ) const;
+
+	// Same as SMAA_THRESHOLD in the shaders. Lower values detect more edges.
+	void setThreshold( float threshold ) { mThreshold = threshold; }
+
+	// Returns the number of pixels on an edge that were found by the last call to apply.
+	size_t getNumEdgePixels() const;
+
+  private:
+	float mThreshold;
+
+	int mWidth;
+	int mHeight;
+
+	// Like the textures that the shaders sample, the planes below store the bottom row first
+	std::vector<float>   mLuma;
+	std::vector<uint8_t> mEdges;   // Bit 0 is an edge on the left (red), bit 1 an edge at the top (green)
+	std::vector<uint8_t> mWeights; // RGBA blending weights
+
+	// For each band of rows, the pixels that are on an edge
+	std::vector<std::vector<uint32_t>> mEdgePixels;
+};
\ No newline at end of file
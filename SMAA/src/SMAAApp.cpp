@@ -28,8 +28,10 @@
 #include "cinder/gl/Texture.h"
 #include "cinder/gl/gl.h"
 
+#include "CpuFilterTest.h"
 #include "Pistons.h"
 #include "SMAA.h"
+#include "SMAACpu.h"
 
 using namespace ci;
 using namespace ci::app;
@@ -49,6 +51,8 @@ class SMAAApp : public App {
 
   private:
 	void render();
+	void applyCpu();
+	void compareWithGpu();
 
   private:
 	enum Mode { EDGE_DETECTION, BLEND_WEIGHTS, BLEND_NEIGHBORS };
@@ -57,6 +61,12 @@ class SMAAApp : public App {
 
 	Pistons mPistons;
 	SMAA    mSMAA;
+	SMAACpu mSMAACpu;
+
+	// If true, SMAA is applied on the CPU to a copy of the frame
+	bool             mUseCpu;
+	Surface8u        mSurfaceCpu;
+	gl::Texture2dRef mTextureCpu;
 
 	gl::FboRef mFboOriginal;
 	gl::FboRef mFboResult;
@@ -96,6 +106,7 @@ void SMAAApp::setup()
 	// initialize member variables and start the timer
 	mDividerX = getWindowWidth() / 2;
 	mMode = Mode::BLEND_NEIGHBORS;
+	mUseCpu = false;
 
 	mTimeOffset = 0.0;
 	mTimer.start();
@@ -131,7 +142,10 @@ void SMAAApp::draw()
 	render();
 
 	// Perform SMAA
-	mSMAA.apply( mFboResult, mFboOriginal );
+	if( mUseCpu )
+		applyCpu();
+	else
+		mSMAA.apply( mFboResult, mFboOriginal );
 
 	int w = getWindowWidth();
 	int h = getWindowHeight();
@@ -142,16 +156,21 @@ void SMAAApp::draw()
 		gl::ScopedBlend blend( false );
 
 		// ...with SMAA for the left side
-		switch( mMode ) {
-		case EDGE_DETECTION:
-			gl::draw( mSMAA.getEdgePass(), Area( 0, 0, mDividerX, h ), Rectf( 0, 0, (float)mDividerX, (float)h ) );
-			break;
-		case BLEND_WEIGHTS:
-			gl::draw( mSMAA.getBlendPass(), Area( 0, 0, mDividerX, h ), Rectf( 0, 0, (float)mDividerX, (float)h ) );
-			break;
-		case BLEND_NEIGHBORS:
-			gl::draw( mFboResult->getColorTexture(), Area( 0, 0, mDividerX, h ), Rectf( 0, 0, (float)mDividerX, (float)h ) );
-			break;
+		if( mUseCpu && mTextureCpu ) {
+			gl::draw( mTextureCpu, Area( 0, 0, mDividerX, h ), Rectf( 0, 0, (float)mDividerX, (float)h ) );
+		}
+		else {
+			switch( mMode ) {
+			case EDGE_DETECTION:
+				gl::draw( mSMAA.getEdgePass(), Area( 0, 0, mDividerX, h ), Rectf( 0, 0, (float)mDividerX, (float)h ) );
+				break;
+			case BLEND_WEIGHTS:
+				gl::draw( mSMAA.getBlendPass(), Area( 0, 0, mDividerX, h ), Rectf( 0, 0, (float)mDividerX, (float)h ) );
+				break;
+			case BLEND_NEIGHBORS:
+				gl::draw( mFboResult->getColorTexture(), Area( 0, 0, mDividerX, h ), Rectf( 0, 0, (float)mDividerX, (float)h ) );
+				break;
+			}
 		}
 
 		// ...and without SMAA for the right side
@@ -202,6 +221,15 @@ void SMAAApp::keyDown( KeyEvent event )
 	case KeyEvent::KEY_3:
 		mMode = Mode::BLEND_NEIGHBORS;
 		break;
+	case KeyEvent::KEY_c:
+		// Toggle between SMAA on the GPU and on the CPU
+		mUseCpu = !mUseCpu;
+		console() << "SMAA on the " << ( mUseCpu ? "CPU" : "GPU" ) << std::endl;
+		break;
+	case KeyEvent::KEY_t:
+		// Compare the result on the CPU with the result on the GPU
+		compareWithGpu();
+		break;
 	case KeyEvent::KEY_v:
 		gl::enableVerticalSync( !gl::isVerticalSyncEnabled() );
 		break;
@@ -236,4 +264,54 @@ void SMAAApp::render()
 	mPistons.draw( mCamera );
 }
 
+void SMAAApp::applyCpu()
+{
+	// Read the frame back, apply SMAA and upload the result or one of the intermediate passes
+	const Surface8u source = mFboOriginal->readPixels8u( mFboOriginal->getBounds() );
+	if( mSurfaceCpu.getSize() != source.getSize() )
+		mSurfaceCpu = Surface8u( source.getWidth(), source.getHeight(), source.hasAlpha(), source.getChannelOrder() );
+
+	mSMAACpu.apply( mSurfaceCpu, source );
+
+	switch( mMode ) {
+	case EDGE_DETECTION:
+		mSMAACpu.copyEdgePass( mSurfaceCpu );
+		break;
+	case BLEND_WEIGHTS:
+		mSMAACpu.copyBlendPass( mSurfaceCpu );
+		break;
+	case BLEND_NEIGHBORS:
+		break;
+	}
+
+	if( !mTextureCpu || mTextureCpu->getSize() != mSurfaceCpu.getSize() )
+		mTextureCpu = gl::Texture2d::create( mSurfaceCpu );
+	else
+		mTextureCpu->update( mSurfaceCpu );
+}
+
+void SMAAApp::compareWithGpu()
+{
+	// Apply SMAA to the current frame on both the GPU and the CPU
+	mSMAA.apply( mFboResult, mFboOriginal );
+
+	const Surface8u source = mFboOriginal->readPixels8u( mFboOriginal->getBounds() );
+	const Surface8u gpu = mFboResult->readPixels8u( mFboResult->getBounds() );
+	Surface8u       cpu( source.getWidth(), source.getHeight(), source.hasAlpha(), source.getChannelOrder() );
+
+	Timer timer( true );
+	mSMAACpu.apply( cpu, source );
+	timer.stop();
+
+	// Bilinear filtering on the GPU has less precision than on the CPU, so we count the pixels that differ by more than one level
+	size_t    numDifferent;
+	const int maxDifference = compareSurfaces( gpu, cpu, 1, &numDifferent, false );
+
+	const double total = double( source.getWidth() ) * source.getHeight();
+	const double percentage = 100.0 * numDifferent / total;
+	console() << "SMAA on the CPU (" << SMAACpu::getKernelName( mSMAACpu.getKernel() ) << ", " << mSMAACpu.getNumThreads() << " threads) took " << timer.getSeconds() * 1000.0 << " ms ("
+	          << 1e-6 * total / timer.getSeconds() << " MP/s) for " << mSMAACpu.getNumEdgePixels() << " pixels on an edge. Largest difference with the GPU is " << maxDifference << ", " << percentage
+	          << "% of the pixels differ by more than 1 (" << ( percentage <= kGpuTolerancePercentage ? "PASSED" : "FAILED" ) << ", tolerance " << kGpuTolerancePercentage << "%)." << std::endl;
+}
+
 CINDER_APP( SMAAApp, RendererGl )
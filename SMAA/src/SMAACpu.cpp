@@ -0,0 +1,931 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SMAACpu.h"
+
+#include "AreaTex.h"
+#include "SearchTex.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if CPU_FILTER_USE_SIMD
+#include <immintrin.h>
+#endif
+
+using namespace ci;
+
+namespace {
+
+// Settings of SMAA_PRESET_ULTRA, which is used by the shaders
+const int   kMaxSearchSteps = 32;
+const int   kMaxSearchStepsDiag = 16;
+const float kCornerRounding = 0.25f;
+const float kLocalContrastAdaptationFactor = 2.0f;
+
+// Layout of the area texture, see SMAA.glsl
+const float kAreaTexMaxDistance = 16.0f;
+const float kAreaTexMaxDistanceDiag = 20.0f;
+
+const uint8_t kEdgeLeft = 1;
+const uint8_t kEdgeTop = 2;
+
+// Offsets of the blending weights of a pixel, which are stored in the same order as the shader writes them
+const int kWeightRed = 0;
+const int kWeightGreen = 1;
+const int kWeightBlue = 2;
+const int kWeightAlpha = 3;
+
+struct Sample {
+	float r, g;
+};
+
+// The image that is being processed. Coordinates are in pixels and, as in texture space, y points up.
+//  Positions of samples are in pixels too, with the center of each pixel at ( x + 0.5, y + 0.5 ).
+struct Image {
+	float         *luma;
+	uint8_t       *edges;
+	uint8_t       *weights;
+	const uint8_t *source;
+	uint8_t       *destination;
+	ptrdiff_t      sourceRowBytes;
+	ptrdiff_t      destinationRowBytes;
+	int            width;
+	int            height;
+	int            pixelInc;
+	int            red, green, blue;
+	float          threshold;
+	float          toFloat[256];
+
+	const float *getLumaRow( int y ) const { return luma + ptrdiff_t( std::min( std::max( y, 0 ), height - 1 ) ) * width; }
+
+	// Like SMAASamplePoint on the color texture, which clamps to the edge
+	float getLuma( int x, int y ) const { return getLumaRow( y )[std::min( std::max( x, 0 ), width - 1 )]; }
+
+	// The edge and blending weight textures are cleared outside the image (GL_CLAMP_TO_BORDER)
+	uint8_t getEdges( int x, int y ) const
+	{
+		if( x < 0 || y < 0 || x >= width || y >= height )
+			return 0;
+		return edges[ptrdiff_t( y ) * width + x];
+	}
+
+	uint8_t getWeight( int x, int y, int channel ) const
+	{
+		if( x < 0 || y < 0 || x >= width || y >= height )
+			return 0;
+		return weights[( ptrdiff_t( y ) * width + x ) * 4 + channel];
+	}
+
+	// The surfaces store the top row first
+	const uint8_t *getSourcePixel( int x, int y ) const { return source + ( height - 1 - y ) * sourceRowBytes + x * pixelInc; }
+	uint8_t       *getDestinationPixel( int x, int y ) const { return destination + ( height - 1 - y ) * destinationRowBytes + x * pixelInc; }
+};
+
+inline float mix( float a, float b, float t )
+{
+	return a * ( 1.0f - t ) + b * t;
+}
+
+// Faster than std::floor, which is a function call without SSE4.1
+inline int floorToInt( float v )
+{
+	const int i = int( v );
+	return v < float( i ) ? i - 1 : i;
+}
+
+inline float roundNearest( float v )
+{
+	return float( floorToInt( v + 0.5f ) );
+}
+
+inline uint8_t toByte( float v )
+{
+	return uint8_t( std::min( std::max( v, 0.0f ), 1.0f ) * 255.0f + 0.5f );
+}
+
+// Like SMAASampleLevelZero on the edge texture, including bilinear filtering. The shaders rely on it
+//  to fetch several edges at once.
+Sample sampleEdges( const Image &image, float x, float y )
+{
+	const int   ix = floorToInt( x - 0.5f );
+	const int   iy = floorToInt( y - 0.5f );
+	const float tx = x - 0.5f - float( ix );
+	const float ty = y - 0.5f - float( iy );
+
+	uint8_t e00, e10, e01, e11;
+	if( ix >= 0 && iy >= 0 && ix + 1 < image.width && iy + 1 < image.height ) {
+		const uint8_t *edges = image.edges + ptrdiff_t( iy ) * image.width + ix;
+		e00 = edges[0];
+		e10 = edges[1];
+		e01 = edges[image.width];
+		e11 = edges[image.width + 1];
+	}
+	else {
+		e00 = image.getEdges( ix, iy );
+		e10 = image.getEdges( ix + 1, iy );
+		e01 = image.getEdges( ix, iy + 1 );
+		e11 = image.getEdges( ix + 1, iy + 1 );
+	}
+
+	Sample result;
+	result.r = mix( mix( float( e00 & kEdgeLeft ), float( e10 & kEdgeLeft ), tx ), mix( float( e01 & kEdgeLeft ), float( e11 & kEdgeLeft ), tx ), ty );
+	result.g = mix( mix( float( e00 >> 1 ), float( e10 >> 1 ), tx ), mix( float( e01 >> 1 ), float( e11 >> 1 ), tx ), ty );
+	return result;
+}
+
+// Bilinear lookup in the area or search texture, at a position in texels. Writes one value for each channel.
+void sampleTexture( const unsigned char *bytes, int width, int height, int numChannels, float x, float y, float *result )
+{
+	const int   ix = floorToInt( x - 0.5f );
+	const int   iy = floorToInt( y - 0.5f );
+	const float tx = x - 0.5f - float( ix );
+	const float ty = y - 0.5f - float( iy );
+
+	// Like the edge texture, the lookup textures are cleared outside (GL_CLAMP_TO_BORDER)
+	float texels[4][2] = {};
+	for( int j = 0; j < 2; ++j ) {
+		for( int i = 0; i < 2; ++i ) {
+			const int u = ix + i;
+			const int v = iy + j;
+			if( u >= 0 && v >= 0 && u < width && v < height )
+				for( int c = 0; c < numChannels; ++c )
+					texels[j * 2 + i][c] = bytes[( v * width + u ) * numChannels + c] / 255.0f;
+		}
+	}
+
+	for( int c = 0; c < numChannels; ++c )
+		result[c] = mix( mix( texels[0][c], texels[1][c], tx ), mix( texels[2][c], texels[3][c], tx ), ty );
+}
+
+Sample sampleArea( float x, float y )
+{
+	float texel[2];
+	sampleTexture( areaTexBytes, AREATEX_WIDTH, AREATEX_HEIGHT, 2, x, y, texel );
+
+	Sample result = { texel[0], texel[1] };
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// First pass: luma edge detection
+
+// Same as SMAALumaEdgeDetectionPS. Returns the edges of a pixel.
+uint8_t detectEdges( const Image &image, int x, int y )
+{
+	const float L = image.getLuma( x, y );
+	const float Lleft = image.getLuma( x - 1, y );
+	const float Ltop = image.getLuma( x, y - 1 );
+
+	const float deltaLeft = std::abs( L - Lleft );
+	const float deltaTop = std::abs( L - Ltop );
+
+	bool edgeLeft = deltaLeft >= image.threshold;
+	bool edgeTop = deltaTop >= image.threshold;
+	if( !edgeLeft && !edgeTop )
+		return 0;
+
+	const float deltaRight = std::abs( L - image.getLuma( x + 1, y ) );
+	const float deltaBottom = std::abs( L - image.getLuma( x, y + 1 ) );
+	const float deltaLeftLeft = std::abs( Lleft - image.getLuma( x - 2, y ) );
+	const float deltaTopTop = std::abs( Ltop - image.getLuma( x, y - 2 ) );
+
+	// Local contrast adaptation
+	const float maxDeltaX = std::max( std::max( deltaLeft, deltaRight ), deltaLeftLeft );
+	const float maxDeltaY = std::max( std::max( deltaTop, deltaBottom ), deltaTopTop );
+	const float finalDelta = std::max( maxDeltaX, maxDeltaY );
+
+	edgeLeft = edgeLeft && finalDelta <= kLocalContrastAdaptationFactor * deltaLeft;
+	edgeTop = edgeTop && finalDelta <= kLocalContrastAdaptationFactor * deltaTop;
+
+	return ( edgeLeft ? kEdgeLeft : 0 ) | ( edgeTop ? kEdgeTop : 0 );
+}
+
+inline void storeEdges( const Image &image, int x, int y, uint8_t edges, std::vector<uint32_t> &edgePixels )
+{
+	image.edges[ptrdiff_t( y ) * image.width + x] = edges;
+	if( edges )
+		edgePixels.push_back( uint32_t( y ) * image.width + x );
+}
+
+void detectEdgesRowScalar( const Image &image, int y, std::vector<uint32_t> &edgePixels )
+{
+	for( int x = 0; x < image.width; ++x )
+		storeEdges( image, x, y, detectEdges( image, x, y ), edgePixels );
+}
+
+//-----------------------------------------------------------------------------
+// Second pass: blending weight calculation
+
+// Same as SMAADecodeDiagBilinearAccess for the red channel. A sample at a 0.25 offset returns 0.25 or 1.0
+//  if the red edge on the right is enabled, which this turns into 0 or 1.
+inline float decodeDiagBilinearAccess( float r )
+{
+	return roundNearest( r * std::abs( 5.0f * r - 5.0f * 0.75f ) );
+}
+
+// Same as SMAASearchDiag1. Returns the number of steps and whether the line continues.
+Sample searchDiag1( const Image &image, float x, float y, float dirX, float dirY, Sample *e )
+{
+	float steps = -1.0f;
+	float continues = 1.0f;
+	while( steps < float( kMaxSearchStepsDiag - 1 ) && continues > 0.9f ) {
+		x += dirX;
+		y += dirY;
+		steps += 1.0f;
+		*e = sampleEdges( image, x, y );
+		continues = e->r * 0.5f + e->g * 0.5f;
+	}
+
+	Sample result = { steps, continues };
+	return result;
+}
+
+// Same as SMAASearchDiag2, which fetches the edge on the left of the next pixel at the same time
+Sample searchDiag2( const Image &image, float x, float y, float dirX, float dirY, Sample *e )
+{
+	float steps = -1.0f;
+	float continues = 1.0f;
+	x += 0.25f;
+	while( steps < float( kMaxSearchStepsDiag - 1 ) && continues > 0.9f ) {
+		x += dirX;
+		y += dirY;
+		steps += 1.0f;
+		*e = sampleEdges( image, x, y );
+		e->r = decodeDiagBilinearAccess( e->r );
+		e->g = roundNearest( e->g );
+		continues = e->r * 0.5f + e->g * 0.5f;
+	}
+
+	Sample result = { steps, continues };
+	return result;
+}
+
+// Same as SMAAAreaDiag, without subsample indices
+Sample areaDiag( float distX, float distY, float e1, float e2 )
+{
+	const float x = kAreaTexMaxDistanceDiag * e1 + distX + 0.5f + 0.5f * AREATEX_WIDTH;
+	const float y = kAreaTexMaxDistanceDiag * e2 + distY + 0.5f;
+	return sampleArea( x, y );
+}
+
+// Same as SMAACalculateDiagWeights
+Sample calculateDiagWeights( const Image &image, float px, float py, const Sample &e )
+{
+	Sample weights = { 0.0f, 0.0f };
+	Sample end;
+	float  d[4];
+
+	// Search for the line ends
+	if( e.r > 0.0f ) {
+		const Sample s = searchDiag1( image, px, py, -1.0f, 1.0f, &end );
+		d[0] = s.r + ( end.g > 0.9f ? 1.0f : 0.0f );
+		d[2] = s.g;
+	}
+	else {
+		d[0] = d[2] = 0.0f;
+	}
+	{
+		const Sample s = searchDiag1( image, px, py, 1.0f, -1.0f, &end );
+		d[1] = s.r;
+		d[3] = s.g;
+	}
+
+	if( d[0] + d[1] > 2.0f ) {
+		// Fetch the crossing edges
+		const Sample left = sampleEdges( image, px - d[0] + 0.25f - 1.0f, py + d[0] );
+		const Sample right = sampleEdges( image, px + d[1] + 1.0f, py - d[1] - 0.25f );
+
+		// Decode the edges, swizzled as c.yxwz in the shader
+		const float c[4] = { roundNearest( left.g ), decodeDiagBilinearAccess( left.r ), roundNearest( right.g ), decodeDiagBilinearAccess( right.r ) };
+
+		// Merge crossing edges at each side into a single value, and remove them if we didn't find the end of the line
+		const float cc1 = d[2] >= 0.9f ? 0.0f : 2.0f * c[0] + c[1];
+		const float cc2 = d[3] >= 0.9f ? 0.0f : 2.0f * c[2] + c[3];
+
+		const Sample area = areaDiag( d[0], d[1], cc1, cc2 );
+		weights.r += area.r;
+		weights.g += area.g;
+	}
+
+	// Search for the line ends
+	{
+		const Sample s = searchDiag2( image, px, py, -1.0f, -1.0f, &end );
+		d[0] = s.r;
+		d[2] = s.g;
+	}
+	if( sampleEdges( image, px + 1.0f, py ).r > 0.0f ) {
+		const Sample s = searchDiag2( image, px, py, 1.0f, 1.0f, &end );
+		d[1] = s.r + ( end.g > 0.9f ? 1.0f : 0.0f );
+		d[3] = s.g;
+	}
+	else {
+		d[1] = d[3] = 0.0f;
+	}
+
+	if( d[0] + d[1] > 2.0f ) {
+		// Fetch the crossing edges
+		const float c0 = sampleEdges( image, px - d[0] - 1.0f, py - d[0] ).g;
+		const float c1 = sampleEdges( image, px - d[0], py - d[0] - 1.0f ).r;
+		const Sample right = sampleEdges( image, px + d[1] + 1.0f, py + d[1] );
+
+		const float cc1 = d[2] >= 0.9f ? 0.0f : 2.0f * c0 + c1;
+		const float cc2 = d[3] >= 0.9f ? 0.0f : 2.0f * right.g + right.r;
+
+		const Sample area = areaDiag( d[0], d[1], cc1, cc2 );
+		weights.r += area.g;
+		weights.g += area.r;
+	}
+
+	return weights;
+}
+
+// Same as SMAASearchLength. The search texture is cropped, the rest of it is zero.
+float searchLength( float e1, float e2, float offset )
+{
+	const float x = 32.0f * e1 + 66.0f * offset + 0.5f;
+	const float y = -32.0f * e2 + 32.5f;
+
+	float texel;
+	sampleTexture( searchTexBytes, SEARCHTEX_WIDTH, SEARCHTEX_HEIGHT, 1, x, y, &texel );
+	return texel;
+}
+
+// Same as SMAASearchXLeft, SMAASearchXRight, SMAASearchYUp and SMAASearchYDown. Every step fetches
+//  four edges at once, see @PSEUDO_GATHER4 in SMAA.glsl.
+float searchXLeft( const Image &image, float x, float y, float end )
+{
+	Sample e = { 0.0f, 1.0f };
+	while( x > end && e.g > 0.8281f && e.r == 0.0f ) {
+		e = sampleEdges( image, x, y );
+		x -= 2.0f;
+	}
+
+	const float offset = 3.25f - ( 255.0f / 127.0f ) * searchLength( e.r, e.g, 0.0f );
+	return x + offset;
+}
+
+float searchXRight( const Image &image, float x, float y, float end )
+{
+	Sample e = { 0.0f, 1.0f };
+	while( x < end && e.g > 0.8281f && e.r == 0.0f ) {
+		e = sampleEdges( image, x, y );
+		x += 2.0f;
+	}
+
+	const float offset = 3.25f - ( 255.0f / 127.0f ) * searchLength( e.r, e.g, 0.5f );
+	return x - offset;
+}
+
+float searchYUp( const Image &image, float x, float y, float end )
+{
+	Sample e = { 1.0f, 0.0f };
+	while( y > end && e.r > 0.8281f && e.g == 0.0f ) {
+		e = sampleEdges( image, x, y );
+		y -= 2.0f;
+	}
+
+	const float offset = 3.25f - ( 255.0f / 127.0f ) * searchLength( e.g, e.r, 0.0f );
+	return y + offset;
+}
+
+float searchYDown( const Image &image, float x, float y, float end )
+{
+	Sample e = { 1.0f, 0.0f };
+	while( y < end && e.r > 0.8281f && e.g == 0.0f ) {
+		e = sampleEdges( image, x, y );
+		y += 2.0f;
+	}
+
+	const float offset = 3.25f - ( 255.0f / 127.0f ) * searchLength( e.g, e.r, 0.5f );
+	return y - offset;
+}
+
+// Same as SMAAArea, without subsample indices. The area texture is compressed quadratically.
+Sample area( float distX, float distY, float e1, float e2 )
+{
+	const float x = kAreaTexMaxDistance * roundNearest( 4.0f * e1 ) + std::sqrt( distX ) + 0.5f;
+	const float y = kAreaTexMaxDistance * roundNearest( 4.0f * e2 ) + std::sqrt( distY ) + 0.5f;
+	return sampleArea( x, y );
+}
+
+// Same as SMAADetectHorizontalCornerPattern and SMAADetectVerticalCornerPattern. The crossing edges
+//  are fetched by the caller.
+void detectCornerPattern( Sample *weights, float distX, float distY, float e1, float e2, float e3, float e4 )
+{
+	const float left = distX <= distY ? 1.0f : 0.0f;
+	const float right = distY <= distX ? 1.0f : 0.0f;
+
+	// Reduce blending for pixels in the center of a line
+	const float roundingLeft = ( 1.0f - kCornerRounding ) * left / ( left + right );
+	const float roundingRight = ( 1.0f - kCornerRounding ) * right / ( left + right );
+
+	const float factor1 = 1.0f - roundingLeft * e1 - roundingRight * e2;
+	const float factor2 = 1.0f - roundingLeft * e3 - roundingRight * e4;
+
+	weights->r *= std::min( std::max( factor1, 0.0f ), 1.0f );
+	weights->g *= std::min( std::max( factor2, 0.0f ), 1.0f );
+}
+
+// Same as SMAABlendingWeightCalculationPS, for a pixel on an edge. Writes its blending weights.
+void calculateBlendingWeights( const Image &image, int x, int y )
+{
+	const float px = x + 0.5f;
+	const float py = y + 0.5f;
+
+	float weights[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	Sample e = sampleEdges( image, px, py );
+
+	// Edge at north
+	if( e.g > 0.0f ) {
+		// Diagonals have both north and west edges, so searching for them in one of the boundaries is enough.
+		//  We give priority to diagonals, so if we find a diagonal we skip horizontal/vertical processing.
+		const Sample diag = calculateDiagWeights( image, px, py, e );
+		weights[0] = diag.r;
+		weights[1] = diag.g;
+
+		if( diag.r == -diag.g ) {
+			// Find the distance to the left and to the right, and fetch the crossing edges at both ends
+			const float left = searchXLeft( image, px - 0.25f, py - 0.125f, px - 0.25f - 2.0f * kMaxSearchSteps );
+			const float right = searchXRight( image, px + 1.25f, py - 0.125f, px + 1.25f + 2.0f * kMaxSearchSteps );
+
+			const float distLeft = std::abs( roundNearest( left - px ) );
+			const float distRight = std::abs( roundNearest( right - px ) );
+
+			const float e1 = sampleEdges( image, left, py - 0.25f ).r;
+			const float e2 = sampleEdges( image, right + 1.0f, py - 0.25f ).r;
+
+			Sample result = area( distLeft, distRight, e1, e2 );
+
+			// Fix corners
+			detectCornerPattern( &result, distLeft, distRight, sampleEdges( image, left, py + 1.0f ).r, sampleEdges( image, right + 1.0f, py + 1.0f ).r,
+			                     sampleEdges( image, left, py - 2.0f ).r, sampleEdges( image, right + 1.0f, py - 2.0f ).r );
+
+			weights[0] = result.r;
+			weights[1] = result.g;
+		}
+		else {
+			// Skip vertical processing
+			e.r = 0.0f;
+		}
+	}
+
+	// Edge at west
+	if( e.r > 0.0f ) {
+		// Find the distance to the top and to the bottom, and fetch the crossing edges at both ends
+		const float top = searchYUp( image, px - 0.125f, py - 0.25f, py - 0.25f - 2.0f * kMaxSearchSteps );
+		const float bottom = searchYDown( image, px - 0.125f, py + 1.25f, py + 1.25f + 2.0f * kMaxSearchSteps );
+
+		const float distTop = std::abs( roundNearest( top - py ) );
+		const float distBottom = std::abs( roundNearest( bottom - py ) );
+
+		const float e1 = sampleEdges( image, px - 0.25f, top ).g;
+		const float e2 = sampleEdges( image, px - 0.25f, bottom + 1.0f ).g;
+
+		Sample result = area( distTop, distBottom, e1, e2 );
+
+		// Fix corners
+		detectCornerPattern( &result, distTop, distBottom, sampleEdges( image, px + 1.0f, top ).g, sampleEdges( image, px + 1.0f, bottom + 1.0f ).g,
+		                     sampleEdges( image, px - 2.0f, top ).g, sampleEdges( image, px - 2.0f, bottom + 1.0f ).g );
+
+		weights[2] = result.r;
+		weights[3] = result.g;
+	}
+
+	// Like the render target of the shader, store the weights with 8 bits of precision
+	uint8_t *pixel = image.weights + ( ptrdiff_t( y ) * image.width + x ) * 4;
+	for( int i = 0; i < 4; ++i )
+		pixel[i] = toByte( weights[i] );
+}
+
+//-----------------------------------------------------------------------------
+// Third pass: neighborhood blending
+
+// Same as SMAANeighborhoodBlendingPS. Pixels without blending weights have already been copied.
+void blendPixel( const Image &image, int x, int y )
+{
+	// Fetch the blending weights for the current pixel
+	const float right = image.toFloat[image.getWeight( x + 1, y, kWeightAlpha )];
+	const float top = image.toFloat[image.getWeight( x, y + 1, kWeightGreen )];
+	const float left = image.toFloat[image.getWeight( x, y, kWeightBlue )];
+	const float bottom = image.toFloat[image.getWeight( x, y, kWeightRed )];
+
+	if( right + top + left + bottom < 1e-5f )
+		return;
+
+	// Blend horizontally or vertically, whichever has the largest weight
+	const bool h = std::max( right, left ) > std::max( top, bottom );
+
+	const float offset1 = h ? right : top;
+	const float offset2 = h ? left : bottom;
+	const float sum = offset1 + offset2;
+
+	// The shader exploits bilinear filtering to mix the current pixel with the chosen neighbors, which
+	//  clamps to the edge of the image
+	const uint8_t *pixel = image.getSourcePixel( x, y );
+	const uint8_t *neighbor1 = h ? image.getSourcePixel( std::min( x + 1, image.width - 1 ), y ) : image.getSourcePixel( x, std::min( y + 1, image.height - 1 ) );
+	const uint8_t *neighbor2 = h ? image.getSourcePixel( std::max( x - 1, 0 ), y ) : image.getSourcePixel( x, std::max( y - 1, 0 ) );
+	uint8_t       *destination = image.getDestinationPixel( x, y );
+
+	// Alpha is copied unchanged
+	const int channels[3] = { image.red, image.green, image.blue };
+	for( int i = 0; i < 3; ++i ) {
+		const int   c = channels[i];
+		const float color = image.toFloat[pixel[c]];
+		const float color1 = mix( color, image.toFloat[neighbor1[c]], offset1 );
+		const float color2 = mix( color, image.toFloat[neighbor2[c]], offset2 );
+
+		destination[c] = toByte( offset1 / sum * color1 + offset2 / sum * color2 );
+	}
+}
+
+void blendRowScalar( const Image &image, int y )
+{
+	for( int x = 0; x < image.width; ++x )
+		blendPixel( image, x, y );
+}
+
+#if CPU_FILTER_USE_SIMD
+
+//-----------------------------------------------------------------------------
+// SIMD kernels
+
+// Same as detectEdges(), for 4 pixels at once
+CPU_FILTER_TARGET_SSE41 void detectEdgesRowSse41( const Image &image, int y, std::vector<uint32_t> &edgePixels )
+{
+	const float *rowTopTop = image.getLumaRow( y - 2 );
+	const float *rowTop = image.getLumaRow( y - 1 );
+	const float *row = image.getLumaRow( y );
+	const float *rowBottom = image.getLumaRow( y + 1 );
+
+	const __m128 sign = _mm_set1_ps( -0.0f );
+	const __m128 threshold = _mm_set1_ps( image.threshold );
+	const __m128 factor = _mm_set1_ps( kLocalContrastAdaptationFactor );
+
+	// The first two pixels need the left edge of the image to be clamped
+	int x = 0;
+	for( ; x < 2 && x < image.width; ++x )
+		storeEdges( image, x, y, detectEdges( image, x, y ), edgePixels );
+
+	for( ; x + 4 < image.width; x += 4 ) {
+		const __m128 L = _mm_loadu_ps( row + x );
+		const __m128 Lleft = _mm_loadu_ps( row + x - 1 );
+		const __m128 Ltop = _mm_loadu_ps( rowTop + x );
+
+		const __m128 deltaLeft = _mm_andnot_ps( sign, _mm_sub_ps( L, Lleft ) );
+		const __m128 deltaTop = _mm_andnot_ps( sign, _mm_sub_ps( L, Ltop ) );
+
+		__m128 edgeLeft = _mm_cmpge_ps( deltaLeft, threshold );
+		__m128 edgeTop = _mm_cmpge_ps( deltaTop, threshold );
+		if( _mm_movemask_ps( _mm_or_ps( edgeLeft, edgeTop ) ) == 0 ) {
+			std::memset( image.edges + ptrdiff_t( y ) * image.width + x, 0, 4 );
+			continue;
+		}
+
+		const __m128 deltaRight = _mm_andnot_ps( sign, _mm_sub_ps( L, _mm_loadu_ps( row + x + 1 ) ) );
+		const __m128 deltaBottom = _mm_andnot_ps( sign, _mm_sub_ps( L, _mm_loadu_ps( rowBottom + x ) ) );
+		const __m128 deltaLeftLeft = _mm_andnot_ps( sign, _mm_sub_ps( Lleft, _mm_loadu_ps( row + x - 2 ) ) );
+		const __m128 deltaTopTop = _mm_andnot_ps( sign, _mm_sub_ps( Ltop, _mm_loadu_ps( rowTopTop + x ) ) );
+
+		const __m128 maxDeltaX = _mm_max_ps( _mm_max_ps( deltaLeft, deltaRight ), deltaLeftLeft );
+		const __m128 maxDeltaY = _mm_max_ps( _mm_max_ps( deltaTop, deltaBottom ), deltaTopTop );
+		const __m128 finalDelta = _mm_max_ps( maxDeltaX, maxDeltaY );
+
+		edgeLeft = _mm_and_ps( edgeLeft, _mm_cmple_ps( finalDelta, _mm_mul_ps( factor, deltaLeft ) ) );
+		edgeTop = _mm_and_ps( edgeTop, _mm_cmple_ps( finalDelta, _mm_mul_ps( factor, deltaTop ) ) );
+
+		const int left = _mm_movemask_ps( edgeLeft );
+		const int top = _mm_movemask_ps( edgeTop );
+		for( int i = 0; i < 4; ++i )
+			storeEdges( image, x + i, y, uint8_t( ( ( left >> i ) & 1 ) * kEdgeLeft | ( ( top >> i ) & 1 ) * kEdgeTop ), edgePixels );
+	}
+
+	for( ; x < image.width; ++x )
+		storeEdges( image, x, y, detectEdges( image, x, y ), edgePixels );
+}
+
+// Same as blendRowScalar(), but skips 4 pixels at a time if none of them have blending weights
+CPU_FILTER_TARGET_SSE41 void blendRowSse41( const Image &image, int y )
+{
+	// The last row has no neighbors at the top
+	if( y == image.height - 1 ) {
+		blendRowScalar( image, y );
+		return;
+	}
+
+	const uint8_t *row = image.weights + ptrdiff_t( y ) * image.width * 4;
+	const uint8_t *rowTop = row + image.width * 4;
+
+	// Red and blue weights of the pixel itself, alpha of its right neighbor and green of its top neighbor
+	const __m128i maskRedBlue = _mm_set1_epi32( 0x00FF00FF );
+	const __m128i maskGreen = _mm_set1_epi32( 0x0000FF00 );
+	const __m128i maskAlpha = _mm_set1_epi32( int( 0xFF000000 ) );
+	const __m128i zero = _mm_setzero_si128();
+
+	int x = 0;
+	for( ; x + 4 < image.width; x += 4 ) {
+		const __m128i weights = _mm_and_si128( _mm_loadu_si128( (const __m128i *)( row + x * 4 ) ), maskRedBlue );
+		const __m128i right = _mm_and_si128( _mm_loadu_si128( (const __m128i *)( row + x * 4 + 4 ) ), maskAlpha );
+		const __m128i top = _mm_and_si128( _mm_loadu_si128( (const __m128i *)( rowTop + x * 4 ) ), maskGreen );
+
+		const __m128i any = _mm_or_si128( _mm_or_si128( weights, right ), top );
+		const int     lanes = ~_mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( any, zero ) ) ) & 0xF;
+		for( int i = 0; i < 4; ++i )
+			if( lanes & ( 1 << i ) )
+				blendPixel( image, x + i, y );
+	}
+
+	for( ; x < image.width; ++x )
+		blendPixel( image, x, y );
+}
+
+// Same as detectEdges(), for 8 pixels at once
+CPU_FILTER_TARGET_AVX2 void detectEdgesRowAvx2( const Image &image, int y, std::vector<uint32_t> &edgePixels )
+{
+	const float *rowTopTop = image.getLumaRow( y - 2 );
+	const float *rowTop = image.getLumaRow( y - 1 );
+	const float *row = image.getLumaRow( y );
+	const float *rowBottom = image.getLumaRow( y + 1 );
+
+	const __m256 sign = _mm256_set1_ps( -0.0f );
+	const __m256 threshold = _mm256_set1_ps( image.threshold );
+	const __m256 factor = _mm256_set1_ps( kLocalContrastAdaptationFactor );
+
+	// The first two pixels need the left edge of the image to be clamped
+	int x = 0;
+	for( ; x < 2 && x < image.width; ++x )
+		storeEdges( image, x, y, detectEdges( image, x, y ), edgePixels );
+
+	for( ; x + 8 < image.width; x += 8 ) {
+		const __m256 L = _mm256_loadu_ps( row + x );
+		const __m256 Lleft = _mm256_loadu_ps( row + x - 1 );
+		const __m256 Ltop = _mm256_loadu_ps( rowTop + x );
+
+		const __m256 deltaLeft = _mm256_andnot_ps( sign, _mm256_sub_ps( L, Lleft ) );
+		const __m256 deltaTop = _mm256_andnot_ps( sign, _mm256_sub_ps( L, Ltop ) );
+
+		__m256 edgeLeft = _mm256_cmp_ps( deltaLeft, threshold, _CMP_GE_OQ );
+		__m256 edgeTop = _mm256_cmp_ps( deltaTop, threshold, _CMP_GE_OQ );
+		if( _mm256_movemask_ps( _mm256_or_ps( edgeLeft, edgeTop ) ) == 0 ) {
+			std::memset( image.edges + ptrdiff_t( y ) * image.width + x, 0, 8 );
+			continue;
+		}
+
+		const __m256 deltaRight = _mm256_andnot_ps( sign, _mm256_sub_ps( L, _mm256_loadu_ps( row + x + 1 ) ) );
+		const __m256 deltaBottom = _mm256_andnot_ps( sign, _mm256_sub_ps( L, _mm256_loadu_ps( rowBottom + x ) ) );
+		const __m256 deltaLeftLeft = _mm256_andnot_ps( sign, _mm256_sub_ps( Lleft, _mm256_loadu_ps( row + x - 2 ) ) );
+		const __m256 deltaTopTop = _mm256_andnot_ps( sign, _mm256_sub_ps( Ltop, _mm256_loadu_ps( rowTopTop + x ) ) );
+
+		const __m256 maxDeltaX = _mm256_max_ps( _mm256_max_ps( deltaLeft, deltaRight ), deltaLeftLeft );
+		const __m256 maxDeltaY = _mm256_max_ps( _mm256_max_ps( deltaTop, deltaBottom ), deltaTopTop );
+		const __m256 finalDelta = _mm256_max_ps( maxDeltaX, maxDeltaY );
+
+		edgeLeft = _mm256_and_ps( edgeLeft, _mm256_cmp_ps( finalDelta, _mm256_mul_ps( factor, deltaLeft ), _CMP_LE_OQ ) );
+		edgeTop = _mm256_and_ps( edgeTop, _mm256_cmp_ps( finalDelta, _mm256_mul_ps( factor, deltaTop ), _CMP_LE_OQ ) );
+
+		const int left = _mm256_movemask_ps( edgeLeft );
+		const int top = _mm256_movemask_ps( edgeTop );
+		for( int i = 0; i < 8; ++i )
+			storeEdges( image, x + i, y, uint8_t( ( ( left >> i ) & 1 ) * kEdgeLeft | ( ( top >> i ) & 1 ) * kEdgeTop ), edgePixels );
+	}
+
+	// Avoid the penalty of mixing AVX and SSE instructions in the scalar code
+	_mm256_zeroupper();
+
+	for( ; x < image.width; ++x )
+		storeEdges( image, x, y, detectEdges( image, x, y ), edgePixels );
+}
+
+// Same as blendRowScalar(), but skips 8 pixels at a time if none of them have blending weights
+CPU_FILTER_TARGET_AVX2 void blendRowAvx2( const Image &image, int y )
+{
+	// The last row has no neighbors at the top
+	if( y == image.height - 1 ) {
+		blendRowScalar( image, y );
+		return;
+	}
+
+	const uint8_t *row = image.weights + ptrdiff_t( y ) * image.width * 4;
+	const uint8_t *rowTop = row + image.width * 4;
+
+	// Red and blue weights of the pixel itself, alpha of its right neighbor and green of its top neighbor
+	const __m256i maskRedBlue = _mm256_set1_epi32( 0x00FF00FF );
+	const __m256i maskGreen = _mm256_set1_epi32( 0x0000FF00 );
+	const __m256i maskAlpha = _mm256_set1_epi32( int( 0xFF000000 ) );
+	const __m256i zero = _mm256_setzero_si256();
+
+	int x = 0;
+	for( ; x + 8 < image.width; x += 8 ) {
+		const __m256i weights = _mm256_and_si256( _mm256_loadu_si256( (const __m256i *)( row + x * 4 ) ), maskRedBlue );
+		const __m256i right = _mm256_and_si256( _mm256_loadu_si256( (const __m256i *)( row + x * 4 + 4 ) ), maskAlpha );
+		const __m256i top = _mm256_and_si256( _mm256_loadu_si256( (const __m256i *)( rowTop + x * 4 ) ), maskGreen );
+
+		const __m256i any = _mm256_or_si256( _mm256_or_si256( weights, right ), top );
+		const int     lanes = ~_mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32( any, zero ) ) ) & 0xFF;
+		if( lanes == 0 )
+			continue;
+
+		// Avoid the penalty of mixing AVX and SSE instructions in the scalar code
+		_mm256_zeroupper();
+
+		for( int i = 0; i < 8; ++i )
+			if( lanes & ( 1 << i ) )
+				blendPixel( image, x + i, y );
+	}
+
+	_mm256_zeroupper();
+
+	for( ; x < image.width; ++x )
+		blendPixel( image, x, y );
+}
+
+#endif // CPU_FILTER_USE_SIMD
+
+// Computes the luminance of the pixels in a range of rows, with the weights of SMAALumaEdgeDetectionPS
+void extractLuma( const Image &image, const float *weights, int begin, int end )
+{
+	for( int y = begin; y < end; ++y ) {
+		float         *luma = image.luma + ptrdiff_t( y ) * image.width;
+		const uint8_t *pixel = image.getSourcePixel( 0, y );
+		for( int x = 0; x < image.width; ++x, pixel += image.pixelInc )
+			luma[x] = weights[pixel[image.red]] + weights[256 + pixel[image.green]] + weights[512 + pixel[image.blue]];
+	}
+}
+
+} // anonymous namespace
+
+SMAACpu::SMAACpu()
+    : mThreshold( 0.05f )
+    , mWidth( 0 )
+    , mHeight( 0 )
+{
+}
+
+size_t SMAACpu::getNumEdgePixels() const
+{
+	size_t count = 0;
+	for( const auto &edgePixels : mEdgePixels )
+		count += edgePixels.size();
+
+	return count;
+}
+
+void SMAACpu::apply( Surface8u &destination, const Surface8u &source )
+{
+	// Source and destination should have the same size and layout
+	assert( destination.getWidth() == source.getWidth() );
+	assert( destination.getHeight() == source.getHeight() );
+	assert( destination.getPixelInc() == source.getPixelInc() );
+	assert( destination.getData() != source.getData() );
+
+	const int width = source.getWidth();
+	const int height = source.getHeight();
+	if( width <= 0 || height <= 0 )
+		return;
+
+	mWidth = width;
+	mHeight = height;
+	mLuma.resize( size_t( width ) * height );
+	mEdges.resize( size_t( width ) * height );
+	mWeights.resize( size_t( width ) * height * 4 );
+	mEdgePixels.resize( getNumBands( height ) );
+
+	Image image;
+	image.luma = mLuma.data();
+	image.edges = mEdges.data();
+	image.weights = mWeights.data();
+	image.source = source.getData();
+	image.destination = destination.getData();
+	image.sourceRowBytes = source.getRowBytes();
+	image.destinationRowBytes = destination.getRowBytes();
+	image.width = width;
+	image.height = height;
+	image.pixelInc = source.getPixelInc();
+	image.red = source.getRedOffset();
+	image.green = source.getGreenOffset();
+	image.blue = source.getBlueOffset();
+	image.threshold = mThreshold;
+
+	for( int i = 0; i < 256; ++i )
+		image.toFloat[i] = i / 255.0f;
+
+	// Luminance of each value of the red, green and blue channels
+	float lumaWeights[3 * 256];
+	for( int i = 0; i < 256; ++i ) {
+		lumaWeights[i] = image.toFloat[i] * 0.2126f;
+		lumaWeights[256 + i] = image.toFloat[i] * 0.7152f;
+		lumaWeights[512 + i] = image.toFloat[i] * 0.0722f;
+	}
+
+	void ( *detectEdgesRow )( const Image &, int, std::vector<uint32_t> & ) = detectEdgesRowScalar;
+	void ( *blendRow )( const Image &, int ) = blendRowScalar;
+#if CPU_FILTER_USE_SIMD
+	switch( getKernel() ) {
+	case SSE41:
+		detectEdgesRow = detectEdgesRowSse41;
+		blendRow = blendRowSse41;
+		break;
+	case AVX2:
+		detectEdgesRow = detectEdgesRowAvx2;
+		blendRow = blendRowAvx2;
+		break;
+	default:
+		break;
+	}
+#endif
+
+	// Each pass reads the results of the previous pass in other bands, so all bands finish a pass before the next one starts
+	processBands( height, 4, [&]( int pass, int band, int begin, int end ) {
+		switch( pass ) {
+		case 0:
+			extractLuma( image, lumaWeights, begin, end );
+			break;
+		case 1:
+			// First pass: edge detection, which also clears the blending weights
+			std::memset( image.weights + ptrdiff_t( begin ) * width * 4, 0, size_t( end - begin ) * width * 4 );
+
+			mEdgePixels[band].clear();
+			for( int y = begin; y < end; ++y )
+				detectEdgesRow( image, y, mEdgePixels[band] );
+			break;
+		case 2:
+			// Second pass: blending weight calculation, only for the pixels on an edge
+			for( uint32_t index : mEdgePixels[band] )
+				calculateBlendingWeights( image, int( index % uint32_t( width ) ), int( index / uint32_t( width ) ) );
+			break;
+		default:
+			// Third pass: neighborhood blending. Pixels without blending weights are copied unchanged.
+			for( int y = begin; y < end; ++y ) {
+				std::memcpy( image.getDestinationPixel( 0, y ), image.getSourcePixel( 0, y ), size_t( width ) * image.pixelInc );
+				blendRow( image, y );
+			}
+			break;
+		}
+	} );
+}
+
+void SMAACpu::copyEdgePass( Surface8u &destination ) const
+{
+	assert( destination.getWidth() == mWidth && destination.getHeight() == mHeight );
+
+	const uint8_t red = destination.getRedOffset();
+	const uint8_t green = destination.getGreenOffset();
+	const uint8_t blue = destination.getBlueOffset();
+
+	for( int y = 0; y < mHeight; ++y ) {
+		const uint8_t *edges = mEdges.data() + ptrdiff_t( y ) * mWidth;
+		uint8_t       *pixel = destination.getData() + ( mHeight - 1 - y ) * destination.getRowBytes();
+
+		for( int x = 0; x < mWidth; ++x, pixel += destination.getPixelInc() ) {
+			pixel[red] = ( edges[x] & kEdgeLeft ) ? 255 : 0;
+			pixel[green] = ( edges[x] & kEdgeTop ) ? 255 : 0;
+			pixel[blue] = 0;
+			if( destination.hasAlpha() )
+				pixel[destination.getAlphaOffset()] = 255;
+		}
+	}
+}
+
+void SMAACpu::copyBlendPass( Surface8u &destination ) const
+{
+	assert( destination.getWidth() == mWidth && destination.getHeight() == mHeight );
+
+	const uint8_t red = destination.getRedOffset();
+	const uint8_t green = destination.getGreenOffset();
+	const uint8_t blue = destination.getBlueOffset();
+
+	for( int y = 0; y < mHeight; ++y ) {
+		const uint8_t *weights = mWeights.data() + ptrdiff_t( y ) * mWidth * 4;
+		uint8_t       *pixel = destination.getData() + ( mHeight - 1 - y ) * destination.getRowBytes();
+
+		for( int x = 0; x < mWidth; ++x, weights += 4, pixel += destination.getPixelInc() ) {
+			pixel[red] = weights[kWeightRed];
+			pixel[green] = weights[kWeightGreen];
+			pixel[blue] = weights[kWeightBlue];
+			if( destination.hasAlpha() )
+				pixel[destination.getAlphaOffset()] = weights[kWeightAlpha];
+		}
+	}
+}
\ No newline at end of file